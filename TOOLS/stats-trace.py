@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+
+"""
+Convert a file written by mpv --dump-stats=filename to the Chrome trace event
+JSON format, which can be loaded by chrome://tracing, Perfetto, and similar
+trace viewers:
+
+    stats-trace.py stats.dump > trace.json
+
+Both --dump-stats-format=text (see stats-conv.py) and binary are accepted.
+Text files carry no thread information, so each start/end pair gets its own
+track instead.
+
+The binary format starts with the 8 byte magic "mpvstats" and a 32 bit format
+version (currently 1), followed by 32 byte records. All integers are little
+endian:
+
+    int64   timestamp in microseconds
+    uint64  ID of the thread that logged the event
+    uint32  event name ID
+    uint8   type: 0 name definition, 1 signal, 2 start, 3 end, 4 value
+    3 bytes padding
+    8 bytes type specific:
+            name definition: uint32 length of the name, which follows the
+                             record (not 0-terminated), and 4 bytes padding
+            value: float64 value
+            others: unused
+
+A name definition assigns the name to the event name ID. It can appear after
+the first use of the ID.
+"""
+
+import json
+import struct
+import sys
+
+RECORD = struct.Struct("<qQIB3x8s")
+NAME, SIGNAL, START, END, VALUE = range(5)
+
+def read_binary(data):
+    if struct.unpack_from("<I", data, 8)[0] != 1:
+        sys.exit("unsupported format version")
+    names = {}
+    events = []
+    pos = 12
+    while pos + RECORD.size <= len(data):
+        ts, tid, name_id, evtype, extra = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        if evtype == NAME:
+            length = struct.unpack_from("<I", extra)[0]
+            names.setdefault(name_id, data[pos:pos + length].decode("utf-8",
+                                                                   "replace"))
+            pos += length
+            continue
+        value = struct.unpack("<d", extra)[0]
+        events.append((ts, tid, name_id, evtype, value))
+    return [(ts, tid, names.get(name_id, "unknown-%d" % name_id), evtype, value)
+            for (ts, tid, name_id, evtype, value) in events]
+
+def read_text(data):
+    events = []
+    for line in data.decode("utf-8", "replace").splitlines():
+        line = line.split("#")[0].strip()
+        if not line:
+            continue
+        ts, event = line.split(" ", 1)
+        evtype, value, name = SIGNAL, 0.0, event
+        if event.startswith("start "):
+            evtype, name = START, event[6:]
+        elif event.startswith("end "):
+            evtype, name = END, event[4:]
+        elif event.startswith("signal "):
+            name = event[7:]
+        elif event.startswith("value "):
+            _, val, name = event.split(" ", 2)
+            evtype, value = VALUE, float(val)
+        tid = name if evtype in (START, END) else ""
+        events.append((int(ts), tid, name, evtype, value))
+    return events
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: stats-trace.py <stats file>")
+    data = open(sys.argv[1], "rb").read()
+    if data.startswith(b"mpvstats"):
+        events = read_binary(data)
+    else:
+        events = read_text(data)
+
+    tids = {}
+    out = []
+    for ts, tid, name, evtype, value in events:
+        if tid not in tids:
+            tids[tid] = len(tids) + 1
+            label = tid if isinstance(tid, str) else "thread %d" % tids[tid]
+            out.append({"ph": "M", "name": "thread_name", "pid": 1,
+                        "tid": tids[tid], "args": {"name": label or "events"}})
+        ev = {"name": name, "ts": ts, "pid": 1, "tid": tids[tid]}
+        if evtype == START:
+            ev["ph"] = "B"
+        elif evtype == END:
+            ev["ph"] = "E"
+        elif evtype == VALUE:
+            ev["ph"] = "C"
+            ev["args"] = {"value": value}
+        else:
+            ev["ph"] = "i"
+            ev["s"] = "t"
+        out.append(ev)
+
+    json.dump({"traceEvents": out, "displayTimeUnit": "ms"}, sys.stdout)
+
+main()
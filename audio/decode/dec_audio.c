@@ -20,6 +20,7 @@
 #include <unistd.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/mem.h>
 
@@ -29,6 +30,9 @@
 #include "common/msg.h"
 #include "misc/bstr.h"
 
+#include "osdep/atomics.h"
+#include "osdep/threads.h"
+
 #include "stream/stream.h"
 #include "demux/demux.h"
 
@@ -51,9 +55,79 @@ static const struct ad_functions * const ad_drivers[] = {
     NULL
 };
 
+// Number of slots in the frame ring (must be a power of 2). The amount of
+// queued audio is normally limited by max_samples, not by this.
+#define FRAME_RING_SIZE 64
+
+struct dec_audio_thread {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // -- Single-producer/single-consumer ring of decoded frames. The decoder
+    //    thread appends at ring_write, the player takes frames at ring_read.
+    //    Both sides access it without taking the lock.
+
+    struct mp_audio *ring[FRAME_RING_SIZE];
+    atomic_uint ring_read, ring_write; // free-running, index with % size
+    atomic_int queued_samples;
+    atomic_int state;           // last DATA_* code returned by the decoder
+    atomic_bool producer_waiting; // decoder thread blocks on a full queue
+    int max_samples;
+
+    // -- All the following fields are protected by lock.
+
+    bool terminate;
+    bool need_input;        // wait for audio_work() before decoding more
+
+    void (*run_fn)(void *); // if non-NULL, function queued to be run on
+    void *run_fn_arg;       // the thread as run_fn(run_fn_arg)
+
+    // Copied from dec_audio after each decode call, for the player to read.
+    char *decoder_desc;
+
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_cb_ctx;
+};
+
+// Run fn(ctx) on the decoder thread (or directly if there is none), and wait
+// until it has finished. fn is called with the thread lock held.
+static void run_on_thread(struct dec_audio *d_audio, void (*fn)(void *),
+                          void *ctx)
+{
+    struct dec_audio_thread *t = d_audio->thread;
+    if (!t) {
+        fn(ctx);
+        return;
+    }
+    pthread_mutex_lock(&t->lock);
+    while (t->run_fn)
+        pthread_cond_wait(&t->wakeup, &t->lock);
+    t->run_fn = fn;
+    t->run_fn_arg = ctx;
+    pthread_cond_broadcast(&t->wakeup);
+    while (t->run_fn)
+        pthread_cond_wait(&t->wakeup, &t->lock);
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void reset_decoder(struct dec_audio *d_audio)
+{
+    if (d_audio->ad_driver)
+        d_audio->ad_driver->control(d_audio, ADCTRL_RESET, NULL);
+    d_audio->pts = MP_NOPTS_VALUE;
+    talloc_free(d_audio->current_frame);
+    d_audio->current_frame = NULL;
+    talloc_free(d_audio->packet);
+    d_audio->packet = NULL;
+    talloc_free(d_audio->new_segment);
+    d_audio->new_segment = NULL;
+    d_audio->start = d_audio->end = MP_NOPTS_VALUE;
+}
+
 static void uninit_decoder(struct dec_audio *d_audio)
 {
-    audio_reset_decoding(d_audio);
+    reset_decoder(d_audio);
     if (d_audio->ad_driver) {
         MP_VERBOSE(d_audio, "Uninit audio decoder.\n");
         d_audio->ad_driver->uninit(d_audio);
@@ -111,7 +185,7 @@ static const struct ad_functions *find_driver(const char *name)
     return NULL;
 }
 
-int audio_init_best_codec(struct dec_audio *d_audio)
+static bool init_best_codec(struct dec_audio *d_audio)
 {
     uninit_decoder(d_audio);
     assert(!d_audio->ad_driver);
@@ -151,28 +225,113 @@ int audio_init_best_codec(struct dec_audio *d_audio)
     return !!d_audio->ad_driver;
 }
 
+// Only the decoder thread, or the player while the thread is blocked in
+// run_on_thread(), may call this.
+static void flush_frames(struct dec_audio_thread *t)
+{
+    unsigned int r = atomic_load(&t->ring_read);
+    unsigned int w = atomic_load(&t->ring_write);
+    for (; r != w; r++) {
+        talloc_free(t->ring[r % FRAME_RING_SIZE]);
+        t->ring[r % FRAME_RING_SIZE] = NULL;
+    }
+    atomic_store(&t->ring_read, r);
+    atomic_store(&t->queued_samples, 0);
+}
+
+static void thread_reset(void *p)
+{
+    struct dec_audio *d_audio = p;
+    struct dec_audio_thread *t = d_audio->thread;
+    reset_decoder(d_audio);
+    if (t) {
+        flush_frames(t);
+        atomic_store(&t->state, DATA_AGAIN);
+        // Don't start decoding before the player has set up the new state.
+        t->need_input = true;
+        t->decoder_desc = d_audio->decoder_desc;
+    }
+}
+
+void audio_reset_decoding(struct dec_audio *d_audio)
+{
+    run_on_thread(d_audio, thread_reset, d_audio);
+}
+
+struct init_args {
+    struct dec_audio *d_audio;
+    bool r;
+};
+
+static void thread_init_best_codec(void *p)
+{
+    struct init_args *args = p;
+    args->r = init_best_codec(args->d_audio);
+    if (args->d_audio->thread)
+        thread_reset(args->d_audio);
+}
+
+int audio_init_best_codec(struct dec_audio *d_audio)
+{
+    struct init_args args = {d_audio};
+    run_on_thread(d_audio, thread_init_best_codec, &args);
+    return args.r;
+}
+
+// Description of the current decoder, or NULL if none. The string stays valid
+// until audio_uninit().
+const char *audio_get_decoder_desc(struct dec_audio *d_audio)
+{
+    struct dec_audio_thread *t = d_audio->thread;
+    if (!t)
+        return d_audio->decoder_desc;
+    pthread_mutex_lock(&t->lock);
+    const char *r = t->decoder_desc;
+    pthread_mutex_unlock(&t->lock);
+    return r;
+}
+
+static void thread_suspend(void *p)
+{
+    struct dec_audio *d_audio = p;
+    d_audio->thread->need_input = true;
+}
+
+// Stop decoding ahead until the next audio_work() call. When this returns,
+// the decoder thread (if any) does not access the demuxer anymore. Typically
+// used before seeking the demuxer, followed by audio_reset_decoding().
+void audio_suspend(struct dec_audio *d_audio)
+{
+    if (d_audio->thread)
+        run_on_thread(d_audio, thread_suspend, d_audio);
+}
+
+static void audio_stop_thread(struct dec_audio *d_audio)
+{
+    struct dec_audio_thread *t = d_audio->thread;
+    if (!t)
+        return;
+    pthread_mutex_lock(&t->lock);
+    t->terminate = true;
+    pthread_cond_broadcast(&t->wakeup);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+    flush_frames(t);
+    pthread_cond_destroy(&t->wakeup);
+    pthread_mutex_destroy(&t->lock);
+    talloc_free(t);
+    d_audio->thread = NULL;
+}
+
 void audio_uninit(struct dec_audio *d_audio)
 {
     if (!d_audio)
         return;
+    audio_stop_thread(d_audio);
     uninit_decoder(d_audio);
     talloc_free(d_audio);
 }
 
-void audio_reset_decoding(struct dec_audio *d_audio)
-{
-    if (d_audio->ad_driver)
-        d_audio->ad_driver->control(d_audio, ADCTRL_RESET, NULL);
-    d_audio->pts = MP_NOPTS_VALUE;
-    talloc_free(d_audio->current_frame);
-    d_audio->current_frame = NULL;
-    talloc_free(d_audio->packet);
-    d_audio->packet = NULL;
-    talloc_free(d_audio->new_segment);
-    d_audio->new_segment = NULL;
-    d_audio->start = d_audio->end = MP_NOPTS_VALUE;
-}
-
 static void fix_audio_pts(struct dec_audio *da)
 {
     if (!da->current_frame)
@@ -195,7 +354,7 @@ static void fix_audio_pts(struct dec_audio *da)
         da->pts += da->current_frame->samples / (double)da->current_frame->rate;
 }
 
-void audio_work(struct dec_audio *da)
+static void work_sync(struct dec_audio *da)
 {
     if (da->current_frame)
         return;
@@ -258,7 +417,7 @@ void audio_work(struct dec_audio *da)
         if (da->ad_driver)
             da->ad_driver->uninit(da);
         da->ad_driver = NULL;
-        audio_init_best_codec(da);
+        init_best_codec(da);
 
         da->start = new_segment->start;
         da->end = new_segment->end;
@@ -270,12 +429,7 @@ void audio_work(struct dec_audio *da)
     }
 }
 
-// Fetch an audio frame decoded with audio_work(). Returns one of:
-//  DATA_OK:    *out_frame is set to a new image
-//  DATA_WAIT:  waiting for demuxer; will receive a wakeup signal
-//  DATA_EOF:   end of file, no more frames to be expected
-//  DATA_AGAIN: dropped frame or something similar
-int audio_get_frame(struct dec_audio *da, struct mp_audio **out_frame)
+static int get_frame_sync(struct dec_audio *da, struct mp_audio **out_frame)
 {
     *out_frame = NULL;
     if (da->current_frame) {
@@ -287,3 +441,135 @@ int audio_get_frame(struct dec_audio *da, struct mp_audio **out_frame)
         return DATA_AGAIN;
     return da->current_state;
 }
+
+void audio_work(struct dec_audio *da)
+{
+    struct dec_audio_thread *t = da->thread;
+    if (t) {
+        // The thread might be waiting for new packets.
+        pthread_mutex_lock(&t->lock);
+        t->need_input = false;
+        pthread_cond_broadcast(&t->wakeup);
+        pthread_mutex_unlock(&t->lock);
+        return;
+    }
+    work_sync(da);
+}
+
+// Fetch an audio frame decoded with audio_work(). Returns one of:
+//  DATA_OK:    *out_frame is set to a new image
+//  DATA_WAIT:  waiting for demuxer or decoder thread; will receive a wakeup
+//  DATA_EOF:   end of file, no more frames to be expected
+//  DATA_AGAIN: dropped frame or something similar
+int audio_get_frame(struct dec_audio *da, struct mp_audio **out_frame)
+{
+    struct dec_audio_thread *t = da->thread;
+    if (!t)
+        return get_frame_sync(da, out_frame);
+
+    *out_frame = NULL;
+    // Read the state before the ring, so a frame queued right before EOF is
+    // never missed.
+    int state = atomic_load(&t->state);
+    unsigned int r = atomic_load(&t->ring_read);
+    if (r == atomic_load(&t->ring_write))
+        return state == DATA_EOF ? DATA_EOF : DATA_WAIT;
+
+    struct mp_audio *frame = t->ring[r % FRAME_RING_SIZE];
+    t->ring[r % FRAME_RING_SIZE] = NULL;
+    atomic_fetch_add(&t->queued_samples, -frame->samples);
+    atomic_store(&t->ring_read, r + 1);
+
+    if (atomic_load(&t->producer_waiting)) {
+        pthread_mutex_lock(&t->lock);
+        pthread_cond_broadcast(&t->wakeup); // decode more
+        pthread_mutex_unlock(&t->lock);
+    }
+
+    *out_frame = frame;
+    return DATA_OK;
+}
+
+static bool queue_full(struct dec_audio_thread *t)
+{
+    unsigned int used = atomic_load(&t->ring_write) - atomic_load(&t->ring_read);
+    return used >= FRAME_RING_SIZE ||
+           atomic_load(&t->queued_samples) >= t->max_samples;
+}
+
+static void *audio_thread(void *p)
+{
+    struct dec_audio *da = p;
+    struct dec_audio_thread *t = da->thread;
+    mpthread_set_name("ad");
+    pthread_mutex_lock(&t->lock);
+    while (!t->terminate) {
+        if (t->run_fn) {
+            t->run_fn(t->run_fn_arg);
+            t->run_fn = NULL;
+            pthread_cond_broadcast(&t->wakeup);
+            continue;
+        }
+        atomic_store(&t->producer_waiting, true);
+        if (!t->need_input && atomic_load(&t->state) != DATA_EOF &&
+            !queue_full(t))
+        {
+            atomic_store(&t->producer_waiting, false);
+            pthread_mutex_unlock(&t->lock);
+
+            MP_STATS(da, "start decode audio");
+            struct mp_audio *frame = NULL;
+            work_sync(da);
+            int state = get_frame_sync(da, &frame);
+            MP_STATS(da, "end decode audio");
+
+            if (frame) {
+                unsigned int w = atomic_load(&t->ring_write);
+                t->ring[w % FRAME_RING_SIZE] = frame;
+                atomic_fetch_add(&t->queued_samples, frame->samples);
+                atomic_store(&t->ring_write, w + 1);
+            }
+
+            pthread_mutex_lock(&t->lock);
+            t->decoder_desc = da->decoder_desc;
+            atomic_store(&t->state, state);
+            t->need_input = state == DATA_WAIT;
+            if ((frame || state == DATA_EOF) && t->wakeup_cb)
+                t->wakeup_cb(t->wakeup_cb_ctx);
+            continue;
+        }
+        pthread_cond_wait(&t->wakeup, &t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+// Decode in a separate thread, which queues up to max_samples decoded samples.
+// Frames are handed to audio_get_frame() through a lock-free ring. wakeup_cb
+// is called (from the decoder thread) when a new frame is available or EOF is
+// reached.
+void audio_start_thread(struct dec_audio *d_audio, int max_samples,
+                        void (*wakeup_cb)(void *ctx), void *wakeup_cb_ctx)
+{
+    if (d_audio->thread)
+        return;
+
+    struct dec_audio_thread *t = talloc_zero(NULL, struct dec_audio_thread);
+    atomic_store(&t->state, DATA_AGAIN);
+    t->max_samples = MPMAX(max_samples, 1);
+    t->need_input = true;
+    t->wakeup_cb = wakeup_cb;
+    t->wakeup_cb_ctx = wakeup_cb_ctx;
+    t->decoder_desc = d_audio->decoder_desc;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->wakeup, NULL);
+
+    d_audio->thread = t;
+    if (pthread_create(&t->thread, NULL, audio_thread, d_audio)) {
+        MP_ERR(d_audio, "Could not start audio decoder thread.\n");
+        pthread_cond_destroy(&t->wakeup);
+        pthread_mutex_destroy(&t->lock);
+        talloc_free(t);
+        d_audio->thread = NULL;
+    }
+}
@@ -25,6 +25,7 @@
 
 struct mp_audio_buffer;
 struct mp_decoder_list;
+struct dec_audio_thread;
 
 struct dec_audio {
     struct mp_log *log;
@@ -33,6 +34,7 @@ struct dec_audio {
     const struct ad_functions *ad_driver;
     struct sh_stream *header;
     struct mp_codec_params *codec;
+    // Written by the decoder thread; use audio_get_decoder_desc() to read it.
     char *decoder_desc;
 
     bool try_spdif;
@@ -48,6 +50,9 @@ struct dec_audio {
     struct demux_packet *new_segment;
     struct mp_audio *current_frame;
     int current_state;
+
+    // Set if decoding runs in a separate thread (audio_start_thread()).
+    struct dec_audio_thread *thread;
 };
 
 struct mp_decoder_list *audio_decoder_list(void);
@@ -58,5 +63,10 @@ void audio_work(struct dec_audio *d_audio);
 int audio_get_frame(struct dec_audio *d_audio, struct mp_audio **out_frame);
 
 void audio_reset_decoding(struct dec_audio *d_audio);
+void audio_suspend(struct dec_audio *d_audio);
+const char *audio_get_decoder_desc(struct dec_audio *d_audio);
+
+void audio_start_thread(struct dec_audio *d_audio, int max_samples,
+                        void (*wakeup_cb)(void *ctx), void *wakeup_cb_ctx);
 
 #endif /* MPLAYER_DEC_AUDIO_H */
@@ -423,6 +423,23 @@ void ao_hotplug_event(struct ao *ao)
     ao_add_events(ao, AO_EVENT_HOTPLUG);
 }
 
+// Count an underrun, and notify the player. Fully thread-safe, and can be
+// called from realtime audio callbacks.
+void ao_underrun_event(struct ao *ao)
+{
+    atomic_fetch_add(&ao->underruns, 1);
+    atomic_fetch_or(&ao->events_, AO_EVENT_UNDERRUN);
+    if (ao->input_ctx)
+        mp_input_wakeup_nolock(ao->input_ctx);
+}
+
+// Number of times the device ran out of audio data during playback (excluding
+// pauses and EOF). Fully thread-safe.
+int64_t ao_get_underruns(struct ao *ao)
+{
+    return atomic_load(&ao->underruns);
+}
+
 bool ao_chmap_sel_adjust(struct ao *ao, const struct mp_chmap_sel *s,
                          struct mp_chmap *map)
 {
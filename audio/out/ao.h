@@ -48,6 +48,7 @@ enum aocontrol {
 enum {
     AO_EVENT_RELOAD = 1,
     AO_EVENT_HOTPLUG = 2,
+    AO_EVENT_UNDERRUN = 4,
 };
 
 enum {
@@ -103,6 +104,7 @@ bool ao_eof_reached(struct ao *ao);
 int ao_query_and_reset_events(struct ao *ao, int events);
 void ao_request_reload(struct ao *ao);
 void ao_hotplug_event(struct ao *ao);
+int64_t ao_get_underruns(struct ao *ao);
 
 struct ao_hotplug;
 struct ao_hotplug *ao_hotplug_create(struct mpv_global *global,
@@ -64,6 +64,10 @@ struct ao {
     // Internal events (use ao_request_reload(), ao_hotplug_event())
     atomic_int events_;
 
+    // Number of buffer underruns during playback (ao_underrun_event(),
+    // ao_get_underruns())
+    atomic_llong underruns;
+
     int buffer;
     double def_buffer;
     void *api_priv;
@@ -191,6 +195,7 @@ struct pollfd;
 int ao_wait_poll(struct ao *ao, struct pollfd *fds, int num_fds,
                  pthread_mutex_t *lock);
 void ao_wakeup_poll(struct ao *ao);
+void ao_underrun_event(struct ao *ao);
 
 bool ao_chmap_sel_adjust(struct ao *ao, const struct mp_chmap_sel *s,
                          struct mp_chmap *map);
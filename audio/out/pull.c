@@ -57,6 +57,12 @@ struct ao_pull_state {
 
     // Device delay of the last written sample, in realtime.
     atomic_llong end_time_us;
+
+    // Set if the last callback could not be filled completely.
+    atomic_bool underrun;
+
+    // Set if the buffer contains the end of the audio (no underrun possible).
+    atomic_bool final_chunk;
 };
 
 static void set_state(struct ao *ao, int new_state)
@@ -98,6 +104,8 @@ static int play(struct ao *ao, void **data, int samples, int flags)
         assert(r == write_bytes);
     }
 
+    atomic_store(&p->final_chunk, !!(flags & AOPLAY_FINAL_CHUNK));
+
     int state = atomic_load(&p->state);
     if (!IS_PLAYING(state)) {
         set_state(ao, AO_STATE_PLAY);
@@ -142,6 +150,16 @@ int ao_read_data(struct ao *ao, void **data, int samples, int64_t out_time_us)
         bytes = MPMIN(bytes, r);
     }
 
+    // Count each continuous period of short reads as one underrun.
+    if (bytes < full_bytes) {
+        if (!atomic_load(&p->underrun) && !atomic_load(&p->final_chunk)) {
+            atomic_store(&p->underrun, true);
+            ao_underrun_event(ao);
+        }
+    } else {
+        atomic_store(&p->underrun, false);
+    }
+
     // Half of the buffer played -> request more.
     need_wakeup = buffered_bytes - bytes <= mp_ring_size(p->buffers[0]) / 2;
 
@@ -54,6 +54,7 @@ struct ao_push_state {
     bool still_playing;
     bool need_wakeup;
     bool paused;
+    bool underrun;          // device ran dry; counted once until refilled
 
     // Whether the current buffer contains the complete audio.
     bool final_chunk;
@@ -281,6 +282,17 @@ static void ao_play_data(struct ao *ao)
         r = data.samples;
     }
     r = MPMAX(r, 0);
+    // The device played everything we gave it, and we have nothing left,
+    // although the player did not signal EOF.
+    if (max == 0 && space >= ao->device_buffer && p->still_playing &&
+        !p->final_chunk && !p->underrun)
+    {
+        p->underrun = true;
+        ao_underrun_event(ao);
+        MP_VERBOSE(ao, "Audio underrun.\n");
+    }
+    if (r > 0)
+        p->underrun = false;
     // Probably can't copy the rest of the buffer due to period alignment.
     bool stuck_eof = r <= 0 && space >= max && data.samples > 0;
     if ((flags & AOPLAY_FINAL_CHUNK) && stuck_eof) {
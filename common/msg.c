@@ -35,6 +35,7 @@
 #include "options/options.h"
 #include "osdep/terminal.h"
 #include "osdep/io.h"
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 
 #include "libmpv/client.h"
@@ -42,6 +43,54 @@
 #include "msg.h"
 #include "msg_control.h"
 
+// Number of queued lines for the file sinks (power of 2). If the writer
+// thread falls behind by this much, further lines are dropped and counted.
+#define LOG_QUEUE_SIZE 4096
+
+// Size of the table used to assign IDs to --dump-stats-format=binary event
+// names (power of 2).
+#define STATS_NAMES_SIZE 1024
+
+enum {
+    SINK_LOG_FILE,
+    SINK_STATS_FILE,
+    SINK_STATS_EVENT,
+};
+
+// Event types in the binary stats format. See TOOLS/stats-trace.py.
+enum {
+    STATS_NAME = 0,     // defines name_id; the name follows the record
+    STATS_SIGNAL,
+    STATS_START,
+    STATS_END,
+    STATS_VALUE,
+};
+
+#define STATS_RECORD_SIZE 32
+
+struct stats_event {
+    int64_t ts;
+    uint64_t tid;
+    uint32_t name_id;
+    int type;
+    double value;
+};
+
+// Slot of the table that assigns IDs to event names. The ID is the slot index
+// plus 1, so different names never share an ID.
+struct stats_name {
+    atomic_uint hash;       // 0 if the slot is unused
+    atomic_bool ready;      // name is set
+    char *name;
+};
+
+struct log_queue_cell {
+    atomic_ulong seq;
+    int sink;
+    char *text;             // SINK_STATS_EVENT: name for STATS_NAME only
+    struct stats_event ev;  // SINK_STATS_EVENT only
+};
+
 struct mp_log_root {
     struct mpv_global *global;
     // --- protected by mp_msg_lock
@@ -57,8 +106,24 @@ struct mp_log_root {
     bool force_stderr;
     struct mp_log_buffer **buffers;
     int num_buffers;
+    bool writer_running;
+    pthread_t writer;
+    bool stats_binary;
+    struct stats_name *stats_names; // hash table of names seen so far
+    // --- protected by writer_lock (and set with mp_msg_lock held too)
     FILE *log_file;
     FILE *stats_file;
+    pthread_mutex_t writer_lock;
+    pthread_cond_t writer_wakeup;
+    bool writer_terminate;
+    int64_t dropped_reported;
+    // --- lock-free multi-producer, single consumer (the writer thread) queue
+    struct log_queue_cell *queue;
+    atomic_ulong queue_write;
+    unsigned long queue_read; // only accessed by the writer thread
+    atomic_bool writer_sleeping;
+    // Lines lost due to a full file queue or a full client log buffer.
+    atomic_llong dropped;
     // --- must be accessed atomically
     /* This is incremented every time the msglevels must be reloaded.
      * (This is perhaps better than maintaining a globally accessible and
@@ -74,7 +139,10 @@ struct mp_log {
     const char *verbose_prefix;
     int level;                  // minimum log level for any outputs
     int terminal_level;         // minimum log level for terminal output
+    int locked_level;           // minimum log level for terminal/log buffers
+    bool to_log_file, to_stats_file, stats_binary;
     atomic_ulong reload_counter;
+    atomic_bool has_partial;    // partial[0] != 0 (partial is under the lock)
     char *partial;
 };
 
@@ -86,7 +154,10 @@ struct mp_log_buffer {
     void *wakeup_cb_ctx;
 };
 
-// Protects some (not all) state in mp_log_root
+// Protects some (not all) state in mp_log_root. Only messages which go to the
+// terminal, to client log buffers, or which complete a partial line take it;
+// log file and stats output is formatted by the calling thread and queued for
+// the writer thread without locking.
 static pthread_mutex_t mp_msg_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static const struct mp_log null_log = {0};
@@ -111,11 +182,20 @@ static void update_loglevel(struct mp_log *log)
             log->level = mp_msg_find_level(root->msg_levels[n * 2 + 1]);
     }
     log->terminal_level = log->level;
-    for (int n = 0; n < log->root->num_buffers; n++)
+    log->locked_level = root->use_terminal ? log->terminal_level : -1;
+    for (int n = 0; n < log->root->num_buffers; n++) {
+        int buffer_level = log->root->buffers[n]->level;
+        if (buffer_level == MP_LOG_BUFFER_MSGL_TERM)
+            buffer_level = log->terminal_level;
         log->level = MPMAX(log->level, log->root->buffers[n]->level);
-    if (log->root->log_file)
+        log->locked_level = MPMAX(log->locked_level, buffer_level);
+    }
+    log->to_log_file = !!log->root->log_file;
+    log->to_stats_file = !!log->root->stats_file;
+    log->stats_binary = log->root->stats_binary;
+    if (log->to_log_file)
         log->level = MPMAX(log->level, MSGL_V);
-    if (log->root->stats_file)
+    if (log->to_stats_file)
         log->level = MPMAX(log->level, MSGL_STATS);
     atomic_store(&log->reload_counter, atomic_load(&log->root->reload_counter));
     pthread_mutex_unlock(&mp_msg_lock);
@@ -275,17 +355,164 @@ static void print_terminal_line(struct mp_log *log, int lev,
     fflush(stream);
 }
 
-static void write_log_file(struct mp_log *log, int lev, char *text)
+static bool queue_empty(struct mp_log_root *root)
 {
-    struct mp_log_root *root = log->root;
+    struct log_queue_cell *cell =
+        &root->queue[root->queue_read & (LOG_QUEUE_SIZE - 1)];
+    return atomic_load(&cell->seq) != root->queue_read + 1;
+}
+
+// Add an entry for the writer thread. Takes ownership of text.
+// Thread-safety: can be called from any thread without locking.
+static void queue_entry(struct mp_log_root *root, int sink, char *text,
+                        const struct stats_event *ev)
+{
+    unsigned long pos = atomic_load(&root->queue_write);
+    struct log_queue_cell *cell;
+    while (1) {
+        cell = &root->queue[pos & (LOG_QUEUE_SIZE - 1)];
+        long diff = (long)(atomic_load(&cell->seq) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_strong(&root->queue_write, &pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            // Writer thread is a full queue behind.
+            atomic_fetch_add(&root->dropped, 1);
+            talloc_free(text);
+            return;
+        } else {
+            pos = atomic_load(&root->queue_write);
+        }
+    }
+    cell->sink = sink;
+    cell->text = text;
+    if (ev)
+        cell->ev = *ev;
+    atomic_store(&cell->seq, pos + 1);
+
+    if (atomic_load(&root->writer_sleeping)) {
+        pthread_mutex_lock(&root->writer_lock);
+        pthread_cond_signal(&root->writer_wakeup);
+        pthread_mutex_unlock(&root->writer_lock);
+    }
+}
+
+static void queue_line(struct mp_log_root *root, int sink, char *text)
+{
+    queue_entry(root, sink, text, NULL);
+}
+
+static void put_le(uint8_t *dst, uint64_t val, int bytes)
+{
+    for (int n = 0; n < bytes; n++)
+        dst[n] = val >> (n * 8);
+}
 
-    if (lev > MSGL_V || !root->log_file)
+// Write a fixed size little endian record, plus the name for STATS_NAME.
+static void write_stats_event(FILE *f, struct stats_event *ev, char *name)
+{
+    uint8_t rec[STATS_RECORD_SIZE] = {0};
+    put_le(rec + 0, ev->ts, 8);
+    put_le(rec + 8, ev->tid, 8);
+    put_le(rec + 16, ev->name_id, 4);
+    rec[20] = ev->type;
+    if (ev->type == STATS_NAME) {
+        put_le(rec + 24, strlen(name), 4);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &ev->value, sizeof(bits));
+        put_le(rec + 24, bits, 8);
+    }
+    fwrite(rec, sizeof(rec), 1, f);
+    if (ev->type == STATS_NAME)
+        fwrite(name, strlen(name), 1, f);
+}
+
+static void *log_writer_thread(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mpthread_set_name("log");
+
+    pthread_mutex_lock(&root->writer_lock);
+    while (1) {
+        while (!queue_empty(root)) {
+            struct log_queue_cell *cell =
+                &root->queue[root->queue_read & (LOG_QUEUE_SIZE - 1)];
+            FILE *f = cell->sink == SINK_LOG_FILE ? root->log_file
+                                                  : root->stats_file;
+            if (f && cell->sink == SINK_STATS_EVENT) {
+                write_stats_event(f, &cell->ev, cell->text);
+            } else if (f) {
+                fputs(cell->text, f);
+            }
+            talloc_free(cell->text);
+            cell->text = NULL;
+            atomic_store(&cell->seq, root->queue_read + LOG_QUEUE_SIZE);
+            root->queue_read++;
+        }
+
+        int64_t dropped = atomic_load(&root->dropped);
+        if (dropped != root->dropped_reported && root->log_file) {
+            fprintf(root->log_file, "[%8.3f][w][log] %"PRId64" log messages "
+                    "dropped\n", (mp_time_us() - MP_START_TIME) / 1e6,
+                    dropped - root->dropped_reported);
+            root->dropped_reported = dropped;
+        }
+
+        if (root->log_file)
+            fflush(root->log_file);
+        if (root->stats_file)
+            fflush(root->stats_file);
+
+        if (root->writer_terminate)
+            break;
+
+        // Producers check writer_sleeping after queuing, so one of the two
+        // sides is guaranteed to see the other.
+        atomic_store(&root->writer_sleeping, true);
+        if (queue_empty(root))
+            pthread_cond_wait(&root->writer_wakeup, &root->writer_lock);
+        atomic_store(&root->writer_sleeping, false);
+    }
+    pthread_mutex_unlock(&root->writer_lock);
+    return NULL;
+}
+
+// Called with mp_msg_lock held.
+static bool start_writer(struct mp_log_root *root)
+{
+    if (root->writer_running)
+        return true;
+    if (!root->queue) {
+        root->queue = talloc_zero_array(root, struct log_queue_cell,
+                                        LOG_QUEUE_SIZE);
+        for (unsigned long n = 0; n < LOG_QUEUE_SIZE; n++)
+            atomic_store(&root->queue[n].seq, n);
+    }
+    root->writer_running =
+        !pthread_create(&root->writer, NULL, log_writer_thread, root);
+    return root->writer_running;
+}
+
+static void write_log_file(struct mp_log *log, int lev, char *text)
+{
+    if (lev > MSGL_V || !log->to_log_file)
         return;
 
-    fprintf(root->log_file, "[%8.3f][%c][%s] %s",
-            (mp_time_us() - MP_START_TIME) / 1e6,
-            mp_log_levels[lev][0],
-            log->verbose_prefix, text);
+    double time = (mp_time_us() - MP_START_TIME) / 1e6;
+    char *res = NULL;
+    // text can contain multiple lines if this was called without lock.
+    while (text[0]) {
+        char *end = strchr(text, '\n');
+        int len = end ? end - text + 1 : strlen(text);
+        res = talloc_asprintf_append_buffer(res, "[%8.3f][%c][%s] %.*s",
+                                            time, mp_log_levels[lev][0],
+                                            log->verbose_prefix, len, text);
+        text += len;
+    }
+    if (res)
+        queue_line(log->root, SINK_LOG_FILE, res);
 }
 
 static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
@@ -299,8 +526,10 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
         if (lev <= buffer_level && lev != MSGL_STATUS) {
             // Assuming a single writer (serialized by msg lock)
             int avail = mp_ring_available(buffer->ring) / sizeof(void *);
-            if (avail < 1)
+            if (avail < 1) {
+                atomic_fetch_add(&root->dropped, 1);
                 continue;
+            }
             struct mp_log_buffer_entry *entry = talloc_ptrtype(NULL, entry);
             if (avail > 1) {
                 *entry = (struct mp_log_buffer_entry) {
@@ -309,6 +538,7 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
                     .text = talloc_strdup(entry, text),
                 };
             } else {
+                atomic_fetch_add(&root->dropped, 1);
                 // write overflow message to signal that messages might be lost
                 *entry = (struct mp_log_buffer_entry) {
                     .prefix = "overflow",
@@ -323,35 +553,145 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
     }
 }
 
-static void dump_stats(struct mp_log *log, int lev, char *text)
+static void free_stats_names(void *p)
 {
-    struct mp_log_root *root = log->root;
-    if (lev == MSGL_STATS && root->stats_file)
-        fprintf(root->stats_file, "%"PRId64" %s\n", mp_time_us(), text);
+    struct stats_name *names = p;
+    for (int n = 0; n < STATS_NAMES_SIZE; n++)
+        talloc_free(names[n].name);
 }
 
-void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
+// Return the ID for an event name, or 0 if the table is full. The first time
+// a name is seen, its definition is queued before the event that uses it.
+// (Another thread can still queue an event with this ID first, so readers
+// must not expect definitions to come before use. If two threads add the same
+// name at the same time, it can get two IDs.)
+static uint32_t intern_stats_name(struct mp_log_root *root, const char *name,
+                                  struct stats_event *ev)
 {
-    if (!mp_msg_test(log, lev))
-        return; // do not display
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const char *s = name; *s; s++)
+        hash = (hash ^ (unsigned char)*s) * 16777619u;
+    hash = hash ? hash : 1;
+
+    for (int n = 0; n < STATS_NAMES_SIZE; n++) {
+        uint32_t i = (hash + n) & (STATS_NAMES_SIZE - 1);
+        struct stats_name *slot = &root->stats_names[i];
+        unsigned int cur = atomic_load(&slot->hash);
+        if (cur == 0 && atomic_compare_exchange_strong(&slot->hash, &cur, hash)) {
+            slot->name = talloc_strdup(NULL, name);
+            atomic_store(&slot->ready, true);
+
+            struct stats_event def = *ev;
+            def.type = STATS_NAME;
+            def.name_id = i + 1;
+            queue_entry(root, SINK_STATS_EVENT, talloc_strdup(NULL, name), &def);
+            return i + 1;
+        }
+        if (cur == hash && atomic_load(&slot->ready) &&
+            strcmp(slot->name, name) == 0)
+            return i + 1;
+    }
+    return 0;
+}
 
-    pthread_mutex_lock(&mp_msg_lock);
+static void queue_stats_event(struct mp_log_root *root, int type,
+                              const char *name, double value)
+{
+    struct stats_event ev = {
+        .ts = mp_time_us(),
+        .tid = mpthread_get_id(),
+        .type = type,
+        .value = value,
+    };
+    ev.name_id = intern_stats_name(root, name, &ev);
+    if (ev.name_id)
+        queue_entry(root, SINK_STATS_EVENT, NULL, &ev);
+}
 
-    struct mp_log_root *root = log->root;
+// Strip the event type prefix described in TOOLS/stats-conv.py (except for
+// "value", which has an argument).
+static int parse_stats_type(bstr *name)
+{
+    if (bstr_eatstart0(name, "start "))
+        return STATS_START;
+    if (bstr_eatstart0(name, "end "))
+        return STATS_END;
+    bstr_eatstart0(name, "signal ");
+    return STATS_SIGNAL;
+}
 
-    root->buffer.len = 0;
+// Queue a binary event directly from the MP_STATS() format string, without
+// formatting it first. This works for all plain event names, and for
+// "value %f <name>". Returns false for anything else.
+static bool dump_stats_event_fmt(struct mp_log_root *root, const char *format,
+                                 va_list va)
+{
+    bstr name = bstr0(format);
+    bool is_value = bstr_eatstart0(&name, "value %f ");
+    int type = is_value ? STATS_VALUE : parse_stats_type(&name);
+    // name ends with the format string, so it's 0-terminated.
+    if (bstrchr(name, '%') >= 0)
+        return false;
+    double value = 0;
+    if (is_value) {
+        va_list copy;
+        va_copy(copy, va);
+        value = va_arg(copy, double);
+        va_end(copy);
+    }
+    queue_stats_event(root, type, name.start, value);
+    return true;
+}
 
-    if (log->partial[0])
-        bstr_xappend_asprintf(root, &root->buffer, "%s", log->partial);
-    log->partial[0] = '\0';
+// Parse the formatted text, and queue it as binary event. This avoids
+// formatting the timestamp and writing text lines.
+static void dump_stats_event(struct mp_log_root *root, char *text)
+{
+    bstr name = bstr0(text);
+    double value = 0;
+    int type = STATS_SIGNAL;
+    if (bstr_startswith0(name, "value ")) {
+        char *end;
+        value = strtod(text + 6, &end);
+        if (end != text + 6 && end[0] == ' ') {
+            type = STATS_VALUE;
+            name = bstr0(end + 1);
+        }
+    } else {
+        type = parse_stats_type(&name);
+    }
+    queue_stats_event(root, type, name.start, value);
+}
 
-    bstr_xappend_vasprintf(root, &root->buffer, format, va);
+static void dump_stats(struct mp_log *log, int lev, char *text)
+{
+    if (lev != MSGL_STATS || !log->to_stats_file)
+        return;
+    if (log->stats_binary) {
+        dump_stats_event(log->root, text);
+    } else {
+        queue_line(log->root, SINK_STATS_FILE,
+                   talloc_asprintf(NULL, "%"PRId64" %s\n", mp_time_us(), text));
+    }
+}
 
-    char *text = root->buffer.start;
+// Output text, which was formatted by the caller, to the sinks that need
+// mp_msg_lock.
+static void write_msg_locked(struct mp_log *log, int lev, char *text)
+{
+    pthread_mutex_lock(&mp_msg_lock);
 
-    if (lev == MSGL_STATS) {
-        dump_stats(log, lev, text);
-    } else if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
+    struct mp_log_root *root = log->root;
+
+    if (log->partial[0]) {
+        root->buffer.len = 0;
+        bstr_xappend_asprintf(root, &root->buffer, "%s%s", log->partial, text);
+        text = root->buffer.start;
+    }
+    log->partial[0] = '\0';
+    atomic_store(&log->has_partial, false);
+
+    if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
         /* discard */
     } else {
         if (lev == MSGL_STATUS && root->termosd)
@@ -381,12 +721,49 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
             if (talloc_get_size(log->partial) < size)
                 log->partial = talloc_realloc(NULL, log->partial, char, size);
             memcpy(log->partial, text, size);
+            atomic_store(&log->has_partial, true);
         }
     }
 
     pthread_mutex_unlock(&mp_msg_lock);
 }
 
+void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
+{
+    if (!mp_msg_test(log, lev))
+        return; // do not display
+
+    if (lev == MSGL_STATS && log->to_stats_file && log->stats_binary &&
+        dump_stats_event_fmt(log->root, format, va))
+        return;
+
+    // Format on the calling thread, without holding any lock.
+    char buf[512];
+    char *text = buf;
+    va_list copy;
+    va_copy(copy, va);
+    int len = vsnprintf(buf, sizeof(buf), format, copy);
+    va_end(copy);
+    if (len < 0)
+        return;
+    if (len >= sizeof(buf))
+        text = talloc_vasprintf(NULL, format, va);
+
+    if (lev == MSGL_STATS) {
+        dump_stats(log, lev, text);
+    } else if (lev <= log->locked_level || lev == MSGL_STATUS ||
+               atomic_load(&log->has_partial) || !len || text[len - 1] != '\n')
+    {
+        write_msg_locked(log, lev, text);
+    } else {
+        // Complete lines which go to the log file only.
+        write_log_file(log, lev, text);
+    }
+
+    if (text != buf)
+        talloc_free(text);
+}
+
 static void destroy_log(void *ptr)
 {
     struct mp_log *log = ptr;
@@ -448,6 +825,8 @@ void mp_msg_init(struct mpv_global *global)
         .global = global,
         .reload_counter = ATOMIC_VAR_INIT(1),
     };
+    pthread_mutex_init(&root->writer_lock, NULL);
+    pthread_cond_init(&root->writer_wakeup, NULL);
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -480,8 +859,14 @@ void mp_msg_update_msglevels(struct mpv_global *global)
     m_option_type_msglevels.copy(NULL, &root->msg_levels,
                                  &global->opts->msg_levels);
 
-    if (!root->log_file && opts->log_file && opts->log_file[0])
-        root->log_file = fopen(opts->log_file, "wb");
+    if (!root->log_file && opts->log_file && opts->log_file[0] &&
+        start_writer(root))
+    {
+        FILE *f = fopen(opts->log_file, "wb");
+        pthread_mutex_lock(&root->writer_lock);
+        root->log_file = f;
+        pthread_mutex_unlock(&root->writer_lock);
+    }
 
     atomic_fetch_add(&root->reload_counter, 1);
     pthread_mutex_unlock(&mp_msg_lock);
@@ -497,11 +882,21 @@ void mp_msg_force_stderr(struct mpv_global *global, bool force_stderr)
 void mp_msg_uninit(struct mpv_global *global)
 {
     struct mp_log_root *root = global->log->root;
+    if (root->writer_running) {
+        // The writer drains the queue before exiting.
+        pthread_mutex_lock(&root->writer_lock);
+        root->writer_terminate = true;
+        pthread_cond_signal(&root->writer_wakeup);
+        pthread_mutex_unlock(&root->writer_lock);
+        pthread_join(root->writer, NULL);
+    }
     if (root->stats_file)
         fclose(root->stats_file);
     if (root->log_file)
         fclose(root->log_file);
     m_option_type_msglevels.free(&root->msg_levels);
+    pthread_cond_destroy(&root->writer_wakeup);
+    pthread_mutex_destroy(&root->writer_lock);
     talloc_free(root);
     global->log = NULL;
 }
@@ -582,17 +977,39 @@ struct mp_log_buffer_entry *mp_msg_log_buffer_read(struct mp_log_buffer *buffer)
     return ptr;
 }
 
-int mp_msg_open_stats_file(struct mpv_global *global, const char *path)
+// binary: use the format described in TOOLS/stats-trace.py instead of text
+int mp_msg_open_stats_file(struct mpv_global *global, const char *path,
+                           bool binary)
 {
     struct mp_log_root *root = global->log->root;
     int r;
 
     pthread_mutex_lock(&mp_msg_lock);
 
-    if (root->stats_file)
-        fclose(root->stats_file);
-    root->stats_file = fopen(path, "wb");
-    r = root->stats_file ? 0 : -1;
+    if (start_writer(root)) {
+        // The writer holds writer_lock while it's writing.
+        pthread_mutex_lock(&root->writer_lock);
+        if (root->stats_file)
+            fclose(root->stats_file);
+        root->stats_file = fopen(path, "wb");
+        r = root->stats_file ? 0 : -1;
+        root->stats_binary = binary;
+        if (binary && root->stats_file) {
+            if (!root->stats_names) {
+                root->stats_names = talloc_zero_array(root, struct stats_name,
+                                                      STATS_NAMES_SIZE);
+                talloc_set_destructor(root->stats_names, free_stats_names);
+            }
+            // Magic and format version.
+            fwrite("mpvstats", 8, 1, root->stats_file);
+            uint8_t version[4];
+            put_le(version, 1, 4);
+            fwrite(version, sizeof(version), 1, root->stats_file);
+        }
+        pthread_mutex_unlock(&root->writer_lock);
+    } else {
+        r = -1;
+    }
 
     pthread_mutex_unlock(&mp_msg_lock);
 
@@ -600,6 +1017,13 @@ int mp_msg_open_stats_file(struct mpv_global *global, const char *path)
     return r;
 }
 
+// Return the number of log lines lost because the log file writer or a client
+// log buffer couldn't keep up.
+int64_t mp_msg_get_dropped(struct mpv_global *global)
+{
+    return atomic_load(&global->log->root->dropped);
+}
+
 // Thread-safety: fully thread-safe, but keep in mind that the lifetime of
 //                log must be guaranteed during the call.
 //                Never call this from signal handlers.
@@ -2,6 +2,7 @@
 #define MP_MSG_CONTROL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct mpv_global;
 void mp_msg_init(struct mpv_global *global);
@@ -29,7 +30,9 @@ struct mp_log_buffer *mp_msg_log_buffer_new(struct mpv_global *global,
 void mp_msg_log_buffer_destroy(struct mp_log_buffer *buffer);
 struct mp_log_buffer_entry *mp_msg_log_buffer_read(struct mp_log_buffer *buffer);
 
-int mp_msg_open_stats_file(struct mpv_global *global, const char *path);
+int mp_msg_open_stats_file(struct mpv_global *global, const char *path,
+                           bool binary);
+int64_t mp_msg_get_dropped(struct mpv_global *global);
 int mp_msg_find_level(const char *s);
 
 extern const char *const mp_log_levels[MSGL_MAX + 1];
@@ -30,6 +30,7 @@
 struct playlist_entry *playlist_entry_new(const char *filename)
 {
     struct playlist_entry *e = talloc_zero(NULL, struct playlist_entry);
+    e->pl_index = -1;
     char *local_filename = mp_file_url_to_filename(e, bstr0(filename));
     e->filename = local_filename ? local_filename : talloc_strdup(e, filename);
     return e;
@@ -49,37 +50,50 @@ void playlist_entry_add_params(struct playlist_entry *e,
         playlist_entry_add_param(e, params[n].name, params[n].value);
 }
 
+// Renumber the entries starting at index start.
+static void playlist_update_indexes(struct playlist *pl, int start)
+{
+    for (int n = MPMAX(start, 0); n < pl->num_entries; n++)
+        pl->entries[n]->pl_index = n;
+}
+
+// Insert the given entries at index at. This is O(n + num) regardless of the
+// number of entries inserted, unlike repeated playlist_insert() calls.
+static void playlist_insert_at(struct playlist *pl, int at,
+                               struct playlist_entry **add, int num)
+{
+    assert(pl && at >= 0 && at <= pl->num_entries);
+    if (num <= 0)
+        return;
+    MP_TARRAY_GROW(pl, pl->entries, pl->num_entries + num - 1);
+    memmove(&pl->entries[at + num], &pl->entries[at],
+            (pl->num_entries - at) * sizeof(pl->entries[0]));
+    pl->num_entries += num;
+    for (int n = 0; n < num; n++) {
+        struct playlist_entry *e = add[n];
+        assert(e->pl == NULL);
+        e->pl = pl;
+        e->id = ++pl->id_alloc;
+        pl->entries[at + n] = e;
+        talloc_steal(pl, e);
+    }
+    playlist_update_indexes(pl, at);
+}
+
 // Add entry "add" after entry "after".
 // If "after" is NULL, add as first entry.
-// Post condition: add->prev == after
+// Post condition: playlist_entry_get_rel(add, -1) == after
 void playlist_insert(struct playlist *pl, struct playlist_entry *after,
                      struct playlist_entry *add)
 {
-    assert(pl && add->pl == NULL && add->next == NULL && add->prev == NULL);
-    if (after) {
+    if (after)
         assert(after->pl == pl);
-        assert(pl->first && pl->last);
-    }
-    add->prev = after;
-    if (after) {
-        add->next = after->next;
-        after->next = add;
-    } else {
-        add->next = pl->first;
-        pl->first = add;
-    }
-    if (add->next) {
-        add->next->prev = add;
-    } else {
-        pl->last = add;
-    }
-    add->pl = pl;
-    talloc_steal(pl, add);
+    playlist_insert_at(pl, after ? after->pl_index + 1 : 0, &add, 1);
 }
 
 void playlist_add(struct playlist *pl, struct playlist_entry *add)
 {
-    playlist_insert(pl, pl->last, add);
+    playlist_insert_at(pl, pl->num_entries, &add, 1);
 }
 
 static void playlist_unlink(struct playlist *pl, struct playlist_entry *entry)
@@ -87,23 +101,15 @@ static void playlist_unlink(struct playlist *pl, struct playlist_entry *entry)
     assert(pl && entry->pl == pl);
 
     if (pl->current == entry) {
-        pl->current = entry->next;
+        pl->current = playlist_entry_get_rel(entry, 1);
         pl->current_was_replaced = true;
     }
 
-    if (entry->next) {
-        entry->next->prev = entry->prev;
-    } else {
-        pl->last = entry->prev;
-    }
-    if (entry->prev) {
-        entry->prev->next = entry->next;
-    } else {
-        pl->first = entry->next;
-    }
-    entry->next = entry->prev = NULL;
+    MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, entry->pl_index);
+    playlist_update_indexes(pl, entry->pl_index);
     // xxx: we'd want to reset the talloc parent of entry
     entry->pl = NULL;
+    entry->pl_index = -1;
 }
 
 void playlist_entry_unref(struct playlist_entry *e)
@@ -122,8 +128,9 @@ void playlist_remove(struct playlist *pl, struct playlist_entry *entry)
 
 void playlist_clear(struct playlist *pl)
 {
-    while (pl->first)
-        playlist_remove(pl, pl->first);
+    // Removing from the end doesn't need to shift or renumber anything.
+    while (pl->num_entries)
+        playlist_remove(pl, pl->entries[pl->num_entries - 1]);
     assert(!pl->current);
     pl->current_was_replaced = false;
 }
@@ -135,14 +142,17 @@ void playlist_move(struct playlist *pl, struct playlist_entry *entry,
     if (entry == at)
         return;
 
-    struct playlist_entry *save_current = pl->current;
-    bool save_replaced = pl->current_was_replaced;
+    assert(entry->pl == pl && (!at || at->pl == pl));
 
-    playlist_unlink(pl, entry);
-    playlist_insert(pl, at ? at->prev : pl->last, entry);
+    int old_index = entry->pl_index;
+    int index = at ? at->pl_index : pl->num_entries;
+    // The entry's own slot is gone once it's removed.
+    if (index > old_index)
+        index--;
 
-    pl->current = save_current;
-    pl->current_was_replaced = save_replaced;
+    MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, old_index);
+    MP_TARRAY_INSERT_AT(pl, pl->entries, pl->num_entries, index, entry);
+    playlist_update_indexes(pl, MPMIN(old_index, index));
 }
 
 void playlist_add_file(struct playlist *pl, const char *filename)
@@ -150,34 +160,13 @@ void playlist_add_file(struct playlist *pl, const char *filename)
     playlist_add(pl, playlist_entry_new(filename));
 }
 
-static int playlist_count(struct playlist *pl)
-{
-    int c = 0;
-    for (struct playlist_entry *e = pl->first; e; e = e->next)
-        c++;
-    return c;
-}
-
 void playlist_shuffle(struct playlist *pl)
 {
-    struct playlist_entry *save_current = pl->current;
-    bool save_replaced = pl->current_was_replaced;
-    int count = playlist_count(pl);
-    struct playlist_entry **arr = talloc_array(NULL, struct playlist_entry *,
-                                               count);
-    for (int n = 0; n < count; n++) {
-        arr[n] = pl->first;
-        playlist_unlink(pl, pl->first);
+    for (int n = 0; n < pl->num_entries - 1; n++) {
+        int j = (int)((double)(pl->num_entries - n) * rand() / (RAND_MAX + 1.0));
+        MPSWAP(struct playlist_entry *, pl->entries[n], pl->entries[n + j]);
     }
-    for (int n = 0; n < count - 1; n++) {
-        int j = (int)((double)(count - n) * rand() / (RAND_MAX + 1.0));
-        MPSWAP(struct playlist_entry *, arr[n], arr[n + j]);
-    }
-    for (int n = 0; n < count; n++)
-        playlist_add(pl, arr[n]);
-    talloc_free(arr);
-    pl->current = save_current;
-    pl->current_was_replaced = save_replaced;
+    playlist_update_indexes(pl, 0);
 }
 
 struct playlist_entry *playlist_get_next(struct playlist *pl, int direction)
@@ -187,15 +176,37 @@ struct playlist_entry *playlist_get_next(struct playlist *pl, int direction)
         return NULL;
     assert(pl->current->pl == pl);
     if (direction < 0)
-        return pl->current->prev;
-    return pl->current_was_replaced ? pl->current : pl->current->next;
+        return playlist_entry_get_rel(pl->current, -1);
+    return pl->current_was_replaced ? pl->current :
+           playlist_entry_get_rel(pl->current, 1);
+}
+
+struct playlist_entry *playlist_get_first(struct playlist *pl)
+{
+    return pl->num_entries ? pl->entries[0] : NULL;
+}
+
+struct playlist_entry *playlist_get_last(struct playlist *pl)
+{
+    return pl->num_entries ? pl->entries[pl->num_entries - 1] : NULL;
+}
+
+// Return the entry "direction" steps after e (or before, if negative), or NULL
+// if there is none.
+struct playlist_entry *playlist_entry_get_rel(struct playlist_entry *e,
+                                              int direction)
+{
+    if (!e || !e->pl)
+        return NULL;
+    return playlist_entry_from_index(e->pl, e->pl_index + direction);
 }
 
 void playlist_add_base_path(struct playlist *pl, bstr base_path)
 {
     if (base_path.len == 0 || bstrcmp0(base_path, ".") == 0)
         return;
-    for (struct playlist_entry *e = pl->first; e; e = e->next) {
+    for (int n = 0; n < pl->num_entries; n++) {
+        struct playlist_entry *e = pl->entries[n];
         if (!mp_is_url(bstr0(e->filename))) {
             char *new_file = mp_path_join_bstr(e, base_path, bstr0(e->filename));
             talloc_free(e->filename);
@@ -207,7 +218,8 @@ void playlist_add_base_path(struct playlist *pl, bstr base_path)
 // Add redirected_from as new redirect entry to each item in pl.
 void playlist_add_redirect(struct playlist *pl, const char *redirected_from)
 {
-    for (struct playlist_entry *e = pl->first; e; e = e->next) {
+    for (int n = 0; n < pl->num_entries; n++) {
+        struct playlist_entry *e = pl->entries[n];
         if (e->num_redirects >= 10) // arbitrary limit for sanity
             break;
         char *s = talloc_strdup(e, redirected_from);
@@ -216,63 +228,70 @@ void playlist_add_redirect(struct playlist *pl, const char *redirected_from)
     }
 }
 
+// Remove all entries from pl and return them as array (allocated with ctx).
+static struct playlist_entry **playlist_take_entries(void *ctx,
+                                                    struct playlist *pl,
+                                                    int *num)
+{
+    struct playlist_entry **entries = talloc_steal(ctx, pl->entries);
+    *num = pl->num_entries;
+    for (int n = 0; n < *num; n++) {
+        entries[n]->pl = NULL;
+        entries[n]->pl_index = -1;
+    }
+    pl->entries = NULL;
+    pl->num_entries = 0;
+    pl->current = NULL;
+    pl->current_was_replaced = false;
+    return entries;
+}
+
 // Move all entries from source_pl to pl, appending them after the current entry
 // of pl. source_pl will be empty, and all entries have changed ownership to pl.
 void playlist_transfer_entries(struct playlist *pl, struct playlist *source_pl)
 {
     struct playlist_entry *add_after = pl->current;
     if (pl->current && pl->current_was_replaced)
-        add_after = pl->current->next;
+        add_after = playlist_entry_get_rel(pl->current, 1);
     if (!add_after)
-        add_after = pl->last;
-
-    while (source_pl->first) {
-        struct playlist_entry *e = source_pl->first;
-        playlist_unlink(source_pl, e);
-        playlist_insert(pl, add_after, e);
-        add_after = e;
-    }
+        add_after = playlist_get_last(pl);
+
+    int num;
+    struct playlist_entry **entries = playlist_take_entries(NULL, source_pl,
+                                                            &num);
+    playlist_insert_at(pl, add_after ? add_after->pl_index + 1 : 0,
+                       entries, num);
+    talloc_free(entries);
 }
 
 void playlist_append_entries(struct playlist *pl, struct playlist *source_pl)
 {
-    while (source_pl->first) {
-        struct playlist_entry *e = source_pl->first;
-        playlist_unlink(source_pl, e);
-        playlist_add(pl, e);
-    }
+    int num;
+    struct playlist_entry **entries = playlist_take_entries(NULL, source_pl,
+                                                            &num);
+    playlist_insert_at(pl, pl->num_entries, entries, num);
+    talloc_free(entries);
 }
 
 // Return number of entries between list start and e.
 // Return -1 if e is not on the list, or if e is NULL.
 int playlist_entry_to_index(struct playlist *pl, struct playlist_entry *e)
 {
-    struct playlist_entry *cur = pl->first;
-    int pos = 0;
-    if (!e)
+    if (!e || e->pl != pl)
         return -1;
-    while (cur && cur != e) {
-        cur = cur->next;
-        pos++;
-    }
-    return cur == e ? pos : -1;
+    return e->pl_index;
 }
 
 int playlist_entry_count(struct playlist *pl)
 {
-    return playlist_entry_to_index(pl, pl->last) + 1;
+    return pl->num_entries;
 }
 
 // Return entry for which playlist_entry_to_index() would return index.
 // Return NULL if not found.
 struct playlist_entry *playlist_entry_from_index(struct playlist *pl, int index)
 {
-    struct playlist_entry *e = pl->first;
-    for (int n = 0; ; n++) {
-        if (!e || n == index)
-            return e;
-        e = e->next;
-    }
+    return index >= 0 && index < pl->num_entries ? pl->entries[index] : NULL;
 }
 
 struct playlist *playlist_parse_file(const char *file, struct mpv_global *global)
@@ -304,7 +323,7 @@ struct playlist *playlist_parse_file(const char *file, struct mpv_global *global
         mp_err(log, "Error while parsing playlist\n");
     }
 
-    if (ret && !ret->first)
+    if (ret && !ret->num_entries)
         mp_warn(log, "Warning: empty playlist\n");
 
     talloc_free(log);
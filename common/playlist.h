@@ -19,6 +19,7 @@
 #define MPLAYER_PLAYLIST_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "misc/bstr.h"
 
 struct playlist_param {
@@ -26,8 +27,13 @@ struct playlist_param {
 };
 
 struct playlist_entry {
-    struct playlist_entry *prev, *next;
+    // Invariant: (pl && pl->entries[pl_index] == this) || (!pl && pl_index < 0)
     struct playlist *pl;
+    int pl_index;
+
+    // Identifies the entry within pl. Never reused, and unlike the index it
+    // stays the same if entries are inserted, removed or moved.
+    int64_t id;
 
     char *filename;
 
@@ -62,7 +68,9 @@ struct playlist_entry {
 };
 
 struct playlist {
-    struct playlist_entry *first, *last;
+    struct playlist_entry **entries;
+    int num_entries;
+    int64_t id_alloc;
 
     // This provides some sort of stable iterator. If this entry is removed from
     // the playlist, current is set to the next element (or NULL), and
@@ -92,6 +100,10 @@ void playlist_move(struct playlist *pl, struct playlist_entry *entry,
 void playlist_add_file(struct playlist *pl, const char *filename);
 void playlist_shuffle(struct playlist *pl);
 struct playlist_entry *playlist_get_next(struct playlist *pl, int direction);
+struct playlist_entry *playlist_get_first(struct playlist *pl);
+struct playlist_entry *playlist_get_last(struct playlist *pl);
+struct playlist_entry *playlist_entry_get_rel(struct playlist_entry *e,
+                                              int direction);
 void playlist_add_base_path(struct playlist *pl, bstr base_path);
 void playlist_add_redirect(struct playlist *pl, const char *redirected_from);
 void playlist_transfer_entries(struct playlist *pl, struct playlist *source_pl);
@@ -118,6 +118,13 @@ struct demux_internal {
     double min_secs;
     int max_packs;
     int max_bytes;
+    int max_back_bytes;         // budget for packets kept for cached seeking
+
+    // Keep packets which were already returned to the decoder, so that seeks
+    // into the range of retained packets can be done without flushing.
+    bool seekable_cache;
+    uint64_t seek_cache_hits;   // seeks served from the packet queues
+    uint64_t seek_cache_misses; // seeks which had to go to the demuxer
 
     // Set if we know that we are at the start of the file. This is used to
     // avoid a redundant initial seek after enabling streams. We could just
@@ -160,8 +167,10 @@ struct demux_stream {
     bool refreshing;
     bool correct_dts;       // packet DTS is strictly monotonically increasing
     bool correct_pos;       // packet pos is strictly monotonically increasing
-    size_t packs;           // number of packets in buffer
-    size_t bytes;           // total bytes of packets in buffer
+    size_t packs;           // number of packets in buffer (after reader_head)
+    size_t bytes;           // total bytes of packets in buffer (same)
+    size_t back_packs;      // number of packets before reader_head
+    size_t back_bytes;      // total bytes of packets before reader_head
     double base_ts;         // timestamp of the last packet returned to decoder
     double last_ts;         // timestamp of the last packet added to queue
     double last_br_ts;      // timestamp of last packet bitrate was calculated
@@ -169,13 +178,25 @@ struct demux_stream {
     double bitrate;
     int64_t last_pos;
     double last_dts;
+    // Packets from head up to reader_head (exclusive) were already returned to
+    // the decoder, and are retained only for seeking (if seekable_cache is
+    // set). reader_head is the next packet to return, or NULL if none.
     struct demux_packet *head;
     struct demux_packet *tail;
+    struct demux_packet *reader_head;
+    // Keyframes in the packet queue, sorted by queue position and timestamp.
+    struct demux_kf_entry *kf_index;
+    int num_kf_index;
 
     // for closed captions (demuxer_feed_caption)
     struct sh_stream *cc;
 };
 
+struct demux_kf_entry {
+    double ts;
+    struct demux_packet *pkt;
+};
+
 // Return "a", or if that is NOPTS, return "def".
 #define PTS_OR_DEF(a, def) ((a) == MP_NOPTS_VALUE ? (def) : (a))
 // If one of the values is NOPTS, always pick the other one.
@@ -197,9 +218,12 @@ static void ds_flush(struct demux_stream *ds)
         free_demux_packet(dp);
         dp = dn;
     }
-    ds->head = ds->tail = NULL;
+    ds->head = ds->tail = ds->reader_head = NULL;
     ds->packs = 0;
     ds->bytes = 0;
+    ds->back_packs = 0;
+    ds->back_bytes = 0;
+    ds->num_kf_index = 0;
     ds->last_ts = ds->base_ts = ds->last_br_ts = MP_NOPTS_VALUE;
     ds->last_br_bytes = 0;
     ds->bitrate = -1;
@@ -212,6 +236,174 @@ static void ds_flush(struct demux_stream *ds)
     ds->correct_dts = ds->correct_pos = true;
 }
 
+// Append a keyframe index entry for dp, if it can be a seek target.
+// called locked
+static void add_index_entry(struct demux_stream *ds, struct demux_packet *dp)
+{
+    double ts = dp->pts == MP_NOPTS_VALUE ? dp->dts : dp->pts;
+    if (!dp->keyframe || ts == MP_NOPTS_VALUE)
+        return;
+    // The index must stay sorted. On timestamp resets, all older entries
+    // become unusable for seeking (the packets are pruned normally).
+    if (ds->num_kf_index && ts < ds->kf_index[ds->num_kf_index - 1].ts)
+        ds->num_kf_index = 0;
+    struct demux_kf_entry e = {ts, dp};
+    MP_TARRAY_APPEND(ds, ds->kf_index, ds->num_kf_index, e);
+}
+
+// Free the oldest packets before ds->reader_head, up to the next keyframe.
+// called locked
+static void ds_prune_head(struct demux_stream *ds)
+{
+    do {
+        struct demux_packet *dp = ds->head;
+        assert(dp && dp != ds->reader_head);
+        ds->head = dp->next;
+        if (!ds->head)
+            ds->tail = NULL;
+        ds->back_packs--;
+        ds->back_bytes -= dp->len;
+        if (ds->num_kf_index && ds->kf_index[0].pkt == dp)
+            MP_TARRAY_REMOVE_AT(ds->kf_index, ds->num_kf_index, 0);
+        free_demux_packet(dp);
+    } while (ds->head != ds->reader_head && !ds->head->keyframe);
+}
+
+// Discard packets that were already returned to the decoder, until the sum of
+// them fits into the back buffer budget. Packets from the stream with the
+// oldest retained data are freed first, to keep the cached ranges aligned.
+// called locked
+static void prune_old_packets(struct demux_internal *in)
+{
+    size_t max_bytes = in->seekable_cache ? in->max_back_bytes : 0;
+    while (1) {
+        size_t total = 0;
+        struct demux_stream *earliest = NULL;
+        double earliest_ts = MP_NOPTS_VALUE;
+        for (int n = 0; n < in->num_streams; n++) {
+            struct demux_stream *ds = in->streams[n]->ds;
+            total += ds->back_bytes;
+            if (!ds->back_packs)
+                continue;
+            double ts = PTS_OR_DEF(ds->head->dts, ds->head->pts);
+            if (!earliest || ts == MP_NOPTS_VALUE ||
+                (earliest_ts != MP_NOPTS_VALUE && ts < earliest_ts))
+            {
+                earliest = ds;
+                earliest_ts = ts;
+            }
+        }
+        if (total <= max_bytes || !earliest)
+            break;
+        ds_prune_head(earliest);
+    }
+}
+
+// Return the time range in which seeks can be served from the packet queues
+// alone. Sparse streams (subtitles) don't restrict the range.
+// called locked
+static bool get_seek_range(struct demux_internal *in, double range[2])
+{
+    range[0] = range[1] = MP_NOPTS_VALUE;
+    if (!in->seekable_cache || in->seeking || in->tracks_switched)
+        return false;
+    bool any = false;
+    for (int n = 0; n < in->num_streams; n++) {
+        struct demux_stream *ds = in->streams[n]->ds;
+        if (!ds->selected || ds->type == STREAM_SUB)
+            continue;
+        if (!ds->num_kf_index || ds->last_ts == MP_NOPTS_VALUE ||
+            ds->need_refresh || ds->refreshing)
+            return false;
+        double start = ds->kf_index[0].ts;
+        double end = ds->last_ts;
+        range[0] = any ? MPMAX(range[0], start) : start;
+        range[1] = any ? MPMIN(range[1], end) : end;
+        any = true;
+    }
+    if (!any || range[0] > range[1]) {
+        range[0] = range[1] = MP_NOPTS_VALUE;
+        return false;
+    }
+    return true;
+}
+
+// Make the reader continue at the keyframe closest to pts (according to the
+// seek flags). The demuxer itself keeps reading where it was.
+// called locked
+static void ds_seek_cached(struct demux_stream *ds, double pts, int flags)
+{
+    // Binary search for the number of index entries with ts <= pts.
+    int lo = 0, hi = ds->num_kf_index;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ds->kf_index[mid].ts <= pts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int idx = lo - 1;
+    if ((flags & SEEK_FORWARD) && (idx < 0 || ds->kf_index[idx].ts < pts) &&
+        idx + 1 < ds->num_kf_index)
+        idx += 1;
+    if (idx < 0 && ds->num_kf_index)
+        idx = 0;
+
+    struct demux_packet *target = idx >= 0 ? ds->kf_index[idx].pkt : ds->head;
+
+    ds->reader_head = target;
+    ds->packs = ds->bytes = ds->back_packs = ds->back_bytes = 0;
+    bool fw = false;
+    for (struct demux_packet *dp = ds->head; dp; dp = dp->next) {
+        fw |= dp == target;
+        if (fw) {
+            ds->packs++;
+            ds->bytes += dp->len;
+        } else {
+            ds->back_packs++;
+            ds->back_bytes += dp->len;
+        }
+    }
+
+    ds->base_ts = idx >= 0 ? ds->kf_index[idx].ts : MP_NOPTS_VALUE;
+    ds->last_br_ts = MP_NOPTS_VALUE;
+    ds->last_br_bytes = 0;
+    if (ds->reader_head)
+        ds->eof = false;
+}
+
+// Try to execute the seek using only the retained packets. Returns false if
+// the target is outside of the cached range; then a normal seek is needed.
+// called locked
+static bool try_seek_cache(struct demux_internal *in, double pts, int flags)
+{
+    if (flags & SEEK_FACTOR)
+        return false;
+
+    double range[2];
+    if (!get_seek_range(in, range) || pts < range[0] || pts > range[1])
+        return false;
+
+    // Streams without any keyframe in the cache (e.g. subtitles) would have
+    // to replay everything that was retained; do a normal seek instead.
+    for (int n = 0; n < in->num_streams; n++) {
+        struct demux_stream *ds = in->streams[n]->ds;
+        if (ds->selected && ds->head && !ds->num_kf_index)
+            return false;
+    }
+
+    MP_VERBOSE(in, "seeking in cached range %f-%f\n", range[0], range[1]);
+
+    for (int n = 0; n < in->num_streams; n++) {
+        struct demux_stream *ds = in->streams[n]->ds;
+        if (ds->selected)
+            ds_seek_cached(ds, pts, flags);
+    }
+    in->warned_queue_overflow = false;
+    return true;
+}
+
 void demux_set_ts_offset(struct demuxer *demuxer, double offset)
 {
     struct demux_internal *in = demuxer->in;
@@ -528,6 +720,8 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
         // first packet in stream
         ds->head = ds->tail = dp;
     }
+    if (!ds->reader_head)
+        ds->reader_head = dp;
 
     // obviously not true anymore
     ds->eof = false;
@@ -544,11 +738,14 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
     if (ds->base_ts == MP_NOPTS_VALUE)
         ds->base_ts = ds->last_ts;
 
+    if (in->seekable_cache)
+        add_index_entry(ds, dp);
+
     MP_DBG(in, "append packet to %s: size=%d pts=%f dts=%f pos=%"PRIi64" "
            "[num=%zd size=%zd]\n", stream_type_name(stream->type),
            dp->len, dp->pts, dp->dts, dp->pos, ds->packs, ds->bytes);
 
-    if (ds->in->wakeup_cb && !ds->head->next)
+    if (ds->in->wakeup_cb && ds->reader_head == dp)
         ds->in->wakeup_cb(ds->in->wakeup_cb_ctx);
     pthread_cond_signal(&in->wakeup);
     pthread_mutex_unlock(&in->lock);
@@ -568,7 +765,7 @@ static bool read_packet(struct demux_internal *in)
     for (int n = 0; n < in->num_streams; n++) {
         struct demux_stream *ds = in->streams[n]->ds;
         active |= ds->active;
-        read_more |= ds->active && !ds->head;
+        read_more |= ds->active && !ds->reader_head;
         packs += ds->packs;
         bytes += ds->bytes;
         if (ds->active && ds->last_ts != MP_NOPTS_VALUE && in->min_secs > 0 &&
@@ -591,7 +788,7 @@ static bool read_packet(struct demux_internal *in)
         }
         for (int n = 0; n < in->num_streams; n++) {
             struct demux_stream *ds = in->streams[n]->ds;
-            bool eof = !ds->head;
+            bool eof = !ds->reader_head;
             if (eof && !ds->eof) {
                 if (in->wakeup_cb)
                     in->wakeup_cb(in->wakeup_cb_ctx);
@@ -650,7 +847,7 @@ static void ds_get_packets(struct demux_stream *ds)
     MP_DBG(in, "reading packet for %s\n", t);
     in->eof = false; // force retry
     ds->eof = false;
-    while (ds->selected && !ds->head && !ds->eof) {
+    while (ds->selected && !ds->reader_head && !ds->eof) {
         ds->active = true;
         // Note: the following code marks EOF if it can't continue
         if (in->threading) {
@@ -741,15 +938,35 @@ static void *demux_thread(void *pctx)
 
 static struct demux_packet *dequeue_packet(struct demux_stream *ds)
 {
-    if (!ds->head)
+    struct demux_internal *in = ds->in;
+    if (!ds->reader_head)
         return NULL;
-    struct demux_packet *pkt = ds->head;
-    ds->head = pkt->next;
-    pkt->next = NULL;
-    if (!ds->head)
-        ds->tail = NULL;
-    ds->bytes -= pkt->len;
-    ds->packs--;
+    struct demux_packet *pkt = ds->reader_head;
+
+    if (in->seekable_cache) {
+        // Keep the packet in the queue, and return a new reference to it.
+        // The reader position is moved only if this succeeds, so that the
+        // packet is not lost on OOM.
+        struct demux_packet *cached = pkt;
+        pkt = demux_copy_packet(cached);
+        if (!pkt)
+            return NULL;
+        ds->reader_head = cached->next;
+        ds->bytes -= cached->len;
+        ds->packs--;
+        ds->back_packs++;
+        ds->back_bytes += cached->len;
+        prune_old_packets(in);
+    } else {
+        ds->reader_head = pkt->next;
+        ds->bytes -= pkt->len;
+        ds->packs--;
+        assert(ds->head == pkt);
+        ds->head = ds->reader_head;
+        if (!ds->head)
+            ds->tail = NULL;
+        pkt->next = NULL;
+    }
 
     double ts = pkt->dts == MP_NOPTS_VALUE ? pkt->pts : pkt->dts;
     if (ts != MP_NOPTS_VALUE)
@@ -861,7 +1078,7 @@ bool demux_has_packet(struct sh_stream *sh)
     bool has_packet = false;
     if (sh) {
         pthread_mutex_lock(&sh->ds->in->lock);
-        has_packet = sh->ds->head;
+        has_packet = sh->ds->reader_head;
         pthread_mutex_unlock(&sh->ds->in->lock);
     }
     return has_packet;
@@ -1207,6 +1424,7 @@ static struct demuxer *open_given_type(struct mpv_global *global,
         .min_secs = demuxer->opts->demuxer_min_secs,
         .max_packs = demuxer->opts->demuxer_max_packs,
         .max_bytes = demuxer->opts->demuxer_max_bytes,
+        .max_back_bytes = demuxer->opts->demuxer_max_back_bytes,
         .initial_state = true,
     };
     pthread_mutex_init(&in->lock, NULL);
@@ -1215,6 +1433,11 @@ static struct demuxer *open_given_type(struct mpv_global *global,
     if (stream->uncached_stream)
         in->min_secs = MPMAX(in->min_secs, demuxer->opts->demuxer_min_secs_cache);
 
+    int seekable_cache = demuxer->opts->demuxer_seekable_cache;
+    if (seekable_cache < 0)
+        seekable_cache = !!stream->uncached_stream;
+    in->seekable_cache = seekable_cache && in->max_back_bytes > 0;
+
     *in->d_thread = *demuxer;
     *in->d_buffer = *demuxer;
 
@@ -1395,6 +1618,19 @@ int demux_seek(demuxer_t *demuxer, double seek_pts, int flags)
 
     pthread_mutex_lock(&in->lock);
 
+    if (!(flags & SEEK_FACTOR))
+        seek_pts = MP_ADD_PTS(seek_pts, -in->ts_offset);
+
+    if (try_seek_cache(in, seek_pts, flags)) {
+        in->seek_cache_hits++;
+        demuxer->filepos = -1; // implicitly synchronized
+        pthread_cond_signal(&in->wakeup);
+        pthread_mutex_unlock(&in->lock);
+        return 1;
+    }
+    if (in->seekable_cache)
+        in->seek_cache_misses++;
+
     MP_VERBOSE(in, "queuing seek to %f%s\n", seek_pts,
                in->seeking ? " (cascade)" : "");
 
@@ -1402,8 +1638,6 @@ int demux_seek(demuxer_t *demuxer, double seek_pts, int flags)
     in->seeking = true;
     in->seek_flags = flags;
     in->seek_pts = seek_pts;
-    if (!(flags & SEEK_FACTOR))
-        in->seek_pts = MP_ADD_PTS(in->seek_pts, -in->ts_offset);
 
     if (!in->threading)
         execute_seek(in);
@@ -1531,6 +1765,16 @@ static void update_cache(struct demux_internal *in)
     struct demuxer *demuxer = in->d_thread;
     struct stream *stream = demuxer->stream;
 
+    // Bitrate of the selected streams, for the adaptive cache readahead.
+    pthread_mutex_lock(&in->lock);
+    double bitrate = -1;
+    for (int n = 0; n < in->num_streams; n++) {
+        struct demux_stream *ds = in->streams[n]->ds;
+        if (ds->selected && ds->bitrate >= 0)
+            bitrate = MPMAX(bitrate, 0) + ds->bitrate;
+    }
+    pthread_mutex_unlock(&in->lock);
+
     // Don't lock while querying the stream.
     double time_length = -1;
     struct mp_tags *stream_metadata = NULL;
@@ -1545,6 +1789,13 @@ static void update_cache(struct demux_internal *in)
     stream_control(stream, STREAM_CTRL_GET_METADATA, &stream_metadata);
     stream_control(stream, STREAM_CTRL_GET_CACHE_INFO, &stream_cache_info);
 
+    if (stream_cache_info.size >= 0) {
+        // Fall back to the average bitrate (includes container overhead).
+        if (bitrate < 0 && stream_size > 0 && time_length > 0)
+            bitrate = stream_size / time_length;
+        stream_control(stream, STREAM_CTRL_SET_CACHE_BITRATE, &bitrate);
+    }
+
     pthread_mutex_lock(&in->lock);
     in->time_length = time_length;
     in->stream_size = stream_size;
@@ -1625,7 +1876,7 @@ static int cached_demux_control(struct demux_internal *in, int cmd, void *arg)
         for (int n = 0; n < in->num_streams; n++) {
             struct demux_stream *ds = in->streams[n]->ds;
             if (ds->active) {
-                r->underrun |= !ds->head && !ds->eof;
+                r->underrun |= !ds->reader_head && !ds->eof;
                 r->ts_range[0] = MP_PTS_MAX(r->ts_range[0], ds->base_ts);
                 r->ts_range[1] = MP_PTS_MIN(r->ts_range[1], ds->last_ts);
                 num_packets += ds->packs;
@@ -1639,6 +1890,18 @@ static int cached_demux_control(struct demux_internal *in, int cmd, void *arg)
             r->ts_duration = 0;
         r->ts_range[0] = MP_ADD_PTS(r->ts_range[0], in->ts_offset);
         r->ts_range[1] = MP_ADD_PTS(r->ts_range[1], in->ts_offset);
+        r->seekable_cache = in->seekable_cache;
+        if (get_seek_range(in, r->seek_range)) {
+            r->seek_range[0] = MP_ADD_PTS(r->seek_range[0], in->ts_offset);
+            r->seek_range[1] = MP_ADD_PTS(r->seek_range[1], in->ts_offset);
+        }
+        for (int n = 0; n < in->num_streams; n++) {
+            struct demux_stream *ds = in->streams[n]->ds;
+            r->fw_bytes += ds->bytes;
+            r->total_bytes += ds->bytes + ds->back_bytes;
+        }
+        r->seek_cache_hits = in->seek_cache_hits;
+        r->seek_cache_misses = in->seek_cache_misses;
         return DEMUXER_CTRL_OK;
     }
     }
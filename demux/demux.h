@@ -50,6 +50,11 @@ struct demux_ctrl_reader_state {
     bool eof, underrun, idle;
     double ts_range[2]; // start, end
     double ts_duration;
+    // Seekable packet cache (--demuxer-seekable-cache)
+    bool seekable_cache;
+    double seek_range[2]; // start, end; MP_NOPTS_VALUE if none
+    int64_t fw_bytes, total_bytes;
+    uint64_t seek_cache_hits, seek_cache_misses;
 };
 
 struct demux_ctrl_stream_ctrl {
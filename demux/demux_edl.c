@@ -133,14 +133,22 @@ error:
     return NULL;
 }
 
-static struct demuxer *open_source(struct timeline *tl, char *filename)
+static struct demuxer *find_source(struct timeline *tl, char *filename)
 {
     for (int n = 0; n < tl->num_sources; n++) {
         struct demuxer *d = tl->sources[n];
         if (strcmp(d->stream->url, filename) == 0)
             return d;
     }
-    struct demuxer *d = demux_open_url(filename, NULL, tl->cancel, tl->global);
+    return NULL;
+}
+
+static struct demuxer *open_source(struct timeline *tl, char *filename)
+{
+    struct demuxer *d = find_source(tl, filename);
+    if (d)
+        return d;
+    d = demux_open_url(filename, NULL, tl->cancel, tl->global);
     if (d) {
         MP_TARRAY_APPEND(tl, tl->sources, tl->num_sources, d);
     } else {
@@ -201,12 +209,62 @@ static void resolve_timestamps(struct tl_part *part, struct demuxer *demuxer)
         part->offset = demuxer->start_time;
 }
 
+// Add a chapter between each file.
+static void add_file_chapter(struct timeline *tl, double pts, char *filename)
+{
+    struct demux_chapter ch = {
+        .pts = pts,
+        .metadata = talloc_zero(tl, struct mp_tags),
+    };
+    mp_tags_set_str(ch.metadata, "title", filename);
+    MP_TARRAY_APPEND(tl, tl->chapters, tl->num_chapters, ch);
+}
+
+// If the length is known, opening the file can be left to demux_timeline.c.
+// The first part defines the track layout, and chapter timestamps need the
+// file's chapter list.
+static bool part_needs_source(struct tl_parts *parts, int n)
+{
+    struct tl_part *part = &parts->parts[n];
+    return n == 0 || part->length < 0 || part->chapter_ts;
+}
+
+// Whether the file must be opened while building the timeline, because at
+// least one part using it needs it. Parts referencing the same file then all
+// use the opened demuxer, instead of opening the file a second time later.
+static bool file_needs_source(struct tl_parts *parts, char *filename)
+{
+    for (int n = 0; n < parts->num_parts; n++) {
+        if (part_needs_source(parts, n) &&
+            strcmp(parts->parts[n].filename, filename) == 0)
+            return true;
+    }
+    return false;
+}
+
 static void build_timeline(struct timeline *tl, struct tl_parts *parts)
 {
     tl->parts = talloc_array_ptrtype(tl, tl->parts, parts->num_parts + 1);
     double starttime = 0;
     for (int n = 0; n < parts->num_parts; n++) {
         struct tl_part *part = &parts->parts[n];
+
+        if (!file_needs_source(parts, part->filename) &&
+            !find_source(tl, part->filename))
+        {
+            add_file_chapter(tl, starttime, part->filename);
+
+            tl->parts[n] = (struct timeline_part) {
+                .start = starttime,
+                .source_start = part->offset_set ? part->offset
+                                                 : MP_NOPTS_VALUE,
+                .url = talloc_strdup(tl, part->filename),
+            };
+
+            starttime += part->length;
+            continue;
+        }
+
         struct demuxer *source = open_source(tl, part->filename);
         if (!source)
             goto error;
@@ -235,13 +293,7 @@ static void build_timeline(struct timeline *tl, struct tl_parts *parts)
             }
         }
 
-        // Add a chapter between each file.
-        struct demux_chapter ch = {
-            .pts = starttime,
-            .metadata = talloc_zero(tl, struct mp_tags),
-        };
-        mp_tags_set_str(ch.metadata, "title", part->filename);
-        MP_TARRAY_APPEND(tl, tl->chapters, tl->num_chapters, ch);
+        add_file_chapter(tl, starttime, part->filename);
 
         // Also copy the source file's chapters for the relevant parts
         copy_chapters(&tl->chapters, &tl->num_chapters, source, part->offset,
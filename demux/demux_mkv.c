@@ -156,8 +156,8 @@ struct block_info {
     bool simple, keyframe, duration_known;
     int64_t timecode;
     mkv_track_t *track;
-    bstr data;
-    void *alloc;
+    bstr data;          // empty if the payload was skipped
+    AVBufferRef *buf;   // padded allocation data points into
     int64_t filepos;
 };
 
@@ -196,6 +196,10 @@ typedef struct mkv_demuxer {
 
     bool eof_warning;
 
+    // Read the payload of blocks of unselected tracks too (instead of
+    // skipping them), for blocks that are kept around until selection.
+    bool read_all_blocks;
+
     struct block_info tmp_block;
 } mkv_demuxer_t;
 
@@ -2331,9 +2335,9 @@ static void mkv_parse_and_add_packet(demuxer_t *demuxer, mkv_track_t *track,
 
 static void free_block(struct block_info *block)
 {
-    free(block->alloc);
-    block->alloc = NULL;
+    av_buffer_unref(&block->buf);
     block->data = (bstr){0};
+    block->track = NULL;
 }
 
 static void index_block(demuxer_t *demuxer, struct block_info *block)
@@ -2346,6 +2350,9 @@ static void index_block(demuxer_t *demuxer, struct block_info *block)
     }
 }
 
+// Returns 1 if a block was read, 0 if it belongs to an unknown track, and -1
+// on errors. The payload of blocks of unselected tracks is skipped, so that
+// block->data is empty; the other fields are set for indexing.
 static int read_block(demuxer_t *demuxer, int64_t end, struct block_info *block)
 {
     mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
@@ -2359,39 +2366,55 @@ static int read_block(demuxer_t *demuxer, int64_t end, struct block_info *block)
     length = ebml_read_length(s);
     if (length > 500000000 || stream_tell(s) + length > (uint64_t)end)
         goto exit;
-    block->alloc = malloc(length + AV_LZO_INPUT_PADDING);
-    if (!block->alloc)
-        goto exit;
-    block->data = (bstr){block->alloc, length};
     block->filepos = stream_tell(s);
-    if (stream_read(s, block->data.start, block->data.len) != block->data.len)
-        goto exit;
 
-    // Parse header of the Block element
-    /* first byte(s): track num */
-    num = ebml_read_vlen_uint(&block->data);
+    // Parse header of the Block element: track number (up to 8 bytes), time
+    // (2 bytes), flags (1 byte, left in the payload for the lacing parser).
+    bstr header = stream_peek(s, MPMIN(length, 11));
+    size_t header_size = header.len;
+    num = ebml_read_vlen_uint(&header);
     if (num == EBML_UINT_INVALID)
         goto exit;
     /* time (relative to cluster time) */
-    if (block->data.len < 3)
+    if (header.len < 3)
         goto exit;
-    time = block->data.start[0] << 8 | block->data.start[1];
-    block->data.start += 2;
-    block->data.len -= 2;
+    time = header.start[0] << 8 | header.start[1];
     if (block->simple)
-        block->keyframe = block->data.start[0] & 0x80;
+        block->keyframe = header.start[2] & 0x80;
     block->timecode = time * mkv_d->tc_scale + mkv_d->cluster_tc;
+    header_size -= header.len - 2;
+    stream_skip(s, header_size);
+    length -= header_size;
+
+    mkv_track_t *track = NULL;
     for (int i = 0; i < mkv_d->num_tracks; i++) {
         if (mkv_d->tracks[i]->tnum == num) {
-            block->track = mkv_d->tracks[i];
+            track = mkv_d->tracks[i];
             break;
         }
     }
-    if (!block->track) {
-        res = 0;
+    if (!track || (!mkv_d->read_all_blocks &&
+                   !demux_stream_is_selected(track->stream)))
+    {
+        if (!stream_skip(s, length))
+            goto exit;
+        block->track = track;
+        res = track ? 1 : 0;
         goto exit;
     }
 
+    // Read the payload directly into a padded, refcounted buffer, which the
+    // packets reference (see handle_block()).
+    size_t padding = MPMAX(AV_LZO_INPUT_PADDING, FF_INPUT_BUFFER_PADDING_SIZE);
+    block->buf = av_buffer_alloc(length + padding);
+    if (!block->buf)
+        goto exit;
+    memset(block->buf->data + length, 0, padding);
+    block->data = (bstr){block->buf->data, length};
+    if (stream_read(s, block->data.start, block->data.len) != block->data.len)
+        goto exit;
+    block->track = track;
+
     res = 1;
 exit:
     if (res <= 0)
@@ -2413,7 +2436,7 @@ static int handle_block(demuxer_t *demuxer, struct block_info *block_info)
     uint32_t lace_size[MAX_NUM_LACES];
     bool use_this_block = tc >= mkv_d->skip_to_timecode;
 
-    if (!demux_stream_is_selected(stream))
+    if (!block_info->buf || !demux_stream_is_selected(stream))
         return 0;
 
     if (demux_mkv_read_block_lacing(&data, &laces, lace_size)) {
@@ -2463,7 +2486,19 @@ static int handle_block(demuxer_t *demuxer, struct block_info *block_info)
 
             block = demux_mkv_decode(demuxer->log, track, block, 1);
 
-            demux_packet_t *dp = new_demux_packet_from(block.start, block.len);
+            // Reference the block buffer directly if nothing was decoded.
+            // This requires zeroed input padding after the data, which only
+            // the last lace has (others are followed by the next lace).
+            demux_packet_t *dp;
+            uint8_t *end = block_info->data.start + block_info->data.len;
+            if (block.start >= block_info->data.start &&
+                block.start + block.len == end)
+            {
+                dp = new_demux_packet_from_buf(block_info->buf, block.start,
+                                               block.len);
+            } else {
+                dp = new_demux_packet_from(block.start, block.len);
+            }
             if (!dp)
                 break;
             dp->keyframe = keyframe;
@@ -2552,7 +2587,7 @@ static int read_block_group(demuxer_t *demuxer, int64_t end,
         }
     }
 
-    return block->data.start ? 1 : 0;
+    return block->track ? 1 : 0;
 
 error:
     free_block(block);
@@ -2564,7 +2599,7 @@ static int read_next_block(demuxer_t *demuxer, struct block_info *block)
     mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
     stream_t *s = demuxer->stream;
 
-    if (mkv_d->tmp_block.alloc) {
+    if (mkv_d->tmp_block.track) {
         *block = mkv_d->tmp_block;
         mkv_d->tmp_block = (struct block_info){0};
         return 1;
@@ -2977,11 +3012,14 @@ static void probe_first_timestamp(struct demuxer *demuxer)
     if (!demuxer->opts->demux_mkv->probe_start_time)
         return;
 
+    // No streams are selected yet, but the block is kept for playback.
     struct block_info block;
+    mkv_d->read_all_blocks = true;
     if (read_next_block(demuxer, &block) > 0) {
         index_block(demuxer, &block);
         mkv_d->tmp_block = block;
     }
+    mkv_d->read_all_blocks = false;
 
     demuxer->start_time = mkv_d->cluster_tc / 1e9;
 
@@ -19,7 +19,6 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <assert.h>
-#include <dirent.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
@@ -39,6 +38,8 @@
 #include "options/options.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/dir_scan.h"
+#include "misc/thread_pool.h"
 #include "common/common.h"
 #include "common/playlist.h"
 #include "stream/stream.h"
@@ -63,6 +64,8 @@ struct tl_ctx {
     int num_chapters; // Total number of expected chapters.
 };
 
+#define MAX_PROBE_THREADS 4
+
 struct find_entry {
     char *name;
     int matchlen;
@@ -83,7 +86,7 @@ static int cmp_entry(const void *pa, const void *pb)
     return 0;
 }
 
-static bool test_matroska_ext(const char *filename)
+static bool test_matroska_ext(void *ctx, int dir, const char *filename)
 {
     static const char *const exts[] = {".mkv", ".mka", ".mks", ".mk3d", NULL};
     for (int n = 0; exts[n]; n++) {
@@ -96,30 +99,26 @@ static bool test_matroska_ext(const char *filename)
     return false;
 }
 
-static char **find_files(const char *original_file)
+static char **find_files(struct tl_ctx *ctx, const char *original_file)
 {
     void *tmpmem = talloc_new(NULL);
     char *basename = mp_basename(original_file);
     struct bstr directory = mp_dirname(original_file);
     char **results = talloc_size(NULL, 0);
     char *dir_zero = bstrdup0(tmpmem, directory);
-    DIR *dp = opendir(dir_zero);
-    if (!dp) {
-        talloc_free(tmpmem);
-        return results;
-    }
+    struct mp_dir_listing *list =
+        mp_scan_dirs(tmpmem, ctx->tl->cancel, &dir_zero, 1, test_matroska_ext,
+                     NULL);
     struct find_entry *entries = NULL;
-    struct dirent *ep;
     int num_results = 0;
-    while ((ep = readdir(dp))) {
-        if (!test_matroska_ext(ep->d_name))
-            continue;
+    for (int n = 0; n < list->num_entries; n++) {
+        struct mp_dir_entry *e = &list->entries[n];
         // don't list the original name
-        if (!strcmp(ep->d_name, basename))
+        if (!strcmp(e->name, basename))
             continue;
 
-        char *name = mp_path_join_bstr(results, directory, bstr0(ep->d_name));
-        char *s1 = ep->d_name;
+        char *name = mp_path_join_bstr(results, directory, bstr0(e->name));
+        char *s1 = e->name;
         char *s2 = basename;
         int matchlen = 0;
         while (*s1 && *s1++ == *s2++)
@@ -127,17 +126,11 @@ static char **find_files(const char *original_file)
         // be a bit more fuzzy about matching the filename
         matchlen = (matchlen + 3) / 5;
 
-        struct stat statbuf;
-        if (stat(name, &statbuf) != 0)
-            continue;
-        off_t size = statbuf.st_size;
-
         entries = talloc_realloc(tmpmem, entries, struct find_entry,
                                  num_results + 1);
-        entries[num_results] = (struct find_entry) { name, matchlen, size };
+        entries[num_results] = (struct find_entry) { name, matchlen, e->size };
         num_results++;
     }
-    closedir(dp);
     // NOTE: maybe should make it compare pointers instead
     if (entries)
         qsort(entries, num_results, sizeof(struct find_entry), cmp_entry);
@@ -159,25 +152,53 @@ static bool has_source_request(struct tl_ctx *ctx,
     return false;
 }
 
-// segment = get Nth segment of a multi-segment file
-static bool check_file_seg(struct tl_ctx *ctx, char *filename, int segment)
+struct probe_job {
+    struct tl_ctx *ctx;
+    char *filename;
+    struct demuxer *d;
+    bool was_valid;
+};
+
+// Open the Nth segment of a multi-segment file. job->d is NULL if the file
+// can't be opened, or if the segment is not one of the wanted sources.
+// job->was_valid is set if the file is a valid Matroska file with at least
+// this many segments (even if the segment itself is not wanted).
+static void open_file_seg(struct probe_job *job, int segment)
 {
-    bool was_valid = false;
+    struct tl_ctx *ctx = job->ctx;
     struct demuxer_params params = {
         .force_format = "mkv",
         .matroska_num_wanted_uids = ctx->num_sources,
         .matroska_wanted_uids = ctx->uids,
         .matroska_wanted_segment = segment,
-        .matroska_was_valid = &was_valid,
+        .matroska_was_valid = &job->was_valid,
         .disable_cache = true,
     };
     struct mp_cancel *cancel = ctx->tl->cancel;
+    job->d = NULL;
+    job->was_valid = false;
     if (mp_cancel_test(cancel))
-        return false;
+        return;
+
+    job->d = demux_open_url(job->filename, &params, cancel, ctx->global);
+}
 
-    struct demuxer *d = demux_open_url(filename, &params, cancel, ctx->global);
+// segment = get Nth segment of a multi-segment file
+// probed = the already opened segment (takes ownership of probed->d), or
+//          NULL to open it here
+static bool check_file_seg(struct tl_ctx *ctx, char *filename, int segment,
+                           struct probe_job *probed)
+{
+    struct probe_job job = { .ctx = ctx, .filename = filename };
+    if (probed) {
+        job = *probed;
+        probed->d = NULL;
+    } else {
+        open_file_seg(&job, segment);
+    }
+    struct demuxer *d = job.d;
     if (!d)
-        return false;
+        return job.was_valid;
 
     struct matroska_data *m = &d->matroska_data;
 
@@ -212,9 +233,14 @@ static bool check_file_seg(struct tl_ctx *ctx, char *filename, int segment)
             if (stream_wants_cache(d->stream, &ctx->global->opts->stream_cache))
             {
                 free_demuxer_and_stream(d);
-                params.disable_cache = false;
-                params.matroska_wanted_uids = ctx->uids; // potentially reallocated, same data
-                d = demux_open_url(filename, &params, cancel, ctx->global);
+                struct demuxer_params params = {
+                    .force_format = "mkv",
+                    .matroska_num_wanted_uids = ctx->num_sources,
+                    .matroska_wanted_uids = ctx->uids,
+                    .matroska_wanted_segment = segment,
+                };
+                d = demux_open_url(filename, &params, ctx->tl->cancel,
+                                   ctx->global);
                 if (!d)
                     return false;
             }
@@ -225,17 +251,48 @@ static bool check_file_seg(struct tl_ctx *ctx, char *filename, int segment)
     }
 
     free_demuxer_and_stream(d);
-    return was_valid;
+    return job.was_valid;
 }
 
-static void check_file(struct tl_ctx *ctx, char *filename, int first)
+static void check_file(struct tl_ctx *ctx, char *filename, int first,
+                       struct probe_job *probed)
 {
     for (int segment = first; ; segment++) {
-        if (!check_file_seg(ctx, filename, segment))
+        struct probe_job *job = segment == first ? probed : NULL;
+        if (!check_file_seg(ctx, filename, segment, job))
             break;
     }
 }
 
+static void probe_file(void *p)
+{
+    struct probe_job *job = p;
+    open_file_seg(job, 0);
+}
+
+// Open the first segment of the given files in parallel; most of the time is
+// spent waiting for I/O. The returned jobs have d set for the files whose
+// first segment is one of the currently wanted sources.
+static struct probe_job *probe_files(void *ta_parent, struct tl_ctx *ctx,
+                                     char **filenames, int num_filenames)
+{
+    struct probe_job *jobs =
+        talloc_zero_array(ta_parent, struct probe_job, num_filenames);
+    struct mp_thread_pool *pool = NULL;
+    if (num_filenames > 1)
+        pool = mp_thread_pool_create(NULL, num_filenames);
+    for (int i = 0; i < num_filenames; i++) {
+        jobs[i] = (struct probe_job){ .ctx = ctx, .filename = filenames[i] };
+        if (pool) {
+            mp_thread_pool_queue(pool, probe_file, &jobs[i]);
+        } else {
+            probe_file(&jobs[i]);
+        }
+    }
+    talloc_free(pool); // waits until all files are probed
+    return jobs;
+}
+
 static bool missing(struct tl_ctx *ctx)
 {
     for (int i = 0; i < ctx->num_sources; i++) {
@@ -260,30 +317,44 @@ static void find_ordered_chapter_sources(struct tl_ctx *ctx)
             struct playlist *pl =
                 playlist_parse_file(opts->ordered_chapters_files, ctx->global);
             talloc_steal(tmp, pl);
-            for (struct playlist_entry *e = pl->first; e; e = e->next)
-                MP_TARRAY_APPEND(tmp, filenames, num_filenames, e->filename);
+            for (int n = 0; n < pl->num_entries; n++) {
+                MP_TARRAY_APPEND(tmp, filenames, num_filenames,
+                                 pl->entries[n]->filename);
+            }
         } else if (ctx->demuxer->stream->uncached_type != STREAMTYPE_FILE) {
             MP_WARN(ctx, "Playback source is not a "
                     "normal disk file. Will not search for related files.\n");
         } else {
             MP_INFO(ctx, "Will scan other files in the "
                     "same directory to find referenced sources.\n");
-            filenames = find_files(main_filename);
+            filenames = find_files(ctx, main_filename);
             num_filenames = MP_TALLOC_AVAIL(filenames);
             talloc_steal(tmp, filenames);
         }
         // Possibly get further segments appended to the first segment
-        check_file(ctx, main_filename, 1);
+        check_file(ctx, main_filename, 1, NULL);
     }
 
     int old_source_count;
     do {
         old_source_count = ctx->num_sources;
-        for (int i = 0; i < num_filenames; i++) {
-            if (!missing(ctx))
-                break;
-            MP_VERBOSE(ctx, "Checking file %s\n", filenames[i]);
-            check_file(ctx, filenames[i], 0);
+        // Probe a few files at a time, so that the search can stop as soon
+        // as all sources were found. Files are probed against the segments
+        // wanted when their batch starts; sources requested by files matched
+        // later are picked up by the next pass.
+        for (int i = 0; i < num_filenames && missing(ctx);
+             i += MAX_PROBE_THREADS)
+        {
+            int num = MPMIN(num_filenames - i, MAX_PROBE_THREADS);
+            struct probe_job *probed = probe_files(tmp, ctx, filenames + i, num);
+            for (int n = 0; n < num; n++) {
+                struct probe_job *job = &probed[n];
+                if (job->was_valid && missing(ctx)) {
+                    MP_VERBOSE(ctx, "Checking file %s\n", job->filename);
+                    check_file(ctx, job->filename, 0, job);
+                }
+                free_demuxer_and_stream(job->d);
+            }
         }
     } while (old_source_count != ctx->num_sources);
 
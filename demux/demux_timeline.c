@@ -17,19 +17,33 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "common/common.h"
 #include "common/msg.h"
+#include "osdep/threads.h"
 
 #include "demux.h"
 #include "timeline.h"
 #include "stheader.h"
 
+// Maximum number of lazily opened sources kept open at the same time.
+#define MAX_OPEN_SOURCES 4
+
+// Source file of segments, which is opened only when it's needed.
+struct lazy_source {
+    char *url;
+    struct demuxer *d;          // NULL if not open
+    int64_t last_used;          // for closing the least recently used one
+};
+
 struct segment {
     int index;
     double start, end;
     double d_start;
-    struct demuxer *d;
+    double source_start;        // as in timeline_part, for lazy segments
+    struct demuxer *d;          // NULL if lazy and not opened
+    struct lazy_source *lazy;
     // stream_map[sh_stream.index] = index into priv.streams, where sh_stream
     // is a stream from the source d. It's used to map the streams of the
     // source onto the set of streams of the virtual timeline.
@@ -63,8 +77,20 @@ struct priv {
     // Total number of packets received past end of segment. Used
     // to be clever about determining when to switch segments.
     int eos_packets;
+
+    struct lazy_source **sources;
+    int num_sources;
+    int64_t use_counter;
+
+    // Opening the source of the next segment in the background.
+    pthread_t preopen_thread;
+    bool preopen_active;
+    struct lazy_source *preopen_src;
+    struct demuxer *preopen_result;
 };
 
+static void associate_streams(struct demuxer *demuxer, struct segment *seg);
+
 static void reselect_streams(struct demuxer *demuxer)
 {
     struct priv *p = demuxer->priv;
@@ -76,6 +102,8 @@ static void reselect_streams(struct demuxer *demuxer)
 
     for (int n = 0; n < p->num_segments; n++) {
         struct segment *seg = p->segments[n];
+        if (!seg->d)
+            continue;
         for (int i = 0; i < seg->num_stream_map; i++) {
             struct sh_stream *sh = demux_get_stream(seg->d, i);
             bool selected = false;
@@ -89,12 +117,135 @@ static void reselect_streams(struct demuxer *demuxer)
     }
 }
 
-static void switch_segment(struct demuxer *demuxer, struct segment *new,
+static void close_source(struct demuxer *demuxer, struct lazy_source *src)
+{
+    struct priv *p = demuxer->priv;
+    MP_VERBOSE(demuxer, "closing source '%s'\n", src->url);
+    for (int n = 0; n < p->num_segments; n++) {
+        struct segment *seg = p->segments[n];
+        if (seg->lazy == src) {
+            seg->d = NULL;
+            seg->num_stream_map = 0;
+        }
+    }
+    free_demuxer_and_stream(src->d);
+    src->d = NULL;
+}
+
+// Close least recently used sources until a new one can be opened. The
+// source of the current segment is never closed.
+static void make_room(struct demuxer *demuxer)
+{
+    struct priv *p = demuxer->priv;
+    for (;;) {
+        struct lazy_source *lru = NULL;
+        int num_open = 0;
+        for (int n = 0; n < p->num_sources; n++) {
+            struct lazy_source *src = p->sources[n];
+            if (!src->d)
+                continue;
+            num_open++;
+            if (p->current && p->current->lazy == src)
+                continue;
+            if (!lru || src->last_used < lru->last_used)
+                lru = src;
+        }
+        if (num_open < MAX_OPEN_SOURCES || !lru)
+            break;
+        close_source(demuxer, lru);
+    }
+}
+
+static void *preopen_thread(void *arg)
+{
+    struct demuxer *demuxer = arg;
+    struct priv *p = demuxer->priv;
+    mpthread_set_name("timeline-open");
+    p->preopen_result = demux_open_url(p->preopen_src->url, NULL,
+                                       p->tl->cancel, p->tl->global);
+    return NULL;
+}
+
+// Wait for background opening to finish, and add the result to its source.
+static void finish_preopen(struct demuxer *demuxer)
+{
+    struct priv *p = demuxer->priv;
+    if (!p->preopen_active)
+        return;
+    pthread_join(p->preopen_thread, NULL);
+    p->preopen_active = false;
+    struct lazy_source *src = p->preopen_src;
+    struct demuxer *d = p->preopen_result;
+    p->preopen_result = NULL;
+    if (d && !src->d) {
+        make_room(demuxer);
+        src->d = d;
+        src->last_used = ++p->use_counter;
+    } else {
+        free_demuxer_and_stream(d);
+    }
+}
+
+// Open the source of the given segment in the background, if it's not open.
+static void start_preopen(struct demuxer *demuxer, struct segment *seg)
+{
+    struct priv *p = demuxer->priv;
+    if (!seg->lazy || seg->lazy->d || p->preopen_active)
+        return;
+    p->preopen_src = seg->lazy;
+    p->preopen_result = NULL;
+    if (pthread_create(&p->preopen_thread, NULL, preopen_thread, demuxer))
+        return;
+    p->preopen_active = true;
+    MP_VERBOSE(demuxer, "opening '%s' in the background\n", seg->lazy->url);
+}
+
+// Make sure seg->d is set. Returns false if the source can't be opened.
+static bool open_segment(struct demuxer *demuxer, struct segment *seg)
+{
+    struct priv *p = demuxer->priv;
+    if (seg->d)
+        return true;
+
+    struct lazy_source *src = seg->lazy;
+    if (p->preopen_active && p->preopen_src == src)
+        finish_preopen(demuxer);
+    if (!src->d) {
+        MP_VERBOSE(demuxer, "opening source '%s'\n", src->url);
+        struct demuxer *d = demux_open_url(src->url, NULL, p->tl->cancel,
+                                           p->tl->global);
+        if (!d) {
+            MP_ERR(demuxer, "Could not open source file '%s'.\n", src->url);
+            return false;
+        }
+        make_room(demuxer);
+        src->d = d;
+    }
+    src->last_used = ++p->use_counter;
+
+    // Other segments from the same file can use it as well.
+    for (int n = 0; n < p->num_segments; n++) {
+        struct segment *other = p->segments[n];
+        if (other->lazy == src && !other->d) {
+            other->d = src->d;
+            other->d_start = other->source_start;
+            if (other->d_start == MP_NOPTS_VALUE)
+                other->d_start = src->d->start_time;
+            associate_streams(demuxer, other);
+        }
+    }
+    return true;
+}
+
+static bool switch_segment(struct demuxer *demuxer, struct segment *new,
                            double start_pts, int flags)
 {
     struct priv *p = demuxer->priv;
     bool new_segment = p->current != new;
 
+    if (!open_segment(demuxer, new))
+        return false;
+
     if (!(flags & (SEEK_FORWARD | SEEK_BACKWARD)))
         flags |= SEEK_BACKWARD | SEEK_HR;
 
@@ -113,6 +264,11 @@ static void switch_segment(struct demuxer *demuxer, struct segment *new,
     }
 
     p->eos_packets = 0;
+
+    if (new->index + 1 < p->num_segments)
+        start_preopen(demuxer, p->segments[new->index + 1]);
+
+    return true;
 }
 
 static void d_seek(struct demuxer *demuxer, double seek_pts, int flags)
@@ -123,15 +279,20 @@ static void d_seek(struct demuxer *demuxer, double seek_pts, int flags)
 
     flags &= SEEK_FORWARD | SEEK_BACKWARD | SEEK_HR;
 
-    struct segment *new = p->segments[p->num_segments - 1];
+    int index = p->num_segments - 1;
     for (int n = 0; n < p->num_segments; n++) {
         if (pts < p->segments[n]->end) {
-            new = p->segments[n];
+            index = n;
             break;
         }
     }
 
-    switch_segment(demuxer, new, pts, flags);
+    // If a source can't be opened, continue with the next segment.
+    for (int n = index; n < p->num_segments; n++) {
+        struct segment *new = p->segments[n];
+        if (switch_segment(demuxer, new, n == index ? pts : new->start, flags))
+            break;
+    }
 }
 
 static int d_fill_buffer(struct demuxer *demuxer)
@@ -169,17 +330,13 @@ static int d_fill_buffer(struct demuxer *demuxer)
     if (eos_reached || !pkt) {
         talloc_free(pkt);
 
-        struct segment *next = NULL;
-        for (int n = 0; n < p->num_segments - 1; n++) {
-            if (p->segments[n] == seg) {
-                next = p->segments[n + 1];
-                break;
-            }
+        // Skip segments whose source can't be opened.
+        for (int n = seg->index + 1; n < p->num_segments; n++) {
+            struct segment *next = p->segments[n];
+            if (switch_segment(demuxer, next, next->start, 0))
+                return 1; // reader will retry
         }
-        if (!next)
-            return 0;
-        switch_segment(demuxer, next, next->start, 0);
-        return 1; // reader will retry
+        return 0;
     }
 
     if (pkt->stream < 0 || pkt->stream > seg->num_stream_map)
@@ -234,6 +391,11 @@ static void print_timeline(struct demuxer *demuxer)
     MP_VERBOSE(demuxer, "Timeline segments:\n");
     for (int n = 0; n < p->num_segments; n++) {
         struct segment *seg = p->segments[n];
+        if (seg->lazy) {
+            MP_VERBOSE(demuxer, " %2d: %12f [%12f] (not opened) '%s'\n", n,
+                       seg->start, seg->source_start, seg->lazy->url);
+            continue;
+        }
         int src_num = -1;
         for (int i = 0; i < p->tl->num_sources; i++) {
             if (p->tl->sources[i] == seg->d) {
@@ -290,6 +452,19 @@ static void associate_streams(struct demuxer *demuxer, struct segment *seg)
     }
 }
 
+static struct lazy_source *get_lazy_source(struct demuxer *demuxer, char *url)
+{
+    struct priv *p = demuxer->priv;
+    for (int n = 0; n < p->num_sources; n++) {
+        if (strcmp(p->sources[n]->url, url) == 0)
+            return p->sources[n];
+    }
+    struct lazy_source *src = talloc_ptrtype(p, src);
+    *src = (struct lazy_source){ .url = talloc_strdup(src, url) };
+    MP_TARRAY_APPEND(p, p->sources, p->num_sources, src);
+    return src;
+}
+
 static int d_open(struct demuxer *demuxer, enum demux_check check)
 {
     struct priv *p = demuxer->priv = talloc_zero(demuxer, struct priv);
@@ -337,11 +512,17 @@ static int d_open(struct demuxer *demuxer, enum demux_check check)
         *seg = (struct segment){
             .d = part->source,
             .d_start = part->source_start,
+            .source_start = part->source_start,
             .start = part->start,
             .end = next->start,
         };
 
-        associate_streams(demuxer, seg);
+        if (seg->d) {
+            associate_streams(demuxer, seg);
+        } else {
+            assert(n > 0 && part->url);
+            seg->lazy = get_lazy_source(demuxer, part->url);
+        }
 
         seg->index = n;
         MP_TARRAY_APPEND(p, p->segments, p->num_segments, seg);
@@ -363,6 +544,9 @@ static void d_close(struct demuxer *demuxer)
 {
     struct priv *p = demuxer->priv;
     struct demuxer *master = p->tl->demuxer;
+    finish_preopen(demuxer);
+    for (int n = 0; n < p->num_sources; n++)
+        free_demuxer_and_stream(p->sources[n]->d);
     timeline_destroy(p->tl);
     free_demuxer(master);
 }
@@ -82,6 +82,19 @@ struct demux_packet *new_demux_packet_from(void *data, size_t len)
     return new_demux_packet_from_avpacket(&pkt);
 }
 
+// Reference len bytes at data, which must point into buf. No data is copied.
+// The caller must make sure the buffer has input padding after data+len.
+struct demux_packet *new_demux_packet_from_buf(struct AVBufferRef *buf,
+                                               void *data, size_t len)
+{
+    if (len > INT_MAX)
+        return NULL;
+    assert((uint8_t *)data >= buf->data &&
+           (uint8_t *)data + len <= buf->data + buf->size);
+    AVPacket pkt = { .buf = buf, .data = data, .size = len };
+    return new_demux_packet_from_avpacket(&pkt);
+}
+
 struct demux_packet *new_demux_packet(size_t len)
 {
     if (len > INT_MAX)
@@ -113,6 +126,7 @@ void demux_packet_copy_attribs(struct demux_packet *dst, struct demux_packet *sr
     dst->new_segment = src->new_segment;
     dst->keyframe = src->keyframe;
     dst->stream = src->stream;
+    dst->codec = src->codec;
 }
 
 struct demux_packet *demux_copy_packet(struct demux_packet *dp)
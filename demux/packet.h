@@ -45,9 +45,13 @@ typedef struct demux_packet {
     struct AVPacket *avpacket;   // keep the buffer allocation and sidedata
 } demux_packet_t;
 
+struct AVBufferRef;
+
 struct demux_packet *new_demux_packet(size_t len);
 struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt);
 struct demux_packet *new_demux_packet_from(void *data, size_t len);
+struct demux_packet *new_demux_packet_from_buf(struct AVBufferRef *buf,
+                                               void *data, size_t len);
 void demux_packet_shorten(struct demux_packet *dp, size_t len);
 void free_demux_packet(struct demux_packet *dp);
 struct demux_packet *demux_copy_packet(struct demux_packet *dp);
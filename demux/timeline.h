@@ -3,8 +3,12 @@
 
 struct timeline_part {
     double start;
-    double source_start;
+    double source_start;    // MP_NOPTS_VALUE: the source's start time
     struct demuxer *source;
+    // If source is NULL, the source is opened from this URL only when playback
+    // gets close to the part (see demux_timeline.c). parts[0] must always have
+    // a source.
+    char *url;
 };
 
 struct timeline {
@@ -15,7 +19,7 @@ struct timeline {
     // main source
     struct demuxer *demuxer;
 
-    // All referenced files. The source file must be at sources[0].
+    // All opened referenced files. The source file must be at sources[0].
     struct demuxer **sources;
     int num_sources;
 
@@ -261,9 +261,15 @@ void mp_uninit_ipc(struct mp_ipc_ctx *ctx);
 struct mpv_event;
 char *mp_json_encode_event(struct mpv_event *event);
 
-// Given the raw IPC input buffer "buf", remove the first newline-separated
-// command, execute it and return the result (if any) as an allocated string.
+// Return whether the raw IPC input buffer "buf" contains a complete command
+// (a newline-terminated line, or a complete binary frame).
+bool mp_ipc_has_command(bstr buf);
+
+// Given the raw IPC input buffer "buf", remove the first command, execute it
+// and return the reply (if any) as allocated string. Replies to binary framed
+// commands are binary framed too, and can contain 0 bytes. Returns an empty
+// bstr if there is no reply. Must be called only if mp_ipc_has_command().
 struct mpv_handle;
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
+bstr mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
 
 #endif /* MPLAYER_INPUT_H */
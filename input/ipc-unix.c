@@ -63,9 +63,10 @@ struct client_arg {
     bool writable;
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+static int ipc_write(struct client_arg *client, bstr data)
 {
-    size_t count = strlen(buf);
+    const char *buf = data.start;
+    size_t count = data.len;
     while (count > 0) {
         ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
         if (rc <= 0) {
@@ -153,7 +154,7 @@ static void *client_thread(void *p)
                     goto done;
                 }
 
-                rc = ipc_write_str(arg, event_msg);
+                rc = ipc_write(arg, bstr0(event_msg));
                 talloc_free(event_msg);
                 if (rc < 0) {
                     MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
@@ -164,7 +165,7 @@ static void *client_thread(void *p)
 
         if (fds[1].revents & (POLLIN | POLLHUP)) {
             while (1) {
-                char buf[128];
+                char buf[4096];
                 bstr append = { buf, 0 };
 
                 ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
@@ -185,20 +186,20 @@ static void *client_thread(void *p)
 
                 bstr_xappend(NULL, &client_msg, append);
 
-                while (bstrchr(client_msg, '\n') != -1) {
-                    char *reply_msg = mp_ipc_consume_next_command(arg->client,
+                while (mp_ipc_has_command(client_msg)) {
+                    bstr reply_msg = mp_ipc_consume_next_command(arg->client,
                         NULL, &client_msg);
 
-                    if (reply_msg && arg->writable) {
-                        rc = ipc_write_str(arg, reply_msg);
+                    if (reply_msg.len && arg->writable) {
+                        rc = ipc_write(arg, reply_msg);
                         if (rc < 0) {
                             MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                            talloc_free(reply_msg);
+                            talloc_free(reply_msg.start);
                             goto done;
                         }
                     }
 
-                    talloc_free(reply_msg);
+                    talloc_free(reply_msg.start);
                 }
             }
         }
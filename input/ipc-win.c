@@ -166,11 +166,11 @@ static bool pipe_error_is_fatal(DWORD error)
     return true;
 }
 
-static DWORD ipc_write_str(struct client_arg *arg, const char *buf)
+static DWORD ipc_write(struct client_arg *arg, bstr buf)
 {
     DWORD error = 0;
 
-    if ((error = async_write(arg->client_h, buf, strlen(buf), &arg->write_ol)))
+    if ((error = async_write(arg->client_h, buf.start, buf.len, &arg->write_ol)))
         goto done;
     if (!GetOverlappedResult(arg->client_h, &arg->write_ol, &(DWORD){0}, TRUE)) {
         error = GetLastError();
@@ -261,7 +261,7 @@ static void *client_thread(void *p)
                     goto done;
                 }
 
-                ipc_write_str(arg, event_msg);
+                ipc_write(arg, bstr0(event_msg));
                 talloc_free(event_msg);
             }
 
@@ -274,12 +274,12 @@ static void *client_thread(void *p)
             }
 
             bstr_xappend(NULL, &client_msg, (bstr){buf, r});
-            while (bstrchr(client_msg, '\n') != -1) {
-                char *reply_msg = mp_ipc_consume_next_command(arg->client,
+            while (mp_ipc_has_command(client_msg)) {
+                bstr reply_msg = mp_ipc_consume_next_command(arg->client,
                     NULL, &client_msg);
-                if (reply_msg && arg->writable)
-                    ipc_write_str(arg, reply_msg);
-                talloc_free(reply_msg);
+                if (reply_msg.len && arg->writable)
+                    ipc_write(arg, reply_msg);
+                talloc_free(reply_msg.start);
             }
 
             // Begin the next read operation on the pipe
@@ -15,6 +15,8 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <libavutil/intreadwrite.h>
+
 #include "config.h"
 
 #include "common/msg.h"
@@ -25,6 +27,14 @@
 #include "options/path.h"
 #include "player/client.h"
 
+// Maximum nesting of a request: enough for a batch of commands, with one
+// level left for structured property values.
+#define MAX_REQUEST_DEPTH 6
+
+// Binary framed messages: a 0 byte, the payload length as 32 bit little
+// endian integer, and the payload (a binary encoded mpv_node).
+#define BINARY_HEADER_SIZE 5
+
 static mpv_node *mpv_node_map_get(mpv_node *src, const char *key)
 {
     if (src->format != MPV_FORMAT_NODE_MAP)
@@ -193,33 +203,38 @@ char *mp_json_encode_event(mpv_event *event)
     return output;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+static void execute_batch(struct mpv_handle *client, void *ta_parent,
+                          mpv_node *batch_node, mpv_node *reply_node);
+
+// Execute the request msg_node, and add the reply fields to reply_node (which
+// must be an empty map).
+static void execute_request(struct mpv_handle *client, void *ta_parent,
+                            mpv_node *msg_node, mpv_node *reply_node)
 {
-    int rc;
+    int rc = 0;
     const char *cmd = NULL;
-    struct mp_log *log = mp_client_get_log(client);
 
-    mpv_node msg_node;
-    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
     mpv_node *reqid_node = NULL;
 
-    rc = json_parse(ta_parent, &msg_node, &src, 3);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received\n");
+    if (msg_node->format != MPV_FORMAT_NODE_MAP) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
     }
 
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
-        rc = MPV_ERROR_INVALID_PARAMETER;
+    reqid_node = mpv_node_map_get(msg_node, "request_id");
+
+    mpv_node *batch_node = mpv_node_map_get(msg_node, "batch");
+    if (batch_node) {
+        if (batch_node->format != MPV_FORMAT_NODE_ARRAY) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+        execute_batch(client, ta_parent, batch_node, reply_node);
+        rc = MPV_ERROR_SUCCESS;
         goto error;
     }
 
-    reqid_node = mpv_node_map_get(&msg_node, "request_id");
-
-    mpv_node *cmd_node = mpv_node_map_get(&msg_node, "command");
+    mpv_node *cmd_node = mpv_node_map_get(msg_node, "command");
     if (!cmd_node ||
         (cmd_node->format != MPV_FORMAT_NODE_ARRAY) ||
         !cmd_node->u.list->num)
@@ -238,15 +253,15 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
     if (!strcmp("client_name", cmd)) {
         const char *client_name = mpv_client_name(client);
-        mpv_node_map_add_string(ta_parent, &reply_node, "data", client_name);
+        mpv_node_map_add_string(ta_parent, reply_node, "data", client_name);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_time_us", cmd)) {
         int64_t time_us = mpv_get_time_us(client);
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", time_us);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", time_us);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_version", cmd)) {
         int64_t ver = mpv_client_api_version();
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", ver);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_property", cmd)) {
         mpv_node result_node;
@@ -264,7 +279,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         rc = mpv_get_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &result_node);
         if (rc >= 0) {
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
             mpv_free_node_contents(&result_node);
         }
     } else if (!strcmp("get_property_string", cmd)) {
@@ -281,9 +296,9 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         char *result = mpv_get_property_string(client,
                                         cmd_node->u.list->values[1].u.string);
         if (!result) {
-            mpv_node_map_add_null(ta_parent, &reply_node, "data");
+            mpv_node_map_add_null(ta_parent, reply_node, "data");
         } else {
-            mpv_node_map_add_string(ta_parent, &reply_node, "data", result);
+            mpv_node_map_add_string(ta_parent, reply_node, "data", result);
             mpv_free(result);
         }
     } else if (!strcmp("set_property", cmd)) {
@@ -428,7 +443,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_command_node(client, cmd_node, &result_node);
         if (rc >= 0)
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
     }
 
 error:
@@ -437,10 +452,158 @@ error:
      * the original requests.
      */
     if (reqid_node) {
-        mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
+        mpv_node_map_add(ta_parent, reply_node, "request_id", reqid_node);
+    }
+
+    mpv_node_map_add_string(ta_parent, reply_node, "error", mpv_error_string(rc));
+}
+
+// Return the mp_client_request type for requests that can be executed with
+// mp_client_run_requests(), or -1 for the IPC-specific commands.
+static int get_request_type(mpv_node *cmd_node)
+{
+    mpv_node_list *args = cmd_node->u.list;
+    if (cmd_node->format != MPV_FORMAT_NODE_ARRAY || !args || !args->num ||
+        args->values[0].format != MPV_FORMAT_STRING)
+        return -1;
+
+    const char *cmd = args->values[0].u.string;
+    bool named = args->num >= 2 && args->values[1].format == MPV_FORMAT_STRING;
+    if (!strcmp("get_property", cmd))
+        return named && args->num == 2 ? MP_CLIENT_REQ_GET_PROPERTY : -1;
+    if (!strcmp("get_property_string", cmd))
+        return named && args->num == 2 ? MP_CLIENT_REQ_GET_PROPERTY_STRING : -1;
+    if (!strcmp("set_property", cmd))
+        return named && args->num == 3 ? MP_CLIENT_REQ_SET_PROPERTY : -1;
+    if (!strcmp("set_property_string", cmd)) {
+        return named && args->num == 3 &&
+               args->values[2].format == MPV_FORMAT_STRING
+               ? MP_CLIENT_REQ_SET_PROPERTY : -1;
+    }
+
+    static const char *const ipc_cmds[] = {
+        "client_name", "get_time_us", "get_version", "observe_property",
+        "observe_property_string", "unobserve_property",
+        "request_log_messages", "suspend", "resume", "enable_event",
+        "disable_event", NULL
+    };
+    for (int n = 0; ipc_cmds[n]; n++) {
+        if (!strcmp(ipc_cmds[n], cmd))
+            return -1;
+    }
+    return MP_CLIENT_REQ_COMMAND;
+}
+
+struct batch_item {
+    mpv_node *msg_node;
+    struct mp_client_request req;
+};
+
+// Run the requests collected in items[], and append their replies to dst.
+static void flush_batch(struct mpv_handle *client, void *ta_parent,
+                        struct batch_item *items, int num_items,
+                        mpv_node *dst)
+{
+    if (!num_items)
+        return;
+
+    struct mp_client_request *reqs =
+        talloc_array(NULL, struct mp_client_request, num_items);
+    for (int n = 0; n < num_items; n++)
+        reqs[n] = items[n].req;
+
+    mp_client_run_requests(client, reqs, num_items);
+
+    for (int n = 0; n < num_items; n++) {
+        struct mp_client_request *r = &reqs[n];
+        int rc = r->status;
+        mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        switch (r->type) {
+        case MP_CLIENT_REQ_GET_PROPERTY_STRING:
+            // Same as the non-batched get_property_string: errors return null.
+            mpv_node_map_add(ta_parent, &reply_node, "data", &r->result);
+            rc = MPV_ERROR_SUCCESS;
+            break;
+        case MP_CLIENT_REQ_GET_PROPERTY:
+        case MP_CLIENT_REQ_COMMAND:
+            if (rc >= 0)
+                mpv_node_map_add(ta_parent, &reply_node, "data", &r->result);
+            break;
+        default: ;
+        }
+        mpv_free_node_contents(&r->result);
+
+        mpv_node *reqid_node = mpv_node_map_get(items[n].msg_node, "request_id");
+        if (reqid_node)
+            mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
+        mpv_node_map_add_string(ta_parent, &reply_node, "error",
+                                mpv_error_string(rc));
+        mpv_node_array_add(ta_parent, dst, &reply_node);
     }
 
-    mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
+    talloc_free(reqs);
+}
+
+// Execute all requests in batch_node, and return their replies as array in
+// the "data" field of reply_node. Consecutive property accesses and commands
+// are run under a single core lock. The IPC-specific commands are executed
+// normally, between them.
+static void execute_batch(struct mpv_handle *client, void *ta_parent,
+                          mpv_node *batch_node, mpv_node *reply_node)
+{
+    mpv_node replies = {.format = MPV_FORMAT_NODE_ARRAY, .u.list = NULL};
+    struct batch_item *items = NULL;
+    int num_items = 0;
+
+    for (int n = 0; n < batch_node->u.list->num; n++) {
+        mpv_node *msg_node = &batch_node->u.list->values[n];
+        mpv_node *cmd_node = mpv_node_map_get(msg_node, "command");
+        int type = cmd_node && !mpv_node_map_get(msg_node, "batch")
+                   ? get_request_type(cmd_node) : -1;
+        if (type < 0) {
+            flush_batch(client, ta_parent, items, num_items, &replies);
+            num_items = 0;
+            mpv_node item_reply = {.format = MPV_FORMAT_NODE_MAP};
+            execute_request(client, ta_parent, msg_node, &item_reply);
+            mpv_node_array_add(ta_parent, &replies, &item_reply);
+            continue;
+        }
+        mpv_node_list *args = cmd_node->u.list;
+        struct batch_item item = {
+            .msg_node = msg_node,
+            .req = {
+                .type = type,
+                .args = type == MP_CLIENT_REQ_COMMAND ? cmd_node
+                                                      : &args->values[2],
+            },
+        };
+        if (type != MP_CLIENT_REQ_COMMAND)
+            item.req.name = args->values[1].u.string;
+        MP_TARRAY_APPEND(ta_parent, items, num_items, item);
+    }
+    flush_batch(client, ta_parent, items, num_items, &replies);
+
+    if (!replies.u.list)
+        replies.u.list = talloc_zero(ta_parent, mpv_node_list);
+    mpv_node_map_add(ta_parent, reply_node, "data", &replies);
+}
+
+// Function is allowed to modify src[n].
+static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
+                                  char *src)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+
+    if (json_parse(ta_parent, &msg_node, &src, MAX_REQUEST_DEPTH) < 0) {
+        mp_err(log, "malformed JSON received\n");
+        mpv_node_map_add_string(ta_parent, &reply_node, "error",
+                        mpv_error_string(MPV_ERROR_INVALID_PARAMETER));
+    } else {
+        execute_request(client, ta_parent, &msg_node, &reply_node);
+    }
 
     char *output = talloc_strdup(ta_parent, "");
     json_write(&output, &reply_node);
@@ -449,6 +612,220 @@ error:
     return output;
 }
 
+static void bin_append(void *ta_parent, bstr *dst, const void *data, size_t len)
+{
+    bstr_xappend(ta_parent, dst, (bstr){(unsigned char *)data, len});
+}
+
+static void bin_append_u32(void *ta_parent, bstr *dst, uint32_t val)
+{
+    uint8_t buf[4];
+    AV_WL32(buf, val);
+    bin_append(ta_parent, dst, buf, 4);
+}
+
+static void bin_append_str(void *ta_parent, bstr *dst, const char *str)
+{
+    size_t len = strlen(str);
+    bin_append_u32(ta_parent, dst, len);
+    bin_append(ta_parent, dst, str, len);
+}
+
+// Append the binary encoding of src to dst. Each node starts with a type
+// byte, integers are little endian:
+//  'n'                             MPV_FORMAT_NONE
+//  'f' <u8>                        MPV_FORMAT_FLAG
+//  'i' <i64>                       MPV_FORMAT_INT64
+//  'd' <double as 64 bit IEEE>     MPV_FORMAT_DOUBLE
+//  's' <u32 len> <bytes>           MPV_FORMAT_STRING
+//  'y' <u32 len> <bytes>           MPV_FORMAT_BYTE_ARRAY
+//  'a' <u32 num> <node>*num        MPV_FORMAT_NODE_ARRAY
+//  'm' <u32 num> (<u32 len> <key bytes> <node>)*num
+//                                  MPV_FORMAT_NODE_MAP
+static void node_write_binary(void *ta_parent, bstr *dst, mpv_node *src)
+{
+    uint8_t buf[8];
+    switch (src->format) {
+    case MPV_FORMAT_FLAG:
+        bin_append(ta_parent, dst, &(char){'f'}, 1);
+        bin_append(ta_parent, dst, &(uint8_t){!!src->u.flag}, 1);
+        break;
+    case MPV_FORMAT_INT64:
+        bin_append(ta_parent, dst, &(char){'i'}, 1);
+        AV_WL64(buf, src->u.int64);
+        bin_append(ta_parent, dst, buf, 8);
+        break;
+    case MPV_FORMAT_DOUBLE: {
+        union { double d; uint64_t i; } v = {.d = src->u.double_};
+        bin_append(ta_parent, dst, &(char){'d'}, 1);
+        AV_WL64(buf, v.i);
+        bin_append(ta_parent, dst, buf, 8);
+        break;
+    }
+    case MPV_FORMAT_STRING:
+        bin_append(ta_parent, dst, &(char){'s'}, 1);
+        bin_append_str(ta_parent, dst, src->u.string);
+        break;
+    case MPV_FORMAT_BYTE_ARRAY:
+        bin_append(ta_parent, dst, &(char){'y'}, 1);
+        bin_append_u32(ta_parent, dst, src->u.ba->size);
+        bin_append(ta_parent, dst, src->u.ba->data, src->u.ba->size);
+        break;
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        bool map = src->format == MPV_FORMAT_NODE_MAP;
+        mpv_node_list *list = src->u.list;
+        int num = list ? list->num : 0;
+        bin_append(ta_parent, dst, &(char){map ? 'm' : 'a'}, 1);
+        bin_append_u32(ta_parent, dst, num);
+        for (int n = 0; n < num; n++) {
+            if (map)
+                bin_append_str(ta_parent, dst, list->keys[n]);
+            node_write_binary(ta_parent, dst, &list->values[n]);
+        }
+        break;
+    }
+    default:
+        bin_append(ta_parent, dst, &(char){'n'}, 1);
+    }
+}
+
+static bool bin_read(bstr *src, void *dst, size_t len)
+{
+    if (src->len < len)
+        return false;
+    memcpy(dst, src->start, len);
+    *src = bstr_cut(*src, len);
+    return true;
+}
+
+static bool bin_read_u32(bstr *src, uint32_t *val)
+{
+    uint8_t buf[4];
+    if (!bin_read(src, buf, 4))
+        return false;
+    *val = AV_RL32(buf);
+    return true;
+}
+
+static char *bin_read_str(void *ta_parent, bstr *src)
+{
+    uint32_t len;
+    if (!bin_read_u32(src, &len) || len > src->len)
+        return NULL;
+    char *str = bstrdup0(ta_parent, bstr_splice(*src, 0, len));
+    *src = bstr_cut(*src, len);
+    return str;
+}
+
+// Parse a node as written by node_write_binary(). Like json_parse(), the
+// result is allocated with ta_parent, and max_depth limits the tree depth.
+static int node_parse_binary(void *ta_parent, mpv_node *dst, bstr *src,
+                             int max_depth)
+{
+    max_depth -= 1;
+    if (max_depth < 0)
+        return -1;
+
+    uint8_t type, buf[8];
+    if (!bin_read(src, &type, 1))
+        return -1;
+    switch (type) {
+    case 'n':
+        *dst = (mpv_node){.format = MPV_FORMAT_NONE};
+        return 0;
+    case 'f':
+        if (!bin_read(src, buf, 1))
+            return -1;
+        *dst = (mpv_node){.format = MPV_FORMAT_FLAG, .u.flag = !!buf[0]};
+        return 0;
+    case 'i':
+        if (!bin_read(src, buf, 8))
+            return -1;
+        *dst = (mpv_node){.format = MPV_FORMAT_INT64, .u.int64 = AV_RL64(buf)};
+        return 0;
+    case 'd': {
+        if (!bin_read(src, buf, 8))
+            return -1;
+        union { double d; uint64_t i; } v = {.i = AV_RL64(buf)};
+        *dst = (mpv_node){.format = MPV_FORMAT_DOUBLE, .u.double_ = v.d};
+        return 0;
+    }
+    case 's': {
+        char *str = bin_read_str(ta_parent, src);
+        if (!str)
+            return -1;
+        *dst = (mpv_node){.format = MPV_FORMAT_STRING, .u.string = str};
+        return 0;
+    }
+    case 'y': {
+        uint32_t len;
+        if (!bin_read_u32(src, &len) || len > src->len)
+            return -1;
+        struct mpv_byte_array *ba = talloc_zero(ta_parent, struct mpv_byte_array);
+        ba->data = talloc_memdup(ba, src->start, len);
+        ba->size = len;
+        *src = bstr_cut(*src, len);
+        *dst = (mpv_node){.format = MPV_FORMAT_BYTE_ARRAY, .u.ba = ba};
+        return 0;
+    }
+    case 'a':
+    case 'm': {
+        bool map = type == 'm';
+        uint32_t num;
+        // Each entry needs at least 1 byte; reject bogus sizes early.
+        if (!bin_read_u32(src, &num) || num > src->len)
+            return -1;
+        mpv_node_list *list = talloc_zero(ta_parent, mpv_node_list);
+        list->values = talloc_zero_array(list, mpv_node, num);
+        if (map)
+            list->keys = talloc_zero_array(list, char *, num);
+        for (list->num = 0; list->num < num; list->num++) {
+            int n = list->num;
+            if (map && !(list->keys[n] = bin_read_str(list, src)))
+                return -1;
+            if (node_parse_binary(list, &list->values[n], src, max_depth) < 0)
+                return -1;
+        }
+        *dst = (mpv_node){
+            .format = map ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY,
+            .u.list = list,
+        };
+        return 0;
+    }
+    }
+    return -1;
+}
+
+// Execute a binary framed request (without the header), and return the
+// binary framed reply.
+static bstr binary_execute_command(struct mpv_handle *client, void *ta_parent,
+                                   bstr src)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+
+    if (node_parse_binary(ta_parent, &msg_node, &src, MAX_REQUEST_DEPTH) < 0 ||
+        src.len)
+    {
+        mp_err(log, "malformed binary request received\n");
+        mpv_node_map_add_string(ta_parent, &reply_node, "error",
+                        mpv_error_string(MPV_ERROR_INVALID_PARAMETER));
+    } else {
+        execute_request(client, ta_parent, &msg_node, &reply_node);
+    }
+
+    bstr output = {0};
+    bin_append(ta_parent, &output, &(char){0}, 1);
+    bin_append_u32(ta_parent, &output, 0);
+    node_write_binary(ta_parent, &output, &reply_node);
+    AV_WL32(output.start + 1, output.len - BINARY_HEADER_SIZE);
+
+    return output;
+}
+
 static char *text_execute_command(struct mpv_handle *client, void *tmp, char *src)
 {
     mpv_command_string(client, src);
@@ -456,9 +833,33 @@ static char *text_execute_command(struct mpv_handle *client, void *tmp, char *sr
     return NULL;
 }
 
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+bool mp_ipc_has_command(bstr buf)
+{
+    if (buf.len && buf.start[0] == '\0') {
+        return buf.len >= BINARY_HEADER_SIZE &&
+               buf.len - BINARY_HEADER_SIZE >= AV_RL32(buf.start + 1);
+    }
+    return bstrchr(buf, '\n') != -1;
+}
+
+bstr mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
 {
     void *tmp = talloc_new(NULL);
+    bstr reply_msg = {0};
+
+    if (buf->len && buf->start[0] == '\0') {
+        assert(mp_ipc_has_command(*buf));
+        size_t len = AV_RL32(buf->start + 1);
+        bstr payload = bstr_splice(*buf, BINARY_HEADER_SIZE,
+                                   BINARY_HEADER_SIZE + len);
+        bstr rest = bstr_cut(*buf, BINARY_HEADER_SIZE + len);
+        talloc_steal(tmp, buf->start);
+        *buf = bstrdup(NULL, rest);
+        reply_msg = binary_execute_command(client, tmp, payload);
+        talloc_steal(ctx, reply_msg.start);
+        talloc_free(tmp);
+        return reply_msg;
+    }
 
     bstr rest;
     bstr line = bstr_getline(*buf, &rest);
@@ -468,16 +869,15 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
 
     json_skip_whitespace(&line0);
 
-    char *reply_msg = NULL;
     if (line0[0] == '\0' || line0[0] == '#') {
         // skip
     } else if (line0[0] == '{') {
-        reply_msg = json_execute_command(client, tmp, line0);
+        reply_msg = bstr0(json_execute_command(client, tmp, line0));
     } else {
-        reply_msg = text_execute_command(client, tmp, line0);
+        reply_msg = bstr0(text_execute_command(client, tmp, line0));
     }
 
-    talloc_steal(ctx, reply_msg);
+    talloc_steal(ctx, reply_msg.start);
     talloc_free(tmp);
     return reply_msg;
 }
@@ -179,7 +179,8 @@ extern "C" {
  *
  * For OpenGL integration (e.g. rendering video to a texture), a separate API
  * is available. Look at opengl_cb.h. This API does not include keyboard or
- * mouse input directly.
+ * mouse input directly. To get video frames rendered into memory buffers
+ * without OpenGL, look at sw_cb.h.
  *
  * Also see client API examples and the mpv manpage.
  *
@@ -215,7 +216,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 23)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 24)
 
 /**
  * Return the MPV_CLIENT_API_VERSION the mpv source has been compiled with.
@@ -1610,7 +1611,14 @@ typedef enum mpv_sub_api {
      * Will return NULL if unavailable (if OpenGL support was not compiled in).
      * See opengl_cb.h for details.
      */
-    MPV_SUB_API_OPENGL_CB = 1
+    MPV_SUB_API_OPENGL_CB = 1,
+    /**
+     * For retrieving video frames into memory buffers, rendered on the CPU.
+     * mpv_get_sub_api(MPV_SUB_API_SW_CB) returns mpv_sw_cb_context*.
+     * This context can be used with mpv_sw_cb_* functions.
+     * See sw_cb.h for details.
+     */
+    MPV_SUB_API_SW_CB = 2
 } mpv_sub_api;
 
 /**
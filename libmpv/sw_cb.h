@@ -0,0 +1,232 @@
+/* Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Note: the client API is licensed under ISC (see above) to ease
+ * interoperability with other licenses. But keep in mind that the
+ * mpv core is still mostly GPLv2+. It's up to lawyers to decide
+ * whether applications using this API are affected by the GPL.
+ * One argument against this is that proprietary applications
+ * using mplayer in slave mode is apparently tolerated, and this
+ * API is basically equivalent to slave mode.
+ */
+
+#ifndef MPV_CLIENT_API_SW_CB_H_
+#define MPV_CLIENT_API_SW_CB_H_
+
+#include "client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Warning: this API is not stable yet.
+ *
+ * Overview
+ * --------
+ *
+ * This API can be used to make mpv deliver video frames into memory buffers
+ * provided by the API user, without any GPU or windowing system involvement.
+ * This is useful for thumbnailers, video analysis, or rendering with a
+ * custom toolkit. If you have an OpenGL context anyway, opengl_cb.h will be
+ * faster and have better quality.
+ *
+ * The API is used much like opengl_cb.h: the renderer needs to be enabled
+ * with mpv_sw_cb_init(), the "vo" option must be set to "sw-cb", and frames
+ * can be retrieved with mpv_sw_cb_draw() or mpv_sw_cb_lock_frame(). The user
+ * thread can be notified of new frames with mpv_sw_cb_set_update_callback().
+ *
+ * mpv_sw_cb_draw() converts and scales the video with libswscale, and blends
+ * the OSD and subtitles on top of it (all on the CPU). Options like "panscan"
+ * and "video-aspect" are applied as with other VOs, and the area not covered
+ * by video is cleared to black.
+ *
+ * mpv_sw_cb_lock_frame() gives access to the decoded frame itself, without
+ * any copying or conversion. This is the fastest way to retrieve video if
+ * the decoded format can be used as-is.
+ *
+ * Threading
+ * ---------
+ *
+ * The mpv_sw_cb_* functions can be called from any thread, under the
+ * following conditions:
+ *  - only one of the mpv_sw_cb_* functions can be called at the same time
+ *    (unless they belong to different mpv cores created by mpv_create())
+ *  - never can be called from within the callbacks set with
+ *    mpv_set_wakeup_callback() or mpv_sw_cb_set_update_callback()
+ *
+ * Context and handle lifecycle
+ * ----------------------------
+ *
+ * Video initialization will fail if the renderer was not enabled yet (with
+ * mpv_sw_cb_init()). Likewise, mpv_sw_cb_uninit() will disable video.
+ *
+ * When the mpv core is destroyed (e.g. via mpv_terminate_destroy()), the
+ * renderer must have been uninitialized. If this doesn't happen, undefined
+ * behavior will result.
+ *
+ * Hardware decoding
+ * -----------------
+ *
+ * Only the hardware decoding modes that copy the video back to system memory
+ * (such as "vaapi-copy" or "dxva2-copy") can be used.
+ */
+
+/**
+ * Opaque context, returned by mpv_get_sub_api(MPV_SUB_API_SW_CB).
+ *
+ * A context is bound to the mpv_handle it was retrieved from. The context
+ * will always be the same (for the same mpv_handle), and is valid until the
+ * mpv_handle it belongs to is released.
+ */
+typedef struct mpv_sw_cb_context mpv_sw_cb_context;
+
+typedef void (*mpv_sw_cb_update_fn)(void *cb_ctx);
+
+/**
+ * Describes an image in memory.
+ */
+typedef struct mpv_sw_cb_image {
+    /**
+     * Pixel format name, as used by the "format" video filter and the
+     * "video-params/pixelformat" property (e.g. "bgr0", "rgba", "yuv420p").
+     */
+    const char *format;
+    /**
+     * Image size in pixels.
+     */
+    int w, h;
+    /**
+     * Pointers to the top left pixel of each plane, and the distance between
+     * two lines in bytes for each plane. Unused planes are NULL/0. Only packed
+     * RGB formats have a single plane.
+     */
+    void *planes[4];
+    int stride[4];
+} mpv_sw_cb_image;
+
+/**
+ * Flags for mpv_sw_cb_draw().
+ */
+typedef enum mpv_sw_cb_draw_flags {
+    /**
+     * Do not draw OSD and subtitles.
+     */
+    MPV_SW_CB_DRAW_NO_OSD = 1 << 0,
+} mpv_sw_cb_draw_flags;
+
+/**
+ * Set the callback that notifies you when a new video frame is available, or
+ * if the video display configuration somehow changed and requires a redraw.
+ * Similar to mpv_set_wakeup_callback(), you must not call any mpv API from
+ * the callback.
+ *
+ * @param callback callback(callback_ctx) is called if the frame should be
+ *                 redrawn
+ * @param callback_ctx opaque argument to the callback
+ */
+void mpv_sw_cb_set_update_callback(mpv_sw_cb_context *ctx,
+                                   mpv_sw_cb_update_fn callback,
+                                   void *callback_ctx);
+
+/**
+ * Enable the renderer. Before this is called, video output with the "sw-cb"
+ * VO will fail.
+ *
+ * You must call mpv_sw_cb_uninit() at some point.
+ *
+ * @return error code, including but not limited to:
+ *      MPV_ERROR_INVALID_PARAMETER: the renderer was already initialized
+ */
+int mpv_sw_cb_init(mpv_sw_cb_context *ctx);
+
+/**
+ * Render video into the given image. The video is scaled to fill the full
+ * image (while keeping the aspect ratio, unless options like "keepaspect"
+ * say otherwise). If the decoded format and size match the image, the video
+ * is copied without conversion.
+ *
+ * This function implicitly pulls a video frame from the internal queue and
+ * renders it. If no new frame is available, the previous frame is redrawn.
+ * The update callback set with mpv_sw_cb_set_update_callback() notifies you
+ * when a new frame was added.
+ *
+ * @param dst Target image. All fields must be set. The memory is written to
+ *            only while this function is running.
+ * @param flags Bitwise or of mpv_sw_cb_draw_flags values.
+ * @return error code, including but not limited to:
+ *      MPV_ERROR_UNINITIALIZED: mpv_sw_cb_init() was not called
+ *      MPV_ERROR_INVALID_PARAMETER: the image format is unknown, or the
+ *                                   image parameters are invalid
+ *      MPV_ERROR_UNSUPPORTED: the video can not be converted to the format
+ */
+int mpv_sw_cb_draw(mpv_sw_cb_context *ctx, mpv_sw_cb_image *dst, int flags);
+
+/**
+ * Pull a video frame from the internal queue like mpv_sw_cb_draw(), but
+ * instead of rendering it, return the decoded frame itself. Nothing is
+ * copied, and no OSD is drawn. The frame must be released with
+ * mpv_sw_cb_unlock_frame() (which also happens when this is called again).
+ *
+ * The memory the frame points to must not be written to. It stays valid until
+ * it is released, even if the player moves on to other frames.
+ *
+ * @param out Set to the frame. All fields (including out->format) are valid
+ *            until the frame is released.
+ * @return error code, including but not limited to:
+ *      MPV_ERROR_UNSUPPORTED: there is no video frame (for example, because
+ *                             video was not initialized yet)
+ */
+int mpv_sw_cb_lock_frame(mpv_sw_cb_context *ctx, mpv_sw_cb_image *out);
+
+/**
+ * Release the frame returned by mpv_sw_cb_lock_frame(). Does nothing if no
+ * frame is locked.
+ *
+ * @return error code
+ */
+int mpv_sw_cb_unlock_frame(mpv_sw_cb_context *ctx);
+
+/**
+ * Tell the renderer that a frame was presented at the given time. This is
+ * optional, but can help the player to achieve better timing. This works
+ * exactly like mpv_opengl_cb_report_flip().
+ *
+ * Note that calling this at least once informs libmpv that you will use this
+ * function. If you use it inconsistently, expect bad video playback.
+ *
+ * @param time The mpv time (using mpv_get_time_us()) at which the frame was
+ *             presented. If 0 is passed, mpv_get_time_us() is used instead.
+ *             Currently, this parameter is ignored.
+ * @return error code
+ */
+int mpv_sw_cb_report_flip(mpv_sw_cb_context *ctx, int64_t time);
+
+/**
+ * Disable the renderer, and release the locked frame (if any).
+ *
+ * If video is still active (e.g. a file playing), video will be disabled
+ * forcefully.
+ *
+ * Calling this multiple times is ok.
+ *
+ * @return error code
+ */
+int mpv_sw_cb_uninit(mpv_sw_cb_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
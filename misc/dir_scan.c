@@ -0,0 +1,283 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "osdep/io.h"
+
+#include "common/common.h"
+#include "options/path.h"
+#include "stream/stream.h"
+#include "thread_pool.h"
+
+#include "dir_scan.h"
+
+#define MAX_THREADS 8
+#define STAT_CHUNK 32       // entries per stat() work item
+#define MAX_CACHED_DIRS 32
+
+enum {
+    STAT_UNKNOWN,
+    STAT_OK,
+    STAT_FAILED,
+};
+
+struct scan_entry {
+    char *name;
+    int state;
+    int64_t size;
+};
+
+// Directory contents as returned by readdir(), and the stat() results so far.
+struct dir_data {
+    char *path;
+    int64_t mtime;
+    bool valid;             // directory could be read
+    bool changed;           // needs to be written back to the cache
+    struct scan_entry *entries;
+    int num_entries;
+    int64_t last_used;      // for cache eviction
+};
+
+struct scan_job {
+    struct mp_cancel *cancel;
+    struct dir_data *dir;
+    int first, count;       // entries to stat()
+};
+
+// Shared by all player instances; the file system is the same for all of them.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct dir_data **cache;
+static int num_cache;
+static int64_t cache_counter;
+static struct mp_dir_scan_stats cache_stats;
+
+static void copy_dir_data(void *ta_parent, struct dir_data *dst,
+                          struct dir_data *src)
+{
+    *dst = *src;
+    dst->path = talloc_strdup(ta_parent, src->path);
+    dst->entries = talloc_memdup(ta_parent, src->entries,
+                                 src->num_entries * sizeof(src->entries[0]));
+    for (int n = 0; n < src->num_entries; n++)
+        dst->entries[n].name = talloc_strdup(ta_parent, src->entries[n].name);
+}
+
+// Fill dir from the cache, if it has an entry for the same directory state.
+static bool cache_lookup(void *ta_parent, struct dir_data *dir)
+{
+    bool found = false;
+    pthread_mutex_lock(&cache_lock);
+    for (int n = 0; n < num_cache; n++) {
+        struct dir_data *c = cache[n];
+        if (strcmp(c->path, dir->path) == 0 && c->mtime == dir->mtime) {
+            c->last_used = ++cache_counter;
+            copy_dir_data(ta_parent, dir, c);
+            dir->changed = false;
+            cache_stats.hits++;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return found;
+}
+
+static void cache_store(struct dir_data *dir)
+{
+    // The mtime has a resolution of 1 second. If the directory was modified
+    // in the same second, later changes might not update it.
+    if (time(NULL) - dir->mtime < 2)
+        return;
+
+    pthread_mutex_lock(&cache_lock);
+    for (int n = 0; n < num_cache; n++) {
+        if (strcmp(cache[n]->path, dir->path) == 0) {
+            talloc_free(cache[n]);
+            MP_TARRAY_REMOVE_AT(cache, num_cache, n);
+            break;
+        }
+    }
+    if (num_cache >= MAX_CACHED_DIRS) {
+        int lru = 0;
+        for (int n = 1; n < num_cache; n++) {
+            if (cache[n]->last_used < cache[lru]->last_used)
+                lru = n;
+        }
+        talloc_free(cache[lru]);
+        MP_TARRAY_REMOVE_AT(cache, num_cache, lru);
+    }
+    struct dir_data *c = talloc_zero(NULL, struct dir_data);
+    copy_dir_data(c, c, dir);
+    c->changed = false;
+    c->last_used = ++cache_counter;
+    MP_TARRAY_APPEND(NULL, cache, num_cache, c);
+    cache_stats.stores++;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static void read_dir_job(void *p)
+{
+    struct scan_job *job = p;
+    struct dir_data *dir = job->dir;
+
+    struct stat st;
+    if (mp_cancel_test(job->cancel) || stat(dir->path, &st) != 0 ||
+        !S_ISDIR(st.st_mode))
+        return;
+    dir->mtime = st.st_mtime;
+
+    if (cache_lookup(dir, dir))
+        return;
+
+    DIR *d = opendir(dir->path);
+    if (!d)
+        return;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        struct scan_entry e = { .name = talloc_strdup(dir, de->d_name) };
+        MP_TARRAY_APPEND(dir, dir->entries, dir->num_entries, e);
+    }
+    closedir(d);
+    dir->valid = true;
+    dir->changed = true;
+}
+
+static void stat_job(void *p)
+{
+    struct scan_job *job = p;
+    struct dir_data *dir = job->dir;
+
+    for (int n = job->first; n < job->first + job->count; n++) {
+        if (mp_cancel_test(job->cancel))
+            break;
+        struct scan_entry *e = &dir->entries[n];
+        char *path = mp_path_join(NULL, dir->path, e->name);
+        struct stat st;
+        e->state = stat(path, &st) == 0 ? STAT_OK : STAT_FAILED;
+        e->size = e->state == STAT_OK ? st.st_size : 0;
+        talloc_free(path);
+    }
+}
+
+// Run fn on each job, spread over worker threads, and wait until all are done.
+static void run_jobs(void (*fn)(void *), struct scan_job *jobs, int num_jobs)
+{
+    struct mp_thread_pool *pool = NULL;
+    if (num_jobs > 1)
+        pool = mp_thread_pool_create(NULL, MPMIN(num_jobs, MAX_THREADS));
+    for (int n = 0; n < num_jobs; n++) {
+        if (pool) {
+            mp_thread_pool_queue(pool, fn, &jobs[n]);
+        } else {
+            fn(&jobs[n]);
+        }
+    }
+    talloc_free(pool); // waits for the queued jobs
+}
+
+// List the given directories. Only entries for which filter returns true
+// (all if filter is NULL), and on which stat() succeeds, are returned. filter
+// is called with filter_ctx and the index of the directory in dirs.
+// The directories are read in parallel, and the stat() calls are spread over
+// worker threads too, which helps a lot with network file systems. Results
+// are cached per directory, until the directory's mtime changes.
+// Returns an array of num_dirs listings, in the same order as dirs. A listing
+// is empty if the directory can't be read, or if cancel was triggered.
+struct mp_dir_listing *mp_scan_dirs(void *ta_parent, struct mp_cancel *cancel,
+                                    char **dirs, int num_dirs,
+                                    bool (*filter)(void *ctx, int dir,
+                                                   const char *name),
+                                    void *filter_ctx)
+{
+    void *tmp = talloc_new(NULL);
+    struct mp_dir_listing *res =
+        talloc_zero_array(ta_parent, struct mp_dir_listing, num_dirs);
+
+    struct scan_job *jobs = talloc_zero_array(tmp, struct scan_job, num_dirs);
+    for (int n = 0; n < num_dirs; n++) {
+        struct dir_data *dir = talloc_zero(tmp, struct dir_data);
+        dir->path = talloc_strdup(dir, dirs[n]);
+        jobs[n] = (struct scan_job){ .cancel = cancel, .dir = dir };
+    }
+    run_jobs(read_dir_job, jobs, num_dirs);
+
+    struct scan_job *stat_jobs = NULL;
+    int num_stat_jobs = 0;
+    for (int n = 0; n < num_dirs; n++) {
+        struct dir_data *dir = jobs[n].dir;
+        struct scan_job job = { .cancel = cancel, .dir = dir, .first = -1 };
+        for (int i = 0; i < dir->num_entries; i++) {
+            struct scan_entry *e = &dir->entries[i];
+            if (e->state != STAT_UNKNOWN || (filter && !filter(filter_ctx, n, e->name)))
+                continue;
+            // Consecutive entries only; skipped entries are left alone.
+            if (job.first >= 0 && (job.first + job.count != i ||
+                                   job.count >= STAT_CHUNK))
+            {
+                MP_TARRAY_APPEND(tmp, stat_jobs, num_stat_jobs, job);
+                job.first = -1;
+            }
+            if (job.first < 0) {
+                job.first = i;
+                job.count = 0;
+            }
+            job.count++;
+            dir->changed = true;
+        }
+        if (job.first >= 0)
+            MP_TARRAY_APPEND(tmp, stat_jobs, num_stat_jobs, job);
+    }
+    run_jobs(stat_job, stat_jobs, num_stat_jobs);
+
+    bool cancelled = mp_cancel_test(cancel);
+    for (int n = 0; n < num_dirs; n++) {
+        struct dir_data *dir = jobs[n].dir;
+        if (cancelled)
+            continue;
+        if (dir->valid && dir->changed)
+            cache_store(dir);
+        struct mp_dir_listing *l = &res[n];
+        for (int i = 0; i < dir->num_entries; i++) {
+            struct scan_entry *e = &dir->entries[i];
+            if (e->state != STAT_OK || (filter && !filter(filter_ctx, n, e->name)))
+                continue;
+            struct mp_dir_entry entry = {
+                .name = talloc_strdup(res, e->name),
+                .size = e->size,
+            };
+            MP_TARRAY_APPEND(res, l->entries, l->num_entries, entry);
+        }
+    }
+
+    talloc_free(tmp);
+    return res;
+}
+
+void mp_dir_scan_get_stats(struct mp_dir_scan_stats *stats)
+{
+    pthread_mutex_lock(&cache_lock);
+    *stats = cache_stats;
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,33 @@
+#ifndef MPV_MP_DIR_SCAN_H
+#define MPV_MP_DIR_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mp_cancel;
+
+struct mp_dir_entry {
+    char *name;         // file name, without the directory
+    int64_t size;
+};
+
+struct mp_dir_listing {
+    struct mp_dir_entry *entries;
+    int num_entries;
+};
+
+struct mp_dir_listing *mp_scan_dirs(void *ta_parent, struct mp_cancel *cancel,
+                                    char **dirs, int num_dirs,
+                                    bool (*filter)(void *ctx, int dir,
+                                                   const char *name),
+                                    void *filter_ctx);
+
+// Counters of the directory listing cache shared by all mp_scan_dirs() calls.
+struct mp_dir_scan_stats {
+    int64_t hits;       // directories served from the cache
+    int64_t stores;     // listings written to the cache
+};
+
+void mp_dir_scan_get_stats(struct mp_dir_scan_stats *stats);
+
+#endif
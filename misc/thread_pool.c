@@ -0,0 +1,126 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "osdep/threads.h"
+
+#include "thread_pool.h"
+
+struct work {
+    void (*fn)(void *ctx);
+    void *fn_ctx;
+};
+
+struct mp_thread_pool {
+    pthread_t *threads;
+    int num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // --- the following fields are protected by lock
+    bool terminate;
+    struct work *work;
+    int num_work;
+};
+
+static void *worker_thread(void *arg)
+{
+    struct mp_thread_pool *pool = arg;
+
+    mpthread_set_name("worker");
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        if (pool->num_work) {
+            struct work work = pool->work[0];
+            MP_TARRAY_REMOVE_AT(pool->work, pool->num_work, 0);
+            pthread_mutex_unlock(&pool->lock);
+            work.fn(work.fn_ctx);
+            pthread_mutex_lock(&pool->lock);
+            continue;
+        }
+        // Queued work is always finished before the threads exit.
+        if (pool->terminate)
+            break;
+        pthread_cond_wait(&pool->wakeup, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void thread_pool_dtor(void *ctx)
+{
+    struct mp_thread_pool *pool = ctx;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->terminate = true;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int n = 0; n < pool->num_threads; n++)
+        pthread_join(pool->threads[n], NULL);
+
+    assert(pool->num_work == 0);
+
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+// Create a pool of the given number of worker threads. Work items are run in
+// FIFO order by whichever thread is free. Freeing the pool (with talloc_free()
+// or via the parent) waits until all queued work has been run.
+// Returns NULL if no thread could be created.
+struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads)
+{
+    assert(threads > 0);
+
+    struct mp_thread_pool *pool = talloc_zero(ta_parent, struct mp_thread_pool);
+    talloc_set_destructor(pool, thread_pool_dtor);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeup, NULL);
+
+    pool->threads = talloc_array(pool, pthread_t, threads);
+    for (int n = 0; n < threads; n++) {
+        if (pthread_create(&pool->threads[n], NULL, worker_thread, pool))
+            break;
+        pool->num_threads++;
+    }
+
+    if (!pool->num_threads) {
+        talloc_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// Run fn(fn_ctx) on one of the pool's threads. fn_ctx is owned by the caller;
+// fn must not block on the thread that queued it.
+void mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
+                          void *fn_ctx)
+{
+    pthread_mutex_lock(&pool->lock);
+    assert(!pool->terminate);
+    struct work work = {fn, fn_ctx};
+    MP_TARRAY_APPEND(pool, pool->work, pool->num_work, work);
+    pthread_cond_signal(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -54,12 +54,34 @@ struct m_config_shadow {
     pthread_mutex_t lock;
     struct m_config *root;
     char *data;
+    // For m_config_get_snapshot().
+    struct m_config_snapshot *snapshot; // most recent one, or NULL
+    int **group_opts;           // per group: indexes into root->opts that
+    int *num_group_opts;        // have a value directly in the group struct
+};
+
+// Immutable copy of the option values of a single group struct. Snapshots
+// share it for as long as the group (and none of its children) changes.
+struct snapshot_group {
+    atomic_int refcount;
+    struct m_config_shadow *shadow;
+    int group;
+    void *opts;
+};
+
+// Immutable copy of all option values, see m_config_get_snapshot().
+struct m_config_snapshot {
+    atomic_int refcount;
+    struct m_config_shadow *shadow;
+    struct snapshot_group **groups;     // per m_config.groups entry
+    long long *ts;                      // m_config_group.ts values of groups
 };
 
 // Represents a sub-struct (OPT_SUBSTRUCT()).
 struct m_config_group {
     const struct m_sub_options *group; // or NULL for top-level options
     int parent_group;   // index of parent group in m_config.groups
+    int parent_offset;  // offset of the struct pointer in the parent struct
     void *opts;         // pointer to group user option struct
     atomic_llong ts;    // incremented on every write access
 };
@@ -197,10 +219,91 @@ static void add_options(struct m_config *config,
                         const void *optstruct_def,
                         const struct m_option *defs);
 
+static bool is_wildcard_opt(struct m_config_option *co)
+{
+    return (co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) &&
+           bstr_endswith0(bstr0(co->name), "*");
+}
+
+// FNV-1a
+static unsigned int hash_name(bstr name)
+{
+    uint32_t h = 2166136261u;
+    for (int n = 0; n < name.len; n++) {
+        h ^= name.start[n];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// (Re)build the lookup index. Must be called after config->opts changed.
+static void build_index(struct m_config *config)
+{
+    TA_FREEP(&config->index_slots);
+    TA_FREEP(&config->wildcard_opts);
+    config->num_wildcard_opts = 0;
+
+    unsigned int size = 16;
+    while (size < config->num_opts * 2)
+        size *= 2;
+    config->index_slots = talloc_array(config, int, size);
+    config->index_mask = size - 1;
+    for (int n = 0; n < size; n++)
+        config->index_slots[n] = -1;
+
+    for (int n = 0; n < config->num_opts; n++) {
+        struct m_config_option *co = &config->opts[n];
+        if (is_wildcard_opt(co)) {
+            MP_TARRAY_APPEND(config, config->wildcard_opts,
+                             config->num_wildcard_opts, n);
+            continue;
+        }
+        bstr name = bstr0(co->name);
+        unsigned int i = hash_name(name) & config->index_mask;
+        while (config->index_slots[i] >= 0) {
+            // Keep the first entry on duplicates.
+            if (bstr_equals0(name, config->opts[config->index_slots[i]].name))
+                break;
+            i = (i + 1) & config->index_mask;
+        }
+        if (config->index_slots[i] < 0)
+            config->index_slots[i] = n;
+    }
+}
+
+// Return the index of the first option in config->opts matching the name.
+static int find_opt(const struct m_config *config, bstr name)
+{
+    int found = -1;
+    unsigned int i = hash_name(name) & config->index_mask;
+    while (config->index_slots[i] >= 0) {
+        int n = config->index_slots[i];
+        if (bstr_equals0(name, config->opts[n].name)) {
+            found = n;
+            break;
+        }
+        i = (i + 1) & config->index_mask;
+    }
+    // A wildcard option listed before the exact match takes precedence.
+    for (int w = 0; w < config->num_wildcard_opts; w++) {
+        int n = config->wildcard_opts[w];
+        if (found >= 0 && n > found)
+            break;
+        bstr prefix = bstr0(config->opts[n].name);
+        prefix.len--; // strip "*"
+        if (bstr_startswith(name, prefix))
+            return n;
+    }
+    return found;
+}
+
+static void restore_backups(struct m_config *config, bool notify);
+static void snapshot_unref(struct m_config_snapshot *snap);
+
 static void config_destroy(void *p)
 {
     struct m_config *config = p;
-    m_config_restore_backups(config);
+    restore_backups(config, false);
     for (int n = 0; n < config->num_opts; n++) {
         struct m_config_option *co = &config->opts[n];
 
@@ -210,8 +313,10 @@ static void config_destroy(void *p)
             m_option_free(co->opt, config->shadow->data + co->shadow_offset);
     }
 
-    if (config->shadow)
+    if (config->shadow) {
+        snapshot_unref(config->shadow->snapshot);
         pthread_mutex_destroy(&config->shadow->lock);
+    }
 }
 
 struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
@@ -239,6 +344,7 @@ struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
 
     if (options)
         add_options(config, NULL, config->optstruct, defaults, options);
+    build_index(config);
     return config;
 }
 
@@ -326,7 +432,7 @@ static void ensure_backup(struct m_config *config, struct m_config_option *co)
     co->is_set_locally = true;
 }
 
-void m_config_restore_backups(struct m_config *config)
+static void restore_backups(struct m_config *config, bool notify)
 {
     while (config->backup_opts) {
         struct m_opt_backup *bc = config->backup_opts;
@@ -335,10 +441,17 @@ void m_config_restore_backups(struct m_config *config)
         m_option_copy(bc->co->opt, bc->co->data, bc->backup);
         m_option_free(bc->co->opt, bc->backup);
         bc->co->is_set_locally = false;
+        if (notify)
+            m_config_notify_change_co(config, bc->co);
         talloc_free(bc);
     }
 }
 
+void m_config_restore_backups(struct m_config *config)
+{
+    restore_backups(config, true);
+}
+
 void m_config_backup_opt(struct m_config *config, const char *opt)
 {
     struct m_config_option *co = m_config_get_co(config, bstr0(opt));
@@ -457,6 +570,7 @@ static void m_config_add_option(struct m_config *config,
         *group = (struct m_config_group){
             .group = subopts,
             .parent_group = parent_group,
+            .parent_offset = arg->offset,
             .opts = new_optstruct,
         };
 
@@ -477,53 +591,43 @@ struct m_config_option *m_config_get_co(const struct m_config *config,
     if (!name.len)
         return NULL;
 
-    for (int n = 0; n < config->num_opts; n++) {
+    int n = find_opt(config, name);
+    if (n >= 0) {
         struct m_config_option *co = &config->opts[n];
-        struct bstr coname = bstr0(co->name);
-        bool matches = false;
-        if ((co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD)
-                && bstr_endswith0(coname, "*")) {
-            coname.len--;
-            if (bstrcmp(bstr_splice(name, 0, coname.len), coname) == 0)
-                matches = true;
-        } else if (bstrcmp(coname, name) == 0)
-            matches = true;
-        if (matches) {
-            const char *prefix = config->is_toplevel ? "--" : "";
-            if (co->opt->type == &m_option_type_alias) {
-                const char *alias = (const char *)co->opt->priv;
-                // deprecation_message is not used, but decides whether it's a
-                // proper or deprecated alias.
-                if (co->opt->deprecation_message && !co->warning_was_printed) {
-                    MP_WARN(config, "Warning: option %s%s was replaced with "
-                            "%s%s and might be removed in the future.\n",
-                            prefix, co->name, prefix, alias);
-                    co->warning_was_printed = true;
-                }
-                return m_config_get_co(config, bstr0(alias));
-            } else if (co->opt->type == &m_option_type_removed) {
-                if (!co->warning_was_printed) {
-                    char *msg = co->opt->priv;
-                    if (msg) {
-                        MP_FATAL(config, "Option %s%s was removed: %s\n",
-                                 prefix, co->name, msg);
-                    } else {
-                        MP_FATAL(config, "Option %s%s was removed.\n",
-                                 prefix, co->name);
-                    }
-                    co->warning_was_printed = true;
-                }
-                return NULL;
-            } else if (co->opt->deprecation_message) {
-                if (!co->warning_was_printed) {
-                    MP_WARN(config, "Warning: option %s%s is deprecated "
-                            "and might be removed in the future (%s).\n",
-                            prefix, co->name, co->opt->deprecation_message);
-                    co->warning_was_printed = true;
+        const char *prefix = config->is_toplevel ? "--" : "";
+        if (co->opt->type == &m_option_type_alias) {
+            const char *alias = (const char *)co->opt->priv;
+            // deprecation_message is not used, but decides whether it's a
+            // proper or deprecated alias.
+            if (co->opt->deprecation_message && !co->warning_was_printed) {
+                MP_WARN(config, "Warning: option %s%s was replaced with "
+                        "%s%s and might be removed in the future.\n",
+                        prefix, co->name, prefix, alias);
+                co->warning_was_printed = true;
+            }
+            return m_config_get_co(config, bstr0(alias));
+        } else if (co->opt->type == &m_option_type_removed) {
+            if (!co->warning_was_printed) {
+                char *msg = co->opt->priv;
+                if (msg) {
+                    MP_FATAL(config, "Option %s%s was removed: %s\n",
+                             prefix, co->name, msg);
+                } else {
+                    MP_FATAL(config, "Option %s%s was removed.\n",
+                             prefix, co->name);
                 }
+                co->warning_was_printed = true;
+            }
+            return NULL;
+        } else if (co->opt->deprecation_message) {
+            if (!co->warning_was_printed) {
+                MP_WARN(config, "Warning: option %s%s is deprecated "
+                        "and might be removed in the future (%s).\n",
+                        prefix, co->name, co->opt->deprecation_message);
+                co->warning_was_printed = true;
             }
-            return co;
         }
+        return co;
     }
     return NULL;
 }
@@ -1032,11 +1136,20 @@ void m_config_create_shadow(struct m_config *config)
 
     config->global->config = config->shadow;
 
+    struct m_config_shadow *shadow = config->shadow;
+    shadow->group_opts = talloc_zero_array(shadow, int *, config->num_groups);
+    shadow->num_group_opts = talloc_zero_array(shadow, int, config->num_groups);
+
     for (int n = 0; n < config->num_opts; n++) {
         struct m_config_option *co = &config->opts[n];
         if (co->shadow_offset < 0)
             continue;
         m_option_copy(co->opt, config->shadow->data + co->shadow_offset, co->data);
+        // Sub-struct pointers are set up by snapshot_create() instead.
+        if (!(co->opt->type->flags & M_OPT_TYPE_HAS_CHILD)) {
+            MP_TARRAY_APPEND(shadow, shadow->group_opts[co->group],
+                             shadow->num_group_opts[co->group], n);
+        }
     }
 }
 
@@ -1105,6 +1218,7 @@ struct m_config_cache *m_config_cache_alloc(void *ta_parent,
             if (!is_group_included(config, n, cache->group))
                 TA_FREEP(&config->groups[n].opts);
         }
+        build_index(config);
     }
 
     m_config_cache_update(cache);
@@ -1191,6 +1305,143 @@ struct m_config *mp_get_root_config(struct mpv_global *global)
     return global->config->root;
 }
 
+static void snapshot_group_destroy(void *p)
+{
+    struct snapshot_group *sg = p;
+    struct m_config_shadow *shadow = sg->shadow;
+    for (int n = 0; n < shadow->num_group_opts[sg->group]; n++) {
+        const struct m_option *opt =
+            shadow->root->opts[shadow->group_opts[sg->group][n]].opt;
+        m_option_free(opt, (char *)sg->opts + opt->offset);
+    }
+}
+
+static void snapshot_group_unref(struct snapshot_group *sg)
+{
+    if (sg && atomic_fetch_add(&sg->refcount, -1) == 1)
+        talloc_free(sg);
+}
+
+// Copy the current values of a group from the shadow data. The caller has to
+// set the sub-struct pointers. Call with shadow->lock held.
+static struct snapshot_group *snapshot_group_create(
+    struct m_config_shadow *shadow, int group)
+{
+    struct m_config *root = shadow->root;
+    struct snapshot_group *sg = talloc_zero(NULL, struct snapshot_group);
+    atomic_store(&sg->refcount, 1);
+    sg->shadow = shadow;
+    sg->group = group;
+    if (group) {
+        sg->opts = m_config_alloc_struct(sg, root->groups[group].group);
+    } else {
+        sg->opts = talloc_zero_size(sg, root->size);
+        if (root->defaults)
+            memcpy(sg->opts, root->defaults, root->size);
+    }
+    for (int n = 0; n < shadow->num_group_opts[group]; n++) {
+        struct m_config_option *co = &root->opts[shadow->group_opts[group][n]];
+        init_opt_inplace(co->opt, (char *)sg->opts + co->opt->offset,
+                         shadow->data + co->shadow_offset);
+    }
+    talloc_set_destructor(sg, snapshot_group_destroy);
+    return sg;
+}
+
+static void snapshot_destroy(void *p)
+{
+    struct m_config_snapshot *snap = p;
+    for (int n = 0; n < snap->shadow->root->num_groups; n++)
+        snapshot_group_unref(snap->groups[n]);
+}
+
+static void snapshot_unref(struct m_config_snapshot *snap)
+{
+    if (snap && atomic_fetch_add(&snap->refcount, -1) == 1)
+        talloc_free(snap);
+}
+
+// Create a new snapshot, which reuses the groups of prev (can be NULL) that
+// did not change since. Call with shadow->lock held.
+static struct m_config_snapshot *snapshot_create(struct m_config_shadow *shadow,
+                                                 struct m_config_snapshot *prev)
+{
+    struct m_config *root = shadow->root;
+    int num_groups = root->num_groups;
+
+    struct m_config_snapshot *snap = talloc_zero(NULL, struct m_config_snapshot);
+    atomic_store(&snap->refcount, 1);
+    snap->shadow = shadow;
+    snap->groups = talloc_zero_array(snap, struct snapshot_group *, num_groups);
+    snap->ts = talloc_array(snap, long long, num_groups);
+    talloc_set_destructor(snap, snapshot_destroy);
+
+    bool *fresh = talloc_array(NULL, bool, num_groups);
+    for (int n = 0; n < num_groups; n++) {
+        snap->ts[n] = atomic_load(&root->groups[n].ts);
+        fresh[n] = !prev || prev->ts[n] != snap->ts[n];
+    }
+    // A parent struct contains the pointer to the child struct, so it must be
+    // copied as well. (m_config_notify_change_co() increments the timestamps
+    // of all parents anyway, but not atomically with the child's.) Parents
+    // always have a lower index than their children.
+    for (int n = num_groups - 1; n > 0; n--) {
+        if (fresh[n])
+            fresh[root->groups[n].parent_group] = true;
+    }
+
+    for (int n = 0; n < num_groups; n++) {
+        if (fresh[n]) {
+            snap->groups[n] = snapshot_group_create(shadow, n);
+        } else {
+            snap->groups[n] = prev->groups[n];
+            atomic_fetch_add(&snap->groups[n]->refcount, 1);
+        }
+    }
+    for (int n = 1; n < num_groups; n++) {
+        struct m_config_group *g = &root->groups[n];
+        if (fresh[g->parent_group]) {
+            void *parent = snap->groups[g->parent_group]->opts;
+            substruct_write_ptr((char *)parent + g->parent_offset,
+                                snap->groups[n]->opts);
+        }
+    }
+
+    talloc_free(fresh);
+    return snap;
+}
+
+struct snapshot_ref {
+    struct m_config_snapshot *snap;
+};
+
+static void snapshot_ref_destroy(void *p)
+{
+    struct snapshot_ref *ref = p;
+    snapshot_unref(ref->snap);
+}
+
+void *m_config_get_snapshot(void *ta_parent, struct mpv_global *global)
+{
+    struct m_config_shadow *shadow = global->config;
+
+    pthread_mutex_lock(&shadow->lock);
+    struct m_config_snapshot *snap = shadow->snapshot;
+    // Any change increments the top-level timestamp too.
+    if (!snap || snap->ts[0] != atomic_load(&shadow->root->groups[0].ts)) {
+        snap = snapshot_create(shadow, shadow->snapshot);
+        snapshot_unref(shadow->snapshot);
+        shadow->snapshot = snap;
+    }
+    atomic_fetch_add(&snap->refcount, 1);
+    pthread_mutex_unlock(&shadow->lock);
+
+    struct snapshot_ref *ref = talloc_ptrtype(ta_parent, ref);
+    *ref = (struct snapshot_ref){snap};
+    talloc_set_destructor(ref, snapshot_ref_destroy);
+    return snap->groups[0]->opts;
+}
+
 void *m_config_alloc_struct(void *talloc_ctx,
                             const struct m_sub_options *subopts)
 {
@@ -60,6 +60,12 @@ typedef struct m_config {
     struct m_config_option *opts; // all options, even suboptions
     int num_opts;
 
+    // Name lookup for m_config_get_co() (open addressing hash table).
+    int *index_slots;       // opts index, or -1 for empty slots
+    unsigned int index_mask; // number of slots - 1 (power of 2)
+    int *wildcard_opts;     // opts indexes of wildcard options (not hashed)
+    int num_wildcard_opts;
+
     // Creation parameters
     size_t size;
     const void *defaults;
@@ -319,6 +325,12 @@ bool m_config_cache_update(struct m_config_cache *cache);
 void *mp_get_config_group(void *ta_parent, struct mpv_global *global,
                           const struct m_sub_options *group);
 
+// Return a read-only copy of the current global option struct (MPOpts), which
+// stays valid and unchanged until ta_parent is freed. Option groups that did
+// not change since the last call are shared with previously returned structs,
+// and if nothing changed at all, this returns the same struct again. Writing
+// to it (or to any sub-struct) is not allowed.
+void *m_config_get_snapshot(void *ta_parent, struct mpv_global *global);
 
 // Read a single global option in a thread-safe way. For multiple options,
 // use m_config_cache. The option must exist and match the provided type (the
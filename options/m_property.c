@@ -46,16 +46,92 @@ struct m_property *m_property_list_find(const struct m_property *list,
     return NULL;
 }
 
-static int do_action(const struct m_property *prop_list, const char *name,
+// Open addressing hash table, which maps names to list indexes.
+struct m_property_index {
+    const struct m_property *list;
+    int *slots;             // list index, or -1 for empty slots
+    unsigned int mask;      // number of slots - 1 (power of 2)
+};
+
+// FNV-1a
+static unsigned int hash_name(bstr name)
+{
+    uint32_t h = 2166136261u;
+    for (int n = 0; n < name.len; n++) {
+        h ^= name.start[n];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+struct m_property_index *m_property_index_create(void *talloc_ctx,
+                                                 const struct m_property *list)
+{
+    int count = 0;
+    while (list[count].name)
+        count++;
+
+    struct m_property_index *index = talloc_ptrtype(talloc_ctx, index);
+    unsigned int size = 16;
+    while (size < count * 2)
+        size *= 2;
+    *index = (struct m_property_index){
+        .list = list,
+        .slots = talloc_array(index, int, size),
+        .mask = size - 1,
+    };
+    for (int n = 0; n < size; n++)
+        index->slots[n] = -1;
+
+    for (int n = 0; n < count; n++) {
+        bstr name = bstr0(list[n].name);
+        unsigned int i = hash_name(name) & index->mask;
+        while (index->slots[i] >= 0) {
+            // Keep the first entry on duplicates, like m_property_list_find().
+            if (bstr_equals0(name, list[index->slots[i]].name))
+                break;
+            i = (i + 1) & index->mask;
+        }
+        if (index->slots[i] < 0)
+            index->slots[i] = n;
+    }
+
+    return index;
+}
+
+const struct m_property *m_property_index_list(const struct m_property_index *index)
+{
+    return index->list;
+}
+
+// Return the position of the property in the list, or -1 if not found.
+int m_property_index_lookup(const struct m_property_index *index, bstr name)
+{
+    unsigned int i = hash_name(name) & index->mask;
+    while (index->slots[i] >= 0) {
+        int n = index->slots[i];
+        if (bstr_equals0(name, index->list[n].name))
+            return n;
+        i = (i + 1) & index->mask;
+    }
+    return -1;
+}
+
+static struct m_property *index_find(const struct m_property_index *index,
+                                     bstr name)
+{
+    int n = m_property_index_lookup(index, name);
+    return n >= 0 ? (struct m_property *)&index->list[n] : NULL;
+}
+
+static int do_action(const struct m_property_index *prop_list, const char *name,
                      int action, void *arg, void *ctx)
 {
     struct m_property *prop;
     struct m_property_action_arg ka;
     const char *sep = strchr(name, '/');
     if (sep && sep[1]) {
-        char base[128];
-        snprintf(base, sizeof(base), "%.*s", (int)(sep - name), name);
-        prop = m_property_list_find(prop_list, base);
+        prop = index_find(prop_list, (bstr){(unsigned char *)name, sep - name});
         ka = (struct m_property_action_arg) {
             .key = sep + 1,
             .action = action,
@@ -64,14 +140,15 @@ static int do_action(const struct m_property *prop_list, const char *name,
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
     } else
-        prop = m_property_list_find(prop_list, name);
+        prop = index_find(prop_list, bstr0(name));
     if (!prop)
         return M_PROPERTY_UNKNOWN;
     return prop->call(ctx, prop, action, arg);
 }
 
 // (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
+int m_property_do(struct mp_log *log,
+                  const struct m_property_index *prop_list,
                   const char *name, int action, void *arg, void *ctx)
 {
     union m_option_value val = {0};
@@ -194,7 +271,8 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
+static int m_property_do_bstr(const struct m_property_index *prop_list,
+                              bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
@@ -212,7 +290,7 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
+static int expand_property(const struct m_property_index *prop_list, char **ret,
                            int *ret_len, bstr prop, bool silent_error, void *ctx)
 {
     bool cond_yes = bstr_eatstart0(&prop, "?");
@@ -243,7 +321,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     return skip;
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
+char *m_properties_expand_string(const struct m_property_index *prop_list,
                                  const char *str0, void *ctx)
 {
     char *ret = NULL;
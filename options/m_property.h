@@ -131,11 +131,19 @@ struct m_property {
 struct m_property *m_property_list_find(const struct m_property *list,
                                         const char *name);
 
+// Hash table for looking up properties by name. The list (terminated with a
+// {0} item) must stay valid and unchanged while the index is used.
+struct m_property_index;
+struct m_property_index *m_property_index_create(void *talloc_ctx,
+                                                 const struct m_property *list);
+const struct m_property *m_property_index_list(const struct m_property_index *index);
+int m_property_index_lookup(const struct m_property_index *index, bstr name);
+
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_index *prop_list,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -160,7 +168,7 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(const struct m_property_index *prop_list,
                                  const char *str, void *ctx);
 
 // Trivial helpers for implementing properties.
@@ -205,6 +205,9 @@ const m_option_t mp_opts[] = {
     OPT_GENERAL(char**, "msg-level", msg_levels, CONF_PRE_PARSE | M_OPT_TERM,
                 .type = &m_option_type_msglevels),
     OPT_STRING("dump-stats", dump_stats, CONF_GLOBAL | CONF_PRE_PARSE),
+    OPT_CHOICE("dump-stats-format", dump_stats_binary,
+               CONF_GLOBAL | CONF_PRE_PARSE,
+               ({"text", 0}, {"binary", 1})),
     OPT_FLAG("msg-color", msg_color, CONF_PRE_PARSE | M_OPT_TERM),
     OPT_STRING("log-file", log_file, CONF_PRE_PARSE | M_OPT_FILE),
     OPT_FLAG("msg-module", msg_module, M_OPT_TERM),
@@ -247,6 +250,11 @@ const m_option_t mp_opts[] = {
     OPT_INTRANGE("cache-backbuffer", stream_cache.back_buffer, 0, 0, 0x7fffffff),
     OPT_STRING("cache-file", stream_cache.file, M_OPT_FILE),
     OPT_INTRANGE("cache-file-size", stream_cache.file_max, 0, 0, 0x7fffffff),
+    OPT_STRING("cache-file-dir", stream_cache.dir, M_OPT_FILE),
+    OPT_INTRANGE("cache-file-dir-size", stream_cache.dir_max, 0, 0, 0x7fffffff),
+    OPT_FLAG("cache-adaptive", stream_cache.adaptive, 0),
+    OPT_DOUBLE("cache-adaptive-secs", stream_cache.adaptive_secs, M_OPT_RANGE,
+               .min = 1, .max = 3600),
 
 #if HAVE_DVDREAD || HAVE_DVDNAV
     OPT_STRING("dvd-device", dvd_device, M_OPT_FILE),
@@ -341,6 +349,9 @@ const m_option_t mp_opts[] = {
     OPT_DOUBLE("demuxer-readahead-secs", demuxer_min_secs, M_OPT_MIN, .min = 0),
     OPT_INTRANGE("demuxer-max-packets", demuxer_max_packs, 0, 0, INT_MAX),
     OPT_INTRANGE("demuxer-max-bytes", demuxer_max_bytes, 0, 0, INT_MAX),
+    OPT_INTRANGE("demuxer-max-back-bytes", demuxer_max_back_bytes, 0, 0, INT_MAX),
+    OPT_CHOICE("demuxer-seekable-cache", demuxer_seekable_cache, 0,
+               ({"auto", -1}, {"no", 0}, {"yes", 1})),
 
     OPT_FLAG("force-seekable", force_seekable, 0),
 
@@ -390,6 +401,10 @@ const m_option_t mp_opts[] = {
 
     OPT_STRING("ad", audio_decoders, 0),
     OPT_STRING("vd", video_decoders, 0),
+    OPT_FLAG("vd-queue-enable", vd_queue_enable, 0),
+    OPT_INTRANGE("vd-queue-max-samples", vd_queue_max_samples, 0, 1, 100),
+    OPT_FLAG("ad-queue-enable", ad_queue_enable, 0),
+    OPT_INTRANGE("ad-queue-max-samples", ad_queue_max_samples, 0, 1, 10000000),
 
     OPT_STRING("audio-spdif", audio_spdif, 0),
 
@@ -551,6 +566,7 @@ const m_option_t mp_opts[] = {
 
     OPT_STRING("stream-capture", stream_capture, M_OPT_FILE),
     OPT_STRING("stream-dump", stream_dump, M_OPT_FILE),
+    OPT_FLAG("stream-file-mmap", stream_file_mmap, 0),
 
     OPT_FLAG("stop-playback-on-init-failure", stop_playback_on_init_failure, 0),
 
@@ -578,6 +594,8 @@ const m_option_t mp_opts[] = {
 
     OPT_FLAG("load-unsafe-playlists", load_unsafe_playlists, 0),
     OPT_FLAG("merge-files", merge_files, 0),
+    OPT_FLAG("prefetch-playlist", prefetch_open, 0),
+    OPT_DOUBLE("prefetch-playlist-secs", prefetch_secs, M_OPT_MIN, .min = 0),
 
     // a-v sync stuff:
     OPT_FLAG("correct-pts", correct_pts, 0),
@@ -635,6 +653,8 @@ const m_option_t mp_opts[] = {
     OPT_SUBSTRUCT("screenshot", screenshot_image_opts, image_writer_conf, 0),
     OPT_STRING("screenshot-template", screenshot_template, 0),
     OPT_STRING("screenshot-directory", screenshot_directory, 0),
+    OPT_INTRANGE("screenshot-queue-size", screenshot_queue_size, 0, 0, 1000),
+    OPT_INTRANGE("screenshot-threads", screenshot_threads, 0, 1, 64),
 
     OPT_SUBSTRUCT("input", input_opts, input_config, 0),
 
@@ -745,6 +765,8 @@ const struct MPOpts mp_default_opts = {
     .audio_driver_list = NULL,
     .audio_decoders = "-spdif:*", // never select spdif by default
     .video_decoders = NULL,
+    .vd_queue_max_samples = 2,
+    .ad_queue_max_samples = 48000,
     .deinterlace = -1,
     .softvol = SOFTVOL_AUTO,
     .softvol_max = 130,
@@ -802,9 +824,14 @@ const struct MPOpts mp_default_opts = {
         .seek_min = 500,
         .back_buffer = 75000,
         .file_max = 1024 * 1024,
+        .dir_max = 10 * 1024 * 1024,
+        .adaptive_secs = 30,
     },
     .demuxer_max_packs = 16000,
     .demuxer_max_bytes = 400 * 1024 * 1024,
+    .demuxer_max_back_bytes = 50 * 1024 * 1024,
+    .prefetch_secs = 5,
+    .demuxer_seekable_cache = -1,
     .demuxer_thread = 1,
     .demuxer_min_secs = 1.0,
     .network_rtsp_transport = 2,
@@ -861,6 +888,7 @@ const struct MPOpts mp_default_opts = {
     .sub_fix_timing = 1,
     .sub_cp = "auto",
     .screenshot_template = "mpv-shot%n",
+    .screenshot_threads = 2,
 
     .hwdec_codecs = "h264,vc1,wmv3,hevc,mpeg2video,vp9",
     .videotoolbox_format = IMGFMT_NV12,
@@ -61,12 +61,17 @@ struct mp_cache_opts {
     int back_buffer;
     char *file;
     int file_max;
+    char *dir;
+    int dir_max;
+    int adaptive;
+    double adaptive_secs;
 };
 
 typedef struct MPOpts {
     int property_print_help;
     int use_terminal;
     char *dump_stats;
+    int dump_stats_binary;
     int verbose;
     char **msg_levels;
     int msg_color;
@@ -123,6 +128,10 @@ typedef struct MPOpts {
 
     char *audio_decoders;
     char *video_decoders;
+    int vd_queue_enable;
+    int vd_queue_max_samples;
+    int ad_queue_enable;
+    int ad_queue_max_samples;
     char *audio_spdif;
 
     int osd_level;
@@ -133,6 +142,7 @@ typedef struct MPOpts {
     int untimed;
     char *stream_capture;
     char *stream_dump;
+    int stream_file_mmap;
     int stop_playback_on_init_failure;
     int loop_times;
     int loop_file;
@@ -144,6 +154,8 @@ typedef struct MPOpts {
     char *chapter_file;
     int load_unsafe_playlists;
     int merge_files;
+    int prefetch_open;
+    double prefetch_secs;
     int quiet;
     int load_config;
     char *force_configdir;
@@ -216,6 +228,8 @@ typedef struct MPOpts {
     char *demuxer_name;
     int demuxer_max_packs;
     int demuxer_max_bytes;
+    int demuxer_max_back_bytes;
+    int demuxer_seekable_cache;
     int demuxer_thread;
     double demuxer_min_secs;
     char *audio_demuxer_name;
@@ -228,6 +242,8 @@ typedef struct MPOpts {
     struct image_writer_opts *screenshot_image_opts;
     char *screenshot_template;
     char *screenshot_directory;
+    int screenshot_queue_size;
+    int screenshot_threads;
 
     double force_fps;
     int index_mode;
@@ -55,3 +55,12 @@ void mpthread_set_name(const char *name)
     pthread_setname_np(tname);
 #endif
 }
+
+uint64_t mpthread_get_id(void)
+{
+#if HAVE_WIN32_INTERNAL_PTHREADS
+    return pthread_self().id;
+#else
+    return (uintptr_t)pthread_self();
+#endif
+}
@@ -10,4 +10,7 @@ int mpthread_mutex_init_recursive(pthread_mutex_t *mutex);
 // Set thread name (for debuggers).
 void mpthread_set_name(const char *name);
 
+// Return a number identifying the calling thread (for debug output).
+uint64_t mpthread_get_id(void);
+
 #endif
@@ -537,6 +537,12 @@ void reinit_audio_chain_src(struct MPContext *mpctx, struct lavfi_pad *src)
         if (!init_audio_decoder(mpctx, track))
             goto init_error;
         ao_c->audio_src = track->d_audio;
+        // Only decoding runs on the thread; filtering and feeding the AO
+        // stay in fill_audio_out_buffers().
+        if (mpctx->opts->ad_queue_enable) {
+            audio_start_thread(ao_c->audio_src, mpctx->opts->ad_queue_max_samples,
+                               wakeup_playloop, mpctx);
+        }
     }
 
     reset_audio_state(mpctx);
@@ -866,6 +872,9 @@ void fill_audio_out_buffers(struct MPContext *mpctx)
 
     dump_audio_stats(mpctx);
 
+    if (mpctx->ao && ao_query_and_reset_events(mpctx->ao, AO_EVENT_UNDERRUN))
+        mp_notify_property(mpctx, "audio-underruns");
+
     if (mpctx->ao && ao_query_and_reset_events(mpctx->ao, AO_EVENT_RELOAD)) {
         ao_reset(mpctx->ao);
         uninit_audio_out(mpctx);
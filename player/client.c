@@ -70,6 +70,27 @@ struct mp_client_api {
 
     struct mp_custom_protocol *custom_protocols;
     int num_custom_protocols;
+
+    // Values of observed properties, shared between observers (see
+    // update_prop()). Linked lists, indexed by property ID + 1 (so index 0
+    // holds the properties without ID).
+    struct cached_prop **cached_props;
+    int num_cached_props;
+    uint64_t reads_avoided;
+};
+
+// Last value of an observed property. Shared by all observers of the same
+// property/format combination. Protected by mp_client_api.lock.
+struct cached_prop {
+    struct cached_prop *next; // next entry with the same property ID
+    char *name;
+    mpv_format format;
+    int id;                 // ==mp_get_property_id(name)
+    int refcount;           // number of observe_property using this
+    bool valid;             // status and value are set
+    bool dirty;             // change notification since the value was read
+    int status;
+    union m_option_value value;
 };
 
 struct observe_property {
@@ -80,11 +101,13 @@ struct observe_property {
     mpv_format format;
     bool changed;           // property change should be signaled to user
     bool need_new_value;    // a new value should be retrieved
+    bool force_read;        // don't use the cached value for the next update
     bool updating;          // a new value is being retrieved
     bool dead;              // property unobserved while retrieving value
     bool new_value_valid, user_value_valid;
     union m_option_value new_value, user_value;
     struct mpv_handle *client;
+    struct cached_prop *cache; // reference, NULL for MPV_FORMAT_NONE
 };
 
 struct mpv_handle {
@@ -136,6 +159,12 @@ struct mpv_handle {
 static bool gen_log_message_event(struct mpv_handle *ctx);
 static bool gen_property_change_event(struct mpv_handle *ctx);
 static void notify_property_events(struct mpv_handle *ctx, uint64_t event_mask);
+static struct cached_prop *acquire_cached_prop(struct mp_client_api *clients,
+                                               const char *name,
+                                               mpv_format format, int id);
+static void release_cached_prop(struct mp_client_api *clients,
+                                struct cached_prop *c);
+static const struct m_option *get_mp_type_get(mpv_format format);
 
 void mp_clients_init(struct MPContext *mpctx)
 {
@@ -398,6 +427,8 @@ void mpv_detach_destroy(mpv_handle *ctx)
     for (int n = 0; n < clients->num_clients; n++) {
         if (clients->clients[n] == ctx) {
             MP_TARRAY_REMOVE_AT(clients->clients, clients->num_clients, n);
+            for (int i = 0; i < ctx->num_properties; i++)
+                release_cached_prop(clients, ctx->properties[i]->cache);
             while (ctx->num_events) {
                 talloc_free(ctx->events[ctx->first_event].data);
                 ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
@@ -662,12 +693,36 @@ bool mp_client_event_is_registered(struct MPContext *mpctx, int event)
     return r;
 }
 
+static void mark_cached_props(struct mp_client_api *clients, int index)
+{
+    for (struct cached_prop *c = clients->cached_props[index]; c; c = c->next)
+        c->dirty = true;
+}
+
+// Mark cached property values affected by the event as stale.
+// Called with clients->lock held.
+static void record_event_change(struct mp_client_api *clients, int event)
+{
+    const int *ids = mp_get_event_property_ids(clients->mpctx, event);
+    if (!ids) {
+        for (int n = 0; n < clients->num_cached_props; n++)
+            mark_cached_props(clients, n);
+        return;
+    }
+    for (int n = 0; ids[n] >= 0; n++) {
+        if (ids[n] + 1 < clients->num_cached_props)
+            mark_cached_props(clients, ids[n] + 1);
+    }
+}
+
 void mp_client_broadcast_event(struct MPContext *mpctx, int event, void *data)
 {
     struct mp_client_api *clients = mpctx->clients;
 
     pthread_mutex_lock(&clients->lock);
 
+    record_event_change(clients, event);
+
     for (int n = 0; n < clients->num_clients; n++) {
         struct mpv_event event_data = {
             .event_id = event,
@@ -701,6 +756,7 @@ int mp_client_send_event(struct MPContext *mpctx, const char *client_name,
 
     struct mpv_handle *ctx = find_client(clients, client_name);
     if (ctx) {
+        record_event_change(clients, event);
         r = send_event(ctx, &event_data, false);
     } else {
         r = -1;
@@ -1292,6 +1348,118 @@ int mpv_get_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
     return run_async(ctx, getproperty_fn, req);
 }
 
+struct requests_batch {
+    struct MPContext *mpctx;
+    struct mp_client_request *reqs;
+    struct mp_cmd **cmds;
+    int num_reqs;
+};
+
+static void requests_fn(void *arg)
+{
+    struct requests_batch *b = arg;
+
+    if (!b->mpctx->initialized) {
+        for (int n = 0; n < b->num_reqs; n++) {
+            talloc_free(b->cmds[n]);
+            b->cmds[n] = NULL;
+            b->reqs[n].status = MPV_ERROR_UNINITIALIZED;
+        }
+        return;
+    }
+
+    for (int n = 0; n < b->num_reqs; n++) {
+        struct mp_client_request *r = &b->reqs[n];
+        switch (r->type) {
+        case MP_CLIENT_REQ_COMMAND: {
+            if (!b->cmds[n]) {
+                r->status = MPV_ERROR_INVALID_PARAMETER;
+                break;
+            }
+            struct cmd_request req = {
+                .mpctx = b->mpctx,
+                .cmd = b->cmds[n],
+                .res = &r->result,
+            };
+            cmd_fn(&req);
+            b->cmds[n] = NULL; // freed by cmd_fn()
+            r->status = req.status;
+            if (r->status < 0) {
+                mpv_free_node_contents(&r->result);
+                r->result = (struct mpv_node){.format = MPV_FORMAT_NONE};
+            }
+            break;
+        }
+        case MP_CLIENT_REQ_GET_PROPERTY:
+        case MP_CLIENT_REQ_GET_PROPERTY_STRING: {
+            bool str = r->type == MP_CLIENT_REQ_GET_PROPERTY_STRING;
+            char *s = NULL;
+            struct getproperty_request req = {
+                .mpctx = b->mpctx,
+                .name = r->name,
+                .format = str ? MPV_FORMAT_STRING : MPV_FORMAT_NODE,
+                .data = str ? (void *)&s : (void *)&r->result,
+            };
+            getproperty_fn(&req);
+            r->status = req.status;
+            if (s) {
+                r->result = (struct mpv_node){
+                    .format = MPV_FORMAT_STRING,
+                    .u.string = s,
+                };
+            }
+            break;
+        }
+        case MP_CLIENT_REQ_SET_PROPERTY: {
+            struct setproperty_request req = {
+                .mpctx = b->mpctx,
+                .name = r->name,
+                .format = MPV_FORMAT_NODE,
+                .data = r->args,
+            };
+            setproperty_fn(&req);
+            r->status = req.status;
+            break;
+        }
+        default:
+            r->status = MPV_ERROR_INVALID_PARAMETER;
+        }
+    }
+}
+
+void mp_client_run_requests(struct mpv_handle *ctx,
+                            struct mp_client_request *reqs, int num_reqs)
+{
+    struct requests_batch b = {
+        .mpctx = ctx->mpctx,
+        .reqs = reqs,
+        .cmds = talloc_zero_array(NULL, struct mp_cmd *, num_reqs),
+        .num_reqs = num_reqs,
+    };
+
+    // Parse the commands outside of the lock, as run_client_command() does.
+    // Abort commands must trigger playback_abort before waiting for the core
+    // lock, which a blocking file load might hold. The pointer itself is set
+    // in mp_create() and never changes, so it's safe to read here.
+    for (int n = 0; n < num_reqs; n++) {
+        reqs[n].status = 0;
+        reqs[n].result = (struct mpv_node){.format = MPV_FORMAT_NONE};
+        if (reqs[n].type != MP_CLIENT_REQ_COMMAND)
+            continue;
+        struct mp_cmd *cmd = mp_input_parse_cmd_node(ctx->log, reqs[n].args);
+        if (cmd) {
+            if (mp_input_is_abort_cmd(cmd))
+                mp_cancel_trigger(ctx->mpctx->playback_abort);
+            cmd->sender = ctx->name;
+        }
+        b.cmds[n] = cmd;
+    }
+
+    run_locked(ctx, requests_fn, &b);
+
+    talloc_free(b.cmds);
+}
+
 static void property_free(void *p)
 {
     struct observe_property *prop = p;
@@ -1311,18 +1479,30 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     if (format == MPV_FORMAT_OSD_STRING)
         return MPV_ERROR_PROPERTY_FORMAT;
 
+    int id = mp_get_property_id(ctx->mpctx, name);
+    uint64_t event_mask = mp_get_property_event_mask(name);
+
+    struct cached_prop *cache = NULL;
+    if (format) {
+        pthread_mutex_lock(&ctx->clients->lock);
+        cache = acquire_cached_prop(ctx->clients, name, format, id);
+        pthread_mutex_unlock(&ctx->clients->lock);
+    }
+
     pthread_mutex_lock(&ctx->lock);
     struct observe_property *prop = talloc_ptrtype(ctx, prop);
     talloc_set_destructor(prop, property_free);
     *prop = (struct observe_property){
         .client = ctx,
         .name = talloc_strdup(prop, name),
-        .id = mp_get_property_id(ctx->mpctx, name),
-        .event_mask = mp_get_property_event_mask(name),
+        .id = id,
+        .event_mask = event_mask,
         .reply_id = userdata,
         .format = format,
         .changed = true,
         .need_new_value = true,
+        .force_read = true,
+        .cache = cache,
     };
     MP_TARRAY_APPEND(ctx, ctx->properties, ctx->num_properties, prop);
     ctx->property_event_masks |= prop->event_mask;
@@ -1334,6 +1514,9 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
 
 int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
 {
+    struct cached_prop **release = NULL;
+    int num_release = 0;
+
     pthread_mutex_lock(&ctx->lock);
     ctx->property_event_masks = 0;
     int count = 0;
@@ -1341,8 +1524,11 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
         struct observe_property *prop = ctx->properties[n];
         if (prop->reply_id == userdata) {
             if (prop->updating) {
+                // update_prop() releases the cache reference.
                 prop->dead = true;
             } else {
+                MP_TARRAY_APPEND(NULL, release, num_release, prop->cache);
+                prop->cache = NULL;
                 // In case mpv_unobserve_property() is called after mpv_wait_event()
                 // returned, and the mpv_event still references the name somehow,
                 // make sure it's not freed while in use. The same can happen
@@ -1357,6 +1543,14 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
     }
     ctx->lowest_changed = 0;
     pthread_mutex_unlock(&ctx->lock);
+
+    // (Not under ctx->lock, because clients->lock must be locked first.)
+    pthread_mutex_lock(&ctx->clients->lock);
+    for (int n = 0; n < num_release; n++)
+        release_cached_prop(ctx->clients, release[n]);
+    pthread_mutex_unlock(&ctx->clients->lock);
+    talloc_free(release);
+
     invalidate_global_event_mask(ctx);
     return count;
 }
@@ -1379,6 +1573,10 @@ void mp_client_property_change(struct MPContext *mpctx, const char *name)
 
     pthread_mutex_lock(&clients->lock);
 
+    // Same matching as for the observers below (by property ID only).
+    if (id + 1 < clients->num_cached_props)
+        mark_cached_props(clients, id + 1);
+
     for (int n = 0; n < clients->num_clients; n++) {
         struct mpv_handle *client = clients->clients[n];
         pthread_mutex_lock(&client->lock);
@@ -1406,10 +1604,64 @@ static void notify_property_events(struct mpv_handle *ctx, uint64_t event_mask)
         wakeup_client(ctx);
 }
 
+// Return a new reference to the shared entry for the property/format pair.
+// Called with clients->lock held.
+static struct cached_prop *acquire_cached_prop(struct mp_client_api *clients,
+                                               const char *name,
+                                               mpv_format format, int id)
+{
+    if (id + 1 >= clients->num_cached_props) {
+        int old = clients->num_cached_props;
+        clients->num_cached_props = id + 2;
+        clients->cached_props = talloc_realloc(clients, clients->cached_props,
+                                               struct cached_prop *,
+                                               clients->num_cached_props);
+        for (int n = old; n < clients->num_cached_props; n++)
+            clients->cached_props[n] = NULL;
+    }
+    struct cached_prop **list = &clients->cached_props[id + 1];
+    for (struct cached_prop *c = *list; c; c = c->next) {
+        if (c->format == format && strcmp(c->name, name) == 0) {
+            c->refcount++;
+            return c;
+        }
+    }
+    struct cached_prop *c = talloc_ptrtype(clients, c);
+    *c = (struct cached_prop){
+        .next = *list,
+        .name = talloc_strdup(c, name),
+        .format = format,
+        .id = id,
+        .refcount = 1,
+    };
+    *list = c;
+    return c;
+}
+
+// Called with clients->lock held.
+static void release_cached_prop(struct mp_client_api *clients,
+                                struct cached_prop *c)
+{
+    if (!c || --c->refcount > 0)
+        return;
+    for (struct cached_prop **p = &clients->cached_props[c->id + 1]; *p;
+         p = &(*p)->next)
+    {
+        if (*p == c) {
+            *p = c->next;
+            break;
+        }
+    }
+    if (c->valid && c->status >= 0)
+        m_option_free(get_mp_type_get(c->format), &c->value);
+    talloc_free(c);
+}
+
 static void update_prop(void *p)
 {
     struct observe_property *prop = p;
     struct mpv_handle *ctx = prop->client;
+    struct mp_client_api *clients = ctx->clients;
 
     const struct m_option *type = get_mp_type_get(prop->format);
     union m_option_value val = {0};
@@ -1421,11 +1673,42 @@ static void update_prop(void *p)
         .data = &val,
     };
 
-    getproperty_fn(&req);
+    // Other observers of the same property might have read the current value
+    // already. Only properties which had a change notification (an event
+    // affecting it, or an explicit mp_notify_property()) need to be re-read.
+    // The entry can't go away while this is running (prop->cache is a
+    // reference, released only after the update).
+    struct cached_prop *c = prop->cache;
+    pthread_mutex_lock(&clients->lock);
+    bool cached = !prop->force_read && c->valid && !c->dirty;
+    if (cached) {
+        req.status = c->status;
+        if (c->status >= 0)
+            m_option_copy(type, &val, &c->value);
+        clients->reads_avoided++;
+    } else {
+        // A notification arriving during the read makes it dirty again.
+        c->dirty = false;
+    }
+    pthread_mutex_unlock(&clients->lock);
+
+    if (!cached) {
+        getproperty_fn(&req);
+
+        pthread_mutex_lock(&clients->lock);
+        if (c->valid && c->status >= 0)
+            m_option_free(type, &c->value);
+        c->valid = true;
+        c->status = req.status;
+        if (req.status >= 0)
+            m_option_copy(type, &c->value, &val);
+        pthread_mutex_unlock(&clients->lock);
+    }
 
     pthread_mutex_lock(&ctx->lock);
     ctx->properties_updating--;
     prop->updating = false;
+    prop->force_read = false;
     m_option_free(type, &prop->new_value);
     prop->new_value_valid = req.status >= 0;
     if (prop->new_value_valid)
@@ -1436,10 +1719,31 @@ static void update_prop(void *p)
         if (!compare_value(&prop->user_value, &prop->new_value, prop->format))
             prop->changed = true;
     }
-    if (prop->dead)
+    struct cached_prop *dead_cache = NULL;
+    if (prop->dead) {
+        dead_cache = prop->cache;
+        prop->cache = NULL;
         talloc_steal(ctx->cur_event, prop);
+    }
     wakeup_client(ctx);
     pthread_mutex_unlock(&ctx->lock);
+
+    if (dead_cache) {
+        pthread_mutex_lock(&clients->lock);
+        release_cached_prop(clients, dead_cache);
+        pthread_mutex_unlock(&clients->lock);
+    }
+}
+
+// Number of observed property updates that used the value read by another
+// observer, instead of reading the property again.
+uint64_t mp_client_get_reads_avoided(struct MPContext *mpctx)
+{
+    struct mp_client_api *clients = mpctx->clients;
+    pthread_mutex_lock(&clients->lock);
+    uint64_t r = clients->reads_avoided;
+    pthread_mutex_unlock(&clients->lock);
+    return r;
 }
 
 // Set ctx->cur_event to a generated property change event, if there is any
@@ -1709,6 +2013,16 @@ int mpv_opengl_cb_render(mpv_opengl_cb_context *ctx, int fbo, int vp[4])
     return mpv_opengl_cb_draw(ctx, fbo, vp[2], vp[3]);
 }
 
+static struct mpv_sw_cb_context *sw_cb_get_context(mpv_handle *ctx)
+{
+    struct mpv_sw_cb_context *cb = ctx->mpctx->sw_cb_ctx;
+    if (!cb) {
+        cb = mp_sw_cb_create(ctx->mpctx->global, ctx->clients);
+        ctx->mpctx->sw_cb_ctx = cb;
+    }
+    return cb;
+}
+
 void *mpv_get_sub_api(mpv_handle *ctx, mpv_sub_api sub_api)
 {
     void *res = NULL;
@@ -1717,6 +2031,9 @@ void *mpv_get_sub_api(mpv_handle *ctx, mpv_sub_api sub_api)
     case MPV_SUB_API_OPENGL_CB:
         res = opengl_cb_get_context(ctx);
         break;
+    case MPV_SUB_API_SW_CB:
+        res = sw_cb_get_context(ctx);
+        break;
     default:;
     }
     unlock_core(ctx);
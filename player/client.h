@@ -28,6 +28,7 @@ int mp_client_send_event_dup(struct MPContext *mpctx, const char *client_name,
                              int event, void *data);
 bool mp_client_event_is_registered(struct MPContext *mpctx, int event);
 void mp_client_property_change(struct MPContext *mpctx, const char *name);
+uint64_t mp_client_get_reads_avoided(struct MPContext *mpctx);
 
 struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name);
 struct mp_log *mp_client_get_log(struct mpv_handle *ctx);
@@ -36,6 +37,30 @@ struct MPContext *mp_client_api_get_core(struct mp_client_api *api);
 
 void mp_resume_all(struct mpv_handle *ctx);
 
+enum mp_client_request_type {
+    MP_CLIENT_REQ_COMMAND,              // like mpv_command_node()
+    MP_CLIENT_REQ_GET_PROPERTY,         // like mpv_get_property(MPV_FORMAT_NODE)
+    MP_CLIENT_REQ_GET_PROPERTY_STRING,  // ... with MPV_FORMAT_STRING
+    MP_CLIENT_REQ_SET_PROPERTY,         // like mpv_set_property(MPV_FORMAT_NODE)
+};
+
+struct mp_client_request {
+    // Set by the caller
+    enum mp_client_request_type type;
+    const char *name;       // property name (not used for commands)
+    struct mpv_node *args;  // command arguments, or the new property value
+    // Set by mp_client_run_requests()
+    int status;             // error code (>= 0 on success)
+    struct mpv_node result; // command result or property value (a string
+                            // for GET_PROPERTY_STRING); MPV_FORMAT_NONE on
+                            // errors. Free with mpv_free_node_contents().
+};
+
+// Execute the requests in order, acquiring the core lock only once. If the
+// core is not initialized yet, all requests fail with MPV_ERROR_UNINITIALIZED.
+void mp_client_run_requests(struct mpv_handle *ctx,
+                            struct mp_client_request *reqs, int num_reqs);
+
 // m_option.c
 void *node_get_alloc(struct mpv_node *node);
 
@@ -47,6 +72,11 @@ struct mpv_opengl_cb_context *mp_opengl_create(struct mpv_global *g,
                                                struct mp_client_api *client_api);
 void kill_video(struct mp_client_api *client_api);
 
+// vo_sw_cb.c
+struct mpv_sw_cb_context;
+struct mpv_sw_cb_context *mp_sw_cb_create(struct mpv_global *g,
+                                          struct mp_client_api *client_api);
+
 bool mp_streamcb_lookup(struct mpv_global *g, const char *protocol,
                         void **out_user_data, mpv_stream_cb_open_ro_fn *out_fn);
 
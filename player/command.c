@@ -61,6 +61,7 @@
 #include "audio/decode/dec_audio.h"
 #include "video/out/bitmap_packer.h"
 #include "options/path.h"
+#include "misc/node.h"
 #include "screenshot.h"
 
 #include "osdep/io.h"
@@ -68,9 +69,28 @@
 
 #include "core.h"
 
+// Frame counter properties. They are not in the MPV_EVENT_TICK list, because
+// they change rarely; update_frame_counters() notifies them on changes.
+enum {
+    FRAME_COUNTER_DEC_DROP,
+    FRAME_COUNTER_MISTIMED,
+    FRAME_COUNTER_VO_DROP,
+    FRAME_COUNTER_VO_DELAYED,
+    NUM_FRAME_COUNTERS
+};
+
+static const char *const frame_counter_props[NUM_FRAME_COUNTERS] = {
+    [FRAME_COUNTER_DEC_DROP] = "drop-frame-count",
+    [FRAME_COUNTER_MISTIMED] = "mistimed-frame-count",
+    [FRAME_COUNTER_VO_DROP] = "vo-drop-frame-count",
+    [FRAME_COUNTER_VO_DELAYED] = "vo-delayed-frame-count",
+};
+
 struct command_ctx {
     // All properties, terminated with a {0} item.
     struct m_property *properties;
+    // For looking up entries in properties by name.
+    struct m_property_index *properties_index;
 
     bool is_idle;
 
@@ -97,6 +117,18 @@ struct command_ctx {
     int64_t hook_seq; // for hook_handler.seq
 
     struct ao_hotplug *hotplug;
+
+    // mp_event_property_change[] resolved to property IDs
+    struct event_property_ids *event_ids;
+    int num_event_ids;
+
+    // Last values of the frame counters (see update_frame_counters())
+    int frame_counters[NUM_FRAME_COUNTERS];
+};
+
+struct event_property_ids {
+    bool all;       // the event can change any property
+    int *ids;       // property IDs, terminated with -1
 };
 
 struct overlay {
@@ -597,24 +629,32 @@ static int mp_property_total_avsync_change(void *ctx, struct m_property *prop,
     return m_property_double_ro(action, arg, mpctx->total_avsync_change);
 }
 
-static int mp_property_drop_frame_cnt(void *ctx, struct m_property *prop,
-                                      int action, void *arg)
+// Return the value of the frame counter property, or -1 if unavailable.
+static int get_frame_counter(struct MPContext *mpctx, int type)
 {
-    MPContext *mpctx = ctx;
-    if (!mpctx->vo_chain)
-        return M_PROPERTY_UNAVAILABLE;
-
-    return m_property_int_ro(action, arg, mpctx->vo_chain->video_src->dropped_frames);
+    struct vo_chain *vo_c = mpctx->vo_chain;
+    if (!vo_c)
+        return -1;
+    switch (type) {
+    case FRAME_COUNTER_DEC_DROP:
+        return vo_c->video_src ? video_get_dropped_frames(vo_c->video_src) : 0;
+    case FRAME_COUNTER_MISTIMED:
+        return mpctx->display_sync_active ? mpctx->mistimed_frames_total : -1;
+    case FRAME_COUNTER_VO_DROP:
+        return vo_get_drop_count(mpctx->video_out);
+    case FRAME_COUNTER_VO_DELAYED:
+        return vo_get_delayed_count(mpctx->video_out);
+    }
+    abort();
 }
 
-static int mp_property_mistimed_frame_count(void *ctx, struct m_property *prop,
-                                            int action, void *arg)
+static int mp_property_frame_counter(void *ctx, struct m_property *prop,
+                                     int action, void *arg)
 {
-    MPContext *mpctx = ctx;
-    if (!mpctx->vo_chain || !mpctx->display_sync_active)
+    int val = get_frame_counter(ctx, (intptr_t)prop->priv);
+    if (val < 0)
         return M_PROPERTY_UNAVAILABLE;
-
-    return m_property_int_ro(action, arg, mpctx->mistimed_frames_total);
+    return m_property_int_ro(action, arg, val);
 }
 
 static int mp_property_vsync_ratio(void *ctx, struct m_property *prop,
@@ -639,26 +679,6 @@ static int mp_property_vsync_ratio(void *ctx, struct m_property *prop,
     return m_property_double_ro(action, arg, vsyncs / (double)frames);
 }
 
-static int mp_property_vo_drop_frame_count(void *ctx, struct m_property *prop,
-                                           int action, void *arg)
-{
-    MPContext *mpctx = ctx;
-    if (!mpctx->vo_chain)
-        return M_PROPERTY_UNAVAILABLE;
-
-    return m_property_int_ro(action, arg, vo_get_drop_count(mpctx->video_out));
-}
-
-static int mp_property_vo_delayed_frame_count(void *ctx, struct m_property *prop,
-                                              int action, void *arg)
-{
-    MPContext *mpctx = ctx;
-    if (!mpctx->vo_chain)
-        return M_PROPERTY_UNAVAILABLE;
-
-    return m_property_int_ro(action, arg, vo_get_delayed_count(mpctx->video_out));
-}
-
 /// Current position in percent (RW)
 static int mp_property_percent_pos(void *ctx, struct m_property *prop,
                                    int action, void *arg)
@@ -946,7 +966,7 @@ static int mp_property_edition(void *ctx, struct m_property *prop,
     case M_PROPERTY_SET: {
         edition = *(int *)arg;
         if (edition != demuxer->edition) {
-            mpctx->opts->edition_id = edition;
+            mp_property_generic_option(mpctx, prop, M_PROPERTY_SET, &edition);
             if (!mpctx->stop_play)
                 mpctx->stop_play = PT_RELOAD_FILE;
         }
@@ -1484,6 +1504,108 @@ static int mp_property_cache_speed(void *ctx, struct m_property *prop,
     return m_property_int64_ro(action, arg, info.speed);
 }
 
+static int mp_property_cache_read_speed(void *ctx, struct m_property *prop,
+                                        int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct stream_cache_info info = {0};
+    demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_INFO, &info);
+    if (info.size <= 0)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_PRINT) {
+        *(char **)arg =
+            talloc_strdup_append(format_file_size(info.read_speed), "/s");
+        return M_PROPERTY_OK;
+    }
+    return m_property_int64_ro(action, arg, info.read_speed);
+}
+
+static int mp_property_cache_stats(void *ctx, struct m_property *prop,
+                                   int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct stream_cache_info info = {0};
+    demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_INFO, &info);
+    if (info.size <= 0)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    struct mpv_node *r = (struct mpv_node *)arg;
+    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add(r, "read-bytes", MPV_FORMAT_INT64)->u.int64 = info.total_read;
+    node_map_add(r, "zero-copy-bytes", MPV_FORMAT_INT64)->u.int64 =
+        info.total_borrowed;
+    node_map_add(r, "fetched-bytes", MPV_FORMAT_INT64)->u.int64 =
+        info.total_fetched;
+    node_map_add(r, "waits", MPV_FORMAT_INT64)->u.int64 = info.waits;
+    return M_PROPERTY_OK;
+}
+
+static int mp_property_cache_controller(void *ctx, struct m_property *prop,
+                                        int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct stream_cache_info info = {0};
+    demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_INFO, &info);
+    if (info.size <= 0)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    const char *state = "filling";
+    if (!info.adaptive) {
+        state = "disabled";
+    } else if (info.idle) {
+        state = info.target_reached ? "target-reached" : "idle";
+    }
+
+    struct mpv_node *r = (struct mpv_node *)arg;
+    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_string(r, "state", state);
+    node_map_add(r, "readahead-target", MPV_FORMAT_INT64)->u.int64 =
+        info.readahead_target;
+    node_map_add(r, "read-size", MPV_FORMAT_INT64)->u.int64 = info.read_size;
+    node_map_add(r, "bitrate", MPV_FORMAT_INT64)->u.int64 = info.bitrate;
+    node_map_add(r, "link-speed", MPV_FORMAT_INT64)->u.int64 = info.link_speed;
+    node_map_add(r, "resume-secs", MPV_FORMAT_DOUBLE)->u.double_ =
+        MPMAX(mpctx->cache_wait_time, 1);
+    node_map_add(r, "rebuffers", MPV_FORMAT_INT64)->u.int64 =
+        mpctx->cache_rebuffers;
+    node_map_add(r, "rebuffer-time", MPV_FORMAT_DOUBLE)->u.double_ =
+        mpctx->cache_rebuffer_time;
+    return M_PROPERTY_OK;
+}
+
+static int mp_property_cache_rebuffers(void *ctx, struct m_property *prop,
+                                       int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_int_ro(action, arg, mpctx->cache_rebuffers);
+}
+
 static int mp_property_cache_idle(void *ctx, struct m_property *prop,
                                   int action, void *arg)
 {
@@ -1545,6 +1667,46 @@ static int mp_property_demuxer_cache_idle(void *ctx, struct m_property *prop,
     return m_property_flag_ro(action, arg, s.idle);
 }
 
+static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
+                                           int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    struct demux_ctrl_reader_state s;
+    if (demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_READER_STATE, &s) < 1)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct mpv_node *r = (struct mpv_node *)arg;
+    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+
+    struct mpv_node *ranges =
+        node_map_add(r, "seekable-ranges", MPV_FORMAT_NODE_ARRAY);
+    if (s.seek_range[0] != MP_NOPTS_VALUE) {
+        struct mpv_node *sub = node_array_add(ranges, MPV_FORMAT_NODE_MAP);
+        node_map_add(sub, "start", MPV_FORMAT_DOUBLE)->u.double_ = s.seek_range[0];
+        node_map_add(sub, "end", MPV_FORMAT_DOUBLE)->u.double_ = s.seek_range[1];
+    }
+
+    node_map_add(r, "seekable-cache", MPV_FORMAT_FLAG)->u.flag = s.seekable_cache;
+    node_map_add(r, "fw-bytes", MPV_FORMAT_INT64)->u.int64 = s.fw_bytes;
+    node_map_add(r, "total-bytes", MPV_FORMAT_INT64)->u.int64 = s.total_bytes;
+    node_map_add(r, "seek-cache-hits", MPV_FORMAT_INT64)->u.int64 =
+        s.seek_cache_hits;
+    node_map_add(r, "seek-cache-misses", MPV_FORMAT_INT64)->u.int64 =
+        s.seek_cache_misses;
+
+    return M_PROPERTY_OK;
+}
+
 static int mp_property_paused_for_cache(void *ctx, struct m_property *prop,
                                         int action, void *arg)
 {
@@ -1785,6 +1947,15 @@ static int mp_property_ao(void *ctx, struct m_property *p, int action, void *arg
                                     mpctx->ao ? ao_get_name(mpctx->ao) : NULL);
 }
 
+static int mp_property_audio_underruns(void *ctx, struct m_property *prop,
+                                       int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_int64_ro(action, arg, ao_get_underruns(mpctx->ao));
+}
+
 static int mp_property_ao_detected_device(void *ctx,struct m_property *prop,
                                           int action, void *arg)
 {
@@ -1832,7 +2003,8 @@ static int mp_property_audio_codec(void *ctx, struct m_property *prop,
 {
     MPContext *mpctx = ctx;
     struct track *track = mpctx->current_track[0][STREAM_AUDIO];
-    const char *c = track && track->d_audio ? track->d_audio->decoder_desc : NULL;
+    const char *c =
+        track && track->d_audio ? audio_get_decoder_desc(track->d_audio) : NULL;
     return m_property_strdup_ro(action, arg, c);
 }
 
@@ -2031,9 +2203,9 @@ static int get_track_entry(int item, int action, void *arg, void *ctx)
 
     const char *decoder_desc = NULL;
     if (track->d_video)
-        decoder_desc = track->d_video->decoder_desc;
+        decoder_desc = video_get_decoder_desc(track->d_video);
     if (track->d_audio)
-        decoder_desc = track->d_audio->decoder_desc;
+        decoder_desc = audio_get_decoder_desc(track->d_audio);
 
     bool has_rg = track->stream->codec->replaygain_data;
     struct replaygain_data rg = has_rg ? *track->stream->codec->replaygain_data
@@ -2479,7 +2651,8 @@ static int mp_property_video_codec(void *ctx, struct m_property *prop,
 {
     MPContext *mpctx = ctx;
     struct track *track = mpctx->current_track[0][STREAM_VIDEO];
-    const char *c = track && track->d_video ? track->d_video->decoder_desc : NULL;
+    const char *c =
+        track && track->d_video ? video_get_decoder_desc(track->d_video) : NULL;
     return m_property_strdup_ro(action, arg, c);
 }
 
@@ -3136,7 +3309,7 @@ static int mp_property_playlist_pos_x(void *ctx, struct m_property *prop,
 {
     MPContext *mpctx = ctx;
     struct playlist *pl = mpctx->playlist;
-    if (!pl->first)
+    if (!pl->num_entries)
         return M_PROPERTY_UNAVAILABLE;
 
     switch (action) {
@@ -3181,30 +3354,11 @@ static int mp_property_playlist_pos_1(void *ctx, struct m_property *prop,
     return mp_property_playlist_pos_x(ctx, prop, action, arg, 1);
 }
 
-struct get_playlist_ctx {
-    struct MPContext *mpctx;
-    int last_index;
-    struct playlist_entry *last_entry;
-};
-
 static int get_playlist_entry(int item, int action, void *arg, void *ctx)
 {
-    struct get_playlist_ctx *p = ctx;
-    struct MPContext *mpctx = p->mpctx;
-
-    struct playlist_entry *e;
-    // This is an optimization that prevents O(n^2) behaviour when the entire
-    // playlist is requested. If a request is made for the last requested entry
-    // or the entry immediately following it, it can be found without a full
-    // traversal of the linked list.
-    if (p->last_entry && item == p->last_index)
-        e = p->last_entry;
-    else if (p->last_entry && item == p->last_index + 1)
-        e = p->last_entry->next;
-    else
-        e = playlist_entry_from_index(mpctx->playlist, item);
-    p->last_index = item;
-    p->last_entry = e;
+    struct MPContext *mpctx = ctx;
+
+    struct playlist_entry *e = playlist_entry_from_index(mpctx->playlist, item);
     if (!e)
         return M_PROPERTY_ERROR;
 
@@ -3215,6 +3369,7 @@ static int get_playlist_entry(int item, int action, void *arg, void *ctx)
         {"current",     SUB_PROP_FLAG(1), .unavailable = !current},
         {"playing",     SUB_PROP_FLAG(1), .unavailable = !playing},
         {"title",       SUB_PROP_STR(e->title), .unavailable = !e->title},
+        {"id",          SUB_PROP_INT64(e->id)},
         {0}
     };
 
@@ -3228,8 +3383,8 @@ static int mp_property_playlist(void *ctx, struct m_property *prop,
     if (action == M_PROPERTY_PRINT) {
         char *res = talloc_strdup(NULL, "");
 
-        for (struct playlist_entry *e = mpctx->playlist->first; e; e = e->next)
-        {
+        for (int n = 0; n < mpctx->playlist->num_entries; n++) {
+            struct playlist_entry *e = mpctx->playlist->entries[n];
             char *p = e->filename;
             if (!mp_is_url(bstr0(p))) {
                 char *s = mp_basename(e->filename);
@@ -3245,9 +3400,8 @@ static int mp_property_playlist(void *ctx, struct m_property *prop,
         return M_PROPERTY_OK;
     }
 
-    struct get_playlist_ctx p = { .mpctx = mpctx };
     return m_property_read_list(action, arg, playlist_entry_count(mpctx->playlist),
-                                get_playlist_entry, &p);
+                                get_playlist_entry, mpctx);
 }
 
 static char *print_obj_osd_list(struct m_obj_settings *list)
@@ -3641,6 +3795,20 @@ static int mp_property_list(void *ctx, struct m_property *prop,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+static int mp_property_reads_avoided(void *ctx, struct m_property *prop,
+                                     int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    return m_property_int64_ro(action, arg, mp_client_get_reads_avoided(mpctx));
+}
+
+static int mp_property_log_dropped(void *ctx, struct m_property *prop,
+                                   int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    return m_property_int64_ro(action, arg, mp_msg_get_dropped(mpctx->global));
+}
+
 static int mp_profile_list(void *ctx, struct m_property *prop,
                            int action, void *arg)
 {
@@ -3689,11 +3857,15 @@ static const struct m_property mp_properties_base[] = {
     M_PROPERTY_DEPRECATED_ALIAS("length", "duration"), // conflicts with option
     {"avsync", mp_property_avsync},
     {"total-avsync-change", mp_property_total_avsync_change},
-    {"drop-frame-count", mp_property_drop_frame_cnt},
-    {"mistimed-frame-count", mp_property_mistimed_frame_count},
+    {"drop-frame-count", mp_property_frame_counter,
+     .priv = (void *)FRAME_COUNTER_DEC_DROP},
+    {"mistimed-frame-count", mp_property_frame_counter,
+     .priv = (void *)FRAME_COUNTER_MISTIMED},
     {"vsync-ratio", mp_property_vsync_ratio},
-    {"vo-drop-frame-count", mp_property_vo_drop_frame_count},
-    {"vo-delayed-frame-count", mp_property_vo_delayed_frame_count},
+    {"vo-drop-frame-count", mp_property_frame_counter,
+     .priv = (void *)FRAME_COUNTER_VO_DROP},
+    {"vo-delayed-frame-count", mp_property_frame_counter,
+     .priv = (void *)FRAME_COUNTER_VO_DELAYED},
     {"percent-pos", mp_property_percent_pos},
     {"time-start", mp_property_time_start},
     {"time-pos", mp_property_time_pos},
@@ -3724,9 +3896,14 @@ static const struct m_property mp_properties_base[] = {
     {"cache-size", mp_property_cache_size},
     {"cache-idle", mp_property_cache_idle},
     {"cache-speed", mp_property_cache_speed},
+    {"cache-read-speed", mp_property_cache_read_speed},
+    {"cache-stats", mp_property_cache_stats},
+    {"cache-controller", mp_property_cache_controller},
+    {"cache-rebuffers", mp_property_cache_rebuffers},
     {"demuxer-cache-duration", mp_property_demuxer_cache_duration},
     {"demuxer-cache-time", mp_property_demuxer_cache_time},
     {"demuxer-cache-idle", mp_property_demuxer_cache_idle},
+    {"demuxer-cache-state", mp_property_demuxer_cache_state},
     {"cache-buffering-state", mp_property_cache_buffering},
     {"paused-for-cache", mp_property_paused_for_cache},
     {"clock", mp_property_clock},
@@ -3764,6 +3941,7 @@ static const struct m_property mp_properties_base[] = {
     {"audio-device", mp_property_audio_device},
     {"audio-device-list", mp_property_audio_devices},
     {"current-ao", mp_property_ao},
+    {"audio-underruns", mp_property_audio_underruns},
     {"audio-out-detected-device", mp_property_ao_detected_device},
 
     // Video
@@ -3895,6 +4073,8 @@ static const struct m_property mp_properties_base[] = {
     {"file-local-options", mp_property_local_options},
     {"option-info", mp_property_option_info},
     {"property-list", mp_property_list},
+    {"property-reads-avoided", mp_property_reads_avoided},
+    {"log-messages-dropped", mp_property_log_dropped},
     {"profile-list", mp_profile_list},
 
     M_PROPERTY_ALIAS("video", "vid"),
@@ -3926,10 +4106,9 @@ static const char *const *const mp_event_property_change[] = {
     E(MPV_EVENT_UNPAUSE, "pause", "paused-on-cache", "core-idle", "eof-reached"),
     E(MPV_EVENT_TICK, "time-pos", "stream-pos", "stream-time-pos", "avsync",
       "percent-pos", "time-remaining", "playtime-remaining", "playback-time",
-      "estimated-vf-fps", "drop-frame-count", "vo-drop-frame-count",
-      "total-avsync-change", "audio-speed-correction", "video-speed-correction",
-      "vo-delayed-frame-count", "mistimed-frame-count", "vsync-ratio",
-      "estimated-display-fps", "vsync-jitter", "sub-text"),
+      "estimated-vf-fps", "total-avsync-change", "audio-speed-correction",
+      "video-speed-correction", "vsync-ratio", "estimated-display-fps",
+      "vsync-jitter", "sub-text"),
     E(MPV_EVENT_VIDEO_RECONFIG, "video-out-params", "video-params",
       "video-format", "video-codec", "video-bitrate", "dwidth", "dheight",
       "width", "height", "fps", "aspect", "vo-configured", "current-vo",
@@ -3937,7 +4116,7 @@ static const char *const *const mp_event_property_change[] = {
       "colormatrix-output-range", "colormatrix-primaries", "video-aspect"),
     E(MPV_EVENT_AUDIO_RECONFIG, "audio-format", "audio-codec", "audio-bitrate",
       "samplerate", "channels", "audio", "volume", "mute", "balance",
-      "current-ao", "audio-codec-name", "audio-params",
+      "current-ao", "audio-codec-name", "audio-params", "audio-underruns",
       "audio-out-params", "volume-max", "mixer-active"),
     E(MPV_EVENT_SEEK, "seeking", "core-idle", "eof-reached"),
     E(MPV_EVENT_PLAYBACK_RESTART, "seeking", "core-idle", "eof-reached"),
@@ -3946,6 +4125,9 @@ static const char *const *const mp_event_property_change[] = {
     E(MP_EVENT_CACHE_UPDATE, "cache", "cache-free", "cache-used", "cache-idle",
       "demuxer-cache-duration", "demuxer-cache-idle", "paused-for-cache",
       "demuxer-cache-time", "cache-buffering-state", "cache-speed",
+      "cache-read-speed", "cache-stats", "cache-controller",
+      "cache-rebuffers",
+      "demuxer-cache-state",
       "cache-percent"),
     E(MP_EVENT_WIN_RESIZE, "window-scale", "osd-width", "osd-height", "osd-par"),
     E(MP_EVENT_WIN_STATE, "window-minimized", "display-names", "display-fps",
@@ -3990,11 +4172,63 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    for (int n = 0; ctx->properties[n].name; n++) {
-        if (match_property(ctx->properties[n].name, name))
-            return n;
+    bstr base = bstr0(name);
+    int sep = bstrchr(base, '/');
+    if (sep >= 0)
+        base = bstr_splice(base, 0, sep);
+    return m_property_index_lookup(ctx->properties_index, base);
+}
+
+static void init_event_property_ids(struct MPContext *mpctx)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    ctx->num_event_ids = MP_ARRAY_SIZE(mp_event_property_change);
+    ctx->event_ids = talloc_zero_array(ctx, struct event_property_ids,
+                                       ctx->num_event_ids);
+    for (int n = 0; n < ctx->num_event_ids; n++) {
+        struct event_property_ids *e = &ctx->event_ids[n];
+        const char *const *const list = mp_event_property_change[n];
+        int num = 0;
+        for (int i = 0; list && list[i]; i++) {
+            if (strcmp(list[i], "*") == 0) {
+                e->all = true;
+                continue;
+            }
+            int id = mp_get_property_id(mpctx, list[i]);
+            if (id >= 0)
+                MP_TARRAY_APPEND(ctx, e->ids, num, id);
+        }
+        MP_TARRAY_APPEND(ctx, e->ids, num, -1);
+    }
+}
+
+// Return the IDs (as in mp_get_property_id()) of the properties the event
+// (possibly) changes, terminated with -1. Returns NULL if the event can change
+// any property. The returned array is immutable, and valid until the player
+// is destroyed.
+const int *mp_get_event_property_ids(struct MPContext *mpctx, int event)
+{
+    static const int none[] = {-1};
+    struct command_ctx *ctx = mpctx->command_ctx;
+    if (event < 0 || event >= ctx->num_event_ids)
+        return none;
+    struct event_property_ids *e = &ctx->event_ids[event];
+    return e->all ? NULL : e->ids;
+}
+
+// Notify the frame counter properties whose values changed. The counters are
+// updated by the decoder and VO threads, which can't notify properties
+// themselves; this is called on each MPV_EVENT_TICK instead.
+static void update_frame_counters(struct MPContext *mpctx)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    for (int n = 0; n < NUM_FRAME_COUNTERS; n++) {
+        int val = get_frame_counter(mpctx, n);
+        if (val != ctx->frame_counters[n]) {
+            ctx->frame_counters[n] = val;
+            mp_notify_property(mpctx, frame_counter_props[n]);
+        }
     }
-    return -1;
 }
 
 static bool is_property_set(int action, void *val)
@@ -4018,7 +4252,8 @@ int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
     struct command_ctx *cmd = ctx->command_ctx;
-    int r = m_property_do(ctx->log, cmd->properties, name, action, val, ctx);
+    int r = m_property_do(ctx->log, cmd->properties_index, name, action, val,
+                          ctx);
     if (r == M_PROPERTY_OK && is_property_set(action, val))
         mp_notify_property(ctx, (char *)name);
     if (mp_msg_test(ctx->log, MSGL_V) && is_property_set(action, val)) {
@@ -4044,7 +4279,7 @@ int mp_property_do(const char *name, int action, void *val,
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    return m_properties_expand_string(ctx->properties, str, mpctx);
+    return m_properties_expand_string(ctx->properties_index, str, mpctx);
 }
 
 // Before expanding properties, parse C-style escapes like "\n"
@@ -4959,8 +5194,9 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
             playlist_append_entries(mpctx->playlist, pl);
             talloc_free(pl);
 
-            if (!append && mpctx->playlist->first)
-                mp_set_playlist_entry(mpctx, new ? new : mpctx->playlist->first);
+            struct playlist_entry *first = playlist_get_first(mpctx->playlist);
+            if (!append && first)
+                mp_set_playlist_entry(mpctx, new ? new : first);
 
             mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
         } else {
@@ -4974,14 +5210,11 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
         // Supposed to clear the playlist, except the currently played item.
         if (mpctx->playlist->current_was_replaced)
             mpctx->playlist->current = NULL;
-        while (mpctx->playlist->first) {
-            struct playlist_entry *e = mpctx->playlist->first;
-            if (e == mpctx->playlist->current) {
-                e = e->next;
-                if (!e)
-                    break;
-            }
-            playlist_remove(mpctx->playlist, e);
+        // Remove from the end, which doesn't need to shift the other entries.
+        for (int n = mpctx->playlist->num_entries - 1; n >= 0; n--) {
+            struct playlist_entry *e = mpctx->playlist->entries[n];
+            if (e != mpctx->playlist->current)
+                playlist_remove(mpctx->playlist, e);
         }
         mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
         break;
@@ -5425,6 +5658,12 @@ void command_init(struct MPContext *mpctx)
 
         ctx->properties[count++] = prop;
     }
+
+    ctx->properties_index = m_property_index_create(ctx, ctx->properties);
+
+    init_event_property_ids(mpctx);
+    for (int n = 0; n < NUM_FRAME_COUNTERS; n++)
+        ctx->frame_counters[n] = -1;
 }
 
 static void command_event(struct MPContext *mpctx, int event, void *arg)
@@ -5436,6 +5675,9 @@ static void command_event(struct MPContext *mpctx, int event, void *arg)
         ctx->marked_pts = MP_NOPTS_VALUE;
     }
 
+    if (event == MPV_EVENT_TICK)
+        update_frame_counters(mpctx);
+
     if (event == MPV_EVENT_IDLE)
         ctx->is_idle = true;
     if (event == MPV_EVENT_START_FILE)
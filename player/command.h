@@ -42,6 +42,7 @@ void handle_command_updates(struct MPContext *mpctx);
 
 int mp_get_property_id(struct MPContext *mpctx, const char *name);
 uint64_t mp_get_property_event_mask(const char *name);
+const int *mp_get_event_property_ids(struct MPContext *mpctx, int event);
 
 enum {
     // Must start with the first unused positive value in enum mpv_event_id
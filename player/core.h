@@ -25,6 +25,7 @@
 
 #include "common/common.h"
 #include "options/options.h"
+#include "osdep/atomics.h"
 #include "sub/osd.h"
 #include "audio/audio.h"
 #include "video/mp_image.h"
@@ -281,6 +282,15 @@ typedef struct MPContext {
     struct demuxer *demuxer;
     struct mp_tags *filtered_tags;
 
+    // Opening the next playlist entry ahead of time (--prefetch-playlist).
+    pthread_t open_thread;
+    bool open_active;           // open_thread was started and not joined yet
+    atomic_bool open_done;      // open_thread has finished
+    struct demux_open_args *open_args; // owned by open_thread until open_done
+    struct mp_cancel *open_cancel; // moved to demuxer_cancel on use
+    // Cancel object of the prefetched demuxer in use; slave of playback_abort.
+    struct mp_cancel *demuxer_cancel;
+
     struct track **tracks;
     int num_tracks;
 
@@ -409,6 +419,10 @@ typedef struct MPContext {
     bool paused_for_cache;
     double cache_stop_time, cache_wait_time;
     int cache_buffer;
+    // Number of times playback was paused for cache, and the total time spent
+    // waiting (current file only).
+    int cache_rebuffers;
+    double cache_rebuffer_time;
 
     // Set after showing warning about decoding being too slow for realtime
     // playback rate. Used to avoid showing it multiple times.
@@ -423,6 +437,7 @@ typedef struct MPContext {
     struct mp_ipc_ctx *ipc_ctx;
 
     struct mpv_opengl_cb_context *gl_cb_ctx;
+    struct mpv_sw_cb_context *sw_cb_ctx;
 } MPContext;
 
 // audio.c
@@ -474,6 +489,7 @@ void print_track_list(struct MPContext *mpctx, const char *msg);
 void reselect_demux_stream(struct MPContext *mpctx, struct track *track);
 void prepare_playlist(struct MPContext *mpctx, struct playlist *pl);
 void autoload_external_files(struct MPContext *mpctx);
+void prefetch_next(struct MPContext *mpctx);
 struct track *select_default_track(struct MPContext *mpctx, int order,
                                    enum stream_type type);
 
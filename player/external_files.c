@@ -1,4 +1,3 @@
-#include <dirent.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
@@ -10,6 +9,7 @@
 #include "common/global.h"
 #include "common/msg.h"
 #include "misc/ctype.h"
+#include "misc/dir_scan.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "external_files.h"
@@ -85,17 +85,43 @@ static struct bstr guess_lang_from_filename(struct bstr name)
     return (struct bstr){name.start + i + 1, n};
 }
 
+struct search_dir {
+    char *path;
+    int limit_fuzziness;
+    int limit_type;
+};
+
+struct scan_ctx {
+    struct MPOpts *opts;
+    struct search_dir *dirs;
+};
+
+// Whether a file with this name is a candidate for append_dir_subtitles().
+// Avoids stat() calls on files of types that aren't searched for.
+static bool test_ext_name(void *p, int dir, const char *name)
+{
+    struct scan_ctx *ctx = p;
+    int type = test_ext(bstr_get_ext(bstr0(name)));
+    int limit_type = ctx->dirs[dir].limit_type;
+    if (limit_type >= 0 && limit_type != type)
+        return false;
+    switch (type) {
+    case STREAM_SUB:    return ctx->opts->sub_auto >= 0;
+    case STREAM_AUDIO:  return ctx->opts->audiofile_auto >= 0;
+    }
+    return false;
+}
+
 static void append_dir_subtitles(struct mpv_global *global,
                                  struct subfn **slist, int *nsub,
-                                 struct bstr path, const char *fname,
-                                 int limit_fuzziness, int limit_type)
+                                 struct search_dir *dir,
+                                 struct mp_dir_listing *list,
+                                 const char *fname)
 {
     void *tmpmem = talloc_new(NULL);
     struct MPOpts *opts = global->opts;
     struct mp_log *log = mp_log_new(tmpmem, global->log, "find_files");
-
-    if (mp_is_url(bstr0(fname)))
-        goto out;
+    struct bstr path = bstr0(dir->path);
 
     struct bstr f_fname = bstr0(mp_basename(fname));
     struct bstr f_fname_noext = bstrdup(tmpmem, bstr_strip_ext(f_fname));
@@ -106,14 +132,10 @@ static void append_dir_subtitles(struct mpv_global *global,
     // 1 = any subtitle file
     // 2 = any sub file containing movie name
     // 3 = sub file containing movie name and the lang extension
-    char *path0 = bstrdup0(tmpmem, path);
-    DIR *d = opendir(path0);
-    if (!d)
-        goto out;
-    mp_verbose(log, "Loading external files in %.*s\n", BSTR_P(path));
-    struct dirent *de;
-    while ((de = readdir(d))) {
-        struct bstr dename = bstr0(de->d_name);
+    if (list->num_entries)
+        mp_verbose(log, "Loading external files in %.*s\n", BSTR_P(path));
+    for (int i = 0; i < list->num_entries; i++) {
+        struct bstr dename = bstr0(list->entries[i].name);
         void *tmpmem2 = talloc_new(tmpmem);
 
         // retrieve various parts of the filename
@@ -137,7 +159,7 @@ static void append_dir_subtitles(struct mpv_global *global,
             break;
         }
 
-        if (fuzz < 0 || (limit_type >= 0 && limit_type != type))
+        if (fuzz < 0 || (dir->limit_type >= 0 && dir->limit_type != type))
             goto next_sub;
 
         // we have a (likely) subtitle file
@@ -164,39 +186,35 @@ static void append_dir_subtitles(struct mpv_global *global,
         if (!prio) {
             // doesn't contain the movie name
             // don't try in the mplayer subtitle directory
-            if (!limit_fuzziness && fuzz >= 2) {
+            if (!dir->limit_fuzziness && fuzz >= 2) {
                 prio = 1;
             }
         }
 
-        mp_dbg(log, "Potential external file: \"%s\"  Priority: %d\n",
-               de->d_name, prio);
+        mp_dbg(log, "Potential external file: \"%.*s\"  Priority: %d\n",
+               BSTR_P(dename), prio);
 
         if (prio) {
             prio += prio;
+            // The scan only lists files which exist.
             char *subpath = mp_path_join_bstr(*slist, path, dename);
-            if (mp_path_exists(subpath)) {
-                MP_TARRAY_GROW(NULL, *slist, *nsub);
-                struct subfn *sub = *slist + (*nsub)++;
-
-                // annoying and redundant
-                if (strncmp(subpath, "./", 2) == 0)
-                    subpath += 2;
-
-                sub->type     = type;
-                sub->priority = prio;
-                sub->fname    = subpath;
-                sub->lang     = found_lang;
-            } else
-                talloc_free(subpath);
+            MP_TARRAY_GROW(NULL, *slist, *nsub);
+            struct subfn *sub = *slist + (*nsub)++;
+
+            // annoying and redundant
+            if (strncmp(subpath, "./", 2) == 0)
+                subpath += 2;
+
+            sub->type     = type;
+            sub->priority = prio;
+            sub->fname    = subpath;
+            sub->lang     = found_lang;
         }
 
     next_sub:
         talloc_free(tmpmem2);
     }
-    closedir(d);
 
- out:
     talloc_free(tmpmem);
 }
 
@@ -227,47 +245,75 @@ static void filter_subidx(struct subfn **slist, int *nsub)
     }
 }
 
-static void load_paths(struct mpv_global *global, struct subfn **slist,
-                       int *nsubs, const char *fname, char **paths,
-                       char *cfg_path, int type)
+static void add_dir(void *ta_parent, struct search_dir **dirs, int *num_dirs,
+                    char *path, int limit_fuzziness, int limit_type)
+{
+    struct search_dir dir = {
+        .path = path,
+        .limit_fuzziness = limit_fuzziness,
+        .limit_type = limit_type,
+    };
+    MP_TARRAY_APPEND(ta_parent, *dirs, *num_dirs, dir);
+}
+
+static void add_paths(struct mpv_global *global, void *ta_parent,
+                      struct search_dir **dirs, int *num_dirs,
+                      const char *fname, char **paths, char *cfg_path, int type)
 {
     for (int i = 0; paths && paths[i]; i++) {
-        char *path = mp_path_join_bstr(*slist, mp_dirname(fname),
+        char *path = mp_path_join_bstr(ta_parent, mp_dirname(fname),
                                        bstr0(paths[i]));
-        append_dir_subtitles(global, slist, nsubs, bstr0(path), fname, 0, type);
+        add_dir(ta_parent, dirs, num_dirs, path, 0, type);
     }
 
     // Load subtitles in ~/.mpv/sub (or similar) limiting sub fuzziness
-    char *mp_subdir = mp_find_config_file(NULL, global, cfg_path);
-    if (mp_subdir) {
-        append_dir_subtitles(global, slist, nsubs, bstr0(mp_subdir), fname, 1,
-                             type);
-    }
-    talloc_free(mp_subdir);
+    char *mp_subdir = mp_find_config_file(ta_parent, global, cfg_path);
+    if (mp_subdir)
+        add_dir(ta_parent, dirs, num_dirs, mp_subdir, 1, type);
 }
 
 // Return a list of subtitles and audio files found, sorted by priority.
 // Last element is terminated with a fname==NULL entry.
-struct subfn *find_external_files(struct mpv_global *global, const char *fname)
+// All directories are scanned in parallel; cancel can be NULL.
+struct subfn *find_external_files(struct mpv_global *global, const char *fname,
+                                  struct mp_cancel *cancel)
 {
     struct MPOpts *opts = global->opts;
     struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
     int n = 0;
 
-    // Load subtitles from current media directory
-    append_dir_subtitles(global, &slist, &n, mp_dirname(fname), fname, 0, -1);
+    void *tmp = talloc_new(NULL);
+    struct search_dir *dirs = NULL;
+    int num_dirs = 0;
 
-    // Load subtitles in dirs specified by sub-paths option
-    if (opts->sub_auto >= 0) {
-        load_paths(global, &slist, &n, fname, opts->sub_paths, "sub/",
-                   STREAM_SUB);
-    }
+    if (!mp_is_url(bstr0(fname))) {
+        // Load subtitles from current media directory
+        add_dir(tmp, &dirs, &num_dirs, bstrdup0(tmp, mp_dirname(fname)), 0, -1);
+
+        // Load subtitles in dirs specified by sub-paths option
+        if (opts->sub_auto >= 0) {
+            add_paths(global, tmp, &dirs, &num_dirs, fname, opts->sub_paths,
+                      "sub/", STREAM_SUB);
+        }
 
-    if (opts->audiofile_auto >= 0) {
-        load_paths(global, &slist, &n, fname, opts->audiofile_paths, "audio/",
-                   STREAM_AUDIO);
+        if (opts->audiofile_auto >= 0) {
+            add_paths(global, tmp, &dirs, &num_dirs, fname,
+                      opts->audiofile_paths, "audio/", STREAM_AUDIO);
+        }
     }
 
+    char **paths = talloc_array(tmp, char *, num_dirs);
+    for (int i = 0; i < num_dirs; i++)
+        paths[i] = dirs[i].path;
+    struct mp_dir_listing *lists =
+        mp_scan_dirs(tmp, cancel, paths, num_dirs, test_ext_name,
+                     &(struct scan_ctx){ .opts = opts, .dirs = dirs });
+
+    for (int i = 0; i < num_dirs; i++)
+        append_dir_subtitles(global, &slist, &n, &dirs[i], &lists[i], fname);
+
+    talloc_free(tmp);
+
     // Sort by name for filter_subidx()
     qsort(slist, n, sizeof(*slist), compare_sub_filename);
 
@@ -28,6 +28,7 @@
 
 #include "osdep/io.h"
 #include "osdep/terminal.h"
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 
 #include "common/msg.h"
@@ -80,6 +81,8 @@ static void uninit_demuxer(struct MPContext *mpctx)
 
     free_demuxer_and_stream(mpctx->demuxer);
     mpctx->demuxer = NULL;
+    talloc_free(mpctx->demuxer_cancel);
+    mpctx->demuxer_cancel = NULL;
 }
 
 #define APPEND(s, ...) mp_snprintf_cat(s, sizeof(s), __VA_ARGS__)
@@ -620,7 +623,8 @@ void autoload_external_files(struct MPContext *mpctx)
                                     &stream_filename) > 0)
             base_filename = talloc_steal(tmp, stream_filename);
     }
-    struct subfn *list = find_external_files(mpctx->global, base_filename);
+    struct subfn *list = find_external_files(mpctx->global, base_filename,
+                                             mpctx->playback_abort);
     talloc_steal(tmp, list);
 
     int sc[STREAM_TYPE_COUNT] = {0};
@@ -674,14 +678,14 @@ void prepare_playlist(struct MPContext *mpctx, struct playlist *pl)
         pl->current = mp_check_playlist_resume(mpctx, pl);
 
     if (!pl->current)
-        pl->current = pl->first;
+        pl->current = playlist_get_first(pl);
 }
 
 // Replace the current playlist entry with playlist contents. Moves the entries
 // from the given playlist pl, so the entries don't actually need to be copied.
 static void transfer_playlist(struct MPContext *mpctx, struct playlist *pl)
 {
-    if (pl->first) {
+    if (pl->num_entries) {
         prepare_playlist(mpctx, pl);
         struct playlist_entry *new = pl->current;
         if (mpctx->playlist->current)
@@ -806,6 +810,137 @@ static void open_demux_thread(void *pctx)
         demux_set_ts_offset(args->demux, -args->demux->start_time);
 }
 
+static void *open_prefetch_thread(void *p)
+{
+    struct MPContext *mpctx = p;
+    mpthread_set_name("prefetch");
+    open_demux_thread(mpctx->open_args);
+    atomic_store(&mpctx->open_done, true);
+    mp_input_wakeup(mpctx->input); // this interrupts mp_idle()
+    return NULL;
+}
+
+static struct demux_open_args *join_open(struct MPContext *mpctx)
+{
+    assert(mpctx->open_active);
+    pthread_join(mpctx->open_thread, NULL);
+    mpctx->open_active = false;
+    struct demux_open_args *args = mpctx->open_args;
+    mpctx->open_args = NULL;
+    return args;
+}
+
+static void cancel_open(struct MPContext *mpctx)
+{
+    if (!mpctx->open_active)
+        return;
+    mp_cancel_trigger(mpctx->open_cancel);
+    struct demux_open_args *args = join_open(mpctx);
+    free_demuxer_and_stream(args->demux);
+    talloc_free(args->global);
+    talloc_free(args);
+    mp_cancel_reset(mpctx->open_cancel);
+}
+
+// Start opening the next playlist entry in the background, if playback of the
+// current file is about to end. The demuxer is picked up by
+// open_demux_reentrant() if the next file is really the prefetched one.
+void prefetch_next(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    if (!opts->prefetch_open || mpctx->open_active || !mpctx->playing ||
+        !mpctx->playback_initialized || mpctx->stop_play || opts->loop_file)
+        return;
+
+    double len = get_time_length(mpctx);
+    double pos = get_playback_time(mpctx);
+    double end = get_play_end_pts(mpctx);
+    if (end != MP_NOPTS_VALUE && (len < 0 || end < len))
+        len = end;
+    if (len < 0 || pos == MP_NOPTS_VALUE || len - pos > opts->prefetch_secs)
+        return;
+
+    // Don't use mp_next_file(), which can mutate the playlist. Entries with
+    // per-file options are skipped, because the file would be opened with the
+    // options of the current file.
+    struct playlist_entry *next = playlist_get_next(mpctx->playlist, +1);
+    if (!next || !next->filename || next->num_params ||
+        mpctx->playing->num_params || next == mpctx->playing)
+        return;
+
+    if (!mpctx->open_cancel)
+        mpctx->open_cancel = mp_cancel_new(mpctx);
+
+    struct demux_open_args *args = talloc_ptrtype(NULL, args);
+    *args = (struct demux_open_args){
+        .global = create_sub_global(mpctx),
+        .cancel = mpctx->open_cancel,
+        .log = mpctx->log,
+        .stream_flags = next->stream_flags,
+        .url = talloc_strdup(args, next->filename),
+    };
+    if (opts->load_unsafe_playlists)
+        args->stream_flags = 0;
+
+    mpctx->open_args = args;
+    atomic_store(&mpctx->open_done, false);
+    if (pthread_create(&mpctx->open_thread, NULL, open_prefetch_thread, mpctx)) {
+        talloc_free(args->global);
+        talloc_free(args);
+        mpctx->open_args = NULL;
+        return;
+    }
+    mpctx->open_active = true;
+
+    MP_VERBOSE(mpctx, "Prefetching %s\n", next->filename);
+}
+
+// Return the prefetched demuxer for the given URL, if it matches. Waits until
+// prefetching is done. Discards the prefetched file if it doesn't match.
+static bool use_prefetched(struct MPContext *mpctx, char *url, int stream_flags,
+                           struct demux_open_args *res)
+{
+    if (!mpctx->open_active)
+        return false;
+    struct demux_open_args *pre = mpctx->open_args;
+    if (strcmp(pre->url, url) != 0 || pre->stream_flags != stream_flags) {
+        MP_VERBOSE(mpctx, "Discarding prefetched file.\n");
+        cancel_open(mpctx);
+        return false;
+    }
+
+    if (!atomic_load(&mpctx->open_done))
+        MP_VERBOSE(mpctx, "Waiting for prefetched file.\n");
+    while (!atomic_load(&mpctx->open_done)) {
+        mp_idle(mpctx);
+
+        if (mpctx->stop_play)
+            mp_cancel_trigger(mpctx->open_cancel);
+    }
+
+    if (!pre->demux) {
+        // Possibly a transient network error; try again normally.
+        cancel_open(mpctx);
+        return false;
+    }
+
+    join_open(mpctx);
+    *res = *pre;
+    talloc_free(pre);
+
+    // The demuxer is bound to the cancel object it was opened with. Keep it
+    // until the demuxer is closed, and make it abort along with
+    // playback_abort (which other threads may access, so it's never replaced).
+    // The next prefetch creates a new one.
+    assert(!mpctx->demuxer_cancel);
+    mpctx->demuxer_cancel = mpctx->open_cancel;
+    mpctx->open_cancel = NULL;
+    mp_cancel_set_parent(mpctx->demuxer_cancel, mpctx->playback_abort);
+
+    MP_VERBOSE(mpctx, "Using prefetched file.\n");
+    return true;
+}
+
 static void open_demux_reentrant(struct MPContext *mpctx)
 {
     struct demux_open_args args = {
@@ -817,7 +952,14 @@ static void open_demux_reentrant(struct MPContext *mpctx)
     };
     if (mpctx->opts->load_unsafe_playlists)
         args.stream_flags = 0;
-    mpctx_run_reentrant(mpctx, open_demux_thread, &args);
+    struct demux_open_args pre;
+    if (use_prefetched(mpctx, args.url, args.stream_flags, &pre)) {
+        talloc_free(args.global);
+        args.global = pre.global;
+        args.demux = pre.demux;
+    } else {
+        mpctx_run_reentrant(mpctx, open_demux_thread, &args);
+    }
     if (args.demux) {
         talloc_steal(args.demux, args.global);
         mpctx->demuxer = args.demux;
@@ -961,6 +1103,8 @@ static void play_current_file(struct MPContext *mpctx)
     mpctx->paused = false;
     mpctx->paused_for_cache = false;
     mpctx->cache_buffer = -1;
+    mpctx->cache_rebuffers = 0;
+    mpctx->cache_rebuffer_time = 0;
     mpctx->playing_msg_shown = false;
     mpctx->max_frames = -1;
     mpctx->video_speed = mpctx->audio_speed = opts->playback_speed;
@@ -1032,8 +1176,8 @@ reopen_file:
             if (mpctx->demuxer->is_network)
                 entry_stream_flags |= STREAM_NETWORK_ONLY;
         }
-        for (struct playlist_entry *e = pl->first; e; e = e->next)
-            e->stream_flags |= entry_stream_flags;
+        for (int n = 0; n < pl->num_entries; n++)
+            pl->entries[n]->stream_flags |= entry_stream_flags;
         transfer_playlist(mpctx, pl);
         mp_notify_property(mpctx, "playlist");
         mpctx->error_playing = 2;
@@ -1259,31 +1403,30 @@ struct playlist_entry *mp_next_file(struct MPContext *mpctx, int direction,
     if (next && direction < 0 && !force) {
         // Don't jump to files that would immediately go to next file anyway
         while (next && next->playback_short)
-            next = next->prev;
+            next = playlist_entry_get_rel(next, -1);
         // Always allow jumping to first file
         if (!next && mpctx->opts->loop_times == 1)
-            next = mpctx->playlist->first;
+            next = playlist_get_first(mpctx->playlist);
     }
     if (!next && mpctx->opts->loop_times != 1) {
         if (direction > 0) {
             if (mpctx->opts->shuffle)
                 playlist_shuffle(mpctx->playlist);
-            next = mpctx->playlist->first;
+            next = playlist_get_first(mpctx->playlist);
             if (next && mpctx->opts->loop_times > 1)
                 mpctx->opts->loop_times--;
         } else {
-            next = mpctx->playlist->last;
+            next = playlist_get_last(mpctx->playlist);
             // Don't jump to files that would immediately go to next file anyway
             while (next && next->playback_short)
-                next = next->prev;
+                next = playlist_entry_get_rel(next, -1);
         }
         bool ignore_failures = mpctx->opts->loop_times == -2;
         if (!force && next && next->init_failed && !ignore_failures) {
             // Don't endless loop if no file in playlist is playable
             bool all_failed = true;
-            struct playlist_entry *cur;
-            for (cur = mpctx->playlist->first; cur; cur = cur->next) {
-                all_failed &= cur->init_failed;
+            for (int n = 0; n < mpctx->playlist->num_entries; n++) {
+                all_failed &= mpctx->playlist->entries[n]->init_failed;
                 if (!all_failed)
                     break;
             }
@@ -1321,6 +1464,8 @@ void mp_play_files(struct MPContext *mpctx)
         if (!mpctx->playlist->current && mpctx->opts->player_idle_mode < 2)
             break;
     }
+
+    cancel_open(mpctx);
 }
 
 // Abort current playback and set the given entry to play next.
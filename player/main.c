@@ -197,6 +197,9 @@ void mp_destroy(struct MPContext *mpctx)
     mpctx->ipc_ctx = NULL;
 #endif
 
+    // Before the clients go away, so they see the completion messages.
+    screenshot_uninit(mpctx);
+
     shutdown_clients(mpctx);
 
     uninit_audio_out(mpctx);
@@ -215,6 +218,8 @@ void mp_destroy(struct MPContext *mpctx)
 
     talloc_free(mpctx->gl_cb_ctx);
     mpctx->gl_cb_ctx = NULL;
+    talloc_free(mpctx->sw_cb_ctx);
+    mpctx->sw_cb_ctx = NULL;
 
     osd_free(mpctx->osd);
 
@@ -465,12 +470,13 @@ int mp_initialize(struct MPContext *mpctx, char **options)
     }
 
     if (opts->dump_stats && opts->dump_stats[0]) {
-        if (mp_msg_open_stats_file(mpctx->global, opts->dump_stats) < 0)
+        if (mp_msg_open_stats_file(mpctx->global, opts->dump_stats,
+                                   opts->dump_stats_binary) < 0)
             MP_ERR(mpctx, "Failed to open stats file '%s'\n", opts->dump_stats);
     }
     MP_STATS(mpctx, "start init");
 
-    if (!mpctx->playlist->first && !opts->player_idle_mode)
+    if (!mpctx->playlist->num_entries && !opts->player_idle_mode)
         return -3;
 
     mp_input_load(mpctx->input);
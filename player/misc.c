@@ -231,11 +231,12 @@ int stream_dump(struct MPContext *mpctx, const char *source_filename)
 
 void merge_playlist_files(struct playlist *pl)
 {
-    if (!pl->first)
+    if (!pl->num_entries)
         return;
     char *edl = talloc_strdup(NULL, "edl://");
-    for (struct playlist_entry *e = pl->first; e; e = e->next) {
-        if (e != pl->first)
+    for (int n = 0; n < pl->num_entries; n++) {
+        struct playlist_entry *e = pl->entries[n];
+        if (n > 0)
             edl = talloc_strdup_append_buffer(edl, ";");
         // Escape if needed
         if (e->filename[strcspn(e->filename, "=%,;\n")] ||
@@ -251,18 +252,17 @@ void merge_playlist_files(struct playlist *pl)
     talloc_free(edl);
 }
 
-// Create a talloc'ed copy of mpctx->global. It contains a copy of the global
-// option struct. It still just references some things though, like mp_log.
-// The main purpose is letting threads access the option struct without the
-// need for additional synchronization.
+// Create a talloc'ed copy of mpctx->global. It contains a read-only snapshot
+// of the global option struct. It still just references some things though,
+// like mp_log. The main purpose is letting threads access the option struct
+// without the need for additional synchronization.
 struct mpv_global *create_sub_global(struct MPContext *mpctx)
 {
     struct mpv_global *new = talloc_ptrtype(NULL, new);
-    struct m_config *new_config = m_config_dup(new, mpctx->mconfig);
     *new = (struct mpv_global){
         .log = mpctx->global->log,
         .config = mpctx->global->config,
-        .opts = new_config->optstruct,
+        .opts = m_config_get_snapshot(new, mpctx->global),
         .client_api = mpctx->clients,
     };
     return new;
@@ -250,7 +250,7 @@ static void term_osd_print_status_lazy(struct MPContext *mpctx)
             }
             int64_t c = vo_get_drop_count(mpctx->video_out);
             struct dec_video *d_video = mpctx->vo_chain->video_src;
-            int dropped_frames = d_video ? d_video->dropped_frames : 0;
+            int dropped_frames = d_video ? video_get_dropped_frames(d_video) : 0;
             if (c > 0 || dropped_frames > 0) {
                 saddf(&line, " Dropped: %"PRId64, c);
                 if (dropped_frames)
@@ -49,6 +49,7 @@
 #include "core.h"
 #include "client.h"
 #include "command.h"
+#include "screenshot.h"
 
 // Wait until mp_input_wakeup(mpctx->input) is called, since the last time
 // mp_wait_events() was called. (But see mp_process_input().)
@@ -258,6 +259,15 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
         demux_flags = (demux_flags | SEEK_HR | SEEK_BACKWARD) & ~SEEK_FORWARD;
     }
 
+    // Decoder threads must not read packets while the demuxer is flushed.
+    // They are reset with reset_playback_state() below.
+    for (int n = 0; n < mpctx->num_tracks; n++) {
+        if (mpctx->tracks[n]->d_video)
+            video_suspend(mpctx->tracks[n]->d_video);
+        if (mpctx->tracks[n]->d_audio)
+            audio_suspend(mpctx->tracks[n]->d_audio);
+    }
+
     demux_seek(mpctx->demuxer, demux_pts, demux_flags);
 
     // Seek external, extra files too:
@@ -531,6 +541,23 @@ static void handle_osd_redraw(struct MPContext *mpctx)
     mpctx->sleeptime = 0;
 }
 
+// How many seconds to buffer before unpausing after a cache underrun, if
+// --cache-adaptive is enabled. If the source is slower than playback, the
+// buffered data drains at (1 - link_speed/bitrate) seconds per second of
+// playback, so buffering that much for --cache-adaptive-secs of playback
+// avoids rebuffering again during that time. If the source is fast enough,
+// the underrun was a hiccup, and resuming quickly is better.
+// Returns -1 if the rates are unknown.
+static double adaptive_cache_wait_time(struct MPOpts *opts,
+                                       struct stream_cache_info *c)
+{
+    if (!c->adaptive || c->bitrate <= 0 || c->link_speed <= 0)
+        return -1;
+    double ratio = c->link_speed / (double)c->bitrate;
+    double secs = opts->stream_cache.adaptive_secs;
+    return MPCLAMP(secs * (1 - ratio), 1, MPMAX(secs, 1));
+}
+
 static void handle_pause_on_low_cache(struct MPContext *mpctx)
 {
     bool force_update = false;
@@ -549,16 +576,22 @@ static void handle_pause_on_low_cache(struct MPContext *mpctx)
     int cache_buffer = 100;
 
     if (mpctx->restart_complete && c.size > 0) {
+        double adaptive_wait = adaptive_cache_wait_time(opts, &c);
         if (mpctx->paused && mpctx->paused_for_cache) {
+            if (adaptive_wait > 0)
+                mpctx->cache_wait_time = adaptive_wait;
             if (!opts->cache_pausing || s.ts_duration >= mpctx->cache_wait_time
                 || s.idle)
             {
                 double elapsed_time = now - mpctx->cache_stop_time;
-                if (elapsed_time > mpctx->cache_wait_time) {
-                    mpctx->cache_wait_time *= 1.5 + 0.1;
-                } else {
-                    mpctx->cache_wait_time /= 1.5 - 0.1;
+                if (adaptive_wait <= 0) {
+                    if (elapsed_time > mpctx->cache_wait_time) {
+                        mpctx->cache_wait_time *= 1.5 + 0.1;
+                    } else {
+                        mpctx->cache_wait_time /= 1.5 - 0.1;
+                    }
                 }
+                mpctx->cache_rebuffer_time += elapsed_time;
                 mpctx->paused_for_cache = false;
                 if (!opts->pause)
                     unpause_player(mpctx);
@@ -572,10 +605,12 @@ static void handle_pause_on_low_cache(struct MPContext *mpctx)
                 mpctx->paused_for_cache = true;
                 opts->pause = prev_paused_user;
                 mpctx->cache_stop_time = now;
+                mpctx->cache_rebuffers++;
                 force_update = true;
             }
         }
-        mpctx->cache_wait_time = MPCLAMP(mpctx->cache_wait_time, 1, 10);
+        if (adaptive_wait <= 0)
+            mpctx->cache_wait_time = MPCLAMP(mpctx->cache_wait_time, 1, 10);
         if (mpctx->paused_for_cache) {
             cache_buffer =
                 100 * MPCLAMP(s.ts_duration / mpctx->cache_wait_time, 0, 0.99);
@@ -814,6 +849,7 @@ int handle_force_window(struct MPContext *mpctx, bool force)
             .osd = mpctx->osd,
             .encode_lavc_ctx = mpctx->encode_lavc_ctx,
             .opengl_cb_context = mpctx->gl_cb_ctx,
+            .sw_cb_context = mpctx->sw_cb_ctx,
         };
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
         if (!mpctx->video_out)
@@ -1003,6 +1039,8 @@ void run_playloop(struct MPContext *mpctx)
     }
 #endif
 
+    MP_STATS(mpctx, "start playloop");
+
     update_demuxer_properties(mpctx);
 
     handle_complex_filter_decoders(mpctx);
@@ -1011,6 +1049,7 @@ void run_playloop(struct MPContext *mpctx)
     handle_vo_events(mpctx);
     handle_heartbeat_cmd(mpctx);
     handle_command_updates(mpctx);
+    screenshot_handle_done(mpctx);
 
     if (mpctx->lavfi) {
         if (lavfi_process(mpctx->lavfi))
@@ -1036,6 +1075,8 @@ void run_playloop(struct MPContext *mpctx)
 
     handle_loop_file(mpctx);
 
+    prefetch_next(mpctx);
+
     handle_keep_open(mpctx);
 
     handle_sstep(mpctx);
@@ -1043,6 +1084,8 @@ void run_playloop(struct MPContext *mpctx)
     if (mpctx->stop_play == AT_END_OF_FILE && mpctx->seek.type)
         mpctx->stop_play = KEEP_PLAYING;
 
+    MP_STATS(mpctx, "end playloop");
+
     if (mpctx->stop_play)
         return;
 
@@ -1069,6 +1112,7 @@ void mp_idle(struct MPContext *mpctx)
     mpctx->sleeptime = 100.0;
     mp_process_input(mpctx);
     handle_command_updates(mpctx);
+    screenshot_handle_done(mpctx);
     handle_cursor_autohide(mpctx);
     handle_vo_events(mpctx);
     update_osd_msg(mpctx);
@@ -15,9 +15,11 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "config.h"
 
@@ -27,8 +29,11 @@
 #include "screenshot.h"
 #include "core.h"
 #include "command.h"
+#include "client.h"
 #include "misc/bstr.h"
 #include "common/msg.h"
+#include "input/input.h"
+#include "misc/thread_pool.h"
 #include "options/path.h"
 #include "video/mp_image.h"
 #include "video/decode/dec_video.h"
@@ -49,8 +54,26 @@ typedef struct screenshot_ctx {
     bool osd;
 
     int frameno;
+
+    // Background writer (--screenshot-queue-size). Created on first use.
+    struct mp_thread_pool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // Jobs not yet reported on the playback thread. The list itself is only
+    // accessed by the playback thread; job->done/ok are protected by lock.
+    struct screenshot_job **jobs;
+    int num_jobs;
 } screenshot_ctx;
 
+struct screenshot_job {
+    screenshot_ctx *ctx;
+    struct mp_image *image;         // owned by the worker until done is set
+    struct image_writer_opts opts;  // format is a private copy
+    char *filename;
+    bool osd;
+    bool done, ok;
+};
+
 void screenshot_init(struct MPContext *mpctx)
 {
     mpctx->screenshot_ctx = talloc(mpctx, screenshot_ctx);
@@ -58,6 +81,8 @@ void screenshot_init(struct MPContext *mpctx)
         .mpctx = mpctx,
         .frameno = 1,
     };
+    pthread_mutex_init(&mpctx->screenshot_ctx->lock, NULL);
+    pthread_cond_init(&mpctx->screenshot_ctx->wakeup, NULL);
 }
 
 #define SMSG_OK 0
@@ -83,6 +108,40 @@ static void screenshot_msg(screenshot_ctx *ctx, int status, const char *msg,
     talloc_free(s);
 }
 
+// Tell clients that a screenshot write has finished.
+static void send_written_event(struct MPContext *mpctx, const char *filename,
+                               bool ok)
+{
+    const char *args[] = {"screenshot-written", filename, ok ? "yes" : "no"};
+    mpv_event_client_message event = {
+        .num_args = MP_ARRAY_SIZE(args),
+        .args = args,
+    };
+    mp_client_broadcast_event(mpctx, MPV_EVENT_CLIENT_MESSAGE, &event);
+}
+
+static void report_write(screenshot_ctx *ctx, const char *filename, bool ok,
+                         bool osd)
+{
+    if (!ok) {
+        bool old_osd = ctx->osd;
+        ctx->osd = osd;
+        screenshot_msg(ctx, SMSG_ERR, "Error writing screenshot '%s'!",
+                       filename);
+        ctx->osd = old_osd;
+    }
+    send_written_event(ctx->mpctx, filename, ok);
+}
+
+static bool is_job_filename(screenshot_ctx *ctx, const char *filename)
+{
+    for (int n = 0; n < ctx->num_jobs; n++) {
+        if (strcmp(ctx->jobs[n]->filename, filename) == 0)
+            return true;
+    }
+    return false;
+}
+
 static char *stripext(void *talloc_ctx, const char *s)
 {
     const char *end = strrchr(s, '.');
@@ -293,7 +352,8 @@ static char *gen_fname(screenshot_ctx *ctx, const char *file_ext)
             talloc_free(t);
         }
 
-        if (!mp_path_exists(fname))
+        // Files still being written by the background writer don't exist yet.
+        if (!mp_path_exists(fname) && !is_job_filename(ctx, fname))
             return fname;
 
         if (sequence == prev_sequence) {
@@ -314,6 +374,106 @@ static void add_subs(struct MPContext *mpctx, struct mp_image *image)
                       OSD_DRAW_SUB_ONLY, image);
 }
 
+// Runs on a pool thread.
+static void write_job(void *arg)
+{
+    struct screenshot_job *job = arg;
+    screenshot_ctx *ctx = job->ctx;
+
+    bool ok = write_image(job->image, &job->opts, job->filename,
+                          ctx->mpctx->log);
+    talloc_free(job->image);
+    job->image = NULL;
+
+    pthread_mutex_lock(&ctx->lock);
+    job->ok = ok;
+    job->done = true;
+    pthread_cond_broadcast(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+
+    mp_input_wakeup(ctx->mpctx->input);
+}
+
+static int num_pending_jobs(screenshot_ctx *ctx)
+{
+    int pending = 0;
+    for (int n = 0; n < ctx->num_jobs; n++)
+        pending += !ctx->jobs[n]->done;
+    return pending;
+}
+
+// Report and free all finished jobs.
+void screenshot_handle_done(struct MPContext *mpctx)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+    if (!ctx || !ctx->num_jobs)
+        return;
+
+    struct screenshot_job **done = NULL;
+    int num_done = 0;
+
+    pthread_mutex_lock(&ctx->lock);
+    for (int n = ctx->num_jobs - 1; n >= 0; n--) {
+        if (ctx->jobs[n]->done) {
+            MP_TARRAY_INSERT_AT(NULL, done, num_done, 0, ctx->jobs[n]);
+            MP_TARRAY_REMOVE_AT(ctx->jobs, ctx->num_jobs, n);
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    for (int n = 0; n < num_done; n++) {
+        struct screenshot_job *job = done[n];
+        report_write(ctx, job->filename, job->ok, job->osd);
+        talloc_free(job);
+    }
+    talloc_free(done);
+}
+
+// Block until fewer than max writes are in flight. This is the backpressure
+// for each-frame mode: playback slows down instead of queuing frames without
+// bound.
+static void wait_queue(screenshot_ctx *ctx, int max)
+{
+    pthread_mutex_lock(&ctx->lock);
+    while (num_pending_jobs(ctx) >= max)
+        pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+// Takes ownership of the image. Returns false if no writer thread is
+// available, in which case the image is left to the caller.
+static bool queue_write(screenshot_ctx *ctx, struct mp_image *image,
+                        const struct image_writer_opts *opts,
+                        const char *filename)
+{
+    struct MPOpts *mopts = ctx->mpctx->opts;
+
+    if (!ctx->pool) {
+        ctx->pool = mp_thread_pool_create(ctx, mopts->screenshot_threads);
+        if (!ctx->pool)
+            return false;
+    }
+
+    wait_queue(ctx, mopts->screenshot_queue_size);
+    screenshot_handle_done(ctx->mpctx);
+
+    struct screenshot_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct screenshot_job){
+        .ctx = ctx,
+        .image = talloc_steal(job, image),
+        .opts = *opts,
+        .filename = talloc_strdup(job, filename),
+        .osd = ctx->osd,
+    };
+    job->opts.format = talloc_strdup(job, opts->format);
+
+    MP_TARRAY_APPEND(ctx, ctx->jobs, ctx->num_jobs, job);
+
+    mp_thread_pool_queue(ctx->pool, write_job, job);
+    return true;
+}
+
+// Takes ownership of the image.
 static void screenshot_save(struct MPContext *mpctx, struct mp_image *image)
 {
     screenshot_ctx *ctx = mpctx->screenshot_ctx;
@@ -323,10 +483,17 @@ static void screenshot_save(struct MPContext *mpctx, struct mp_image *image)
     char *filename = gen_fname(ctx, image_writer_file_ext(opts));
     if (filename) {
         screenshot_msg(ctx, SMSG_OK, "Screenshot: '%s'", filename);
-        if (!write_image(image, opts, filename, mpctx->log))
-            screenshot_msg(ctx, SMSG_ERR, "Error writing screenshot!");
+        if (mpctx->opts->screenshot_queue_size > 0 &&
+            queue_write(ctx, image, opts, filename))
+        {
+            image = NULL;
+        } else {
+            bool ok = write_image(image, opts, filename, mpctx->log);
+            report_write(ctx, filename, ok, ctx->osd);
+        }
         talloc_free(filename);
     }
+    talloc_free(image);
 }
 
 static struct mp_image *screenshot_get(struct MPContext *mpctx, int mode)
@@ -391,8 +558,8 @@ void screenshot_to_file(struct MPContext *mpctx, const char *filename, int mode,
         goto end;
     }
     screenshot_msg(ctx, SMSG_OK, "Screenshot: '%s'", filename);
-    if (!write_image(image, &opts, filename, mpctx->log))
-        screenshot_msg(ctx, SMSG_ERR, "Error writing screenshot!");
+    bool ok = write_image(image, &opts, filename, mpctx->log);
+    report_write(ctx, filename, ok, osd);
     talloc_free(image);
 
 end:
@@ -425,8 +592,6 @@ void screenshot_request(struct MPContext *mpctx, int mode, bool each_frame,
     } else {
         screenshot_msg(ctx, SMSG_ERR, "Taking screenshot failed.");
     }
-
-    talloc_free(image);
 }
 
 void screenshot_flip(struct MPContext *mpctx)
@@ -439,3 +604,21 @@ void screenshot_flip(struct MPContext *mpctx)
     ctx->each_frame = false;
     screenshot_request(mpctx, ctx->mode, true, ctx->osd);
 }
+
+void screenshot_uninit(struct MPContext *mpctx)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+    if (!ctx)
+        return;
+
+    // Waits for all queued writes.
+    talloc_free(ctx->pool);
+    ctx->pool = NULL;
+    screenshot_handle_done(mpctx);
+    assert(!ctx->num_jobs);
+
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+    talloc_free(ctx);
+    mpctx->screenshot_ctx = NULL;
+}
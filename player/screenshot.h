@@ -45,4 +45,10 @@ struct mp_image *screenshot_get_rgb(struct MPContext *mpctx, int mode);
 // Called by the playback core code when a new frame is displayed.
 void screenshot_flip(struct MPContext *mpctx);
 
+// Report screenshots finished by the background writer.
+void screenshot_handle_done(struct MPContext *mpctx);
+
+// Wait for pending background writes and free everything.
+void screenshot_uninit(struct MPContext *mpctx);
+
 #endif /* MPLAYER_SCREENSHOT_H */
@@ -462,6 +462,7 @@ int reinit_video_chain_src(struct MPContext *mpctx, struct lavfi_pad *src)
             .osd = mpctx->osd,
             .encode_lavc_ctx = mpctx->encode_lavc_ctx,
             .opengl_cb_context = mpctx->gl_cb_ctx,
+            .sw_cb_context = mpctx->sw_cb_ctx,
         };
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
         if (!mpctx->video_out) {
@@ -494,6 +495,11 @@ int reinit_video_chain_src(struct MPContext *mpctx, struct lavfi_pad *src)
         vo_c->container_fps = vo_c->video_src->fps;
         vo_c->is_coverart = !!sh->attached_picture;
 
+        if (opts->vd_queue_enable && !vo_c->is_coverart) {
+            video_start_thread(vo_c->video_src, opts->vd_queue_max_samples,
+                               wakeup_playloop, mpctx);
+        }
+
         track->vo_c = vo_c;
         vo_c->track = track;
     }
@@ -561,8 +567,8 @@ static bool check_framedrop(struct MPContext *mpctx, struct vo_chain *vo_c)
         double frame_time = fps > 0 ? 1.0 / fps : 0;
         // we should avoid dropping too many frames in sequence unless we
         // are too late. and we allow 100ms A-V delay here:
-        int dropped_frames =
-            vo_c->video_src->dropped_frames - mpctx->dropped_frames_start;
+        int dropped_frames = video_get_dropped_frames(vo_c->video_src) -
+                             mpctx->dropped_frames_start;
         if (mpctx->last_av_difference - 0.100 > dropped_frames * frame_time)
             return !!(opts->frame_dropping & 2);
     }
@@ -763,7 +769,7 @@ static void handle_new_frame(struct MPContext *mpctx)
     }
     struct dec_video *d_video = mpctx->vo_chain->video_src;
     if (d_video)
-        mpctx->dropped_frames_start = d_video->dropped_frames;
+        mpctx->dropped_frames_start = video_get_dropped_frames(d_video);
     MP_TRACE(mpctx, "frametime=%5.3f\n", frame_time);
 }
 
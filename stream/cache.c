@@ -32,6 +32,13 @@
 // the cache is active.
 #define CACHE_UPDATE_CONTROLS_TIME 2.0
 
+// Adaptive mode: minimum time the cache sleeps after the readahead target has
+// been reached. (The maximum is CACHE_IDLE_SLEEP_TIME.)
+#define CACHE_ADAPTIVE_MIN_SLEEP 0.05
+
+// Adaptive mode: size reads so that a single read takes about this long.
+#define CACHE_ADAPTIVE_READ_TIME 0.1
+
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,6 +56,7 @@
 
 #include "config.h"
 
+#include "osdep/atomics.h"
 #include "osdep/timer.h"
 #include "osdep/threads.h"
 
@@ -75,6 +83,10 @@ struct priv {
     int64_t seek_limit;     // keep filling cache if distance is less that seek limit
     bool seekable;          // underlying stream is seekable
 
+    // User-set sizes. resize_cache() derives the above from them.
+    int64_t opt_back_size;
+    int64_t opt_seek_limit;
+
     struct mp_log *log;
 
     // Owned by the main thread
@@ -98,15 +110,34 @@ struct priv {
     int64_t reads;          // number of actual read attempts performed
     int64_t speed_start;    // start time (us) for calculating download speed
     int64_t speed_amount;   // bytes read since speed_start
+    int64_t speed_busy;     // time (us) spent in read calls since speed_start
     double speed;
+    double link_speed;      // speed_amount / speed_busy (last non-idle window)
 
     bool enable_readahead;  // actively read beyond read() position
-    int64_t read_filepos;   // client read position (mirrors cache->pos)
     int64_t read_min;       // file position until which the thread should
                             // read even if readahead is disabled
+    int64_t fill_read_pos;  // read_filepos as seen by the last cache_fill()
+
+    int64_t total_fetched;  // statistics (see struct stream_cache_info)
+    int64_t waits;
+    int64_t read_speed;
+    int64_t speed_read_start; // total_read at speed_start
 
     int64_t eof_pos;
 
+    // Adaptive readahead (see adapt_readahead())
+    bool adaptive;
+    double adaptive_secs;
+    double bitrate;         // media bitrate in bytes/s, set by the demuxer
+    int64_t readahead_target;
+    int64_t read_size;
+    int64_t size_limit;     // readahead buffer size set by the user
+    int64_t resize_size;    // buffer size requested by adapt_readahead()
+    bool refilling;         // reading until readahead_target is reached
+    bool target_reached;    // idle because of readahead_target
+    double target_sleep;    // idle time until refilling is expected
+
     int control;            // requested STREAM_CTRL_... or CACHE_CTRL_...
     void *control_arg;      // temporary for executing STREAM_CTRLs
     int control_res;
@@ -118,6 +149,26 @@ struct priv {
     struct mp_tags *stream_metadata;
     double start_pts;
     bool has_avseek;
+
+    // The following members are accessed without holding the mutex. This
+    // makes the ring buffer a single-producer/single-consumer queue: the
+    // client can read and consume data between read_filepos and ring_end
+    // without locking, because the cache thread never overwrites it.
+
+    // Client read position (mirrors cache->pos). Written by the client, or
+    // by the cache thread while the client waits for it (seeks, controls).
+    atomic_llong read_filepos;
+    // max_filepos and offset, published by the cache thread after the buffer
+    // contents were written.
+    atomic_llong ring_end;
+    atomic_llong ring_offset;
+    // Set while the cache thread sleeps because the buffer is full.
+    atomic_bool thread_waiting;
+    // Set by the cache thread if the buffer should be resized. The client
+    // then lets it resize the buffer while it can't hold any borrowed data.
+    atomic_bool resize_wanted;
+    atomic_llong total_read;
+    atomic_llong total_borrowed;
 };
 
 enum {
@@ -125,6 +176,7 @@ enum {
     CACHE_CTRL_QUIT = -1,
     CACHE_CTRL_PING = -2,
     CACHE_CTRL_SEEK = -3,
+    CACHE_CTRL_RESIZE = -4,
 
     // we should fill buffer only if space>=FILL_LIMIT
     FILL_LIMIT = 16 * 1024,
@@ -152,12 +204,26 @@ static bool cache_wakeup_and_wait(struct priv *s, double *retry_time)
     return !mp_cancel_test(s->cache->cancel);
 }
 
+// Make the ring buffer state visible to the lock-free client path. Must be
+// called by the cache thread (with the mutex held) after writing to the
+// buffer, or after changing max_filepos or offset.
+static void publish_ring(struct priv *s)
+{
+    // The client loads ring_end first, so it never sees an offset older than
+    // the buffer contents. (Offsets differ only by multiples of buffer_size
+    // anyway, as long as the cache isn't dropped or resized, which happens
+    // only while the client waits.)
+    atomic_store(&s->ring_offset, s->offset);
+    atomic_store(&s->ring_end, s->max_filepos);
+}
+
 // Runs in the cache thread
 static void cache_drop_contents(struct priv *s)
 {
-    s->offset = s->min_filepos = s->max_filepos = s->read_filepos;
+    s->offset = s->min_filepos = s->max_filepos = atomic_load(&s->read_filepos);
     s->eof = false;
     s->start_pts = MP_NOPTS_VALUE;
+    publish_ring(s);
 }
 
 static void update_speed(struct priv *s)
@@ -165,7 +231,15 @@ static void update_speed(struct priv *s)
     int64_t now = mp_time_us();
     if (s->speed_start + 1000000 <= now) {
         s->speed = s->speed_amount * 1e6 / (now - s->speed_start);
+        // Keep the last value if the cache was idle during the whole window.
+        if (s->speed_busy > 0 && s->speed_amount > 0)
+            s->link_speed = s->speed_amount * 1e6 / s->speed_busy;
+        int64_t total_read = atomic_load(&s->total_read);
+        s->read_speed = (total_read - s->speed_read_start) * 1e6 /
+                        (now - s->speed_start);
+        s->speed_read_start = total_read;
         s->speed_amount = 0;
+        s->speed_busy = 0;
         s->speed_start = now;
     }
 }
@@ -204,9 +278,44 @@ static size_t read_buffer(struct priv *s, unsigned char *dst,
     return read;
 }
 
+// Return a pointer to the data at the absolute file position pos, and the
+// number of bytes that can be read from there without wrapping (at most
+// max_len). Returns 0 if pos is not cached.
+// The client can call this without holding the mutex, as long as
+// pos >= read_filepos (see the comment on read_filepos).
+static int ring_peek(struct priv *s, int64_t pos, unsigned char **data,
+                     int max_len)
+{
+    int64_t end = atomic_load(&s->ring_end);
+    int64_t offset = atomic_load(&s->ring_offset);
+    if (pos >= end)
+        return 0;
+    int64_t bpos = (pos - offset) % s->buffer_size; // file pos to buffer pos
+    if (bpos < 0)
+        bpos += s->buffer_size;
+    *data = &s->buffer[bpos];
+    return MPMIN(MPMIN(end - pos, s->buffer_size - bpos), max_len);
+}
+
+// Called by the client to consume data returned by ring_peek().
+static void ring_consume(struct priv *s, int len, bool borrowed)
+{
+    atomic_store(&s->read_filepos, atomic_load(&s->read_filepos) + len);
+    atomic_fetch_add(&s->total_read, len);
+    if (borrowed)
+        atomic_fetch_add(&s->total_borrowed, len);
+    // The cache thread might be waiting for free space. (It checks
+    // read_filepos after setting thread_waiting, so no wakeup is lost.)
+    if (atomic_load(&s->thread_waiting)) {
+        pthread_mutex_lock(&s->mutex);
+        pthread_cond_signal(&s->wakeup);
+        pthread_mutex_unlock(&s->mutex);
+    }
+}
+
 static bool cache_update_stream_position(struct priv *s)
 {
-    int64_t read = s->read_filepos;
+    int64_t read = atomic_load(&s->read_filepos);
 
     // drop cache contents only if seeking backward or too much fwd.
     // This is also done for on-disk files, since it loses the backseek cache.
@@ -229,10 +338,53 @@ static bool cache_update_stream_position(struct priv *s)
     return stream_tell(s->stream) == s->max_filepos;
 }
 
+// Recompute the adaptive readahead target and read size from the measured
+// source speed, and the rate at which data is consumed (the media bitrate as
+// reported by the demuxer, or else the measured client read speed). Request
+// a buffer resize if the buffer doesn't fit the target.
+// Runs in the cache thread.
+static void adapt_readahead(struct priv *s)
+{
+    int64_t limit = s->size_limit;
+    if (s->stream_size > 0)
+        limit = MPMIN(limit, s->stream_size);
+    double rate = s->bitrate > 0 ? s->bitrate : s->read_speed;
+
+    // Large reads on fast sources (fewer wakeups), small reads on slow sources
+    // (data becomes available to the client sooner).
+    int64_t size = s->stream->read_chunk;
+    if (s->link_speed > 0)
+        size = MPCLAMP(s->link_speed * CACHE_ADAPTIVE_READ_TIME, FILL_LIMIT, size);
+    s->read_size = size;
+
+    // If the consumption rate is unknown, or the source is barely faster than
+    // playback, buffer as much as possible to ride out speed fluctuations.
+    // Otherwise, buffering adaptive_secs worth of data is enough, and avoids
+    // wasting bandwidth and memory on data that might never be played.
+    int64_t target = limit;
+    if (rate > 0 && s->link_speed >= rate * 1.5)
+        target = MPCLAMP(rate * s->adaptive_secs, FILL_LIMIT * 4, limit);
+    s->readahead_target = target;
+
+    // The buffer needs to hold the target plus the read that exceeds it. Grow
+    // it (with some headroom) as soon as it's too small, but shrink it only
+    // if it's more than twice as large as needed, so that fluctuating speed
+    // measurements don't reallocate it all the time.
+    int64_t cur = s->buffer_size - s->back_size;
+    int64_t need = MPMIN(target + s->read_size, limit);
+    if (need > cur || need * 2 < cur) {
+        int64_t new_size = MPMIN(need + need / 2, limit);
+        if (new_size != cur) {
+            s->resize_size = new_size;
+            atomic_store(&s->resize_wanted, true);
+        }
+    }
+}
+
 // Runs in the cache thread.
 static void cache_fill(struct priv *s)
 {
-    int64_t read = s->read_filepos;
+    int64_t read = atomic_load(&s->read_filepos);
     bool read_attempted = false;
     int len = 0;
 
@@ -242,6 +394,29 @@ static void cache_fill(struct priv *s)
     if (!s->enable_readahead && s->read_min <= s->max_filepos)
         goto done;
 
+    s->target_reached = false;
+    if (s->adaptive) {
+        adapt_readahead(s);
+        // Hysteresis: once the target is reached, wait until half of it has
+        // been consumed, so that reads are done in bursts.
+        int64_t ahead = s->max_filepos - read;
+        if (ahead >= s->readahead_target) {
+            s->refilling = false;
+        } else if (ahead < s->readahead_target / 2) {
+            s->refilling = true;
+        }
+        if (!s->refilling && s->read_min <= s->max_filepos) {
+            double rate = s->bitrate > 0 ? s->bitrate : s->read_speed;
+            double t = CACHE_IDLE_SLEEP_TIME;
+            if (rate > 0)
+                t = (ahead - s->readahead_target / 2) / rate;
+            s->target_sleep = MPCLAMP(t, CACHE_ADAPTIVE_MIN_SLEEP,
+                                      CACHE_IDLE_SLEEP_TIME);
+            s->target_reached = true;
+            goto done;
+        }
+    }
+
     if (mp_cancel_test(s->cache->cancel))
         goto done;
 
@@ -274,7 +449,7 @@ static void cache_fill(struct priv *s)
         space = s->buffer_size - pos;
 
     // limit read size (or else would block and read the entire buffer in 1 call)
-    space = FFMIN(space, s->stream->read_chunk);
+    space = FFMIN(space, s->adaptive ? s->read_size : s->stream->read_chunk);
 
     // back+newb+space <= buffer_size
     int64_t back2 = s->buffer_size - (space + newb); // max back size
@@ -283,7 +458,9 @@ static void cache_fill(struct priv *s)
 
     // The read call might take a long time and block, so drop the lock.
     pthread_mutex_unlock(&s->mutex);
+    int64_t read_start = mp_time_us();
     len = stream_read_partial(s->stream, &s->buffer[pos], space);
+    int64_t read_time = mp_time_us() - read_start;
     pthread_mutex_lock(&s->mutex);
 
     // Do this after reading a block, because at least libdvdnav updates the
@@ -298,11 +475,15 @@ static void cache_fill(struct priv *s)
     if (pos + len == s->buffer_size)
         s->offset += s->buffer_size; // wrap...
     s->speed_amount += len;
+    s->speed_busy += read_time;
+    s->total_fetched += MPMAX(len, 0);
+    publish_ring(s);
 
     read_attempted = true;
 
 done: ;
 
+    s->fill_read_pos = read;
     bool prev_eof = s->eof;
     if (read_attempted)
         s->eof = len <= 0;
@@ -325,17 +506,18 @@ static int resize_cache(struct priv *s, int64_t size)
     int64_t min_size = FILL_LIMIT * 2;
     int64_t max_size = ((size_t)-1) / 8;
 
+    int64_t back_size = s->opt_back_size;
     if (s->stream_size > 0) {
         size = MPMIN(size, s->stream_size);
         if (size >= s->stream_size) {
             MP_VERBOSE(s, "no backbuffer needed\n");
-            s->back_size = 0;
+            back_size = 0;
         }
     }
 
     int64_t buffer_size = MPCLAMP(size, min_size, max_size);
-    s->back_size = MPCLAMP(s->back_size, min_size, max_size);
-    buffer_size += s->back_size;
+    back_size = MPCLAMP(back_size, min_size, max_size);
+    buffer_size += back_size;
 
     unsigned char *buffer = malloc(buffer_size);
     if (!buffer) {
@@ -347,23 +529,24 @@ static int resize_cache(struct priv *s, int64_t size)
         // Copy & free the old ringbuffer data.
         // If the buffer is too small, prefer to copy these regions:
         // 1. Data starting from read_filepos, until cache end
-        size_t read_1 = read_buffer(s, buffer, buffer_size, s->read_filepos);
+        int64_t read_filepos = atomic_load(&s->read_filepos);
+        size_t read_1 = read_buffer(s, buffer, buffer_size, read_filepos);
         // 2. then data from before read_filepos until cache start
         //    (this one needs to be copied to the end of the ringbuffer)
         size_t read_2 = 0;
-        if (s->min_filepos < s->read_filepos) {
+        if (s->min_filepos < read_filepos) {
             size_t copy_len = buffer_size - read_1;
-            copy_len = MPMIN(copy_len, s->read_filepos - s->min_filepos);
+            copy_len = MPMIN(copy_len, read_filepos - s->min_filepos);
             assert(copy_len + read_1 <= buffer_size);
             read_2 = read_buffer(s, buffer + buffer_size - copy_len, copy_len,
-                                 s->read_filepos - copy_len);
+                                 read_filepos - copy_len);
             // This shouldn't happen, unless copy_len was computed incorrectly.
             assert(read_2 == copy_len);
         }
         // Set it up such that read_1 is at buffer pos 0, and read_2 wraps
         // around below it, so that it is located at the end of the buffer.
-        s->min_filepos = s->read_filepos - read_2;
-        s->max_filepos = s->read_filepos + read_1;
+        s->min_filepos = read_filepos - read_2;
+        s->max_filepos = read_filepos + read_1;
         s->offset = s->max_filepos - read_1;
     } else {
         cache_drop_contents(s);
@@ -372,14 +555,15 @@ static int resize_cache(struct priv *s, int64_t size)
     free(s->buffer);
 
     s->buffer_size = buffer_size;
+    s->back_size = back_size;
     s->buffer = buffer;
+    publish_ring(s);
     s->idle = false;
     s->eof = false;
 
     //make sure that we won't wait from cache_fill
     //more data than it is allowed to fill
-    if (s->seek_limit > s->buffer_size - FILL_LIMIT)
-        s->seek_limit = s->buffer_size - FILL_LIMIT;
+    s->seek_limit = MPMIN(s->opt_seek_limit, s->buffer_size - FILL_LIMIT);
 
     MP_VERBOSE(s, "Cache size set to %lld KiB (%lld KiB backbuffer)\n",
                (long long)(s->buffer_size / 1024),
@@ -417,11 +601,25 @@ static int cache_get_cached_control(stream_t *cache, int cmd, void *arg)
     case STREAM_CTRL_GET_CACHE_INFO:
         *(struct stream_cache_info *)arg = (struct stream_cache_info) {
             .size = s->buffer_size - s->back_size,
-            .fill = s->max_filepos - s->read_filepos,
+            .fill = s->max_filepos - atomic_load(&s->read_filepos),
             .idle = s->idle,
             .speed = llrint(s->speed),
+            .read_speed = s->read_speed,
+            .total_read = atomic_load(&s->total_read),
+            .total_borrowed = atomic_load(&s->total_borrowed),
+            .total_fetched = s->total_fetched,
+            .waits = s->waits,
+            .adaptive = s->adaptive,
+            .target_reached = s->target_reached,
+            .readahead_target = s->adaptive ? s->readahead_target : 0,
+            .read_size = s->adaptive ? s->read_size : s->stream->read_chunk,
+            .bitrate = llrint(s->bitrate),
+            .link_speed = llrint(s->link_speed),
         };
         return STREAM_OK;
+    case STREAM_CTRL_SET_CACHE_BITRATE:
+        s->bitrate = MPMAX(*(double *)arg, 0);
+        return STREAM_OK;
     case STREAM_CTRL_SET_READAHEAD:
         s->enable_readahead = *(int *)arg;
         pthread_cond_signal(&s->wakeup);
@@ -483,7 +681,8 @@ static void cache_execute_control(struct priv *s)
 
     switch (s->control) {
     case STREAM_CTRL_SET_CACHE_SIZE:
-        s->control_res = resize_cache(s, *(int64_t *)s->control_arg);
+        s->size_limit = *(int64_t *)s->control_arg;
+        s->control_res = resize_cache(s, s->size_limit);
         break;
     default:
         s->control_res = stream_control(s->stream, s->control, s->control_arg);
@@ -496,8 +695,8 @@ static void cache_execute_control(struct priv *s)
                "returned error, this is not allowed!\n");
     } else if (pos_changed || (ok && control_needs_flush(s->control))) {
         MP_VERBOSE(s, "Dropping cache due to control()\n");
-        s->read_filepos = stream_tell(s->stream);
-        s->read_min = s->read_filepos;
+        atomic_store(&s->read_filepos, stream_tell(s->stream));
+        s->read_min = stream_tell(s->stream);
         s->control_flush = true;
         cache_drop_contents(s);
     }
@@ -507,6 +706,20 @@ static void cache_execute_control(struct priv *s)
     pthread_cond_signal(&s->wakeup);
 }
 
+// Runs in the cache thread, while the client waits in cache_sync_resize().
+static void cache_execute_resize(struct priv *s)
+{
+    // Never drop data ahead of the read position; it might not be possible to
+    // read it again from the stream.
+    int64_t ahead = s->max_filepos - atomic_load(&s->read_filepos);
+    int64_t size = MPMAX(s->resize_size, ahead + FILL_LIMIT);
+    if (resize_cache(s, size) != STREAM_OK)
+        MP_WARN(s, "Failed to resize cache buffer.\n");
+    atomic_store(&s->resize_wanted, false);
+    s->control = CACHE_CTRL_NONE;
+    pthread_cond_signal(&s->wakeup);
+}
+
 static void *cache_thread(void *arg)
 {
     struct priv *s = arg;
@@ -525,6 +738,8 @@ static void *cache_thread(void *arg)
             s->control_res = cache_update_stream_position(s);
             s->control = CACHE_CTRL_NONE;
             pthread_cond_signal(&s->wakeup);
+        } else if (s->control == CACHE_CTRL_RESIZE) {
+            cache_execute_resize(s);
         } else {
             cache_fill(s);
         }
@@ -533,8 +748,23 @@ static void *cache_thread(void *arg)
             s->control = CACHE_CTRL_NONE;
         }
         if (s->idle && s->control == CACHE_CTRL_NONE) {
-            struct timespec ts = mp_rel_time_to_timespec(CACHE_IDLE_SLEEP_TIME);
-            pthread_cond_timedwait(&s->wakeup, &s->mutex, &ts);
+            // If the buffer is full, the client frees space without locking,
+            // and wakes us up only if this flag is set.
+            bool full = !s->eof;
+            double timeout = CACHE_IDLE_SLEEP_TIME;
+            // The readahead target is refilled only after a while, so don't
+            // make the client wake us up on every read.
+            if (s->target_reached) {
+                full = false;
+                timeout = s->target_sleep;
+            }
+            if (full)
+                atomic_store(&s->thread_waiting, true);
+            if (!full || atomic_load(&s->read_filepos) == s->fill_read_pos) {
+                struct timespec ts = mp_rel_time_to_timespec(timeout);
+                pthread_cond_timedwait(&s->wakeup, &s->mutex, &ts);
+            }
+            atomic_store(&s->thread_waiting, false);
         }
     }
     pthread_cond_signal(&s->wakeup);
@@ -543,37 +773,102 @@ static void *cache_thread(void *arg)
     return NULL;
 }
 
-static int cache_fill_buffer(struct stream *cache, char *buffer, int max_len)
+// Wait until data at the read position is available (max_len is a hint for
+// how much data is needed). Return false on EOF or abort.
+static bool cache_wait_data(struct priv *s, int max_len)
 {
-    struct priv *s = cache->priv;
-    assert(s->cache_thread_running);
+    bool ok = false;
 
     pthread_mutex_lock(&s->mutex);
 
-    if (cache->pos != s->read_filepos)
+    int64_t pos = atomic_load(&s->read_filepos);
+    if (s->cache->pos != pos)
         MP_ERR(s, "!!! read_filepos differs !!! report this bug...\n");
 
-    int readb = 0;
-    if (max_len > 0) {
-        double retry_time = 0;
-        int64_t retry = s->reads - 1; // try at least 1 read on EOF
-        while (1) {
-            s->read_min = s->read_filepos + max_len + 64 * 1024;
-            readb = read_buffer(s, buffer, max_len, s->read_filepos);
-            s->read_filepos += readb;
-            if (readb > 0)
-                break;
-            if (s->eof && s->read_filepos >= s->max_filepos && s->reads >= retry)
-                break;
-            s->idle = false;
-            if (!cache_wakeup_and_wait(s, &retry_time))
-                break;
+    double retry_time = 0;
+    int64_t retry = s->reads - 1; // try at least 1 read on EOF
+    while (1) {
+        s->read_min = pos + max_len + 64 * 1024;
+        if (pos >= s->min_filepos && pos < s->max_filepos) {
+            ok = true;
+            break;
         }
+        if (s->eof && pos >= s->max_filepos && s->reads >= retry)
+            break;
+        s->idle = false;
+        s->waits++;
+        if (!cache_wakeup_and_wait(s, &retry_time))
+            break;
     }
 
     // wakeup the cache thread, possibly make it read more data ahead
     pthread_cond_signal(&s->wakeup);
     pthread_mutex_unlock(&s->mutex);
+    return ok;
+}
+
+// Let the cache thread execute a resize requested by adapt_readahead(). The
+// buffer memory is freed, so the caller must not hold borrowed data.
+static void cache_sync_resize(struct priv *s)
+{
+    pthread_mutex_lock(&s->mutex);
+    s->control = CACHE_CTRL_RESIZE;
+    double retry = 0;
+    while (s->control != CACHE_CTRL_NONE) {
+        if (!cache_wakeup_and_wait(s, &retry))
+            break;
+    }
+    // On abort, don't let the cache thread resize it behind our back.
+    if (s->control == CACHE_CTRL_RESIZE)
+        s->control = CACHE_CTRL_NONE;
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static int cache_borrow_buffer(stream_t *cache, void **data, int max_len)
+{
+    struct priv *s = cache->priv;
+    assert(s->cache_thread_running);
+
+    // Data returned by the previous call is invalid now, so this is safe.
+    if (atomic_load(&s->resize_wanted))
+        cache_sync_resize(s);
+
+    int64_t pos = atomic_load(&s->read_filepos);
+    unsigned char *ptr = NULL;
+    int len = ring_peek(s, pos, &ptr, max_len);
+    if (len <= 0 && max_len > 0 && cache_wait_data(s, max_len))
+        len = ring_peek(s, pos, &ptr, max_len);
+    *data = ptr;
+    return len;
+}
+
+static void cache_commit_buffer(stream_t *cache, int len)
+{
+    ring_consume(cache->priv, len, true);
+}
+
+static int cache_fill_buffer(struct stream *cache, char *buffer, int max_len)
+{
+    struct priv *s = cache->priv;
+
+    void *data;
+    int readb = cache_borrow_buffer(cache, &data, max_len);
+    if (readb <= 0)
+        return 0;
+    memcpy(buffer, data, readb);
+    ring_consume(s, readb, false);
+
+    // Data wrapping around the end of the ring buffer.
+    if (readb < max_len) {
+        unsigned char *ptr;
+        int64_t pos = atomic_load(&s->read_filepos);
+        int len = ring_peek(s, pos, &ptr, max_len - readb);
+        if (len > 0) {
+            memcpy(buffer + readb, ptr, len);
+            ring_consume(s, len, false);
+            readb += len;
+        }
+    }
     return readb;
 }
 
@@ -587,7 +882,7 @@ static int cache_seek(stream_t *cache, int64_t pos)
 
     MP_DBG(s, "request seek: %" PRId64 " <= to=%" PRId64
            " (cur=%" PRId64 ") <= %" PRId64 "  \n",
-           s->min_filepos, pos, s->read_filepos, s->max_filepos);
+           s->min_filepos, pos, (int64_t)atomic_load(&s->read_filepos), s->max_filepos);
 
     if (!s->seekable && pos > s->max_filepos) {
         MP_ERR(s, "Attempting to seek past cached data in unseekable stream.\n");
@@ -596,7 +891,8 @@ static int cache_seek(stream_t *cache, int64_t pos)
         MP_ERR(s, "Attempting to seek before cached data in unseekable stream.\n");
         r = 0;
     } else {
-        cache->pos = s->read_filepos = s->read_min = pos;
+        cache->pos = s->read_min = pos;
+        atomic_store(&s->read_filepos, pos);
         s->eof = false; // so that cache_read() will actually wait for new data
         s->control = CACHE_CTRL_SEEK;
         s->control_res = 0;
@@ -642,7 +938,7 @@ static int cache_control(stream_t *cache, int cmd, void *arg)
     r = s->control_res;
     if (s->control_flush) {
         stream_drop_buffers(cache);
-        cache->pos = s->read_filepos;
+        cache->pos = atomic_load(&s->read_filepos);
     }
 
 done:
@@ -679,17 +975,21 @@ int stream_cache_init(stream_t *cache, stream_t *stream,
     s->log = cache->log;
     s->eof_pos = -1;
     s->enable_readahead = true;
+    s->adaptive = opts->adaptive;
+    s->adaptive_secs = opts->adaptive_secs;
+    s->refilling = true;
 
     cache_drop_contents(s);
 
     s->speed_start = mp_time_us();
 
-    s->seek_limit = opts->seek_min * 1024ULL;
-    s->back_size = opts->back_buffer * 1024ULL;
+    s->opt_seek_limit = opts->seek_min * 1024ULL;
+    s->opt_back_size = opts->back_buffer * 1024ULL;
+    s->size_limit = opts->size * 1024ULL;
 
     s->stream_size = stream_get_size(stream);
 
-    if (resize_cache(s, opts->size * 1024ULL) != STREAM_OK) {
+    if (resize_cache(s, s->size_limit) != STREAM_OK) {
         MP_ERR(s, "Failed to allocate cache buffer.\n");
         talloc_free(s);
         return -1;
@@ -704,6 +1004,8 @@ int stream_cache_init(stream_t *cache, stream_t *stream,
 
     cache->seek = cache_seek;
     cache->fill_buffer = cache_fill_buffer;
+    cache->borrow_buffer = cache_borrow_buffer;
+    cache->commit_buffer = cache_commit_buffer;
     cache->control = cache_control;
     cache->close = cache_uninit;
 
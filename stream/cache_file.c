@@ -17,25 +17,70 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libavutil/sha.h>
+#include <libavutil/mem.h>
 
 #include "osdep/io.h"
+#include "osdep/threads.h"
 
 #include "common/common.h"
 #include "common/msg.h"
 
 #include "options/options.h"
+#include "options/path.h"
 
 #include "stream.h"
 
 #define BLOCK_SIZE 1024LL
 #define BLOCK_ALIGN(p) ((p) & ~(BLOCK_SIZE - 1))
 
+// The readahead thread reads at most this much from the source at once...
+#define READ_CHUNK (64 * BLOCK_SIZE)
+// ...and stays at most this far ahead of the reader.
+#define READAHEAD (4 * 1024 * 1024LL)
+
+// Header line of the block map files of --cache-file-dir, followed by the
+// cache key and the block bits.
+#define MAP_MAGIC "mpv-cache-map 1"
+
 struct priv {
     struct stream *original;
+    struct mp_log *log;
+
+    // Serializes access to original. If both locks are needed, this one must
+    // be acquired first.
+    pthread_mutex_t orig_lock;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // --- Protected by lock.
     FILE *cache_file;
     uint8_t *block_bits;    // 1 bit for each BLOCK_SIZE, whether block was read
     int64_t size;           // currently known size
     int64_t max_size;       // max. size for block_bits and cache_file
+    int64_t num_cached;     // number of set bits in block_bits
+    int64_t read_pos;       // where the reader is
+    bool readahead_failed;  // don't retry until the next seek
+    bool terminate;
+    // --- End of protected fields.
+
+    bool have_thread;
+    pthread_t thread;
+
+    // Only set with --cache-file-dir.
+    char *dir;              // cache directory
+    char *name;             // file name of the entry, without suffix
+    char *key;              // identifies the source the entry is for
+    int64_t dir_max;        // max. total size of all entries
 };
 
 static bool test_bit(struct priv *p, int64_t pos)
@@ -52,71 +97,400 @@ static void set_bit(struct priv *p, int64_t pos, bool bit)
         return;
     size_t block = pos / BLOCK_SIZE;
     unsigned int m = (1 << (block % 8));
+    if (!(p->block_bits[block / 8] & m) != !bit)
+        p->num_cached += bit ? 1 : -1;
     p->block_bits[block / 8] = (p->block_bits[block / 8] & ~m) | (bit ? m : 0);
 }
 
+// Must be called with lock held.
+static void update_size(struct priv *p, int64_t new_size)
+{
+    // Size of file changes -> invalidate last block
+    if (p->size >= 0 && new_size != p->size)
+        set_bit(p, BLOCK_ALIGN(p->size), 0);
+    p->size = MPMIN(p->max_size, new_size);
+}
+
+// Read len bytes at pos from the source, and write them to the cache file.
+// Must be called with orig_lock held, and lock not held.
+static int fetch(struct priv *p, int64_t pos, int len)
+{
+    char *tmp = talloc_size(NULL, len);
+    int r = -1;
+    if (stream_seek(p->original, pos) >= 1)
+        r = stream_read(p->original, tmp, len);
+
+    pthread_mutex_lock(&p->lock);
+    if (r >= 0 && r < len) {
+        if (p->size < 0) {
+            MP_WARN(p, "suspected EOF\n");
+        } else if (pos + r < p->size) {
+            MP_ERR(p, "unexpected EOF\n");
+            r = -1;
+        }
+    }
+    if (r > 0) {
+        if (fseeko(p->cache_file, pos, SEEK_SET) ||
+            fwrite(tmp, r, 1, p->cache_file) != 1)
+        {
+            r = -1;
+        } else {
+            // A partial block is complete only at the end of the file.
+            for (int64_t b = pos; b < pos + r; b += BLOCK_SIZE) {
+                if (b + BLOCK_SIZE <= pos + r || pos + r >= p->size)
+                    set_bit(p, b, 1);
+            }
+        }
+    } else {
+        r = -1;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    talloc_free(tmp);
+    return r;
+}
+
+// Return the first block in the readahead window that is not cached yet, and
+// the number of bytes that should be read from there. Must be called with lock
+// held. Returns -1 if there is nothing to do.
+static int64_t find_readahead(struct priv *p, int *out_len)
+{
+    if (p->size < 0 || p->readahead_failed)
+        return -1;
+    int64_t end = MPMIN(p->size, p->read_pos + READAHEAD);
+    int64_t pos = BLOCK_ALIGN(p->read_pos);
+    while (pos < end && test_bit(p, pos))
+        pos += BLOCK_SIZE;
+    if (pos >= end)
+        return -1;
+    int64_t chunk_end = pos;
+    while (chunk_end < end && chunk_end - pos < READ_CHUNK &&
+           !test_bit(p, chunk_end))
+        chunk_end += BLOCK_SIZE;
+    *out_len = MPMIN(chunk_end, p->size) - pos;
+    return pos;
+}
+
+static void *readahead_thread(void *arg)
+{
+    struct priv *p = arg;
+    mpthread_set_name("cache-file");
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        int len = 0;
+        int64_t pos = find_readahead(p, &len);
+        if (pos < 0) {
+            pthread_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        pthread_mutex_lock(&p->orig_lock);
+        int r = fetch(p, pos, len);
+        pthread_mutex_unlock(&p->orig_lock);
+
+        pthread_mutex_lock(&p->lock);
+        if (r < 0)
+            p->readahead_failed = true;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
 static int fill_buffer(stream_t *s, char *buffer, int max_len)
 {
     struct priv *p = s->priv;
     if (s->pos < 0)
         return -1;
     if (s->pos >= p->max_size) {
-        if (stream_seek(p->original, s->pos) < 1)
-            return -1;
-        return stream_read(p->original, buffer, max_len);
+        int r = -1;
+        pthread_mutex_lock(&p->orig_lock);
+        if (stream_seek(p->original, s->pos) >= 1)
+            r = stream_read(p->original, buffer, max_len);
+        pthread_mutex_unlock(&p->orig_lock);
+        return r;
     }
-    // Size of file changes -> invalidate last block
+    pthread_mutex_lock(&p->lock);
     if (s->pos >= p->size - BLOCK_SIZE) {
-        int64_t new_size = stream_get_size(s);
-        if (p->size >= 0 && new_size != p->size)
-            set_bit(p, BLOCK_ALIGN(p->size), 0);
-        p->size = MPMIN(p->max_size, new_size);
+        pthread_mutex_unlock(&p->lock);
+        pthread_mutex_lock(&p->orig_lock);
+        int64_t new_size = stream_get_size(p->original);
+        pthread_mutex_lock(&p->lock);
+        pthread_mutex_unlock(&p->orig_lock);
+        update_size(p, new_size);
     }
+    p->read_pos = s->pos;
+    pthread_cond_signal(&p->wakeup);
     int64_t aligned = BLOCK_ALIGN(s->pos);
     if (!test_bit(p, aligned)) {
-        char tmp[BLOCK_SIZE];
-        stream_seek(p->original, aligned);
-        int r = stream_read(p->original, tmp, BLOCK_SIZE);
-        if (r < BLOCK_SIZE) {
-            if (p->size < 0) {
-                MP_WARN(s, "suspected EOF\n");
-            } else if (aligned + r < p->size) {
-                MP_ERR(s, "unexpected EOF\n");
-                return -1;
-            }
-        }
-        if (fseeko(p->cache_file, aligned, SEEK_SET))
-            return -1;
-        if (fwrite(tmp, r, 1, p->cache_file) != 1)
+        pthread_mutex_unlock(&p->lock);
+        pthread_mutex_lock(&p->orig_lock);
+        // The readahead thread might have read it while we were waiting.
+        pthread_mutex_lock(&p->lock);
+        bool cached = test_bit(p, aligned);
+        pthread_mutex_unlock(&p->lock);
+        int r = cached ? 0 : fetch(p, aligned, BLOCK_SIZE);
+        pthread_mutex_unlock(&p->orig_lock);
+        if (r < 0)
             return -1;
-        set_bit(p, aligned, 1);
+        pthread_mutex_lock(&p->lock);
     }
-    if (fseeko(p->cache_file, s->pos, SEEK_SET))
-        return -1;
-    // align/limit to blocks
-    max_len = MPMIN(max_len, BLOCK_SIZE - (s->pos % BLOCK_SIZE));
-    // Limit to max. known file size
-    if (p->size >= 0)
-        max_len = MPMIN(max_len, p->size - s->pos);
-    return fread(buffer, 1, max_len, p->cache_file);
+    int r = -1;
+    if (fseeko(p->cache_file, s->pos, SEEK_SET) == 0) {
+        // align/limit to blocks
+        max_len = MPMIN(max_len, BLOCK_SIZE - (s->pos % BLOCK_SIZE));
+        // Limit to max. known file size
+        if (p->size >= 0)
+            max_len = MPMIN(max_len, p->size - s->pos);
+        r = fread(buffer, 1, max_len, p->cache_file);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return r;
 }
 
 static int seek(stream_t *s, int64_t newpos)
 {
+    struct priv *p = s->priv;
+    pthread_mutex_lock(&p->lock);
+    p->read_pos = newpos;
+    p->readahead_failed = false;
+    pthread_cond_signal(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
     return 1;
 }
 
 static int control(stream_t *s, int cmd, void *arg)
 {
     struct priv *p = s->priv;
-    return stream_control(p->original, cmd, arg);
+    pthread_mutex_lock(&p->orig_lock);
+    int r = stream_control(p->original, cmd, arg);
+    pthread_mutex_unlock(&p->orig_lock);
+    return r;
+}
+
+static char *entry_path(void *ta_parent, struct priv *p, const char *name,
+                        const char *suffix)
+{
+    char *fname = talloc_asprintf(NULL, "%s%s", name, suffix);
+    char *path = mp_path_join(ta_parent, p->dir, fname);
+    talloc_free(fname);
+    return path;
+}
+
+static bool has_suffix(const char *name, const char *suffix)
+{
+    size_t len = strlen(name), slen = strlen(suffix);
+    return len > slen && strcmp(name + len - slen, suffix) == 0;
+}
+
+// Read the header of a block map file. If bits is not NULL, also read the
+// block bits (the entry's size must be max_size), and fail if key doesn't
+// match.
+static bool read_map(const char *path, const char *key, int64_t *out_size,
+                     int64_t *out_cached, uint8_t *bits, size_t bits_size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    bool ok = false;
+    char *key_buf = NULL;
+    int64_t size = 0, cached = 0, key_len = 0;
+    if (fscanf(f, MAP_MAGIC " %"SCNd64" %"SCNd64" %"SCNd64"\n",
+               &size, &cached, &key_len) != 3 || key_len < 0 ||
+        key_len > 64 * 1024)
+        goto done;
+    *out_size = size;
+    *out_cached = cached;
+    if (bits) {
+        key_buf = talloc_size(NULL, key_len + 1);
+        if (fread(key_buf, key_len, 1, f) != 1)
+            goto done;
+        key_buf[key_len] = '\0';
+        if (strcmp(key_buf, key) != 0 || fread(bits, bits_size, 1, f) != 1)
+            goto done;
+    }
+    ok = true;
+done:
+    talloc_free(key_buf);
+    fclose(f);
+    return ok;
+}
+
+// Must be called with lock held, or when there are no other threads.
+static void write_map(struct priv *p)
+{
+    void *tmp = talloc_new(NULL);
+    char *path = entry_path(tmp, p, p->name, ".map");
+    char *tmp_path = talloc_asprintf(tmp, "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "wb");
+    if (f) {
+        fprintf(f, MAP_MAGIC " %"PRId64" %"PRId64" %zu\n", p->size,
+                p->num_cached, strlen(p->key));
+        bool ok = fwrite(p->key, strlen(p->key), 1, f) == 1 &&
+                  fwrite(p->block_bits, talloc_get_size(p->block_bits), 1, f) == 1;
+        ok &= fclose(f) == 0;
+        if (ok && rename(tmp_path, path) == 0) {
+            talloc_free(tmp);
+            return;
+        }
+        unlink(tmp_path);
+    }
+    MP_WARN(p, "could not write '%s'\n", path);
+    talloc_free(tmp);
+}
+
+struct dir_entry {
+    char *name;
+    int64_t used;           // bytes cached
+    int64_t mtime;          // last use
+};
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    const struct dir_entry *e1 = a, *e2 = b;
+    return MPCLAMP(e1->mtime - e2->mtime, -1, 1);
+}
+
+// Delete the least recently used entries until the total size of the
+// directory (counting the current entry with reserve bytes) fits dir_max.
+static void evict_entries(struct priv *p, int64_t reserve)
+{
+    void *tmp = talloc_new(NULL);
+    DIR *d = opendir(p->dir);
+    if (!d)
+        goto done;
+    struct dir_entry *entries = NULL;
+    int num_entries = 0;
+    int64_t total = reserve;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        char *path = mp_path_join(tmp, p->dir, de->d_name);
+        if (has_suffix(de->d_name, ".data")) {
+            // Data files without map are left over from crashes.
+            char *name = bstrdup0(tmp, bstr_strip_ext(bstr0(de->d_name)));
+            char *map = entry_path(tmp, p, name, ".map");
+            struct stat st;
+            if (stat(map, &st) != 0 && strcmp(name, p->name) != 0)
+                unlink(path);
+            continue;
+        }
+        if (!has_suffix(de->d_name, ".map"))
+            continue;
+        struct dir_entry e = {
+            .name = bstrdup0(tmp, bstr_strip_ext(bstr0(de->d_name))),
+        };
+        if (strcmp(e.name, p->name) == 0)
+            continue;
+        struct stat st;
+        int64_t size;
+        if (stat(path, &st) != 0 || !read_map(path, NULL, &size, &e.used,
+                                              NULL, 0))
+            continue;
+        e.used *= BLOCK_SIZE;
+        e.mtime = st.st_mtime;
+        total += e.used;
+        MP_TARRAY_APPEND(tmp, entries, num_entries, e);
+    }
+    closedir(d);
+
+    qsort(entries, num_entries, sizeof(entries[0]), cmp_mtime);
+    for (int n = 0; n < num_entries && total > p->dir_max; n++) {
+        MP_VERBOSE(p, "evicting cache entry %s\n", entries[n].name);
+        unlink(entry_path(tmp, p, entries[n].name, ".map"));
+        unlink(entry_path(tmp, p, entries[n].name, ".data"));
+        total -= entries[n].used;
+    }
+done:
+    talloc_free(tmp);
+}
+
+// Something that changes if the source is modified. Most network protocols
+// don't expose anything like this, so it's only the mtime for local files.
+static char *get_validator(void *ta_parent, struct stream *s)
+{
+    struct stat st;
+    if (s->uncached_type == STREAMTYPE_FILE && s->path &&
+        stat(s->path, &st) == 0)
+        return talloc_asprintf(ta_parent, "mtime=%"PRId64, (int64_t)st.st_mtime);
+    if (s->mime_type)
+        return talloc_asprintf(ta_parent, "mime=%s", s->mime_type);
+    return "";
+}
+
+// Set up the entry in --cache-file-dir for the source, and load the block map
+// of a previous session. Returns the data file, or NULL on error.
+static FILE *open_entry(stream_t *cache, struct priv *p, const char *dir,
+                        int64_t size)
+{
+    p->dir = mp_get_user_path(p, cache->global, dir);
+    mp_mkdirp(p->dir);
+
+    p->key = talloc_asprintf(p, "%s\n%"PRId64"\n%s", p->original->url, size,
+                             get_validator(p, p->original));
+    uint8_t hash[32];
+    struct AVSHA *sha = av_sha_alloc();
+    if (!sha)
+        abort();
+    av_sha_init(sha, 256);
+    av_sha_update(sha, p->key, strlen(p->key));
+    av_sha_final(sha, hash);
+    av_free(sha);
+    p->name = talloc_strdup(p, "");
+    for (int i = 0; i < sizeof(hash); i++)
+        p->name = talloc_asprintf_append(p->name, "%02X", hash[i]);
+
+    void *tmp = talloc_new(NULL);
+    char *map_path = entry_path(tmp, p, p->name, ".map");
+    char *data_path = entry_path(tmp, p, p->name, ".data");
+
+    FILE *file = NULL;
+    int64_t map_size = 0;
+    if (read_map(map_path, p->key, &map_size, &p->num_cached, p->block_bits,
+                 talloc_get_size(p->block_bits)) &&
+        map_size == p->size)
+    {
+        file = fopen(data_path, "rb+");
+        if (file) {
+            MP_VERBOSE(p, "reusing %"PRId64" KB from '%s'\n",
+                       (int64_t)(p->num_cached * BLOCK_SIZE / 1024), data_path);
+        }
+    }
+    if (!file) {
+        memset(p->block_bits, 0, talloc_get_size(p->block_bits));
+        p->num_cached = 0;
+        evict_entries(p, p->size);
+        file = fopen(data_path, "wb+");
+    }
+    if (file)
+        write_map(p); // also marks the entry as recently used
+    else
+        MP_ERR(p, "can't open cache file '%s'\n", data_path);
+
+    talloc_free(tmp);
+    return file;
 }
 
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
-    if (p->cache_file)
+    if (p->have_thread) {
+        pthread_mutex_lock(&p->lock);
+        p->terminate = true;
+        pthread_cond_signal(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+    }
+    if (p->cache_file) {
+        if (p->name && fflush(p->cache_file) == 0) {
+            write_map(p);
+            evict_entries(p, p->num_cached * BLOCK_SIZE);
+        }
         fclose(p->cache_file);
+    }
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
+    pthread_mutex_destroy(&p->orig_lock);
     talloc_free(p);
 }
 
@@ -124,7 +498,9 @@ static void s_close(stream_t *s)
 int stream_file_cache_init(stream_t *cache, stream_t *stream,
                            struct mp_cache_opts *opts)
 {
-    if (!opts->file || !opts->file[0] || opts->file_max < 1)
+    bool use_file = opts->file && opts->file[0];
+    bool use_dir = !use_file && opts->dir && opts->dir[0];
+    if ((!use_file && !use_dir) || opts->file_max < 1)
         return 0;
 
     if (!stream->seekable) {
@@ -132,23 +508,51 @@ int stream_file_cache_init(stream_t *cache, stream_t *stream,
         return -1;
     }
 
-    bool use_anon_file = strcmp(opts->file, "TMP") == 0;
-    FILE *file = use_anon_file ? tmpfile() : fopen(opts->file, "wb+");
-    if (!file) {
-        MP_ERR(cache, "can't open cache file '%s'\n", opts->file);
-        return -1;
+    int64_t size = stream_get_size(stream);
+    if (use_dir && size < 0) {
+        MP_WARN(cache, "stream size unknown, not using --cache-file-dir\n");
+        return 0;
     }
 
     struct priv *p = talloc_zero(NULL, struct priv);
 
-    cache->priv = p;
     p->original = stream;
-    p->cache_file = file;
+    p->log = cache->log;
     p->max_size = opts->file_max * 1024LL;
+    p->dir_max = opts->dir_max * 1024LL;
+    pthread_mutex_init(&p->orig_lock, NULL);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
 
     // file_max can be INT_MAX, so this is at most about 256MB
     p->block_bits = talloc_zero_size(p, (p->max_size / BLOCK_SIZE + 1) / 8 + 1);
 
+    FILE *file = NULL;
+    if (use_dir) {
+        p->size = MPMIN(p->max_size, size);
+        file = open_entry(cache, p, opts->dir, size);
+    } else {
+        bool use_anon_file = strcmp(opts->file, "TMP") == 0;
+        file = use_anon_file ? tmpfile() : fopen(opts->file, "wb+");
+        if (!file)
+            MP_ERR(cache, "can't open cache file '%s'\n", opts->file);
+    }
+    cache->priv = p;
+    if (!file) {
+        s_close(cache);
+        cache->priv = NULL;
+        return -1;
+    }
+    p->cache_file = file;
+
+    if (size >= 0) {
+        pthread_mutex_lock(&p->lock);
+        update_size(p, size);
+        pthread_mutex_unlock(&p->lock);
+        p->have_thread =
+            !pthread_create(&p->thread, NULL, readahead_thread, p);
+    }
+
     cache->seek = seek;
     cache->fill_buffer = fill_buffer;
     cache->control = control;
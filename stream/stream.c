@@ -24,6 +24,7 @@
 
 #include <strings.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/common.h>
 #include "osdep/atomics.h"
@@ -512,6 +513,15 @@ int stream_read_partial(stream_t *s, char *buf, int buf_size)
     assert(buf_size >= 0);
     if (s->buf_pos == s->buf_len && buf_size > 0) {
         s->buf_pos = s->buf_len = 0;
+        // Copy straight out of the stream's memory (e.g. the cache's ring
+        // buffer), regardless of the read size.
+        if (s->borrow_buffer && !s->sector_size) {
+            struct bstr data = stream_borrow(s, buf_size);
+            if (data.len)
+                memcpy(buf, data.start, data.len);
+            stream_commit(s, data.len);
+            return data.len;
+        }
         // Do a direct read, but only if there's no sector alignment requirement
         // Also, small reads will be more efficient with buffering & copying
         if (!s->sector_size && buf_size >= STREAM_BUFFER_SIZE)
@@ -544,7 +554,8 @@ int stream_read(stream_t *s, char *mem, int total)
 }
 
 // Read ahead at most len bytes without changing the read position. Return a
-// pointer to the internal buffer, starting from the current read position.
+// pointer to the internal buffer (or to the stream's own memory, see
+// stream_borrow()), starting from the current read position.
 // Can read ahead at most STREAM_MAX_BUFFER_SIZE bytes.
 // The returned buffer becomes invalid on the next stream call, and you must
 // not write to it.
@@ -552,6 +563,15 @@ struct bstr stream_peek(stream_t *s, int len)
 {
     assert(len >= 0);
     assert(len <= STREAM_MAX_BUFFER_SIZE);
+    // Callers may rely on seeking back to the peeked data, which doesn't
+    // work with the internal buffer left empty on unseekable streams.
+    if (s->buf_pos == s->buf_len && len > 0 && s->borrow_buffer &&
+        !s->sector_size && s->seekable)
+    {
+        struct bstr data = stream_borrow(s, len);
+        if (data.len == len)
+            return data;
+    }
     if (s->buf_len - s->buf_pos < len) {
         // Move to front to guarantee we really can read up to max size.
         int buf_valid = s->buf_len - s->buf_pos;
@@ -576,6 +596,49 @@ struct bstr stream_peek(stream_t *s, int len)
                   .len = FFMIN(len, s->buf_len - s->buf_pos)};
 }
 
+// Return at most max_len bytes from the current read position, without
+// copying them if the stream supports it (like the cache). Otherwise, this
+// uses the internal buffer, like stream_peek(). The read position is not
+// changed; use stream_commit() to consume (part of) the returned data.
+// The returned data becomes invalid on the next stream call (other than
+// stream_commit()), and you must not write to it.
+// Returns an empty bstr on EOF or error.
+struct bstr stream_borrow(stream_t *s, int max_len)
+{
+    assert(max_len >= 0);
+    if (s->buf_pos == s->buf_len && max_len > 0) {
+        if (s->borrow_buffer && !s->sector_size) {
+            void *data = NULL;
+            int len = s->borrow_buffer(s, &data, max_len);
+            if (len > 0) {
+                s->buf_pos = s->buf_len = 0;
+                s->borrowed = data;
+                s->eof = 0;
+                return (struct bstr){data, len};
+            }
+            // Let the normal read path deal with EOF and reconnecting.
+        }
+        stream_fill_buffer(s);
+    }
+    int len = MPMIN(max_len, s->buf_len - s->buf_pos);
+    return (struct bstr){&s->buffer[s->buf_pos], len};
+}
+
+// Consume len bytes of the data returned by the last stream_borrow() call.
+void stream_commit(stream_t *s, int len)
+{
+    assert(len >= 0);
+    if (s->buf_pos < s->buf_len) {
+        assert(len <= s->buf_len - s->buf_pos);
+        s->buf_pos += len;
+    } else if (len > 0) {
+        // Borrowed from the stream implementation; s->buffer was not used.
+        stream_capture_write(s, s->borrowed, len);
+        s->commit_buffer(s, len);
+        s->pos += len;
+    }
+}
+
 int stream_write_buffer(stream_t *s, unsigned char *buf, int len)
 {
     int rd;
@@ -593,6 +656,15 @@ static bool stream_skip_read(struct stream *s, int64_t len)
 {
     while (len > 0) {
         int x = s->buf_len - s->buf_pos;
+        if (x == 0 && s->borrow_buffer && !s->sector_size) {
+            // Skip the data without copying it anywhere.
+            struct bstr data = stream_borrow(s, MPMIN(len, INT_MAX));
+            if (!data.len)
+                return false; // EOF
+            stream_commit(s, data.len);
+            len -= data.len;
+            continue;
+        }
         if (x == 0) {
             if (!stream_fill_buffer_by(s, len))
                 return false; // EOF
@@ -959,15 +1031,24 @@ struct bstr stream_read_file(const char *filename, void *talloc_ctx,
     return res;
 }
 
+// Protects the parent/slave links of all mp_cancel instances.
+static pthread_mutex_t cancel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void cancel_unlink(struct mp_cancel *c);
+
 #ifndef __MINGW32__
 struct mp_cancel {
     atomic_bool triggered;
     int wakeup_pipe[2];
+    struct mp_cancel *parent;
+    struct mp_cancel **slaves;
+    int num_slaves;
 };
 
 static void cancel_destroy(void *p)
 {
     struct mp_cancel *c = p;
+    cancel_unlink(c);
     close(c->wakeup_pipe[0]);
     close(c->wakeup_pipe[1]);
 }
@@ -981,8 +1062,7 @@ struct mp_cancel *mp_cancel_new(void *talloc_ctx)
     return c;
 }
 
-// Request abort.
-void mp_cancel_trigger(struct mp_cancel *c)
+static void cancel_set(struct mp_cancel *c)
 {
     atomic_store(&c->triggered, true);
     (void)write(c->wakeup_pipe[1], &(char){0}, 1);
@@ -1030,11 +1110,15 @@ int mp_cancel_get_fd(struct mp_cancel *c)
 struct mp_cancel {
     atomic_bool triggered;
     HANDLE event;
+    struct mp_cancel *parent;
+    struct mp_cancel **slaves;
+    int num_slaves;
 };
 
 static void cancel_destroy(void *p)
 {
     struct mp_cancel *c = p;
+    cancel_unlink(c);
     CloseHandle(c->event);
 }
 
@@ -1047,7 +1131,7 @@ struct mp_cancel *mp_cancel_new(void *talloc_ctx)
     return c;
 }
 
-void mp_cancel_trigger(struct mp_cancel *c)
+static void cancel_set(struct mp_cancel *c)
 {
     atomic_store(&c->triggered, true);
     SetEvent(c->event);
@@ -1082,6 +1166,62 @@ int mp_cancel_get_fd(struct mp_cancel *c)
 
 #endif
 
+static void trigger_locked(struct mp_cancel *c)
+{
+    cancel_set(c);
+    for (int n = 0; n < c->num_slaves; n++)
+        trigger_locked(c->slaves[n]);
+}
+
+// Request abort. This also aborts all slaves (see mp_cancel_set_parent()).
+void mp_cancel_trigger(struct mp_cancel *c)
+{
+    pthread_mutex_lock(&cancel_lock);
+    trigger_locked(c);
+    pthread_mutex_unlock(&cancel_lock);
+}
+
+static void remove_slave_locked(struct mp_cancel *slave)
+{
+    struct mp_cancel *parent = slave->parent;
+    if (!parent)
+        return;
+    for (int n = 0; n < parent->num_slaves; n++) {
+        if (parent->slaves[n] == slave) {
+            MP_TARRAY_REMOVE_AT(parent->slaves, parent->num_slaves, n);
+            break;
+        }
+    }
+    slave->parent = NULL;
+}
+
+static void cancel_unlink(struct mp_cancel *c)
+{
+    pthread_mutex_lock(&cancel_lock);
+    remove_slave_locked(c);
+    for (int n = 0; n < c->num_slaves; n++)
+        c->slaves[n]->parent = NULL;
+    c->num_slaves = 0;
+    pthread_mutex_unlock(&cancel_lock);
+}
+
+// Make slave get triggered whenever parent is triggered (including right now,
+// if parent is already triggered). Resetting parent does not reset slave.
+// parent==NULL removes the link. The link is removed automatically if either
+// of them is destroyed.
+void mp_cancel_set_parent(struct mp_cancel *slave, struct mp_cancel *parent)
+{
+    pthread_mutex_lock(&cancel_lock);
+    remove_slave_locked(slave);
+    if (parent) {
+        MP_TARRAY_APPEND(parent, parent->slaves, parent->num_slaves, slave);
+        slave->parent = parent;
+        if (atomic_load(&parent->triggered))
+            trigger_locked(slave);
+    }
+    pthread_mutex_unlock(&cancel_lock);
+}
+
 char **stream_get_proto_list(void)
 {
     char **list = NULL;
@@ -70,6 +70,7 @@ enum stream_ctrl {
     STREAM_CTRL_GET_CACHE_INFO,
     STREAM_CTRL_SET_CACHE_SIZE,
     STREAM_CTRL_SET_READAHEAD,
+    STREAM_CTRL_SET_CACHE_BITRATE,      // double* (media bytes/s, <=0: unknown)
 
     // stream_memory.c
     STREAM_CTRL_SET_CONTENTS,
@@ -125,6 +126,18 @@ struct stream_cache_info {
     int64_t fill;
     bool idle;
     int64_t speed;
+    int64_t read_speed;     // bytes/s read by the client (1 second window)
+    int64_t total_read;     // total bytes read by the client
+    int64_t total_borrowed; // ... of which were passed on without copying
+    int64_t total_fetched;  // total bytes read from the underlying stream
+    int64_t waits;          // how often the client had to wait for data
+    // Adaptive readahead (--cache-adaptive) controller state
+    bool adaptive;
+    bool target_reached;    // stopped reading because readahead_target is full
+    int64_t readahead_target; // bytes to keep buffered ahead of the read pos
+    int64_t read_size;      // current size of a single read from the source
+    int64_t bitrate;        // media bitrate in bytes/s (0 if unknown)
+    int64_t link_speed;     // source speed while actually reading, bytes/s
 };
 
 struct stream_lang_req {
@@ -172,6 +185,13 @@ typedef struct stream {
 
     // Read
     int (*fill_buffer)(struct stream *s, char *buffer, int max_len);
+    // Optional: set *data to the stream's own memory at the current position,
+    // and return how many bytes are available there (at most max_len). Blocks
+    // like fill_buffer. Returns <= 0 on EOF or error. The data must stay valid
+    // until the next call on the stream.
+    int (*borrow_buffer)(struct stream *s, void **data, int max_len);
+    // Consume len bytes returned by borrow_buffer (required if it's set).
+    void (*commit_buffer)(struct stream *s, int len);
     // Write
     int (*write_buffer)(struct stream *s, char *buffer, int len);
     // Seek
@@ -213,6 +233,8 @@ typedef struct stream {
 
     struct stream *uncached_stream; // underlying stream for cache wrapper
 
+    unsigned char *borrowed; // last data returned by borrow_buffer
+
     // Includes additional padding in case sizes get rounded up by sector size.
     unsigned char buffer[];
 } stream_t;
@@ -258,6 +280,8 @@ bool stream_seek(stream_t *s, int64_t pos);
 int stream_read(stream_t *s, char *mem, int total);
 int stream_read_partial(stream_t *s, char *buf, int buf_size);
 struct bstr stream_peek(stream_t *s, int len);
+struct bstr stream_borrow(stream_t *s, int max_len);
+void stream_commit(stream_t *s, int len);
 void stream_drop_buffers(stream_t *s);
 int64_t stream_get_size(stream_t *s);
 
@@ -283,6 +307,7 @@ void mp_cancel_trigger(struct mp_cancel *c);
 bool mp_cancel_test(struct mp_cancel *c);
 bool mp_cancel_wait(struct mp_cancel *c, double timeout);
 void mp_cancel_reset(struct mp_cancel *c);
+void mp_cancel_set_parent(struct mp_cancel *slave, struct mp_cancel *parent);
 void *mp_cancel_get_event(struct mp_cancel *c); // win32 HANDLE
 int mp_cancel_get_fd(struct mp_cancel *c);
 
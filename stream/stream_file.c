@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -30,12 +31,17 @@
 #include <poll.h>
 #endif
 
+#if HAVE_POSIX
+#include <sys/mman.h>
+#endif
+
 #include "osdep/io.h"
 
 #include "common/common.h"
 #include "common/msg.h"
 #include "stream.h"
 #include "options/m_option.h"
+#include "options/options.h"
 #include "options/path.h"
 
 #if HAVE_BSD_FSTATFS
@@ -61,6 +67,15 @@ struct priv {
     int fd;
     bool close;
     bool regular;
+
+    // --stream-file-mmap
+    void *map;          // whole file as it was at open time, or NULL
+    int64_t map_len;    // size of the mapping (for munmap())
+    int64_t map_size;   // readable part of the mapping (shrinks on truncation)
+    int64_t map_pos;    // read position (the fd position is not used)
+    int64_t advised;    // end of the range last passed to POSIX_MADV_WILLNEED;
+                        // data is read from the mapping only up to this point
+    int64_t page_size;
 };
 
 static int fill_buffer(stream_t *s, char *buffer, int max_len)
@@ -103,6 +118,96 @@ static int seek(stream_t *s, int64_t newpos)
     return lseek(p->fd, newpos, SEEK_SET) != (off_t)-1;
 }
 
+#if HAVE_POSIX
+
+// How far ahead of the read position the OS is asked to page in data.
+#define MMAP_READAHEAD (4 * 1024 * 1024)
+
+static void map_advise(struct priv *p)
+{
+    if (p->advised - p->map_pos > MMAP_READAHEAD / 2)
+        return;
+    // Accessing pages beyond the end of a truncated file raises SIGBUS. Check
+    // the size each time the window moves, which catches most truncations
+    // before the removed part is touched (but can't rule out races).
+    struct stat st;
+    if (fstat(p->fd, &st) == 0 && st.st_size < p->map_size)
+        p->map_size = MPMAX(st.st_size, 0);
+    int64_t start = MPMAX(p->advised, p->map_pos) & ~(p->page_size - 1);
+    int64_t end = MPMIN(p->map_pos + MMAP_READAHEAD, p->map_size);
+    if (end > start)
+        posix_madvise((char *)p->map + start, end - start, POSIX_MADV_WILLNEED);
+    p->advised = end;
+}
+
+static int map_borrow_buffer(stream_t *s, void **data, int max_len)
+{
+    struct priv *p = s->priv;
+    map_advise(p);
+    int64_t end = MPMIN(p->advised, p->map_size);
+    if (p->map_pos >= end)
+        return 0;
+    *data = (char *)p->map + p->map_pos;
+    return MPMIN(max_len, end - p->map_pos);
+}
+
+static void map_commit_buffer(stream_t *s, int len)
+{
+    struct priv *p = s->priv;
+    p->map_pos += len;
+}
+
+static int map_fill_buffer(stream_t *s, char *buffer, int max_len)
+{
+    struct priv *p = s->priv;
+    void *data;
+    int len = map_borrow_buffer(s, &data, max_len);
+    if (len > 0) {
+        memcpy(buffer, data, len);
+    } else {
+        // The file might have grown since it was mapped.
+        len = pread(p->fd, buffer, max_len, p->map_pos);
+        if (len <= 0)
+            return -1;
+    }
+    p->map_pos += len;
+    return len;
+}
+
+static int map_seek(stream_t *s, int64_t newpos)
+{
+    struct priv *p = s->priv;
+    p->map_pos = newpos;
+    p->advised = newpos;
+    return 1;
+}
+
+// Switch the stream to reading from a mapping of the whole file. On failure,
+// the stream is left as it is, and reads with read() as usual.
+static void map_file(stream_t *s, int64_t size)
+{
+    struct priv *p = s->priv;
+    if (size <= 0 || (uint64_t)size > SIZE_MAX)
+        return;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, p->fd, 0);
+    if (map == MAP_FAILED) {
+        MP_VERBOSE(s, "Cannot map file: %s\n", mp_strerror(errno));
+        return;
+    }
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+    p->map = map;
+    p->map_len = p->map_size = size;
+    p->map_pos = p->advised = 0;
+    p->page_size = MPMAX(sysconf(_SC_PAGESIZE), 1);
+    s->fill_buffer = map_fill_buffer;
+    s->borrow_buffer = map_borrow_buffer;
+    s->commit_buffer = map_commit_buffer;
+    s->seek = map_seek;
+    MP_VERBOSE(s, "Reading file through a memory mapping.\n");
+}
+
+#endif
+
 static int control(stream_t *s, int cmd, void *arg)
 {
     struct priv *p = s->priv;
@@ -123,6 +228,10 @@ static int control(stream_t *s, int cmd, void *arg)
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
+#if HAVE_POSIX
+    if (p->map)
+        munmap(p->map, p->map_len);
+#endif
     if (p->close && p->fd >= 0)
         close(p->fd);
 }
@@ -316,6 +425,12 @@ static int open_f(stream_t *stream)
     if (check_stream_network(p->fd))
         stream->streaming = true;
 
+#if HAVE_POSIX
+    if (stream->opts->stream_file_mmap && p->regular && !write &&
+        !stream->streaming && len != (off_t)-1)
+        map_file(stream, len);
+#endif
+
     return STREAM_OK;
 }
 
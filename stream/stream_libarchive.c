@@ -18,9 +18,12 @@
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <libavutil/intreadwrite.h>
+
 #include "misc/bstr.h"
 #include "common/common.h"
 #include "stream.h"
+#include "rar.h"
 
 #include "stream_libarchive.h"
 
@@ -303,18 +306,67 @@ bool mp_archive_next_entry(struct mp_archive *mpa)
     return false;
 }
 
+// Maximum number of extra archive handles kept around for seeking in
+// compressed entries.
+#define MAX_CHECKPOINTS 3
+
+// An archive handle with its decoder positioned at pos within the entry.
+struct checkpoint {
+    struct mp_archive *mpa;
+    struct stream *src;     // primary volume as read by mpa
+    int64_t pos;
+};
+
+// Part of a stored entry, which can be read from the volume directly.
+struct entry_range {
+    char *url;              // volume the data is in
+    int64_t offset;         // byte position within the volume
+    int64_t start;          // byte position within the entry
+    int64_t size;
+};
+
 struct priv {
     struct mp_archive *mpa;
+    struct stream *mpa_src;
     struct stream *src;
     int64_t entry_size;
     char *entry_name;
+
+    // Stored entries: the entry data as byte ranges of the volumes. If set,
+    // the entry is read from them, and libarchive is not used anymore.
+    struct entry_range *ranges;
+    int num_ranges;
+    struct stream *volume;  // opened on demand for reading a range
+
+    // Compressed entries: handles left over from seeking backwards.
+    struct checkpoint checkpoints[MAX_CHECKPOINTS];
+    int num_checkpoints;
 };
 
+static void free_handle(struct priv *p, struct mp_archive *mpa,
+                        struct stream *src)
+{
+    mp_archive_free(mpa);
+    if (src != p->src)
+        free_stream(src);
+}
+
+// Open the archive again, and skip to the entry. Except for the first time,
+// this uses a separate stream for the primary volume, so that the new handle
+// doesn't interfere with the checkpoints.
 static int reopen_archive(stream_t *s)
 {
     struct priv *p = s->priv;
-    mp_archive_free(p->mpa);
-    p->mpa = mp_archive_new(s->log, p->src, MP_ARCHIVE_FLAG_UNSAFE);
+    free_handle(p, p->mpa, p->mpa_src);
+    p->mpa = NULL;
+    p->mpa_src = p->src;
+    if (p->num_checkpoints) {
+        p->mpa_src = stream_create(p->src->url, STREAM_READ | STREAM_SAFE_ONLY,
+                                   s->cancel, s->global);
+        if (!p->mpa_src)
+            return STREAM_ERROR;
+    }
+    p->mpa = mp_archive_new(s->log, p->mpa_src, MP_ARCHIVE_FLAG_UNSAFE);
     if (!p->mpa)
         return STREAM_ERROR;
 
@@ -329,15 +381,263 @@ static int reopen_archive(stream_t *s)
         }
     }
 
-    mp_archive_free(p->mpa);
+    free_handle(p, p->mpa, p->mpa_src);
     p->mpa = NULL;
     MP_ERR(s, "archive entry not found. '%s'\n", p->entry_name);
     return STREAM_ERROR;
 }
 
+static void add_range(struct priv *p, const char *url, int64_t offset,
+                      int64_t size)
+{
+    struct entry_range r = {
+        .url = talloc_strdup(p, url),
+        .offset = offset,
+        .size = size,
+    };
+    if (p->num_ranges) {
+        struct entry_range *last = &p->ranges[p->num_ranges - 1];
+        r.start = last->start + last->size;
+    }
+    MP_TARRAY_APPEND(p, p->ranges, p->num_ranges, r);
+}
+
+static bool read_at(struct stream *src, int64_t pos, void *buf, int len)
+{
+    return stream_seek(src, pos) && stream_read(src, buf, len) == len;
+}
+
+// Find the entry in the zip central directory, and add it if it's stored.
+// Neither zip64 nor split archives are handled.
+static void index_zip(stream_t *s, struct stream *src)
+{
+    struct priv *p = s->priv;
+    int64_t size = stream_get_size(src);
+    if (size < 22)
+        return;
+
+    int tail_len = MPMIN(size, 22 + 65535);
+    uint8_t *tail = talloc_size(NULL, tail_len);
+    uint8_t *cd = NULL;
+    if (!read_at(src, size - tail_len, tail, tail_len))
+        goto done;
+
+    // "End of central directory" record, followed by a comment.
+    uint8_t *eocd = NULL;
+    for (int n = tail_len - 22; n >= 0; n--) {
+        if (AV_RL32(tail + n) == 0x06054b50) {
+            eocd = tail + n;
+            break;
+        }
+    }
+    if (!eocd || AV_RL16(eocd + 4) || AV_RL16(eocd + 6))
+        goto done;
+    uint32_t cd_size = AV_RL32(eocd + 12);
+    uint32_t cd_offset = AV_RL32(eocd + 16);
+    if (cd_offset == 0xFFFFFFFF || cd_size > 64 * 1024 * 1024)
+        goto done;
+    cd = talloc_size(NULL, cd_size);
+    if (!read_at(src, cd_offset, cd, cd_size))
+        goto done;
+
+    size_t name_len = strlen(p->entry_name);
+    uint32_t pos = 0;
+    while (pos + 46 <= cd_size && AV_RL32(cd + pos) == 0x02014b50) {
+        uint8_t *e = cd + pos;
+        int e_name_len = AV_RL16(e + 28);
+        if (pos + 46 + e_name_len > cd_size)
+            break;
+        if (e_name_len == name_len &&
+            memcmp(e + 46, p->entry_name, name_len) == 0)
+        {
+            // Only method 0 (stored) without encryption is a plain copy.
+            uint32_t csize = AV_RL32(e + 20), usize = AV_RL32(e + 24);
+            uint32_t header = AV_RL32(e + 42);
+            uint8_t h[30];
+            if (AV_RL16(e + 10) == 0 && !(AV_RL16(e + 8) & 1) &&
+                csize == usize && csize != 0xFFFFFFFF &&
+                read_at(src, header, h, sizeof(h)) &&
+                AV_RL32(h) == 0x04034b50)
+            {
+                int64_t data = header + 30 + AV_RL16(h + 26) + AV_RL16(h + 28);
+                add_range(p, src->url, data, usize);
+            }
+            break;
+        }
+        pos += 46 + e_name_len + AV_RL16(e + 30) + AV_RL16(e + 32);
+    }
+
+done:
+    talloc_free(tail);
+    talloc_free(cd);
+}
+
+// Use the uncompressed RAR parser from rar.c, which also follows the entry
+// across volumes.
+static void index_rar(stream_t *s, struct stream *src)
+{
+    struct priv *p = s->priv;
+    int count;
+    rar_file_t **files;
+    if (RarProbe(src) || RarParse(src, &count, &files))
+        return;
+    for (int i = 0; i < count; i++) {
+        rar_file_t *f = files[i];
+        if (!p->num_ranges && f->is_complete &&
+            strcmp(f->name, p->entry_name) == 0)
+        {
+            for (int n = 0; n < f->chunk_count; n++) {
+                rar_file_chunk_t *c = f->chunk[n];
+                add_range(p, c->mrl, c->offset, c->size);
+            }
+        }
+        RarFileDelete(f);
+    }
+    talloc_free(files);
+}
+
+static int read_ranges(stream_t *s, int64_t pos, char *buffer, int max_len)
+{
+    struct priv *p = s->priv;
+    struct entry_range *r = NULL;
+    for (int n = 0; n < p->num_ranges; n++) {
+        if (pos >= p->ranges[n].start &&
+            pos < p->ranges[n].start + p->ranges[n].size)
+        {
+            r = &p->ranges[n];
+            break;
+        }
+    }
+    if (!r)
+        return 0;
+
+    if (p->volume && strcmp(p->volume->url, r->url) != 0) {
+        free_stream(p->volume);
+        p->volume = NULL;
+    }
+    if (!p->volume) {
+        p->volume = stream_create(r->url, STREAM_READ | STREAM_SAFE_ONLY,
+                                  s->cancel, s->global);
+        if (!p->volume)
+            return -1;
+    }
+
+    int64_t vpos = r->offset + (pos - r->start);
+    if (stream_tell(p->volume) != vpos && !stream_seek(p->volume, vpos))
+        return -1;
+    int len = MPMIN(max_len, r->start + r->size - pos);
+    return stream_read_partial(p->volume, buffer, len);
+}
+
+// Map a stored entry to byte ranges of the volumes, so that seeking is done
+// directly on the volume streams. Called right after the first open, while
+// the libarchive handle is still at the start of the entry.
+static void index_entry(stream_t *s)
+{
+    struct priv *p = s->priv;
+    if (p->entry_size < 0 || !p->src->seekable)
+        return;
+
+    int format = archive_format(p->mpa->arch) & ARCHIVE_FORMAT_BASE_MASK;
+    if (format != ARCHIVE_FORMAT_ZIP && format != ARCHIVE_FORMAT_RAR)
+        return;
+
+    struct stream *src = stream_create(p->src->url,
+                                       STREAM_READ | STREAM_SAFE_ONLY,
+                                       s->cancel, s->global);
+    if (!src)
+        return;
+    // rar.c complains about every compressed file it skips.
+    src->log = mp_null_log;
+    if (format == ARCHIVE_FORMAT_ZIP)
+        index_zip(s, src);
+    if (format == ARCHIVE_FORMAT_RAR)
+        index_rar(s, src);
+    free_stream(src);
+
+    int64_t size = 0;
+    for (int n = 0; n < p->num_ranges; n++)
+        size += p->ranges[n].size;
+
+    // Compare the start of the entry as decoded by libarchive, in case the
+    // archive is laid out in some way the parsers above don't expect.
+    bool ok = p->num_ranges && size == p->entry_size;
+    if (ok) {
+        char a[4096], b[4096];
+        int len = MPMIN(p->entry_size, sizeof(a));
+        int got = 0;
+        while (got < len) {
+            int r = archive_read_data(p->mpa->arch, a + got, len - got);
+            if (r <= 0)
+                break;
+            got += r;
+        }
+        int got_direct = 0;
+        while (got_direct < len) {
+            int r = read_ranges(s, got_direct, b + got_direct, len - got_direct);
+            if (r <= 0)
+                break;
+            got_direct += r;
+        }
+        ok = got == len && got_direct == len && memcmp(a, b, len) == 0;
+        if (!ok) {
+            MP_WARN(s, "archive entry index does not match, not using it\n");
+            p->num_ranges = 0;
+            if (got > 0)
+                reopen_archive(s);
+        }
+    } else {
+        p->num_ranges = 0;
+    }
+
+    if (ok) {
+        MP_VERBOSE(s, "reading stored entry directly from %d range(s)\n",
+                   p->num_ranges);
+        free_handle(p, p->mpa, p->mpa_src);
+        p->mpa = NULL;
+    }
+}
+
+static void free_checkpoints(struct priv *p)
+{
+    for (int n = 0; n < p->num_checkpoints; n++)
+        free_handle(p, p->checkpoints[n].mpa, p->checkpoints[n].src);
+    p->num_checkpoints = 0;
+}
+
+// Keep the current handle as checkpoint at pos. If there are too many, the
+// one closest to the start of the entry is dropped, as it's the cheapest to
+// restore by reopening.
+static void park_handle(struct priv *p, int64_t pos)
+{
+    if (!p->mpa || pos <= 0) {
+        free_handle(p, p->mpa, p->mpa_src);
+    } else {
+        if (p->num_checkpoints == MAX_CHECKPOINTS) {
+            int min = 0;
+            for (int n = 1; n < p->num_checkpoints; n++) {
+                if (p->checkpoints[n].pos < p->checkpoints[min].pos)
+                    min = n;
+            }
+            struct checkpoint *c = &p->checkpoints[min];
+            free_handle(p, c->mpa, c->src);
+            MP_TARRAY_REMOVE_AT(p->checkpoints, p->num_checkpoints, min);
+        }
+        p->checkpoints[p->num_checkpoints++] = (struct checkpoint){
+            .mpa = p->mpa,
+            .src = p->mpa_src,
+            .pos = pos,
+        };
+    }
+    p->mpa = NULL;
+    p->mpa_src = NULL;
+}
+
 static int archive_entry_fill_buffer(stream_t *s, char *buffer, int max_len)
 {
     struct priv *p = s->priv;
+    if (p->num_ranges)
+        return read_ranges(s, s->pos, buffer, max_len);
     if (!p->mpa)
         return 0;
     int r = archive_read_data(p->mpa->arch, buffer, max_len);
@@ -349,15 +649,38 @@ static int archive_entry_fill_buffer(stream_t *s, char *buffer, int max_len)
 static int archive_entry_seek(stream_t *s, int64_t newpos)
 {
     struct priv *p = s->priv;
+    // Stored entries: read_ranges() seeks the volume on the next read.
+    if (p->num_ranges)
+        return 1;
     if (!p->mpa)
         return -1;
     if (archive_seek_data(p->mpa->arch, newpos, SEEK_SET) >= 0)
         return 1;
-    // libarchive can't seek in most formats.
-    if (newpos < s->pos) {
+    // libarchive can't seek in most formats, and decoder state can't be
+    // saved. Continue with whichever handle is closest before the target:
+    // the current one, one parked by a previous backward seek, or a new one.
+    int best = -1;
+    int64_t best_pos = newpos >= s->pos ? s->pos : -1;
+    for (int n = 0; n < p->num_checkpoints; n++) {
+        if (p->checkpoints[n].pos <= newpos && p->checkpoints[n].pos > best_pos)
+        {
+            best = n;
+            best_pos = p->checkpoints[n].pos;
+        }
+    }
+    if (best >= 0) {
+        struct checkpoint c = p->checkpoints[best];
+        MP_TARRAY_REMOVE_AT(p->checkpoints, p->num_checkpoints, best);
+        MP_VERBOSE(s, "resuming archive decoding at %"PRId64"\n", c.pos);
+        park_handle(p, s->pos);
+        p->mpa = c.mpa;
+        p->mpa_src = c.src;
+        s->pos = c.pos;
+    } else if (best_pos < 0) {
         // Hack seeking backwards into working by reopening the archive and
         // starting over.
         MP_VERBOSE(s, "trying to reopen archive for performing seek\n");
+        park_handle(p, s->pos);
         if (reopen_archive(s) < STREAM_OK)
             return -1;
         s->pos = 0;
@@ -382,7 +705,9 @@ static int archive_entry_seek(stream_t *s, int64_t newpos)
 static void archive_entry_close(stream_t *s)
 {
     struct priv *p = s->priv;
-    mp_archive_free(p->mpa);
+    free_checkpoints(p);
+    free_handle(p, p->mpa, p->mpa_src);
+    free_stream(p->volume);
     free_stream(p->src);
 }
 
@@ -428,6 +753,7 @@ static int archive_entry_open(stream_t *stream)
         archive_entry_close(stream);
         return r;
     }
+    index_entry(stream);
 
     stream->fill_buffer = archive_entry_fill_buffer;
     if (p->src->seekable) {
@@ -23,9 +23,12 @@
 
 #include <libswscale/swscale.h>
 #include <libavutil/common.h>
+#include <libavutil/cpu.h>
 
+#include "config.h"
 #include "common/common.h"
 #include "draw_bmp.h"
+#include "draw_bmp_kernels.h"
 #include "img_convert.h"
 #include "video/mp_image.h"
 #include "video/sws_utils.h"
@@ -55,6 +58,7 @@ struct mp_draw_sub_cache
     struct part *parts[MAX_OSD_PARTS];
     struct mp_image *upsample_img;
     struct mp_image upsample_temp;
+    const struct draw_bmp_kernels *kernels;
 };
 
 
@@ -66,77 +70,120 @@ static bool get_sub_area(struct mp_rect bb, struct mp_image *temp,
 
 #define CONDITIONAL 1
 
-#define BLEND_CONST_ALPHA(TYPE)                                                 \
-    TYPE *dst_r = dst_rp;                                                       \
+#define BLEND_CONST_ALPHA(TYPE, NAME)                                           \
+static void NAME(TYPE *dst_r, int srcp, const uint8_t *srca_r,                  \
+                 uint8_t srcamul, int w)                                        \
+{                                                                               \
     for (int x = 0; x < w; x++) {                                               \
         uint32_t srcap = srca_r[x];                                             \
         if (CONDITIONAL && !srcap) continue;                                    \
         srcap *= srcamul; /* now 0..65025 */                                    \
         dst_r[x] = (srcp * srcap + dst_r[x] * (65025 - srcap) + 32512) / 65025; \
-    }
+    }                                                                           \
+}
+
+BLEND_CONST_ALPHA(uint8_t, blend_const_alpha_8_c)
+BLEND_CONST_ALPHA(uint16_t, blend_const_alpha_16_c)
+
+#define BLEND_SRC_ALPHA(TYPE, NAME)                                             \
+static void NAME(TYPE *dst_r, const TYPE *src_r, const uint8_t *srca_r, int w)  \
+{                                                                               \
+    for (int x = 0; x < w; x++) {                                               \
+        uint32_t srcap = srca_r[x];                                             \
+        if (CONDITIONAL && !srcap) continue;                                    \
+        dst_r[x] = (src_r[x] * srcap + dst_r[x] * (255 - srcap) + 127) / 255;   \
+    }                                                                           \
+}
+
+BLEND_SRC_ALPHA(uint8_t, blend_src_alpha_8_c)
+BLEND_SRC_ALPHA(uint16_t, blend_src_alpha_16_c)
+
+// srcp is uint32_t, as srcp * 65025 overflows int for 16 bit planes.
+#define BLEND_SRC_DST_MUL(TYPE, MAX, NAME)                                      \
+static void NAME(TYPE *dst_r, const uint8_t *src_r, uint8_t srcmul, int w)      \
+{                                                                               \
+    for (int x = 0; x < w; x++) {                                               \
+        uint32_t srcp = src_r[x] * srcmul; /* now 0..65025 */                   \
+        dst_r[x] = (srcp * (MAX) + dst_r[x] * (65025 - srcp) + 32512) / 65025;  \
+    }                                                                           \
+}
+
+BLEND_SRC_DST_MUL(uint8_t, 255, blend_src_dst_mul_8_c)
+BLEND_SRC_DST_MUL(uint16_t, 65025, blend_src_dst_mul_16_c)
+
+const struct draw_bmp_kernels draw_bmp_kernels_c = {
+    .name = "C",
+    .blend_src_alpha_8 = blend_src_alpha_8_c,
+    .blend_src_alpha_16 = blend_src_alpha_16_c,
+    .blend_const_alpha_8 = blend_const_alpha_8_c,
+    .blend_const_alpha_16 = blend_const_alpha_16_c,
+    .blend_src_dst_mul_8 = blend_src_dst_mul_8_c,
+    .blend_src_dst_mul_16 = blend_src_dst_mul_16_c,
+};
+
+const struct draw_bmp_kernels *draw_bmp_get_kernels(void)
+{
+#if HAVE_AVX2_INTRINSICS
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+        return &draw_bmp_kernels_avx2;
+#endif
+#if HAVE_SSE2_INTRINSICS
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)
+        return &draw_bmp_kernels_sse2;
+#endif
+    return &draw_bmp_kernels_c;
+}
 
 // dst = srcp * (srca * srcamul) + dst * (1 - (srca * srcamul))
-static void blend_const_alpha(void *dst, int dst_stride, int srcp,
+static void blend_const_alpha(const struct draw_bmp_kernels *k,
+                              void *dst, int dst_stride, int srcp,
                               uint8_t *srca, int srca_stride, uint8_t srcamul,
                               int w, int h, int bytes)
 {
     if (!srcamul)
         return;
     for (int y = 0; y < h; y++) {
-        void *dst_rp = (uint8_t *)dst + dst_stride * y;
+        void *dst_r = (uint8_t *)dst + dst_stride * y;
         uint8_t *srca_r = srca + srca_stride * y;
         if (bytes == 2) {
-            BLEND_CONST_ALPHA(uint16_t)
+            k->blend_const_alpha_16(dst_r, srcp, srca_r, srcamul, w);
         } else if (bytes == 1) {
-            BLEND_CONST_ALPHA(uint8_t)
+            k->blend_const_alpha_8(dst_r, srcp, srca_r, srcamul, w);
         }
     }
 }
 
-#define BLEND_SRC_ALPHA(TYPE)                                                   \
-    TYPE *dst_r = dst_rp, *src_r = src_rp;                                      \
-    for (int x = 0; x < w; x++) {                                               \
-        uint32_t srcap = srca_r[x];                                             \
-        if (CONDITIONAL && !srcap) continue;                                    \
-        dst_r[x] = (src_r[x] * srcap + dst_r[x] * (255 - srcap) + 127) / 255;   \
-    }
-
 // dst = src * srca + dst * (1 - srca)
-static void blend_src_alpha(void *dst, int dst_stride, void *src,
+static void blend_src_alpha(const struct draw_bmp_kernels *k,
+                            void *dst, int dst_stride, void *src,
                             int src_stride, uint8_t *srca, int srca_stride,
                             int w, int h, int bytes)
 {
     for (int y = 0; y < h; y++) {
-        void *dst_rp = (uint8_t *)dst + dst_stride * y;
-        void *src_rp = (uint8_t *)src + src_stride * y;
+        void *dst_r = (uint8_t *)dst + dst_stride * y;
+        void *src_r = (uint8_t *)src + src_stride * y;
         uint8_t *srca_r = srca + srca_stride * y;
         if (bytes == 2) {
-            BLEND_SRC_ALPHA(uint16_t)
+            k->blend_src_alpha_16(dst_r, src_r, srca_r, w);
         } else if (bytes == 1) {
-            BLEND_SRC_ALPHA(uint8_t)
+            k->blend_src_alpha_8(dst_r, src_r, srca_r, w);
         }
     }
 }
 
-#define BLEND_SRC_DST_MUL(TYPE, MAX)                                            \
-    TYPE *dst_r = dst_rp;                                                       \
-    for (int x = 0; x < w; x++) {                                               \
-        uint16_t srcp = src_r[x] * srcmul; /* now 0..65025 */                   \
-        dst_r[x] = (srcp * (MAX) + dst_r[x] * (65025 - srcp) + 32512) / 65025;  \
-    }
-
 // dst = src * srcmul + dst * (1 - src * srcmul)
-static void blend_src_dst_mul(void *dst, int dst_stride,
+static void blend_src_dst_mul(const struct draw_bmp_kernels *k,
+                              void *dst, int dst_stride,
                               uint8_t *src, int src_stride, uint8_t srcmul,
                               int w, int h, int dst_bytes)
 {
     for (int y = 0; y < h; y++) {
-        void *dst_rp = (uint8_t *)dst + dst_stride * y;
+        void *dst_r = (uint8_t *)dst + dst_stride * y;
         uint8_t *src_r = (uint8_t *)src + src_stride * y;
         if (dst_bytes == 2) {
-            BLEND_SRC_DST_MUL(uint16_t, 65025)
+            k->blend_src_dst_mul_16(dst_r, src_r, srcmul, w);
         } else if (dst_bytes == 1) {
-            BLEND_SRC_DST_MUL(uint8_t, 255)
+            k->blend_src_dst_mul_8(dst_r, src_r, srcmul, w);
         }
     }
 }
@@ -206,6 +253,7 @@ static void draw_rgba(struct mp_draw_sub_cache *cache, struct mp_rect bb,
                       struct mp_image *temp, int bits,
                       struct sub_bitmaps *sbs)
 {
+    const struct draw_bmp_kernels *k = cache->kernels;
     struct part *part = get_cache(cache, sbs, temp);
     assert(part);
 
@@ -233,11 +281,12 @@ static void draw_rgba(struct mp_draw_sub_cache *cache, struct mp_rect bb,
         uint8_t *alpha_p = sba->planes[0] + src_y * sba->stride[0] + src_x;
         for (int p = 0; p < (temp->num_planes > 2 ? 3 : 1); p++) {
             void *src = sbi->planes[p] + src_y * sbi->stride[p] + src_x * bytes;
-            blend_src_alpha(dst.planes[p], dst.stride[p], src, sbi->stride[p],
-                            alpha_p, sba->stride[0], dst.w, dst.h, bytes);
+            blend_src_alpha(k, dst.planes[p], dst.stride[p], src,
+                            sbi->stride[p], alpha_p, sba->stride[0],
+                            dst.w, dst.h, bytes);
         }
         if (temp->num_planes >= 4) {
-            blend_src_dst_mul(dst.planes[3], dst.stride[3], alpha_p,
+            blend_src_dst_mul(k, dst.planes[3], dst.stride[3], alpha_p,
                               sba->stride[0], 255, dst.w, dst.h, bytes);
         }
 
@@ -249,6 +298,7 @@ static void draw_rgba(struct mp_draw_sub_cache *cache, struct mp_rect bb,
 static void draw_ass(struct mp_draw_sub_cache *cache, struct mp_rect bb,
                      struct mp_image *temp, int bits, struct sub_bitmaps *sbs)
 {
+    const struct draw_bmp_kernels *k = cache->kernels;
     struct mp_csp_params cspar = MP_CSP_PARAMS_DEFAULTS;
     mp_csp_set_image_params(&cspar, &temp->params);
     cspar.levels_out = MP_CSP_LEVELS_PC; // RGB (libass.color)
@@ -287,11 +337,11 @@ static void draw_ass(struct mp_draw_sub_cache *cache, struct mp_rect bb,
         int bytes = (bits + 7) / 8;
         uint8_t *alpha_p = (uint8_t *)sb->bitmap + src_y * sb->stride + src_x;
         for (int p = 0; p < (temp->num_planes > 2 ? 3 : 1); p++) {
-            blend_const_alpha(dst.planes[p], dst.stride[p], color_yuv[p],
+            blend_const_alpha(k, dst.planes[p], dst.stride[p], color_yuv[p],
                               alpha_p, sb->stride, a, dst.w, dst.h, bytes);
         }
         if (temp->num_planes >= 4) {
-            blend_src_dst_mul(dst.planes[3], dst.stride[3], alpha_p,
+            blend_src_dst_mul(k, dst.planes[3], dst.stride[3], alpha_p,
                               sb->stride, a, dst.w, dst.h, bytes);
         }
     }
@@ -501,8 +551,10 @@ void mp_draw_sub_bitmaps(struct mp_draw_sub_cache **cache, struct mp_image *dst,
         return;
 
     struct mp_draw_sub_cache *cache_ = cache ? *cache : NULL;
-    if (!cache_)
+    if (!cache_) {
         cache_ = talloc_zero(NULL, struct mp_draw_sub_cache);
+        cache_->kernels = draw_bmp_get_kernels();
+    }
 
     int format, bits;
     get_closest_y444_format(dst->imgfmt, &format, &bits);
@@ -0,0 +1,251 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include <immintrin.h>
+
+#include <stdint.h>
+
+#include "draw_bmp_kernels.h"
+
+// Same arithmetic as draw_bmp_sse2.c (see there), on 16 pixels at a time.
+
+static inline __m256i div255_epu16(__m256i x)
+{
+    __m256i t = _mm256_add_epi16(_mm256_srli_epi16(x, 8),
+                                 _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, t), 8);
+}
+
+static inline __m256i div255_epu32(__m256i x)
+{
+    __m256i q = _mm256_add_epi32(_mm256_srli_epi32(x, 8),
+                                 _mm256_add_epi32(_mm256_srli_epi32(x, 16),
+                                                  _mm256_srli_epi32(x, 24)));
+    __m256i r = _mm256_add_epi32(_mm256_sub_epi32(x, _mm256_slli_epi32(q, 8)),
+                                 q);
+    r = _mm256_add_epi32(r, _mm256_add_epi32(_mm256_srli_epi32(r, 8),
+                                             _mm256_set1_epi32(1)));
+    return _mm256_add_epi32(q, _mm256_srli_epi32(r, 8));
+}
+
+static inline __m256i div65025_epu32(__m256i x)
+{
+    return div255_epu32(div255_epu32(x));
+}
+
+// x / 65025 for x <= 255 * 65025 + 32512, i.e. when blending to 8 bit planes.
+// Cheaper than div65025_epu32(), as the first quotient estimate needs only 2
+// terms, and the second division fits the 16 bit formula.
+static inline __m256i div65025_epu24(__m256i x)
+{
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i q = _mm256_add_epi32(_mm256_srli_epi32(x, 8),
+                                 _mm256_srli_epi32(x, 16));
+    __m256i r = _mm256_add_epi32(_mm256_sub_epi32(x, _mm256_slli_epi32(q, 8)),
+                                 q);
+    r = _mm256_add_epi32(r, _mm256_add_epi32(_mm256_srli_epi32(r, 8), one));
+    q = _mm256_add_epi32(q, _mm256_srli_epi32(r, 8));
+    q = _mm256_add_epi32(q, _mm256_add_epi32(_mm256_srli_epi32(q, 8), one));
+    return _mm256_srli_epi32(q, 8);
+}
+
+enum {
+    DIV_255,
+    DIV_65025,
+    DIV_65025_8BIT,     // result fits into 8 bits, see div65025_epu24()
+};
+
+// (a * b + c * d + bias) / divisor for 16 unsigned 16 bit lanes. The 32 bit
+// intermediates are unpacked and packed within each 128 bit lane, which keeps
+// the pixel order intact.
+static inline __m256i mul_add_div_epu16(__m256i a, __m256i b, __m256i c,
+                                        __m256i d, __m256i bias, int div)
+{
+    __m256i ab_l = _mm256_mullo_epi16(a, b), ab_h = _mm256_mulhi_epu16(a, b);
+    __m256i cd_l = _mm256_mullo_epi16(c, d), cd_h = _mm256_mulhi_epu16(c, d);
+    __m256i lo = _mm256_add_epi32(_mm256_unpacklo_epi16(ab_l, ab_h),
+                                  _mm256_unpacklo_epi16(cd_l, cd_h));
+    __m256i hi = _mm256_add_epi32(_mm256_unpackhi_epi16(ab_l, ab_h),
+                                  _mm256_unpackhi_epi16(cd_l, cd_h));
+    lo = _mm256_add_epi32(lo, bias);
+    hi = _mm256_add_epi32(hi, bias);
+    if (div == DIV_255) {
+        lo = div255_epu32(lo);
+        hi = div255_epu32(hi);
+    } else if (div == DIV_65025_8BIT) {
+        lo = div65025_epu24(lo);
+        hi = div65025_epu24(hi);
+    } else {
+        lo = div65025_epu32(lo);
+        hi = div65025_epu32(hi);
+    }
+    return _mm256_packus_epi32(lo, hi);
+}
+
+static inline __m256i load_epu8(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+// Store 16 lanes with values 0..255 as bytes.
+static inline void store_epu8(uint8_t *p, __m256i v)
+{
+    v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+    _mm_storeu_si128((__m128i *)p, _mm256_castsi256_si128(v));
+}
+
+// True if all 16 bytes at p are 0. Blending with alpha 0 leaves dst unchanged.
+static inline int all_zero(const uint8_t *p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return _mm_testz_si128(v, v);
+}
+
+static void blend_src_alpha_8_avx2(uint8_t *dst, const uint8_t *src,
+                                   const uint8_t *srca, int w)
+{
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i c127 = _mm256_set1_epi16(127);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        if (all_zero(srca + x))
+            continue;
+        __m256i a = load_epu8(srca + x);
+        __m256i s = load_epu8(src + x);
+        __m256i d = load_epu8(dst + x);
+        __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(s, a),
+                        _mm256_mullo_epi16(d, _mm256_sub_epi16(c255, a)));
+        store_epu8(dst + x, div255_epu16(_mm256_add_epi16(v, c127)));
+    }
+    draw_bmp_kernels_c.blend_src_alpha_8(dst + x, src + x, srca + x, w - x);
+}
+
+static void blend_src_alpha_16_avx2(uint16_t *dst, const uint16_t *src,
+                                    const uint8_t *srca, int w)
+{
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i bias = _mm256_set1_epi32(127);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        if (all_zero(srca + x))
+            continue;
+        __m256i a = load_epu8(srca + x);
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + x));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+        __m256i r = mul_add_div_epu16(s, a, d, _mm256_sub_epi16(c255, a),
+                                      bias, DIV_255);
+        _mm256_storeu_si256((__m256i *)(dst + x), r);
+    }
+    draw_bmp_kernels_c.blend_src_alpha_16(dst + x, src + x, srca + x, w - x);
+}
+
+static void blend_const_alpha_8_avx2(uint8_t *dst, int srcp,
+                                     const uint8_t *srca, uint8_t srcamul,
+                                     int w)
+{
+    const __m256i c65025 = _mm256_set1_epi16((int16_t)65025);
+    const __m256i bias = _mm256_set1_epi32(32512);
+    const __m256i mul = _mm256_set1_epi16(srcamul);
+    const __m256i color = _mm256_set1_epi16(srcp);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        if (all_zero(srca + x))
+            continue;
+        __m256i a = _mm256_mullo_epi16(load_epu8(srca + x), mul);
+        __m256i d = load_epu8(dst + x);
+        store_epu8(dst + x, mul_add_div_epu16(color, a, d,
+                                    _mm256_sub_epi16(c65025, a), bias,
+                                    DIV_65025_8BIT));
+    }
+    draw_bmp_kernels_c.blend_const_alpha_8(dst + x, srcp, srca + x, srcamul,
+                                           w - x);
+}
+
+static void blend_const_alpha_16_avx2(uint16_t *dst, int srcp,
+                                      const uint8_t *srca, uint8_t srcamul,
+                                      int w)
+{
+    const __m256i c65025 = _mm256_set1_epi16((int16_t)65025);
+    const __m256i bias = _mm256_set1_epi32(32512);
+    const __m256i mul = _mm256_set1_epi16(srcamul);
+    const __m256i color = _mm256_set1_epi16((int16_t)srcp);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        if (all_zero(srca + x))
+            continue;
+        __m256i a = _mm256_mullo_epi16(load_epu8(srca + x), mul);
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+        __m256i r = mul_add_div_epu16(color, a, d, _mm256_sub_epi16(c65025, a),
+                                      bias, DIV_65025);
+        _mm256_storeu_si256((__m256i *)(dst + x), r);
+    }
+    draw_bmp_kernels_c.blend_const_alpha_16(dst + x, srcp, srca + x, srcamul,
+                                            w - x);
+}
+
+static void blend_src_dst_mul_8_avx2(uint8_t *dst, const uint8_t *src,
+                                     uint8_t srcmul, int w)
+{
+    const __m256i c65025 = _mm256_set1_epi16((int16_t)65025);
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i bias = _mm256_set1_epi32(32512);
+    const __m256i mul = _mm256_set1_epi16(srcmul);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        if (all_zero(src + x))
+            continue;
+        __m256i s = _mm256_mullo_epi16(load_epu8(src + x), mul);
+        __m256i d = load_epu8(dst + x);
+        store_epu8(dst + x, mul_add_div_epu16(s, c255, d,
+                                    _mm256_sub_epi16(c65025, s), bias,
+                                    DIV_65025_8BIT));
+    }
+    draw_bmp_kernels_c.blend_src_dst_mul_8(dst + x, src + x, srcmul, w - x);
+}
+
+static void blend_src_dst_mul_16_avx2(uint16_t *dst, const uint8_t *src,
+                                      uint8_t srcmul, int w)
+{
+    const __m256i c65025 = _mm256_set1_epi16((int16_t)65025);
+    const __m256i bias = _mm256_set1_epi32(32512);
+    const __m256i mul = _mm256_set1_epi16(srcmul);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        if (all_zero(src + x))
+            continue;
+        __m256i s = _mm256_mullo_epi16(load_epu8(src + x), mul);
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+        __m256i r = mul_add_div_epu16(s, c65025, d, _mm256_sub_epi16(c65025, s),
+                                      bias, DIV_65025);
+        _mm256_storeu_si256((__m256i *)(dst + x), r);
+    }
+    draw_bmp_kernels_c.blend_src_dst_mul_16(dst + x, src + x, srcmul, w - x);
+}
+
+const struct draw_bmp_kernels draw_bmp_kernels_avx2 = {
+    .name = "AVX2",
+    .blend_src_alpha_8 = blend_src_alpha_8_avx2,
+    .blend_src_alpha_16 = blend_src_alpha_16_avx2,
+    .blend_const_alpha_8 = blend_const_alpha_8_avx2,
+    .blend_const_alpha_16 = blend_const_alpha_16_avx2,
+    .blend_src_dst_mul_8 = blend_src_dst_mul_8_avx2,
+    .blend_src_dst_mul_16 = blend_src_dst_mul_16_avx2,
+};
+
+#pragma GCC pop_options
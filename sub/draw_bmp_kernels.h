@@ -0,0 +1,35 @@
+#ifndef MPLAYER_DRAW_BMP_KERNELS_H
+#define MPLAYER_DRAW_BMP_KERNELS_H
+
+#include <stdint.h>
+
+// Per-row blending kernels used by draw_bmp.c. All variants must produce
+// bit-identical results to draw_bmp_kernels_c (test/draw_bmp.c checks this).
+// srca/src alpha values are always 8 bit; "_16" refers to the dst/src planes.
+struct draw_bmp_kernels {
+    const char *name;
+    // dst = src * srca + dst * (1 - srca)
+    void (*blend_src_alpha_8)(uint8_t *dst, const uint8_t *src,
+                              const uint8_t *srca, int w);
+    void (*blend_src_alpha_16)(uint16_t *dst, const uint16_t *src,
+                               const uint8_t *srca, int w);
+    // dst = srcp * (srca * srcamul) + dst * (1 - (srca * srcamul))
+    void (*blend_const_alpha_8)(uint8_t *dst, int srcp, const uint8_t *srca,
+                                uint8_t srcamul, int w);
+    void (*blend_const_alpha_16)(uint16_t *dst, int srcp, const uint8_t *srca,
+                                 uint8_t srcamul, int w);
+    // dst = src * srcmul + dst * (1 - src * srcmul)
+    void (*blend_src_dst_mul_8)(uint8_t *dst, const uint8_t *src,
+                                uint8_t srcmul, int w);
+    void (*blend_src_dst_mul_16)(uint16_t *dst, const uint8_t *src,
+                                 uint8_t srcmul, int w);
+};
+
+extern const struct draw_bmp_kernels draw_bmp_kernels_c;
+extern const struct draw_bmp_kernels draw_bmp_kernels_sse2;
+extern const struct draw_bmp_kernels draw_bmp_kernels_avx2;
+
+// Return the fastest kernel set supported by the build and the running CPU.
+const struct draw_bmp_kernels *draw_bmp_get_kernels(void);
+
+#endif /* MPLAYER_DRAW_BMP_KERNELS_H */
@@ -0,0 +1,263 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#include <emmintrin.h>
+
+#include <stdint.h>
+
+#include "draw_bmp_kernels.h"
+
+// All divisions below are exact integer divisions, so that the results are
+// identical to the C kernels in draw_bmp.c.
+
+// x / 255 for unsigned 16 bit lanes; exact (and not overflowing) for
+// x <= 65279, which covers a * b + c * (255 - b) + 127 with 8 bit a, b, c.
+static inline __m128i div255_epu16(__m128i x)
+{
+    __m128i t = _mm_add_epi16(_mm_srli_epi16(x, 8), _mm_set1_epi16(1));
+    return _mm_srli_epi16(_mm_add_epi16(x, t), 8);
+}
+
+// x / 255 for unsigned 32 bit lanes, exact for the full range. q is an
+// underestimate of the quotient, and the remainder is fixed up with the
+// 16 bit formula above.
+static inline __m128i div255_epu32(__m128i x)
+{
+    __m128i q = _mm_add_epi32(_mm_srli_epi32(x, 8),
+                              _mm_add_epi32(_mm_srli_epi32(x, 16),
+                                            _mm_srli_epi32(x, 24)));
+    __m128i r = _mm_add_epi32(_mm_sub_epi32(x, _mm_slli_epi32(q, 8)), q);
+    r = _mm_add_epi32(r, _mm_add_epi32(_mm_srli_epi32(r, 8),
+                                       _mm_set1_epi32(1)));
+    return _mm_add_epi32(q, _mm_srli_epi32(r, 8));
+}
+
+static inline __m128i div65025_epu32(__m128i x)
+{
+    return div255_epu32(div255_epu32(x));
+}
+
+// x / 65025 for x <= 255 * 65025 + 32512, i.e. when blending to 8 bit planes.
+// Cheaper than div65025_epu32(), as the first quotient estimate needs only 2
+// terms, and the second division fits the 16 bit formula.
+static inline __m128i div65025_epu24(__m128i x)
+{
+    __m128i one = _mm_set1_epi32(1);
+    __m128i q = _mm_add_epi32(_mm_srli_epi32(x, 8), _mm_srli_epi32(x, 16));
+    __m128i r = _mm_add_epi32(_mm_sub_epi32(x, _mm_slli_epi32(q, 8)), q);
+    r = _mm_add_epi32(r, _mm_add_epi32(_mm_srli_epi32(r, 8), one));
+    q = _mm_add_epi32(q, _mm_srli_epi32(r, 8));
+    q = _mm_add_epi32(q, _mm_add_epi32(_mm_srli_epi32(q, 8), one));
+    return _mm_srli_epi32(q, 8);
+}
+
+// a * b + c * d + bias for 8 unsigned 16 bit lanes, with the 32 bit result
+// split into the low and high 4 lanes.
+static inline void mul_add_epu16(__m128i a, __m128i b, __m128i c, __m128i d,
+                                 __m128i bias, __m128i *lo, __m128i *hi)
+{
+    __m128i ab_l = _mm_mullo_epi16(a, b), ab_h = _mm_mulhi_epu16(a, b);
+    __m128i cd_l = _mm_mullo_epi16(c, d), cd_h = _mm_mulhi_epu16(c, d);
+    *lo = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(ab_l, ab_h),
+                                      _mm_unpacklo_epi16(cd_l, cd_h)), bias);
+    *hi = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(ab_l, ab_h),
+                                      _mm_unpackhi_epi16(cd_l, cd_h)), bias);
+}
+
+// Pack 32 bit lanes in the range 0..65535 to 16 bit lanes (SSE2 has only
+// the signed saturating pack).
+static inline __m128i pack_epu32(__m128i lo, __m128i hi)
+{
+    __m128i bias = _mm_set1_epi32(0x8000);
+    __m128i r = _mm_packs_epi32(_mm_sub_epi32(lo, bias),
+                                _mm_sub_epi32(hi, bias));
+    return _mm_add_epi16(r, _mm_set1_epi16(-0x8000));
+}
+
+// Zero-extend the low (hi=0) or high (hi=1) 8 bytes to 16 bit lanes.
+static inline __m128i unpack_epu8(__m128i v, int hi)
+{
+    __m128i zero = _mm_setzero_si128();
+    return hi ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+}
+
+// True if all 16 bytes are 0. Blending with alpha 0 leaves dst unchanged.
+static inline int all_zero(__m128i a)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) == 0xFFFF;
+}
+
+static void blend_src_alpha_8_sse2(uint8_t *dst, const uint8_t *src,
+                                   const uint8_t *srca, int w)
+{
+    const __m128i c255 = _mm_set1_epi16(255), c127 = _mm_set1_epi16(127);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(srca + x));
+        if (all_zero(a))
+            continue;
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i r[2];
+        for (int n = 0; n < 2; n++) {
+            __m128i a16 = unpack_epu8(a, n);
+            __m128i s16 = unpack_epu8(s, n);
+            __m128i d16 = unpack_epu8(d, n);
+            __m128i v = _mm_add_epi16(_mm_mullo_epi16(s16, a16),
+                            _mm_mullo_epi16(d16, _mm_sub_epi16(c255, a16)));
+            r[n] = div255_epu16(_mm_add_epi16(v, c127));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(r[0], r[1]));
+    }
+    draw_bmp_kernels_c.blend_src_alpha_8(dst + x, src + x, srca + x, w - x);
+}
+
+static void blend_src_alpha_16_sse2(uint16_t *dst, const uint16_t *src,
+                                    const uint8_t *srca, int w)
+{
+    const __m128i c255 = _mm_set1_epi16(255), c127 = _mm_set1_epi32(127);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i a = _mm_loadl_epi64((const __m128i *)(srca + x));
+        if (all_zero(a))
+            continue;
+        a = unpack_epu8(a, 0);
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i lo, hi;
+        mul_add_epu16(s, a, d, _mm_sub_epi16(c255, a), c127, &lo, &hi);
+        _mm_storeu_si128((__m128i *)(dst + x),
+                         pack_epu32(div255_epu32(lo), div255_epu32(hi)));
+    }
+    draw_bmp_kernels_c.blend_src_alpha_16(dst + x, src + x, srca + x, w - x);
+}
+
+static void blend_const_alpha_8_sse2(uint8_t *dst, int srcp,
+                                     const uint8_t *srca, uint8_t srcamul,
+                                     int w)
+{
+    const __m128i c65025 = _mm_set1_epi16((int16_t)65025);
+    const __m128i bias = _mm_set1_epi32(32512);
+    const __m128i mul = _mm_set1_epi16(srcamul), color = _mm_set1_epi16(srcp);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(srca + x));
+        if (all_zero(a))
+            continue;
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i r[2];
+        for (int n = 0; n < 2; n++) {
+            __m128i a16 = unpack_epu8(a, n);
+            __m128i d16 = unpack_epu8(d, n);
+            a16 = _mm_mullo_epi16(a16, mul);
+            __m128i lo, hi;
+            mul_add_epu16(color, a16, d16, _mm_sub_epi16(c65025, a16), bias,
+                          &lo, &hi);
+            r[n] = _mm_packs_epi32(div65025_epu24(lo), div65025_epu24(hi));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(r[0], r[1]));
+    }
+    draw_bmp_kernels_c.blend_const_alpha_8(dst + x, srcp, srca + x, srcamul,
+                                           w - x);
+}
+
+static void blend_const_alpha_16_sse2(uint16_t *dst, int srcp,
+                                      const uint8_t *srca, uint8_t srcamul,
+                                      int w)
+{
+    const __m128i c65025 = _mm_set1_epi16((int16_t)65025);
+    const __m128i bias = _mm_set1_epi32(32512);
+    const __m128i mul = _mm_set1_epi16(srcamul);
+    const __m128i color = _mm_set1_epi16((int16_t)srcp);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i a = _mm_loadl_epi64((const __m128i *)(srca + x));
+        if (all_zero(a))
+            continue;
+        a = _mm_mullo_epi16(unpack_epu8(a, 0), mul);
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i lo, hi;
+        mul_add_epu16(color, a, d, _mm_sub_epi16(c65025, a), bias, &lo, &hi);
+        _mm_storeu_si128((__m128i *)(dst + x),
+                         pack_epu32(div65025_epu32(lo), div65025_epu32(hi)));
+    }
+    draw_bmp_kernels_c.blend_const_alpha_16(dst + x, srcp, srca + x, srcamul,
+                                            w - x);
+}
+
+static void blend_src_dst_mul_8_sse2(uint8_t *dst, const uint8_t *src,
+                                     uint8_t srcmul, int w)
+{
+    const __m128i c65025 = _mm_set1_epi16((int16_t)65025);
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i bias = _mm_set1_epi32(32512);
+    const __m128i mul = _mm_set1_epi16(srcmul);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+        if (all_zero(s))
+            continue;
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i r[2];
+        for (int n = 0; n < 2; n++) {
+            __m128i s16 = unpack_epu8(s, n);
+            __m128i d16 = unpack_epu8(d, n);
+            s16 = _mm_mullo_epi16(s16, mul);
+            __m128i lo, hi;
+            mul_add_epu16(s16, c255, d16, _mm_sub_epi16(c65025, s16), bias,
+                          &lo, &hi);
+            r[n] = _mm_packs_epi32(div65025_epu24(lo), div65025_epu24(hi));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(r[0], r[1]));
+    }
+    draw_bmp_kernels_c.blend_src_dst_mul_8(dst + x, src + x, srcmul, w - x);
+}
+
+static void blend_src_dst_mul_16_sse2(uint16_t *dst, const uint8_t *src,
+                                      uint8_t srcmul, int w)
+{
+    const __m128i c65025 = _mm_set1_epi16((int16_t)65025);
+    const __m128i bias = _mm_set1_epi32(32512);
+    const __m128i mul = _mm_set1_epi16(srcmul);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i s = _mm_loadl_epi64((const __m128i *)(src + x));
+        if (all_zero(s))
+            continue;
+        s = _mm_mullo_epi16(unpack_epu8(s, 0), mul);
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i lo, hi;
+        mul_add_epu16(s, c65025, d, _mm_sub_epi16(c65025, s), bias, &lo, &hi);
+        _mm_storeu_si128((__m128i *)(dst + x),
+                         pack_epu32(div65025_epu32(lo), div65025_epu32(hi)));
+    }
+    draw_bmp_kernels_c.blend_src_dst_mul_16(dst + x, src + x, srcmul, w - x);
+}
+
+const struct draw_bmp_kernels draw_bmp_kernels_sse2 = {
+    .name = "SSE2",
+    .blend_src_alpha_8 = blend_src_alpha_8_sse2,
+    .blend_src_alpha_16 = blend_src_alpha_16_sse2,
+    .blend_const_alpha_8 = blend_const_alpha_8_sse2,
+    .blend_const_alpha_16 = blend_const_alpha_16_sse2,
+    .blend_src_dst_mul_8 = blend_src_dst_mul_8_sse2,
+    .blend_src_dst_mul_16 = blend_src_dst_mul_16_sse2,
+};
+
+#pragma GCC pop_options
@@ -0,0 +1,1055 @@
+/*
+ * Micro-benchmarks for some hot paths. Each benchmark runs a fixed number of
+ * iterations (scaled with --scale), so that results of different builds are
+ * comparable. The results are written as JSON to stdout.
+ *
+ * Usage: bench [--scale=<factor>] [--filter=<substring>] [--list]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libavutil/cpu.h>
+
+#include "config.h"
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "audio/audio.h"
+#include "audio/audio_buffer.h"
+#include "audio/format.h"
+#include "audio/filter/af.h"
+#include "common/playlist.h"
+#include "demux/demux.h"
+#include "demux/ebml.h"
+#include "demux/packet.h"
+#include "misc/bstr.h"
+#include "misc/json.h"
+#include "misc/node.h"
+#include "options/m_config.h"
+#include "options/m_property.h"
+#include "options/options.h"
+#include "options/parse_configfile.h"
+#include "osdep/timer.h"
+#include "stream/stream.h"
+#include "sub/draw_bmp.h"
+#include "sub/draw_bmp_kernels.h"
+#include "video/img_format.h"
+#include "video/mp_image.h"
+#include "video/mp_image_pool.h"
+#include "mpv_talloc.h"
+
+struct bench_ctx {
+    struct mpv_global *global;
+    void *ta_ctx;       // freed after the benchmark has finished
+    void *priv;         // for use by the benchmark
+    int64_t items;      // work units per iteration, for the rate output
+    const char *unit;   // name of the work unit
+};
+
+struct bench {
+    const char *name;
+    int iterations;                         // default iteration budget
+    bool (*init)(struct bench_ctx *ctx);    // untimed; false skips benchmark
+    void (*run)(struct bench_ctx *ctx);     // one timed iteration
+    void (*uninit)(struct bench_ctx *ctx);  // untimed
+};
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return rnd_state >> 8;
+}
+
+// --- bstr
+
+static bool init_bstr(struct bench_ctx *ctx)
+{
+    bstr *text = talloc_zero(ctx->ta_ctx, bstr);
+    for (int n = 0; n < 2000; n++) {
+        bstr_xappend_asprintf(ctx->ta_ctx, text,
+            "%d\n00:%02d:%02d,%03d --> 00:%02d:%02d,%03d\n"
+            "  Line %d with some text, key=value and \xc3\xbc\xc3\xb1\xc3\xaf"
+            "\xc3\xa7\xc3\xb6" "d\xc3\xa9  \n\n",
+            n + 1, n / 60 % 60, n % 60, n % 1000, n / 60 % 60, n % 60,
+            (n + 500) % 1000, n);
+    }
+    ctx->priv = text;
+    ctx->items = text->len;
+    ctx->unit = "bytes";
+    return true;
+}
+
+static void run_bstr(struct bench_ctx *ctx)
+{
+    bstr rest = *(bstr *)ctx->priv;
+    int found = 0;
+    while (rest.len) {
+        bstr line = bstr_strip(bstr_getline(rest, &rest));
+        bstr left, right;
+        if (bstr_find0(line, " --> ") >= 0)
+            found++;
+        if (bstr_split_tok(line, "=", &left, &right))
+            found += bstrcasecmp0(bstr_strip(left), "KEY") == 0;
+        if (bstr_validate_utf8(line) < 0)
+            abort();
+        found += bstr_startswith0(line, "Line");
+    }
+    if (!found)
+        abort();
+}
+
+// --- json
+
+static void make_json_node(void *ta_ctx, struct mpv_node *root)
+{
+    node_init(root, MPV_FORMAT_NODE_ARRAY, NULL);
+    for (int n = 0; n < 200; n++) {
+        struct mpv_node *e = node_array_add(root, MPV_FORMAT_NODE_MAP);
+        node_map_add(e, "id", MPV_FORMAT_INT64)->u.int64 = n;
+        node_map_add_string(e, "type", n % 2 ? "audio" : "video");
+        node_map_add(e, "selected", MPV_FORMAT_FLAG)->u.flag = n == 1;
+        node_map_add(e, "demux-fps", MPV_FORMAT_DOUBLE)->u.double_ = 23.976;
+        char title[80];
+        snprintf(title, sizeof(title), "Track \"%d\"\tcommentary \\ %s", n,
+                 "\xc3\xa4\xc3\xb6");
+        node_map_add_string(e, "title", title);
+        node_map_add_string(e, "lang", "eng");
+        struct mpv_node *l = node_map_add(e, "ff-index", MPV_FORMAT_NODE_ARRAY);
+        for (int i = 0; i < 4; i++)
+            node_array_add(l, MPV_FORMAT_INT64)->u.int64 = i * n;
+    }
+    talloc_steal(ta_ctx, root->u.list);
+}
+
+static bool init_json_write(struct bench_ctx *ctx)
+{
+    struct mpv_node *root = talloc_zero(ctx->ta_ctx, struct mpv_node);
+    make_json_node(ctx->ta_ctx, root);
+    ctx->priv = root;
+    ctx->items = root->u.list->num;
+    ctx->unit = "objects";
+    return true;
+}
+
+static void run_json_write(struct bench_ctx *ctx)
+{
+    char *s = talloc_strdup(NULL, "");
+    if (json_write(&s, ctx->priv) < 0)
+        abort();
+    talloc_free(s);
+}
+
+static bool init_json_parse(struct bench_ctx *ctx)
+{
+    struct mpv_node root;
+    make_json_node(ctx->ta_ctx, &root);
+    char *s = talloc_strdup(ctx->ta_ctx, "");
+    if (json_write(&s, &root) < 0)
+        return false;
+    ctx->priv = s;
+    ctx->items = strlen(s);
+    ctx->unit = "bytes";
+    return true;
+}
+
+static void run_json_parse(struct bench_ctx *ctx)
+{
+    void *tmp = talloc_new(NULL);
+    char *s = talloc_strdup(tmp, ctx->priv); // json_parse() mutates the input
+    struct mpv_node node;
+    if (json_parse(tmp, &node, &s, 50) < 0)
+        abort();
+    talloc_free(tmp);
+}
+
+// --- m_property
+
+#define NUM_PROPS 300
+
+static int prop_call(void *ctx, struct m_property *prop, int action, void *arg)
+{
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_INT};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+        *(int *)arg = 1;
+        return M_PROPERTY_OK;
+    case M_PROPERTY_KEY_ACTION: {
+        struct m_property_action_arg *ka = arg;
+        if (strcmp(ka->key, "sub") != 0)
+            return M_PROPERTY_UNKNOWN;
+        return prop_call(ctx, prop, ka->action, ka->arg);
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
+static bool init_property(struct bench_ctx *ctx)
+{
+    struct m_property *list = talloc_zero_array(ctx->ta_ctx, struct m_property,
+                                                NUM_PROPS + 1);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        list[n] = (struct m_property){
+            .name = talloc_asprintf(ctx->ta_ctx, "property-name-%d", n),
+            .call = prop_call,
+        };
+    }
+    ctx->priv = m_property_index_create(ctx->ta_ctx, list);
+    ctx->items = NUM_PROPS;
+    ctx->unit = "lookups";
+    return true;
+}
+
+static void run_property(struct bench_ctx *ctx)
+{
+    struct m_property_index *index = ctx->priv;
+    const struct m_property *list = m_property_index_list(index);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        if (m_property_index_lookup(index, bstr0(list[n].name)) != n)
+            abort();
+    }
+}
+
+// Baseline for run_property().
+static void run_property_list(struct bench_ctx *ctx)
+{
+    struct m_property_index *index = ctx->priv;
+    const struct m_property *list = m_property_index_list(index);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        if (m_property_list_find(list, list[n].name) != &list[n])
+            abort();
+    }
+}
+
+struct property_do_priv {
+    struct m_property_index *index;
+    char *names[NUM_PROPS];     // "<name>/sub"
+};
+
+static bool init_property_do(struct bench_ctx *ctx)
+{
+    init_property(ctx);
+    struct property_do_priv *p = talloc_zero(ctx->ta_ctx, struct property_do_priv);
+    p->index = ctx->priv;
+    const struct m_property *list = m_property_index_list(p->index);
+    for (int n = 0; n < NUM_PROPS; n++)
+        p->names[n] = talloc_asprintf(p, "%s/sub", list[n].name);
+    ctx->priv = p;
+    ctx->unit = "calls";
+    return true;
+}
+
+static void run_property_do(struct bench_ctx *ctx)
+{
+    struct property_do_priv *p = ctx->priv;
+    for (int n = 0; n < NUM_PROPS; n++) {
+        int val;
+        if (m_property_do(NULL, p->index, p->names[n], M_PROPERTY_GET, &val,
+                          NULL) != M_PROPERTY_OK)
+            abort();
+    }
+}
+
+// --- m_config
+
+#define CONFIG_TOP_OPTS 200
+#define CONFIG_PROFILES 20
+#define CONFIG_PROFILE_OPTS 50
+
+static struct m_config *new_config(void *ta_ctx)
+{
+    return m_config_new(ta_ctx, mp_null_log, sizeof(struct MPOpts),
+                        &mp_default_opts, mp_opts);
+}
+
+static bool init_config_parse(struct bench_ctx *ctx)
+{
+    // Use flag options that can be set from a config file, so that every
+    // line of the generated file is valid.
+    struct m_config *config = new_config(ctx->ta_ctx);
+    char **names = NULL;
+    int num_names = 0;
+    for (int n = 0; n < m_config_get_co_count(config); n++) {
+        struct m_config_option *co = m_config_get_co_index(config, n);
+        if (co->opt->type == &m_option_type_flag &&
+            !co->opt->deprecation_message &&
+            m_config_set_option_ext(config, bstr0(co->name), bstr0("yes"),
+                                    M_SETOPT_CHECK_ONLY |
+                                    M_SETOPT_FROM_CONFIG_FILE) >= 0)
+            MP_TARRAY_APPEND(ctx->ta_ctx, names, num_names, (char *)co->name);
+    }
+    if (!num_names)
+        return false;
+
+    bstr *text = talloc_zero(ctx->ta_ctx, bstr);
+    for (int n = 0; n < CONFIG_TOP_OPTS; n++) {
+        bstr_xappend_asprintf(ctx->ta_ctx, text, "%s=%s\n",
+                              names[rnd() % num_names], rnd() % 2 ? "yes" : "no");
+    }
+    for (int p = 0; p < CONFIG_PROFILES; p++) {
+        bstr_xappend_asprintf(ctx->ta_ctx, text, "[profile-%d]\n", p);
+        for (int n = 0; n < CONFIG_PROFILE_OPTS; n++) {
+            bstr_xappend_asprintf(ctx->ta_ctx, text, "%s=%s\n",
+                                  names[rnd() % num_names],
+                                  rnd() % 2 ? "yes" : "no");
+        }
+    }
+    ctx->priv = text;
+    ctx->items = CONFIG_TOP_OPTS + CONFIG_PROFILES * (CONFIG_PROFILE_OPTS + 1);
+    ctx->unit = "lines";
+    return true;
+}
+
+// Roughly what happens at startup: create the option tree, load a config
+// file, and apply the profiles defined in it.
+static void run_config_parse(struct bench_ctx *ctx)
+{
+    bstr *text = ctx->priv;
+    struct m_config *config = new_config(NULL);
+    m_config_parse(config, "bench.conf", *text, NULL, 0);
+    for (int p = 0; p < CONFIG_PROFILES; p++) {
+        char name[32];
+        snprintf(name, sizeof(name), "profile-%d", p);
+        if (m_config_set_profile(config, name, 0) < 0)
+            abort();
+    }
+    talloc_free(config);
+}
+
+struct sub_global_priv {
+    struct mpv_global *global;
+    struct m_config *config;
+    bool snapshot;
+    int n;
+    void *copies[2];
+};
+
+static bool init_sub_global(struct bench_ctx *ctx, bool snapshot)
+{
+    struct sub_global_priv *p = talloc_zero(ctx->ta_ctx, struct sub_global_priv);
+    p->global = talloc_zero(ctx->ta_ctx, struct mpv_global);
+    p->global->log = mp_null_log;
+    p->config = new_config(ctx->ta_ctx);
+    p->config->global = p->global;
+    m_config_create_shadow(p->config);
+    p->snapshot = snapshot;
+    ctx->priv = p;
+    ctx->unit = "files";
+    return true;
+}
+
+static bool init_sub_global_dup(struct bench_ctx *ctx)
+{
+    return init_sub_global(ctx, false);
+}
+
+static bool init_sub_global_snapshot(struct bench_ctx *ctx)
+{
+    return init_sub_global(ctx, true);
+}
+
+// What create_sub_global() does when opening a file in a playlist, with the
+// previous file's copy still alive (as with prefetching) and an option change
+// in between.
+static void run_sub_global(struct bench_ctx *ctx)
+{
+    struct sub_global_priv *p = ctx->priv;
+    m_config_set_option0(p->config, "pause", p->n % 2 ? "yes" : "no");
+    void **copy = &p->copies[p->n++ % 2];
+    talloc_free(*copy);
+    *copy = talloc_new(NULL);
+    if (p->snapshot) {
+        m_config_get_snapshot(*copy, p->global);
+    } else {
+        m_config_dup(*copy, p->config);
+    }
+}
+
+static void uninit_sub_global(struct bench_ctx *ctx)
+{
+    struct sub_global_priv *p = ctx->priv;
+    for (int n = 0; n < 2; n++)
+        talloc_free(p->copies[n]);
+}
+
+// --- playlist
+
+#define PLAYLIST_ENTRIES 100000
+#define PLAYLIST_EDITS 100
+
+static struct playlist *make_playlist(void *ta_ctx)
+{
+    struct playlist *pl = talloc_zero(ta_ctx, struct playlist);
+    for (int n = 0; n < PLAYLIST_ENTRIES; n++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/media/file-%06d.mkv", n);
+        playlist_add_file(pl, name);
+    }
+    return pl;
+}
+
+static bool init_playlist_build(struct bench_ctx *ctx)
+{
+    ctx->items = PLAYLIST_ENTRIES;
+    ctx->unit = "entries";
+    return true;
+}
+
+static void run_playlist_build(struct bench_ctx *ctx)
+{
+    struct playlist *pl = make_playlist(NULL);
+    if (playlist_entry_count(pl) != PLAYLIST_ENTRIES)
+        abort();
+    playlist_clear(pl);
+    talloc_free(pl);
+}
+
+static bool init_playlist(struct bench_ctx *ctx)
+{
+    ctx->priv = make_playlist(ctx->ta_ctx);
+    ctx->items = PLAYLIST_ENTRIES;
+    ctx->unit = "lookups";
+    return true;
+}
+
+// What a client enumerating playlist/N/filename does.
+static void run_playlist_index(struct bench_ctx *ctx)
+{
+    struct playlist *pl = ctx->priv;
+    for (int n = 0; n < playlist_entry_count(pl); n++) {
+        struct playlist_entry *e = playlist_entry_from_index(pl, n);
+        if (!e || playlist_entry_to_index(pl, e) != n)
+            abort();
+    }
+}
+
+static bool init_playlist_edit(struct bench_ctx *ctx)
+{
+    init_playlist(ctx);
+    ctx->items = PLAYLIST_EDITS * 3;
+    ctx->unit = "edits";
+    return true;
+}
+
+// Insert, move and remove entries at random positions.
+static void run_playlist_edit(struct bench_ctx *ctx)
+{
+    struct playlist *pl = ctx->priv;
+    for (int n = 0; n < PLAYLIST_EDITS; n++) {
+        int count = playlist_entry_count(pl);
+        struct playlist_entry *at = playlist_entry_from_index(pl, rnd() % count);
+        struct playlist_entry *e = playlist_entry_new("/media/inserted.mkv");
+        playlist_insert(pl, at, e);
+        playlist_move(pl, e, playlist_entry_from_index(pl, rnd() % count));
+        playlist_remove(pl, e);
+    }
+}
+
+// --- mp_image_pool
+
+#define POOL_IMAGES 4
+
+static bool init_image_pool(struct bench_ctx *ctx)
+{
+    struct mp_image_pool *pool = mp_image_pool_new(POOL_IMAGES);
+    talloc_steal(ctx->ta_ctx, pool);
+    ctx->priv = pool;
+    ctx->items = POOL_IMAGES;
+    ctx->unit = "images";
+    return true;
+}
+
+static void run_image_pool(struct bench_ctx *ctx)
+{
+    struct mp_image *imgs[POOL_IMAGES];
+    for (int n = 0; n < POOL_IMAGES; n++) {
+        imgs[n] = mp_image_pool_get(ctx->priv, IMGFMT_420P, 1920, 1080);
+        if (!imgs[n])
+            abort();
+    }
+    for (int n = 0; n < POOL_IMAGES; n++)
+        talloc_free(imgs[n]);
+}
+
+// --- draw_bmp
+
+#define SUB_LINES 2
+#define SUB_PARTS_PER_LINE 20
+
+struct draw_bmp_priv {
+    struct mp_image *img;
+    struct sub_bitmaps sbs;
+    struct mp_draw_sub_cache *cache;
+};
+
+static bool init_draw_bmp(struct bench_ctx *ctx, int imgfmt)
+{
+    struct draw_bmp_priv *p = talloc_zero(ctx->ta_ctx, struct draw_bmp_priv);
+    p->img = mp_image_alloc(imgfmt, 1920, 1080);
+    if (!p->img)
+        return false;
+    talloc_steal(p, p->img);
+    mp_image_clear(p->img, 0, 0, p->img->w, p->img->h);
+
+    // Roughly what libass produces for 2 lines of text: one bitmap per glyph
+    // (fill and outline), with partially transparent edges.
+    int pw = 48, ph = 64;
+    uint8_t *bitmap = talloc_size(p, pw * ph);
+    for (int y = 0; y < ph; y++) {
+        for (int x = 0; x < pw; x++) {
+            int r = (x - pw / 2) * (x - pw / 2) + (y - ph / 2) * (y - ph / 2);
+            bitmap[y * pw + x] = r < 300 ? 255 : r < 500 ? rnd() % 256 : 0;
+        }
+    }
+    p->sbs = (struct sub_bitmaps){ .format = SUBBITMAP_LIBASS, .change_id = 1 };
+    p->sbs.num_parts = SUB_LINES * SUB_PARTS_PER_LINE * 2;
+    p->sbs.parts = talloc_zero_array(p, struct sub_bitmap, p->sbs.num_parts);
+    for (int n = 0; n < p->sbs.num_parts; n++) {
+        int glyph = n / 2;
+        p->sbs.parts[n] = (struct sub_bitmap){
+            .bitmap = bitmap, .stride = pw,
+            .w = pw, .h = ph, .dw = pw, .dh = ph,
+            .x = 480 + (glyph % SUB_PARTS_PER_LINE) * (pw - 4) + n % 2,
+            .y = 900 + (glyph / SUB_PARTS_PER_LINE) * ph + n % 2,
+            .libass.color = n % 2 ? 0x00000000 : 0xFFFFFF00,
+        };
+    }
+    ctx->priv = p;
+    ctx->items = p->sbs.num_parts * pw * ph;
+    ctx->unit = "pixels";
+    return true;
+}
+
+static bool init_draw_bmp_8(struct bench_ctx *ctx)
+{
+    return init_draw_bmp(ctx, IMGFMT_420P);
+}
+
+static bool init_draw_bmp_10(struct bench_ctx *ctx)
+{
+    return init_draw_bmp(ctx, IMGFMT_420P10);
+}
+
+static void run_draw_bmp(struct bench_ctx *ctx)
+{
+    struct draw_bmp_priv *p = ctx->priv;
+    mp_draw_sub_bitmaps(&p->cache, p->img, &p->sbs);
+}
+
+static void uninit_draw_bmp(struct bench_ctx *ctx)
+{
+    struct draw_bmp_priv *p = ctx->priv;
+    talloc_free(p->cache);
+}
+
+// Single blending kernels (see test/draw_bmp.c for the correctness checks),
+// on a subtitle-sized area with mostly non-transparent alpha.
+
+#define KERNEL_W 1920
+#define KERNEL_H 256
+
+struct kernel_priv {
+    const struct draw_bmp_kernels *k;
+    uint8_t *a, *s8, *d8;
+    uint16_t *d16;
+};
+
+static bool init_kernels(struct bench_ctx *ctx,
+                         const struct draw_bmp_kernels *k, int cpu_flag)
+{
+    if (cpu_flag && !(av_get_cpu_flags() & cpu_flag))
+        return false;
+    struct kernel_priv *p = talloc_zero(ctx->ta_ctx, struct kernel_priv);
+    int size = KERNEL_W * KERNEL_H;
+    p->k = k;
+    p->a = talloc_size(p, size);
+    p->s8 = talloc_size(p, size);
+    p->d8 = talloc_size(p, size);
+    p->d16 = talloc_array(p, uint16_t, size);
+    for (int n = 0; n < size; n++) {
+        p->a[n] = rnd() % 256;
+        p->s8[n] = rnd() % 256;
+        p->d8[n] = rnd() % 256;
+        p->d16[n] = rnd() % 65536;
+    }
+    ctx->priv = p;
+    ctx->items = size;
+    ctx->unit = "pixels";
+    return true;
+}
+
+static bool init_kernels_c(struct bench_ctx *ctx)
+{
+    return init_kernels(ctx, &draw_bmp_kernels_c, 0);
+}
+
+#if HAVE_SSE2_INTRINSICS
+static bool init_kernels_sse2(struct bench_ctx *ctx)
+{
+    return init_kernels(ctx, &draw_bmp_kernels_sse2, AV_CPU_FLAG_SSE2);
+}
+#endif
+
+#if HAVE_AVX2_INTRINSICS
+static bool init_kernels_avx2(struct bench_ctx *ctx)
+{
+    return init_kernels(ctx, &draw_bmp_kernels_avx2, AV_CPU_FLAG_AVX2);
+}
+#endif
+
+static void run_src_alpha_8(struct bench_ctx *ctx)
+{
+    struct kernel_priv *p = ctx->priv;
+    for (int y = 0; y < KERNEL_H; y++) {
+        int o = y * KERNEL_W;
+        p->k->blend_src_alpha_8(p->d8 + o, p->s8 + o, p->a + o, KERNEL_W);
+    }
+}
+
+static void run_const_alpha_8(struct bench_ctx *ctx)
+{
+    struct kernel_priv *p = ctx->priv;
+    for (int y = 0; y < KERNEL_H; y++) {
+        int o = y * KERNEL_W;
+        p->k->blend_const_alpha_8(p->d8 + o, 200, p->a + o, 255, KERNEL_W);
+    }
+}
+
+static void run_const_alpha_16(struct bench_ctx *ctx)
+{
+    struct kernel_priv *p = ctx->priv;
+    for (int y = 0; y < KERNEL_H; y++) {
+        int o = y * KERNEL_W;
+        p->k->blend_const_alpha_16(p->d16 + o, 50000, p->a + o, 255, KERNEL_W);
+    }
+}
+
+// --- audio filters
+
+#define AUDIO_SAMPLES 4096
+
+struct af_priv {
+    struct af_stream *afs;
+    struct mp_audio *src;
+    struct mp_audio_pool *pool;
+};
+
+static struct af_priv *init_af(struct bench_ctx *ctx, int in_format,
+                               int out_format)
+{
+    struct af_priv *p = talloc_zero(ctx->ta_ctx, struct af_priv);
+    p->afs = af_new(ctx->global);
+    mp_audio_set_format(&p->afs->input, in_format);
+    mp_audio_set_num_channels(&p->afs->input, 2);
+    p->afs->input.rate = 48000;
+    mp_audio_set_format(&p->afs->output, out_format);
+    mp_audio_set_num_channels(&p->afs->output, 2);
+    p->afs->output.rate = 48000;
+    if (af_init(p->afs) < 0) {
+        af_destroy(p->afs);
+        return NULL;
+    }
+
+    p->pool = mp_audio_pool_create(p);
+    p->src = talloc_zero(p, struct mp_audio);
+    mp_audio_copy_config(p->src, &p->afs->input);
+    mp_audio_realloc(p->src, AUDIO_SAMPLES);
+    p->src->samples = AUDIO_SAMPLES;
+    for (int n = 0; n < AUDIO_SAMPLES * 2; n++) {
+        double v = sin(n / 2 * 2 * M_PI * 440 / 48000) * 0.5;
+        if (in_format == AF_FORMAT_S16) {
+            ((int16_t *)p->src->planes[0])[n] = v * INT16_MAX;
+        } else {
+            ((float *)p->src->planes[0])[n] = v;
+        }
+    }
+
+    ctx->priv = p;
+    ctx->items = AUDIO_SAMPLES;
+    ctx->unit = "samples";
+    return p;
+}
+
+static bool init_af_format(struct bench_ctx *ctx)
+{
+    struct af_priv *p = init_af(ctx, AF_FORMAT_S16, AF_FORMAT_FLOAT);
+    // Forcing float input inserts the actual conversion filter before it.
+    return p && af_add(p->afs, "format", "bench",
+                       (char *[]){"format", "float", NULL});
+}
+
+static bool init_af_scaletempo(struct bench_ctx *ctx)
+{
+    struct af_priv *p = init_af(ctx, AF_FORMAT_FLOAT, AF_FORMAT_FLOAT);
+    if (!p || !af_add(p->afs, "scaletempo", "bench", NULL))
+        return false;
+    double speed = 1.25;
+    af_control_any_rev(p->afs, AF_CONTROL_SET_PLAYBACK_SPEED, &speed);
+    return true;
+}
+
+static void run_af(struct bench_ctx *ctx)
+{
+    struct af_priv *p = ctx->priv;
+    struct mp_audio *in = mp_audio_pool_new_copy(p->pool, p->src);
+    if (!in || af_filter_frame(p->afs, in) < 0)
+        abort();
+    struct mp_audio *out;
+    while ((out = af_read_output_frame(p->afs)))
+        talloc_free(out);
+}
+
+static void uninit_af(struct bench_ctx *ctx)
+{
+    struct af_priv *p = ctx->priv;
+    if (p)
+        af_destroy(p->afs);
+}
+
+// --- EBML/Matroska
+
+static void put_bytes(void *ta, bstr *out, const void *data, size_t len)
+{
+    bstr_xappend(ta, out, (bstr){(unsigned char *)data, len});
+}
+
+// Element with 8 byte length field (valid, if not the most compact, EBML).
+static void put_elem(void *ta, bstr *out, uint32_t id, bstr data)
+{
+    // EBML IDs include their length marker, so just strip leading 0 bytes.
+    int id_len = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+    for (int n = id_len - 1; n >= 0; n--)
+        put_bytes(ta, out, &(uint8_t){id >> (n * 8)}, 1);
+    uint8_t len[8] = {0x01};
+    for (int n = 1; n < 8; n++)
+        len[n] = (uint64_t)data.len >> ((7 - n) * 8);
+    put_bytes(ta, out, len, 8);
+    put_bytes(ta, out, data.start, data.len);
+}
+
+static void put_uint(void *ta, bstr *out, uint32_t id, uint64_t v)
+{
+    uint8_t b[8];
+    for (int n = 0; n < 8; n++)
+        b[n] = v >> ((7 - n) * 8);
+    put_elem(ta, out, id, (bstr){b, 8});
+}
+
+static void put_float(void *ta, bstr *out, uint32_t id, double v)
+{
+    uint64_t i;
+    memcpy(&i, &v, sizeof(i));
+    put_uint(ta, out, id, i); // same big endian layout
+}
+
+static void put_str(void *ta, bstr *out, uint32_t id, const char *s)
+{
+    put_elem(ta, out, id, bstr0(s));
+}
+
+#define NUM_CUES 2000
+
+static bstr make_cues(void *ta)
+{
+    bstr cues = {0};
+    for (int n = 0; n < NUM_CUES; n++) {
+        bstr pos = {0}, point = {0};
+        put_uint(ta, &pos, MATROSKA_ID_CUETRACK, 1);
+        put_uint(ta, &pos, MATROSKA_ID_CUECLUSTERPOSITION, n * 100000);
+        put_uint(ta, &point, MATROSKA_ID_CUETIME, n * 1000);
+        put_elem(ta, &point, MATROSKA_ID_CUETRACKPOSITIONS, pos);
+        put_elem(ta, &cues, MATROSKA_ID_CUEPOINT, point);
+    }
+    bstr res = {0};
+    put_elem(ta, &res, MATROSKA_ID_CUES, cues);
+    return res;
+}
+
+static bool init_ebml(struct bench_ctx *ctx)
+{
+    bstr data = make_cues(ctx->ta_ctx);
+    ctx->priv = open_memory_stream(data.start, data.len);
+    ctx->items = NUM_CUES;
+    ctx->unit = "cue points";
+    return true;
+}
+
+static void run_ebml(struct bench_ctx *ctx)
+{
+    struct stream *s = ctx->priv;
+    struct ebml_parse_ctx parse_ctx = {.log = mp_null_log};
+    struct ebml_cues cues = {0};
+    stream_seek(s, 0);
+    if (ebml_read_id(s) != MATROSKA_ID_CUES ||
+        ebml_read_element(s, &parse_ctx, &cues, &ebml_cues_desc) < 0 ||
+        cues.n_cue_point != NUM_CUES)
+        abort();
+    talloc_free(parse_ctx.talloc_ctx);
+}
+
+static void uninit_stream(struct bench_ctx *ctx)
+{
+    free_stream(ctx->priv);
+}
+
+#define MKV_CLUSTERS 100
+#define MKV_BLOCKS 50   // per cluster, alternating between the 2 tracks
+
+static bstr make_mkv(void *ta)
+{
+    bstr file = {0}, header = {0}, segment = {0}, info = {0};
+    put_str(ta, &header, EBML_ID_DOCTYPE, "matroska");
+    put_uint(ta, &header, EBML_ID_DOCTYPEREADVERSION, 2);
+    put_elem(ta, &file, EBML_ID_EBML, header);
+
+    put_uint(ta, &info, MATROSKA_ID_TIMECODESCALE, 1000000);
+    put_elem(ta, &segment, MATROSKA_ID_INFO, info);
+
+    bstr tracks = {0}, video = {0}, audio = {0}, track = {0};
+    put_uint(ta, &track, MATROSKA_ID_TRACKNUMBER, 1);
+    put_uint(ta, &track, MATROSKA_ID_TRACKUID, 1);
+    put_uint(ta, &track, MATROSKA_ID_TRACKTYPE, MATROSKA_TRACK_VIDEO);
+    put_str(ta, &track, MATROSKA_ID_CODECID, "V_VP9");
+    put_uint(ta, &video, MATROSKA_ID_PIXELWIDTH, 1920);
+    put_uint(ta, &video, MATROSKA_ID_PIXELHEIGHT, 1080);
+    put_elem(ta, &track, MATROSKA_ID_VIDEO, video);
+    put_elem(ta, &tracks, MATROSKA_ID_TRACKENTRY, track);
+    track = (bstr){0};
+    put_uint(ta, &track, MATROSKA_ID_TRACKNUMBER, 2);
+    put_uint(ta, &track, MATROSKA_ID_TRACKUID, 2);
+    put_uint(ta, &track, MATROSKA_ID_TRACKTYPE, MATROSKA_TRACK_AUDIO);
+    put_str(ta, &track, MATROSKA_ID_CODECID, "A_PCM/INT/LIT");
+    put_float(ta, &audio, MATROSKA_ID_SAMPLINGFREQUENCY, 48000);
+    put_uint(ta, &audio, MATROSKA_ID_CHANNELS, 2);
+    put_uint(ta, &audio, MATROSKA_ID_BITDEPTH, 16);
+    put_elem(ta, &track, MATROSKA_ID_AUDIO, audio);
+    put_elem(ta, &tracks, MATROSKA_ID_TRACKENTRY, track);
+    put_elem(ta, &segment, MATROSKA_ID_TRACKS, tracks);
+
+    uint8_t payload[4 + 2000] = {0};
+    for (int c = 0; c < MKV_CLUSTERS; c++) {
+        bstr cluster = {0};
+        put_uint(ta, &cluster, MATROSKA_ID_TIMECODE, c * 1000);
+        for (int b = 0; b < MKV_BLOCKS; b++) {
+            int track_num = b % 2 + 1;
+            int ts = b * 1000 / MKV_BLOCKS;
+            payload[0] = 0x80 | track_num;
+            payload[1] = ts >> 8;
+            payload[2] = ts & 0xFF;
+            payload[3] = track_num == 1 && b == 0 ? 0x80 : 0x00; // keyframe
+            size_t size = 4 + (track_num == 1 ? 2000 : 768);
+            put_elem(ta, &cluster, MATROSKA_ID_SIMPLEBLOCK,
+                     (bstr){payload, size});
+        }
+        put_elem(ta, &segment, MATROSKA_ID_CLUSTER, cluster);
+    }
+    put_elem(ta, &file, MATROSKA_ID_SEGMENT, segment);
+    return file;
+}
+
+struct demux_mkv_priv {
+    bstr data;
+    int only_type;      // select only tracks of this stream_type if >= 0
+};
+
+static bool init_demux_mkv(struct bench_ctx *ctx)
+{
+    struct demux_mkv_priv *p = talloc_zero(ctx->ta_ctx, struct demux_mkv_priv);
+    p->data = make_mkv(ctx->ta_ctx);
+    p->only_type = -1;
+    ctx->priv = p;
+    ctx->items = MKV_CLUSTERS * MKV_BLOCKS;
+    ctx->unit = "packets";
+    return true;
+}
+
+// Throughput in file bytes, with the audio track deselected (its blocks are
+// skipped, but still have to be parsed).
+static bool init_demux_mkv_video(struct bench_ctx *ctx)
+{
+    init_demux_mkv(ctx);
+    struct demux_mkv_priv *p = ctx->priv;
+    p->only_type = STREAM_VIDEO;
+    ctx->items = p->data.len;
+    ctx->unit = "bytes";
+    return true;
+}
+
+static void run_demux_mkv(struct bench_ctx *ctx)
+{
+    struct demux_mkv_priv *p = ctx->priv;
+    struct stream *s = open_memory_stream(p->data.start, p->data.len);
+    struct demuxer_params params = {.force_format = "mkv"};
+    struct demuxer *demuxer = demux_open(s, &params, ctx->global);
+    if (!demuxer)
+        abort();
+    for (int n = 0; n < demux_get_num_stream(demuxer); n++) {
+        struct sh_stream *sh = demux_get_stream(demuxer, n);
+        if (p->only_type < 0 || sh->type == p->only_type)
+            demuxer_select_track(demuxer, sh, MP_NOPTS_VALUE, true);
+    }
+    int packets = 0;
+    struct demux_packet *pkt;
+    while ((pkt = demux_read_any_packet(demuxer))) {
+        talloc_free(pkt);
+        packets++;
+    }
+    if (!packets)
+        abort();
+    free_demuxer_and_stream(demuxer);
+}
+
+static const struct bench benchmarks[] = {
+    {"bstr", 200, init_bstr, run_bstr},
+    {"json_write", 500, init_json_write, run_json_write},
+    {"json_parse", 500, init_json_parse, run_json_parse},
+    {"m_property_index_lookup", 5000, init_property, run_property},
+    {"m_property_list_find", 500, init_property, run_property_list},
+    {"m_property_do/sub-key", 2000, init_property_do, run_property_do},
+    {"m_config/parse-config", 50, init_config_parse, run_config_parse},
+    {"m_config/sub-global-dup", 2000, init_sub_global_dup, run_sub_global,
+     uninit_sub_global},
+    {"m_config/sub-global-snapshot", 2000, init_sub_global_snapshot,
+     run_sub_global, uninit_sub_global},
+    {"playlist/build", 20, init_playlist_build, run_playlist_build},
+    {"playlist/index", 200, init_playlist, run_playlist_index},
+    {"playlist/edit", 20, init_playlist_edit, run_playlist_edit},
+    {"mp_image_pool_get", 20000, init_image_pool, run_image_pool},
+    {"draw_bmp/yuv420p", 200, init_draw_bmp_8, run_draw_bmp,
+     uninit_draw_bmp},
+    {"draw_bmp/yuv420p10", 200, init_draw_bmp_10, run_draw_bmp,
+     uninit_draw_bmp},
+    {"draw_bmp/c/src_alpha_8", 200, init_kernels_c, run_src_alpha_8},
+    {"draw_bmp/c/const_alpha_8", 200, init_kernels_c, run_const_alpha_8},
+    {"draw_bmp/c/const_alpha_16", 200, init_kernels_c, run_const_alpha_16},
+#if HAVE_SSE2_INTRINSICS
+    {"draw_bmp/sse2/src_alpha_8", 200, init_kernels_sse2, run_src_alpha_8},
+    {"draw_bmp/sse2/const_alpha_8", 200, init_kernels_sse2, run_const_alpha_8},
+    {"draw_bmp/sse2/const_alpha_16", 200, init_kernels_sse2,
+     run_const_alpha_16},
+#endif
+#if HAVE_AVX2_INTRINSICS
+    {"draw_bmp/avx2/src_alpha_8", 200, init_kernels_avx2, run_src_alpha_8},
+    {"draw_bmp/avx2/const_alpha_8", 200, init_kernels_avx2, run_const_alpha_8},
+    {"draw_bmp/avx2/const_alpha_16", 200, init_kernels_avx2,
+     run_const_alpha_16},
+#endif
+    {"af_format/s16-float", 2000, init_af_format, run_af, uninit_af},
+    {"af_scaletempo", 500, init_af_scaletempo, run_af, uninit_af},
+    {"ebml_read_element/cues", 200, init_ebml, run_ebml, uninit_stream},
+    {"demux_mkv/packets", 50, init_demux_mkv, run_demux_mkv},
+    {"demux_mkv/video-only", 50, init_demux_mkv_video, run_demux_mkv},
+    {0}
+};
+
+static struct mpv_global *create_global(void *ta_ctx)
+{
+    struct mpv_global *global = talloc_zero(ta_ctx, struct mpv_global);
+    global->log = mp_null_log;
+    struct m_config *config = m_config_new(ta_ctx, global->log,
+                                           sizeof(struct MPOpts),
+                                           &mp_default_opts, mp_opts);
+    global->opts = config->optstruct;
+    return global;
+}
+
+static void run_bench(const struct bench *b, struct mpv_global *global,
+                      double scale, struct mpv_node *results)
+{
+    struct bench_ctx ctx = {
+        .global = global,
+        .ta_ctx = talloc_new(NULL),
+        .items = 1,
+        .unit = "iterations",
+    };
+    struct mpv_node *res = node_array_add(results, MPV_FORMAT_NODE_MAP);
+    node_map_add_string(res, "name", b->name);
+
+    if (b->init && !b->init(&ctx)) {
+        node_map_add(res, "skipped", MPV_FORMAT_FLAG)->u.flag = 1;
+        goto done;
+    }
+
+    int iterations = MPMAX(1, lrint(b->iterations * scale));
+    // One untimed warmup iteration (fills caches and pools).
+    b->run(&ctx);
+
+    int64_t start = mp_time_us();
+    for (int n = 0; n < iterations; n++)
+        b->run(&ctx);
+    int64_t time = MPMAX(mp_time_us() - start, 1);
+
+    node_map_add(res, "iterations", MPV_FORMAT_INT64)->u.int64 = iterations;
+    node_map_add(res, "time_us", MPV_FORMAT_INT64)->u.int64 = time;
+    node_map_add(res, "ns_per_iteration", MPV_FORMAT_DOUBLE)->u.double_ =
+        time * 1000.0 / iterations;
+    node_map_add_string(res, "unit", ctx.unit);
+    node_map_add(res, "per_second", MPV_FORMAT_DOUBLE)->u.double_ =
+        (double)ctx.items * iterations * 1e6 / time;
+
+done:
+    if (b->uninit)
+        b->uninit(&ctx);
+    talloc_free(ctx.ta_ctx);
+}
+
+int main(int argc, char **argv)
+{
+    double scale = 1.0;
+    const char *filter = NULL;
+    bool list = false;
+
+    for (int n = 1; n < argc; n++) {
+        bstr arg = bstr0(argv[n]);
+        if (bstr_eatstart0(&arg, "--scale=")) {
+            scale = bstrtod(arg, &arg);
+            if (arg.len || !(scale > 0))
+                goto usage;
+        } else if (bstr_eatstart0(&arg, "--filter=")) {
+            filter = (char *)arg.start;
+        } else if (bstr_equals0(arg, "--list")) {
+            list = true;
+        } else {
+            goto usage;
+        }
+    }
+
+    if (list) {
+        for (int n = 0; benchmarks[n].name; n++)
+            printf("%s\n", benchmarks[n].name);
+        return 0;
+    }
+
+    void *ta_ctx = talloc_new(NULL);
+    mp_time_init();
+    struct mpv_global *global = create_global(ta_ctx);
+
+    struct mpv_node root;
+    node_init(&root, MPV_FORMAT_NODE_MAP, NULL);
+    talloc_steal(ta_ctx, root.u.list);
+    node_map_add(&root, "scale", MPV_FORMAT_DOUBLE)->u.double_ = scale;
+    struct mpv_node *results =
+        node_map_add(&root, "benchmarks", MPV_FORMAT_NODE_ARRAY);
+
+    for (int n = 0; benchmarks[n].name; n++) {
+        if (!filter || strstr(benchmarks[n].name, filter))
+            run_bench(&benchmarks[n], global, scale, results);
+    }
+
+    char *out = talloc_strdup(ta_ctx, "");
+    json_write(&out, &root);
+    printf("%s\n", out);
+
+    talloc_free(ta_ctx);
+    return 0;
+
+usage:
+    fprintf(stderr, "Usage: %s [--scale=<factor>] [--filter=<substring>] "
+            "[--list]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "test_helpers.h"
+#include "misc/dir_scan.h"
+#include "mpv_talloc.h"
+
+static const char *const files[] = {"a.mkv", "b.srt", "c.txt", NULL};
+
+struct test_dir {
+    char path[64];
+};
+
+static void create_dir(struct test_dir *d)
+{
+    snprintf(d->path, sizeof(d->path), "/tmp/mpv-dir-scan-XXXXXX");
+    assert_true(mkdtemp(d->path) != NULL);
+    for (int n = 0; files[n]; n++) {
+        char name[128];
+        snprintf(name, sizeof(name), "%s/%s", d->path, files[n]);
+        FILE *f = fopen(name, "wb");
+        assert_true(f != NULL);
+        fclose(f);
+    }
+    // Recently modified directories are not cached; pretend it's old.
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= 3600;
+    times[1] = times[0];
+    assert_int_equal(utimes(d->path, times), 0);
+}
+
+static void remove_dir(struct test_dir *d)
+{
+    for (int n = 0; files[n]; n++) {
+        char name[128];
+        snprintf(name, sizeof(name), "%s/%s", d->path, files[n]);
+        unlink(name);
+    }
+    rmdir(d->path);
+}
+
+static bool filter_srt(void *ctx, int dir, const char *name)
+{
+    return strstr(name, ".srt") != NULL;
+}
+
+static int scan(struct test_dir *d, bool (*filter)(void *, int, const char *))
+{
+    char *dirs[] = {d->path};
+    struct mp_dir_listing *l = mp_scan_dirs(NULL, NULL, dirs, 1, filter, NULL);
+    int num = l[0].num_entries;
+    talloc_free(l);
+    return num;
+}
+
+static void test_cache_hit(void **state) {
+    struct test_dir d;
+    create_dir(&d);
+    struct mp_dir_scan_stats s0, s1, s2, s3;
+    mp_dir_scan_get_stats(&s0);
+
+    // First scan: all entries are stat()ed, and the listing is stored.
+    assert_int_equal(scan(&d, NULL), 3);
+    mp_dir_scan_get_stats(&s1);
+    assert_int_equal(s1.hits, s0.hits);
+    assert_int_equal(s1.stores, s0.stores + 1);
+
+    // Same directory state: served from the cache, nothing is written back.
+    assert_int_equal(scan(&d, NULL), 3);
+    mp_dir_scan_get_stats(&s2);
+    assert_int_equal(s2.hits, s1.hits + 1);
+    assert_int_equal(s2.stores, s1.stores);
+
+    // A filter selecting already stat()ed entries doesn't store either.
+    assert_int_equal(scan(&d, filter_srt), 1);
+    mp_dir_scan_get_stats(&s3);
+    assert_int_equal(s3.hits, s2.hits + 1);
+    assert_int_equal(s3.stores, s2.stores);
+
+    remove_dir(&d);
+}
+
+static void test_filter_subset(void **state) {
+    struct test_dir d;
+    create_dir(&d);
+    struct mp_dir_scan_stats s0, s1, s2;
+
+    // Only the .srt entry is stat()ed and stored at first.
+    assert_int_equal(scan(&d, filter_srt), 1);
+    mp_dir_scan_get_stats(&s0);
+
+    // The other entries still need stat(), so the cache entry is updated.
+    assert_int_equal(scan(&d, NULL), 3);
+    mp_dir_scan_get_stats(&s1);
+    assert_int_equal(s1.hits, s0.hits + 1);
+    assert_int_equal(s1.stores, s0.stores + 1);
+
+    assert_int_equal(scan(&d, NULL), 3);
+    mp_dir_scan_get_stats(&s2);
+    assert_int_equal(s2.stores, s1.stores);
+
+    remove_dir(&d);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_cache_hit),
+        cmocka_unit_test(test_filter_subset),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
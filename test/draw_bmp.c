@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavutil/cpu.h>
+
+#include "test_helpers.h"
+#include "config.h"
+#include "common/common.h"
+#include "sub/draw_bmp_kernels.h"
+
+#define MAX_W 80
+#define ROUNDS 2000
+
+struct variant {
+    const struct draw_bmp_kernels *k;
+    int cpu_flag;
+};
+
+static const struct variant variants[] = {
+    {&draw_bmp_kernels_c, 0},
+#if HAVE_SSE2_INTRINSICS
+    {&draw_bmp_kernels_sse2, AV_CPU_FLAG_SSE2},
+#endif
+#if HAVE_AVX2_INTRINSICS
+    {&draw_bmp_kernels_avx2, AV_CPU_FLAG_AVX2},
+#endif
+};
+
+static bool variant_supported(const struct variant *v)
+{
+    return !v->cpu_flag || (av_get_cpu_flags() & v->cpu_flag);
+}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return rnd_state >> 8;
+}
+
+// Random values, with a bias towards the extremes (which are the values most
+// likely to expose rounding or overflow differences).
+static uint32_t rnd_val(uint32_t max)
+{
+    switch (rnd() % 4) {
+    case 0: return 0;
+    case 1: return max;
+    default: return rnd() % (max + 1);
+    }
+}
+
+// Alpha rows: fully transparent, fully opaque, or random.
+static void fill_alpha(uint8_t *a, int w)
+{
+    int mode = rnd() % 3;
+    for (int x = 0; x < w; x++)
+        a[x] = mode == 0 ? 0 : mode == 1 ? 255 : rnd_val(255);
+}
+
+static void fill8(uint8_t *p, int w)
+{
+    for (int x = 0; x < w; x++)
+        p[x] = rnd_val(255);
+}
+
+static void fill16(uint16_t *p, int w)
+{
+    for (int x = 0; x < w; x++)
+        p[x] = rnd_val(65535);
+}
+
+static void test_kernels(const struct variant *v)
+{
+    const struct draw_bmp_kernels *c = &draw_bmp_kernels_c;
+    const struct draw_bmp_kernels *k = v->k;
+    uint8_t a[MAX_W], s8[MAX_W], d8[MAX_W], r8[MAX_W];
+    uint16_t s16[MAX_W], d16[MAX_W], r16[MAX_W];
+
+    if (!variant_supported(v)) {
+        printf("%s: not supported by this CPU, skipping\n", k->name);
+        return;
+    }
+
+    for (int n = 0; n < ROUNDS; n++) {
+        // Odd offsets test unaligned access and the scalar tail.
+        int off = rnd() % 8;
+        int w = rnd() % (MAX_W - off + 1);
+        int srcp8 = rnd_val(255), srcp16 = rnd_val(65535);
+        uint8_t mul = rnd_val(255);
+
+        fill_alpha(a, MAX_W);
+        fill8(s8, MAX_W);
+        fill16(s16, MAX_W);
+
+        fill8(d8, MAX_W);
+        memcpy(r8, d8, sizeof(r8));
+        c->blend_src_alpha_8(r8 + off, s8 + off, a + off, w);
+        k->blend_src_alpha_8(d8 + off, s8 + off, a + off, w);
+        assert_memory_equal(d8, r8, sizeof(r8));
+
+        fill16(d16, MAX_W);
+        memcpy(r16, d16, sizeof(r16));
+        c->blend_src_alpha_16(r16 + off, s16 + off, a + off, w);
+        k->blend_src_alpha_16(d16 + off, s16 + off, a + off, w);
+        assert_memory_equal(d16, r16, sizeof(r16));
+
+        fill8(d8, MAX_W);
+        memcpy(r8, d8, sizeof(r8));
+        c->blend_const_alpha_8(r8 + off, srcp8, a + off, mul, w);
+        k->blend_const_alpha_8(d8 + off, srcp8, a + off, mul, w);
+        assert_memory_equal(d8, r8, sizeof(r8));
+
+        fill16(d16, MAX_W);
+        memcpy(r16, d16, sizeof(r16));
+        c->blend_const_alpha_16(r16 + off, srcp16, a + off, mul, w);
+        k->blend_const_alpha_16(d16 + off, srcp16, a + off, mul, w);
+        assert_memory_equal(d16, r16, sizeof(r16));
+
+        fill8(d8, MAX_W);
+        memcpy(r8, d8, sizeof(r8));
+        c->blend_src_dst_mul_8(r8 + off, a + off, mul, w);
+        k->blend_src_dst_mul_8(d8 + off, a + off, mul, w);
+        assert_memory_equal(d8, r8, sizeof(r8));
+
+        fill16(d16, MAX_W);
+        memcpy(r16, d16, sizeof(r16));
+        c->blend_src_dst_mul_16(r16 + off, a + off, mul, w);
+        k->blend_src_dst_mul_16(d16 + off, a + off, mul, w);
+        assert_memory_equal(d16, r16, sizeof(r16));
+    }
+}
+
+static void test_bitexact(void **state) {
+    for (int n = 0; n < MP_ARRAY_SIZE(variants); n++)
+        test_kernels(&variants[n]);
+}
+
+static void test_dispatch(void **state) {
+    const struct draw_bmp_kernels *k = draw_bmp_get_kernels();
+    bool found = false;
+    for (int n = 0; n < MP_ARRAY_SIZE(variants); n++) {
+        if (variants[n].k == k) {
+            assert_true(variant_supported(&variants[n]));
+            found = true;
+        }
+    }
+    assert_true(found);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_bitexact),
+        cmocka_unit_test(test_dispatch),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
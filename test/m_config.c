@@ -0,0 +1,155 @@
+#include "test_helpers.h"
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+#include "mpv_talloc.h"
+
+struct sub_opts {
+    int a, b;
+};
+
+#define OPT_BASE_STRUCT struct sub_opts
+static const struct m_sub_options sub_conf = {
+    .opts = (const m_option_t[]){
+        OPT_FLAG("a", a, 0),
+        OPT_INT("b", b, 0),
+        {0}
+    },
+    .size = sizeof(struct sub_opts),
+};
+#undef OPT_BASE_STRUCT
+
+struct test_opts {
+    int x, y, z;
+    char *str;
+    char **list;
+    struct sub_opts *sub;
+};
+
+#define OPT_BASE_STRUCT struct test_opts
+static const m_option_t test_options[] = {
+    OPT_FLAG("x", x, 0),
+    OPT_FLAG("wild-early", y, 0),
+    OPT_STRINGLIST("wild-*", list, 0),
+    OPT_FLAG("wild-late", z, 0),
+    OPT_STRING("str", str, 0),
+    OPT_SUBSTRUCT("sub", sub, sub_conf, 0),
+    OPT_INT("x", y, 0),
+    OPT_REPLACED("old-x", "x"),
+    OPT_REMOVED("gone", NULL),
+    {0}
+};
+#undef OPT_BASE_STRUCT
+
+// What m_config_get_co() did before it used an index.
+static struct m_config_option *find_linear(struct m_config *config, bstr name)
+{
+    for (int n = 0; n < config->num_opts; n++) {
+        struct m_config_option *co = &config->opts[n];
+        bstr coname = bstr0(co->name);
+        if ((co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) &&
+            bstr_endswith0(coname, "*"))
+        {
+            coname.len--;
+            if (bstr_startswith(name, coname))
+                return co;
+        } else if (bstr_equals(coname, name)) {
+            return co;
+        }
+    }
+    return NULL;
+}
+
+static void test_lookup(void **state) {
+    struct m_config *config = m_config_new(NULL, mp_null_log,
+                                           sizeof(struct test_opts), NULL,
+                                           test_options);
+    const char *names[] = {"x", "sub", "sub-a", "sub-b", "sub-c", "wild",
+                           "wild-", "wild-early", "wild-late", "wild-foo",
+                           "wild-*", "", "nope", NULL};
+    for (int n = 0; names[n]; n++) {
+        bstr name = bstr0(names[n]);
+        assert_ptr_equal(m_config_get_co(config, name),
+                         name.len ? find_linear(config, name) : NULL);
+    }
+
+    // Duplicates: the first option wins.
+    assert_ptr_equal(m_config_get_co(config, bstr0("x"))->opt, &test_options[0]);
+    // Wildcards take precedence over later exact matches only.
+    assert_string_equal(m_config_get_co(config, bstr0("wild-early"))->name,
+                        "wild-early");
+    assert_string_equal(m_config_get_co(config, bstr0("wild-late"))->name,
+                        "wild-*");
+    // Aliases resolve to the target, removed options are not found.
+    assert_string_equal(m_config_get_co(config, bstr0("old-x"))->name, "x");
+    assert_null(m_config_get_co(config, bstr0("gone")));
+
+    talloc_free(config);
+}
+
+static void set_opt(struct m_config *config, const char *name, const char *val)
+{
+    assert_true(m_config_set_option0(config, name, val) >= 0);
+}
+
+static void test_snapshot(void **state) {
+    struct mpv_global *global = talloc_zero(NULL, struct mpv_global);
+    struct m_config *config = m_config_new(global, mp_null_log,
+                                           sizeof(struct test_opts), NULL,
+                                           test_options);
+    config->global = global;
+    m_config_create_shadow(config);
+    set_opt(config, "str", "first");
+
+    void *ta_ctx = talloc_new(NULL);
+    struct test_opts *s1 = m_config_get_snapshot(ta_ctx, global);
+    assert_string_equal(s1->str, "first");
+    assert_ptr_not_equal(s1->str, ((struct test_opts *)config->optstruct)->str);
+    // Nothing changed: same snapshot.
+    assert_ptr_equal(m_config_get_snapshot(ta_ctx, global), s1);
+
+    // A changed sub-group is copied along with its parent.
+    void *tmp = talloc_new(NULL);
+    set_opt(config, "sub-b", "5");
+    struct test_opts *s2 = m_config_get_snapshot(tmp, global);
+    assert_ptr_not_equal(s2, s1);
+    assert_ptr_not_equal(s2->sub, s1->sub);
+    assert_int_equal(s1->sub->b, 0);
+    assert_int_equal(s2->sub->b, 5);
+    assert_string_equal(s2->str, "first");
+
+    // Unchanged sub-groups are shared, and outlive the snapshot they were
+    // created for.
+    set_opt(config, "str", "second");
+    struct test_opts *s3 = m_config_get_snapshot(ta_ctx, global);
+    assert_ptr_equal(s3->sub, s2->sub);
+    assert_string_equal(s3->str, "second");
+    assert_string_equal(s2->str, "first");
+    talloc_free(tmp);
+    set_opt(config, "str", "third");
+    m_config_get_snapshot(ta_ctx, global);
+    assert_int_equal(s3->sub->b, 5);
+    assert_string_equal(s3->str, "second");
+
+    // Restoring file-local options is visible too.
+    m_config_backup_opt(config, "x");
+    set_opt(config, "x", "yes");
+    struct test_opts *s4 = m_config_get_snapshot(ta_ctx, global);
+    m_config_restore_backups(config);
+    struct test_opts *s5 = m_config_get_snapshot(ta_ctx, global);
+    assert_int_equal(s4->x, 1);
+    assert_int_equal(s5->x, 0);
+
+    talloc_free(ta_ctx);
+    talloc_free(global);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_lookup),
+        cmocka_unit_test(test_snapshot),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,117 @@
+#include "test_helpers.h"
+#include "common/common.h"
+#include "options/m_property.h"
+#include "mpv_talloc.h"
+
+#define NUM_PROPS 300
+
+static int prop_call(void *ctx, struct m_property *prop, int action, void *arg)
+{
+    int *calls = ctx;
+    (*calls)++;
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_INT};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+        *(int *)arg = (intptr_t)prop->priv;
+        return M_PROPERTY_OK;
+    case M_PROPERTY_KEY_ACTION: {
+        struct m_property_action_arg *ka = arg;
+        if (strcmp(ka->key, "sub") != 0)
+            return M_PROPERTY_UNKNOWN;
+        if (ka->action == M_PROPERTY_GET_TYPE) {
+            *(struct m_option *)ka->arg =
+                (struct m_option){.type = CONF_TYPE_INT};
+            return M_PROPERTY_OK;
+        }
+        if (ka->action == M_PROPERTY_GET) {
+            *(int *)ka->arg = -(intptr_t)prop->priv;
+            return M_PROPERTY_OK;
+        }
+        return M_PROPERTY_NOT_IMPLEMENTED;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
+static struct m_property *create_list(void *ta_ctx)
+{
+    struct m_property *list = talloc_zero_array(ta_ctx, struct m_property,
+                                                NUM_PROPS + 1);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        list[n] = (struct m_property){
+            .name = talloc_asprintf(ta_ctx, "test-property-%d", n),
+            .call = prop_call,
+            .priv = (void *)(intptr_t)(n + 1),
+        };
+    }
+    return list;
+}
+
+static void test_index_lookup(void **state) {
+    void *ta_ctx = talloc_new(NULL);
+    struct m_property *list = create_list(ta_ctx);
+    struct m_property_index *index = m_property_index_create(ta_ctx, list);
+
+    assert_ptr_equal(m_property_index_list(index), list);
+    for (int n = 0; n < NUM_PROPS; n++)
+        assert_int_equal(m_property_index_lookup(index, bstr0(list[n].name)), n);
+    assert_int_equal(m_property_index_lookup(index, bstr0("test-property")), -1);
+    assert_int_equal(m_property_index_lookup(index, bstr0("")), -1);
+    assert_int_equal(m_property_index_lookup(index,
+                                    bstr0("test-property-1/sub")), -1);
+
+    talloc_free(ta_ctx);
+}
+
+static void test_index_duplicates(void **state) {
+    void *ta_ctx = talloc_new(NULL);
+    struct m_property list[] = {
+        {"dup", prop_call, (void *)1},
+        {"other", prop_call, (void *)2},
+        {"dup", prop_call, (void *)3},
+        {0}
+    };
+    struct m_property_index *index = m_property_index_create(ta_ctx, list);
+    // Same semantics as m_property_list_find(): first entry wins.
+    assert_int_equal(m_property_index_lookup(index, bstr0("dup")), 0);
+    assert_int_equal(m_property_index_lookup(index, bstr0("other")), 1);
+    talloc_free(ta_ctx);
+}
+
+static void test_property_do(void **state) {
+    void *ta_ctx = talloc_new(NULL);
+    struct m_property *list = create_list(ta_ctx);
+    struct m_property_index *index = m_property_index_create(ta_ctx, list);
+    int calls = 0;
+    int val = 0;
+
+    assert_int_equal(m_property_do(NULL, index, "test-property-41",
+                                   M_PROPERTY_GET, &val, &calls),
+                     M_PROPERTY_OK);
+    assert_int_equal(val, 42);
+
+    assert_int_equal(m_property_do(NULL, index, "test-property-41/sub",
+                                   M_PROPERTY_GET, &val, &calls),
+                     M_PROPERTY_OK);
+    assert_int_equal(val, -42);
+
+    assert_int_equal(m_property_do(NULL, index, "test-property-41/none",
+                                   M_PROPERTY_GET, &val, &calls),
+                     M_PROPERTY_UNKNOWN);
+    assert_int_equal(m_property_do(NULL, index, "does-not-exist",
+                                   M_PROPERTY_GET, &val, &calls),
+                     M_PROPERTY_UNKNOWN);
+
+    talloc_free(ta_ctx);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_index_lookup),
+        cmocka_unit_test(test_index_duplicates),
+        cmocka_unit_test(test_property_do),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
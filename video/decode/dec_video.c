@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/rational.h>
 
@@ -26,6 +27,7 @@
 #include "options/options.h"
 #include "common/msg.h"
 
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 
 #include "stream/stream.h"
@@ -56,9 +58,76 @@ const vd_functions_t * const mpcodecs_vd_drivers[] = {
     NULL
 };
 
-void video_reset(struct dec_video *d_video)
+struct dec_video_thread {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // -- All the following fields are protected by lock.
+
+    bool terminate;
+    bool need_input;        // wait for video_work() before decoding more
+    int state;              // last DATA_* code returned by the decoder
+    int max_frames;
+    struct mp_image **frames;
+    int num_frames;
+
+    // Copied to dec_video before each decode call.
+    double start_pts;
+    bool framedrop;
+
+    void (*run_fn)(void *); // if non-NULL, function queued to be run on
+    void *run_fn_arg;       // the thread as run_fn(run_fn_arg)
+
+    // Copied from dec_video after each decode call, for the player to read.
+    int dropped_frames;
+    char *decoder_desc;
+
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_cb_ctx;
+};
+
+// Make decoder state visible to video_get_* functions. Must be called with
+// the thread lock held, on the decoder thread (or while it's blocked).
+static void publish_state(struct dec_video *d_video)
 {
-    video_vd_control(d_video, VDCTRL_RESET, NULL);
+    struct dec_video_thread *t = d_video->thread;
+    t->dropped_frames = d_video->dropped_frames;
+    t->decoder_desc = d_video->decoder_desc;
+}
+
+// Run fn(ctx) on the decoder thread (or directly if there is none), and wait
+// until it has finished. fn is called with the thread lock held.
+static void run_on_thread(struct dec_video *d_video, void (*fn)(void *),
+                          void *ctx)
+{
+    struct dec_video_thread *t = d_video->thread;
+    if (!t) {
+        fn(ctx);
+        return;
+    }
+    pthread_mutex_lock(&t->lock);
+    while (t->run_fn)
+        pthread_cond_wait(&t->wakeup, &t->lock);
+    t->run_fn = fn;
+    t->run_fn_arg = ctx;
+    pthread_cond_broadcast(&t->wakeup);
+    while (t->run_fn)
+        pthread_cond_wait(&t->wakeup, &t->lock);
+    pthread_mutex_unlock(&t->lock);
+}
+
+static int vd_control(struct dec_video *d_video, int cmd, void *arg)
+{
+    const struct vd_functions *vd = d_video->vd_driver;
+    if (vd)
+        return vd->control(d_video, cmd, arg);
+    return CONTROL_UNKNOWN;
+}
+
+static void reset_decoder(struct dec_video *d_video)
+{
+    vd_control(d_video, VDCTRL_RESET, NULL);
     d_video->first_packet_pdts = MP_NOPTS_VALUE;
     d_video->start_pts = MP_NOPTS_VALUE;
     d_video->decoded_pts = MP_NOPTS_VALUE;
@@ -75,18 +144,90 @@ void video_reset(struct dec_video *d_video)
     d_video->start = d_video->end = MP_NOPTS_VALUE;
 }
 
+static void flush_frames(struct dec_video_thread *t)
+{
+    for (int n = 0; n < t->num_frames; n++)
+        talloc_free(t->frames[n]);
+    t->num_frames = 0;
+}
+
+static void thread_reset(void *p)
+{
+    struct dec_video *d_video = p;
+    struct dec_video_thread *t = d_video->thread;
+    reset_decoder(d_video);
+    if (t) {
+        flush_frames(t);
+        t->state = DATA_AGAIN;
+        t->start_pts = MP_NOPTS_VALUE;
+        // Don't start decoding before the player has set up the new state.
+        t->need_input = true;
+        publish_state(d_video);
+    }
+}
+
+void video_reset(struct dec_video *d_video)
+{
+    run_on_thread(d_video, thread_reset, d_video);
+}
+
+static void thread_suspend(void *p)
+{
+    struct dec_video *d_video = p;
+    d_video->thread->need_input = true;
+}
+
+// Stop decoding ahead until the next video_work() call. When this returns,
+// the decoder thread (if any) does not access the demuxer anymore. Typically
+// used before seeking the demuxer, followed by video_reset().
+void video_suspend(struct dec_video *d_video)
+{
+    if (d_video->thread)
+        run_on_thread(d_video, thread_suspend, d_video);
+}
+
+struct vd_control_args {
+    struct dec_video *d_video;
+    int cmd;
+    void *arg;
+    int r;
+};
+
+static void thread_vd_control(void *p)
+{
+    struct vd_control_args *args = p;
+    args->r = vd_control(args->d_video, args->cmd, args->arg);
+}
+
 int video_vd_control(struct dec_video *d_video, int cmd, void *arg)
 {
-    const struct vd_functions *vd = d_video->vd_driver;
-    if (vd)
-        return vd->control(d_video, cmd, arg);
-    return CONTROL_UNKNOWN;
+    struct vd_control_args args = {d_video, cmd, arg, CONTROL_UNKNOWN};
+    run_on_thread(d_video, thread_vd_control, &args);
+    return args.r;
+}
+
+static void video_stop_thread(struct dec_video *d_video)
+{
+    struct dec_video_thread *t = d_video->thread;
+    if (!t)
+        return;
+    pthread_mutex_lock(&t->lock);
+    t->terminate = true;
+    pthread_cond_broadcast(&t->wakeup);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+    flush_frames(t);
+    pthread_cond_destroy(&t->wakeup);
+    pthread_mutex_destroy(&t->lock);
+    talloc_free(t);
+    d_video->thread = NULL;
 }
 
 void video_uninit(struct dec_video *d_video)
 {
     if (!d_video)
         return;
+    video_stop_thread(d_video);
     mp_image_unrefp(&d_video->current_mpi);
     mp_image_unrefp(&d_video->cover_art_mpi);
     if (d_video->vd_driver) {
@@ -138,7 +279,7 @@ bool video_init_best_codec(struct dec_video *d_video)
     struct MPOpts *opts = d_video->opts;
 
     assert(!d_video->vd_driver);
-    video_reset(d_video);
+    reset_decoder(d_video);
     d_video->has_broken_packet_pts = -10; // needs 10 packets to reach decision
 
     struct mp_decoder_entry *decoder = NULL;
@@ -334,30 +475,75 @@ static struct mp_image *decode_packet(struct dec_video *d_video,
         mpi->pts != MP_NOPTS_VALUE && d_video->fps > 0)
     {
         int delay = -1;
-        video_vd_control(d_video, VDCTRL_GET_BFRAMES, &delay);
+        vd_control(d_video, VDCTRL_GET_BFRAMES, &delay);
         mpi->pts -= MPMAX(delay, 0) / d_video->fps;
     }
 
     return mpi;
 }
 
-void video_reset_aspect(struct dec_video *d_video)
+static void thread_reset_aspect(void *p)
 {
+    struct dec_video *d_video = p;
     d_video->last_format = (struct mp_image_params){0};
 }
 
+void video_reset_aspect(struct dec_video *d_video)
+{
+    run_on_thread(d_video, thread_reset_aspect, d_video);
+}
+
 void video_set_framedrop(struct dec_video *d_video, bool enabled)
 {
-    d_video->framedrop_enabled = enabled;
+    struct dec_video_thread *t = d_video->thread;
+    if (t) {
+        pthread_mutex_lock(&t->lock);
+        t->framedrop = enabled;
+        pthread_mutex_unlock(&t->lock);
+    } else {
+        d_video->framedrop_enabled = enabled;
+    }
+}
+
+// Number of frames dropped by the decoder since the last reset.
+int video_get_dropped_frames(struct dec_video *d_video)
+{
+    struct dec_video_thread *t = d_video->thread;
+    if (!t)
+        return d_video->dropped_frames;
+    pthread_mutex_lock(&t->lock);
+    int r = t->dropped_frames;
+    pthread_mutex_unlock(&t->lock);
+    return r;
+}
+
+// Description of the current decoder, or NULL if none. The string stays valid
+// until video_uninit().
+const char *video_get_decoder_desc(struct dec_video *d_video)
+{
+    struct dec_video_thread *t = d_video->thread;
+    if (!t)
+        return d_video->decoder_desc;
+    pthread_mutex_lock(&t->lock);
+    const char *r = t->decoder_desc;
+    pthread_mutex_unlock(&t->lock);
+    return r;
 }
 
 // Frames before the start timestamp can be dropped. (Used for hr-seek.)
 void video_set_start(struct dec_video *d_video, double start_pts)
 {
-    d_video->start_pts = start_pts;
+    struct dec_video_thread *t = d_video->thread;
+    if (t) {
+        pthread_mutex_lock(&t->lock);
+        t->start_pts = start_pts;
+        pthread_mutex_unlock(&t->lock);
+    } else {
+        d_video->start_pts = start_pts;
+    }
 }
 
-void video_work(struct dec_video *d_video)
+static void work_sync(struct dec_video *d_video)
 {
     if (d_video->current_mpi)
         return;
@@ -462,12 +648,7 @@ void video_work(struct dec_video *d_video)
     }
 }
 
-// Fetch an image decoded with video_work(). Returns one of:
-//  DATA_OK:    *out_mpi is set to a new image
-//  DATA_WAIT:  waiting for demuxer; will receive a wakeup signal
-//  DATA_EOF:   end of file, no more frames to be expected
-//  DATA_AGAIN: dropped frame or something similar
-int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi)
+static int get_frame_sync(struct dec_video *d_video, struct mp_image **out_mpi)
 {
     *out_mpi = NULL;
     if (d_video->current_mpi) {
@@ -479,3 +660,118 @@ int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi)
         return DATA_AGAIN;
     return d_video->current_state;
 }
+
+void video_work(struct dec_video *d_video)
+{
+    struct dec_video_thread *t = d_video->thread;
+    if (t) {
+        // The thread might be waiting for new packets.
+        pthread_mutex_lock(&t->lock);
+        t->need_input = false;
+        pthread_cond_broadcast(&t->wakeup);
+        pthread_mutex_unlock(&t->lock);
+        return;
+    }
+    work_sync(d_video);
+}
+
+// Fetch an image decoded with video_work(). Returns one of:
+//  DATA_OK:    *out_mpi is set to a new image
+//  DATA_WAIT:  waiting for demuxer or decoder thread; will receive a wakeup
+//  DATA_EOF:   end of file, no more frames to be expected
+//  DATA_AGAIN: dropped frame or something similar
+int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi)
+{
+    struct dec_video_thread *t = d_video->thread;
+    if (!t)
+        return get_frame_sync(d_video, out_mpi);
+
+    *out_mpi = NULL;
+    int r = DATA_WAIT;
+    pthread_mutex_lock(&t->lock);
+    if (t->num_frames) {
+        *out_mpi = t->frames[0];
+        MP_TARRAY_REMOVE_AT(t->frames, t->num_frames, 0);
+        pthread_cond_broadcast(&t->wakeup); // decode more
+        r = DATA_OK;
+    } else if (t->state == DATA_EOF) {
+        r = DATA_EOF;
+    }
+    pthread_mutex_unlock(&t->lock);
+    return r;
+}
+
+static void *video_thread(void *p)
+{
+    struct dec_video *d_video = p;
+    struct dec_video_thread *t = d_video->thread;
+    mpthread_set_name("vd");
+    pthread_mutex_lock(&t->lock);
+    while (!t->terminate) {
+        if (t->run_fn) {
+            t->run_fn(t->run_fn_arg);
+            t->run_fn = NULL;
+            pthread_cond_broadcast(&t->wakeup);
+            continue;
+        }
+        if (!t->need_input && t->state != DATA_EOF &&
+            t->num_frames < t->max_frames)
+        {
+            d_video->start_pts = t->start_pts;
+            d_video->framedrop_enabled = t->framedrop;
+            pthread_mutex_unlock(&t->lock);
+
+            MP_STATS(d_video, "start decode video");
+            struct mp_image *mpi = NULL;
+            work_sync(d_video);
+            int state = get_frame_sync(d_video, &mpi);
+            MP_STATS(d_video, "end decode video");
+
+            pthread_mutex_lock(&t->lock);
+            publish_state(d_video);
+            t->state = state;
+            t->need_input = state == DATA_WAIT;
+            if (mpi)
+                MP_TARRAY_APPEND(t, t->frames, t->num_frames, mpi);
+            if ((mpi || state == DATA_EOF) && t->wakeup_cb)
+                t->wakeup_cb(t->wakeup_cb_ctx);
+            continue;
+        }
+        pthread_cond_wait(&t->wakeup, &t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+// Decode in a separate thread, which queues up to max_frames decoded images.
+// wakeup_cb is called (from the decoder thread) when a new frame is available
+// or EOF is reached. Does nothing for cover art.
+void video_start_thread(struct dec_video *d_video, int max_frames,
+                        void (*wakeup_cb)(void *ctx), void *wakeup_cb_ctx)
+{
+    if (d_video->thread || d_video->header->attached_picture)
+        return;
+
+    struct dec_video_thread *t = talloc_ptrtype(NULL, t);
+    *t = (struct dec_video_thread){
+        .need_input = true,
+        .state = DATA_AGAIN,
+        .max_frames = MPMAX(max_frames, 1),
+        .start_pts = d_video->start_pts,
+        .framedrop = d_video->framedrop_enabled,
+        .wakeup_cb = wakeup_cb,
+        .wakeup_cb_ctx = wakeup_cb_ctx,
+    };
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->wakeup, NULL);
+
+    d_video->thread = t;
+    publish_state(d_video);
+    if (pthread_create(&t->thread, NULL, video_thread, d_video)) {
+        MP_ERR(d_video, "Could not start video decoder thread.\n");
+        pthread_cond_destroy(&t->wakeup);
+        pthread_mutex_destroy(&t->lock);
+        talloc_free(t);
+        d_video->thread = NULL;
+    }
+}
@@ -36,12 +36,12 @@ struct dec_video {
     struct sh_stream *header;
     struct mp_codec_params *codec;
 
+    // Written by the decoder thread; use video_get_*() to read them.
     char *decoder_desc;
+    int dropped_frames;
 
     float fps;            // FPS from demuxer or from user override
 
-    int dropped_frames;
-
     // Internal (shared with vd_lavc.c).
 
     void *priv; // for free use by vd_driver
@@ -76,6 +76,9 @@ struct dec_video {
     struct mp_image *cover_art_mpi;
     struct mp_image *current_mpi;
     int current_state;
+
+    // Set if decoding runs in a separate thread (video_start_thread()).
+    struct dec_video_thread *thread;
 };
 
 struct mp_decoder_list *video_decoder_list(void);
@@ -86,7 +89,13 @@ void video_uninit(struct dec_video *d_video);
 void video_work(struct dec_video *d_video);
 int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi);
 
+void video_start_thread(struct dec_video *d_video, int max_frames,
+                        void (*wakeup_cb)(void *ctx), void *wakeup_cb_ctx);
+void video_suspend(struct dec_video *d_video);
+
 void video_set_framedrop(struct dec_video *d_video, bool enabled);
+int video_get_dropped_frames(struct dec_video *d_video);
+const char *video_get_decoder_desc(struct dec_video *d_video);
 void video_set_start(struct dec_video *d_video, double start_pts);
 
 int video_vd_control(struct dec_video *d_video, int cmd, void *arg);
@@ -414,6 +414,18 @@ static const struct gl_functions gl_functions[] = {
             {0}
         },
     },
+    // For the on-disk shader cache.
+    {
+        .ver_core = 410,
+        .ver_es_core = 300,
+        .extension = "GL_ARB_get_program_binary",
+        .functions = (const struct gl_function[]) {
+            DEF_FN(GetProgramBinary),
+            DEF_FN(ProgramBinary),
+            DEF_FN(ProgramParameteri),
+            {0}
+        },
+    },
 };
 
 #undef FN_OFFS
@@ -108,6 +108,13 @@
 #define GL_TRANSLATED_SHADER_SOURCE_LENGTH_ANGLE 0x93A0
 #endif
 
+// GL_ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
 #ifndef GL_RGB_RAW_422_APPLE
 #define GL_RGB_RAW_422_APPLE 0x8A51
 #endif
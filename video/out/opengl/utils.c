@@ -22,8 +22,16 @@
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <libavutil/sha.h>
+#include <libavutil/mem.h>
+
+#include "osdep/io.h"
 #include "common/common.h"
+#include "options/path.h"
+#include "stream/stream.h"
 #include "formats.h"
 #include "utils.h"
 
@@ -483,6 +491,11 @@ struct gl_shader_cache {
 
     bool error_state; // true if an error occurred
 
+    // on-disk cache of linked program binaries (NULL if disabled)
+    char *cache_dir;
+    struct mpv_global *global;
+    int cache_hits, cache_misses;
+
     // temporary buffers (avoids frequent reallocations)
     bstr tmp[5];
 };
@@ -525,6 +538,10 @@ void gl_sc_destroy(struct gl_shader_cache *sc)
 {
     if (!sc)
         return;
+    if (sc->cache_hits || sc->cache_misses) {
+        MP_VERBOSE(sc, "shader cache: %d hits, %d misses\n",
+                   sc->cache_hits, sc->cache_misses);
+    }
     gl_sc_reset(sc);
     sc_flush_cache(sc);
     talloc_free(sc);
@@ -837,10 +854,147 @@ static void link_shader(struct gl_shader_cache *sc, GLuint program)
         sc->error_state = true;
 }
 
+// Enable the on-disk program binary cache, or disable it if dir is NULL or "".
+void gl_sc_set_cache_dir(struct gl_shader_cache *sc, struct mpv_global *global,
+                         const char *dir)
+{
+    talloc_free(sc->cache_dir);
+    sc->cache_dir = NULL;
+    sc->global = global;
+
+    GL *gl = sc->gl;
+    if (!dir || !dir[0] || !gl->ProgramBinary)
+        return;
+
+    GLint formats = 0;
+    gl->GetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) {
+        MP_VERBOSE(sc, "No program binary formats, not caching shaders.\n");
+        return;
+    }
+
+    sc->cache_dir = mp_get_user_path(sc, global, dir);
+}
+
+// Return the cache filename for the given program, or NULL if disabled.
+static char *get_cache_file(struct gl_shader_cache *sc, void *ta_ctx,
+                            const char *vertex, const char *frag)
+{
+    if (!sc->cache_dir)
+        return NULL;
+
+    GL *gl = sc->gl;
+    // Binaries are only valid for the exact driver they were created with.
+    char *cache_info = talloc_asprintf(ta_ctx, "ver=1, %s, %s, %s\n",
+                                       gl->GetString(GL_VENDOR),
+                                       gl->GetString(GL_RENDERER),
+                                       gl->GetString(GL_VERSION));
+
+    uint8_t hash[32];
+    struct AVSHA *sha = av_sha_alloc();
+    if (!sha)
+        abort();
+    av_sha_init(sha, 256);
+    av_sha_update(sha, cache_info, strlen(cache_info));
+    av_sha_update(sha, vertex, strlen(vertex) + 1);
+    av_sha_update(sha, frag, strlen(frag) + 1);
+    av_sha_final(sha, hash);
+    av_free(sha);
+
+    char *cache_file = talloc_strdup(ta_ctx, "");
+    for (int i = 0; i < sizeof(hash); i++)
+        cache_file = talloc_asprintf_append(cache_file, "%02X", hash[i]);
+    return mp_path_join(ta_ctx, sc->cache_dir, cache_file);
+}
+
+// Cache file layout: GLenum binary format (native endian), binary data.
+static GLuint load_cached_program(struct gl_shader_cache *sc,
+                                  const char *cache_file)
+{
+    GL *gl = sc->gl;
+
+    if (stat(cache_file, &(struct stat){0}) != 0)
+        return 0;
+
+    void *tmp = talloc_new(NULL);
+    struct bstr data = stream_read_file(cache_file, tmp, sc->global,
+                                        100000000); // 100 MB
+    GLuint prog = 0;
+    GLenum format;
+    if (data.len > sizeof(format)) {
+        memcpy(&format, data.start, sizeof(format));
+        prog = gl->CreateProgram();
+        gl->ProgramBinary(prog, format, data.start + sizeof(format),
+                          data.len - sizeof(format));
+        GLint status = 0;
+        gl->GetProgramiv(prog, GL_LINK_STATUS, &status);
+        if (!status) {
+            // Driver update or corrupted file; will be overwritten.
+            MP_VERBOSE(sc, "Rejected cached program '%s'.\n", cache_file);
+            // Rejection may raise GL_INVALID_ENUM (unknown format); don't
+            // let it be reported against unrelated later calls.
+            while (gl->GetError() != GL_NO_ERROR) {}
+            gl->DeleteProgram(prog);
+            prog = 0;
+        }
+    }
+    talloc_free(tmp);
+    return prog;
+}
+
+static void store_cached_program(struct gl_shader_cache *sc, GLuint prog,
+                                 const char *cache_file)
+{
+    GL *gl = sc->gl;
+
+    GLint status = 0, size = 0;
+    gl->GetProgramiv(prog, GL_LINK_STATUS, &status);
+    gl->GetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (!status || size <= 0)
+        return;
+
+    void *data = talloc_size(NULL, size);
+    GLenum format = 0;
+    GLsizei len = 0;
+    gl->GetProgramBinary(prog, size, &len, &format, data);
+
+    if (len > 0) {
+        mp_mkdirp(sc->cache_dir);
+        // Write to a temporary file and rename it, so that a concurrent mpv
+        // instance (or a crash) never leaves a truncated binary behind.
+        char *tmp_file = talloc_asprintf(data, "%s.tmp", cache_file);
+        FILE *out = fopen(tmp_file, "wb");
+        if (out) {
+            bool ok = fwrite(&format, sizeof(format), 1, out) == 1 &&
+                      fwrite(data, len, 1, out) == 1;
+            ok = fclose(out) == 0 && ok;
+            if (!ok || rename(tmp_file, cache_file) != 0) {
+                MP_WARN(sc, "Failed to write shader cache file '%s'.\n",
+                        cache_file);
+                unlink(tmp_file);
+            }
+        }
+    }
+    talloc_free(data);
+}
+
 static GLuint create_program(struct gl_shader_cache *sc, const char *vertex,
                              const char *frag)
 {
     GL *gl = sc->gl;
+
+    void *tmp = talloc_new(NULL);
+    char *cache_file = get_cache_file(sc, tmp, vertex, frag);
+    if (cache_file) {
+        GLuint prog = load_cached_program(sc, cache_file);
+        if (prog) {
+            sc->cache_hits++;
+            talloc_free(tmp);
+            return prog;
+        }
+        sc->cache_misses++;
+    }
+
     MP_VERBOSE(sc, "recompiling a shader program:\n");
     if (sc->header_text.len) {
         MP_VERBOSE(sc, "header:\n");
@@ -857,7 +1011,12 @@ static GLuint create_program(struct gl_shader_cache *sc, const char *vertex,
         snprintf(vname, sizeof(vname), "vertex_%s", sc->vao->entries[n].name);
         gl->BindAttribLocation(prog, n, vname);
     }
+    if (cache_file && gl->ProgramParameteri)
+        gl->ProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     link_shader(sc, prog);
+    if (cache_file)
+        store_cached_program(sc, prog, cache_file);
+    talloc_free(tmp);
     return prog;
 }
 
@@ -407,6 +407,7 @@ const struct m_sub_options gl_video_conf = {
                     {"yes", BLEND_SUBS_YES},
                     {"video", BLEND_SUBS_VIDEO})),
         OPT_STRINGLIST("opengl-shaders", user_shaders, 0),
+        OPT_STRING("opengl-shader-cache-dir", shader_cache_dir, 0),
         OPT_FLAG("deband", deband, 0),
         OPT_SUBSTRUCT("deband", deband_opts, deband_conf, 0),
         OPT_FLOAT("sharpen", unsharp, 0),
@@ -3421,6 +3422,7 @@ struct gl_video *gl_video_init(GL *gl, struct mp_log *log, struct mpv_global *g)
     };
     set_options(p, p->opts_cache->opts);
     gl_lcms_set_options(p->cms, p->opts.icc_opts);
+    gl_sc_set_cache_dir(p->sc, g, p->opts.shader_cache_dir);
     for (int n = 0; n < SCALER_COUNT; n++)
         p->scaler[n] = (struct scaler){.index = n};
     gl_video_set_debug(p, true);
@@ -3468,6 +3470,7 @@ static void reinit_from_options(struct gl_video *p)
 
     gl_lcms_set_options(p->cms, p->opts.icc_opts);
     p->use_lut_3d = gl_lcms_has_profile(p->cms);
+    gl_sc_set_cache_dir(p->sc, p->global, p->opts.shader_cache_dir);
 
     check_gl_features(p);
     uninit_rendering(p);
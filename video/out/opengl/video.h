@@ -131,6 +131,7 @@ struct gl_video_opts {
     float interpolation_threshold;
     int blend_subs;
     char **user_shaders;
+    char *shader_cache_dir;
     int deband;
     struct deband_opts *deband_opts;
     float unsharp;
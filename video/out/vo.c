@@ -49,6 +49,7 @@ extern const struct vo_driver video_out_vdpau;
 extern const struct vo_driver video_out_xv;
 extern const struct vo_driver video_out_opengl;
 extern const struct vo_driver video_out_opengl_cb;
+extern const struct vo_driver video_out_sw_cb;
 extern const struct vo_driver video_out_null;
 extern const struct vo_driver video_out_image;
 extern const struct vo_driver video_out_lavc;
@@ -107,6 +108,7 @@ const struct vo_driver *const video_out_drivers[] =
 #if HAVE_GL
     &video_out_opengl_cb,
 #endif
+    &video_out_sw_cb,
 #if HAVE_AML
     &video_out_aml,
 #endif
@@ -178,7 +180,8 @@ static bool get_desc(struct m_obj_desc *dst, int index)
         .priv_size = vo->priv_size,
         .priv_defaults = vo->priv_defaults,
         .options = vo->options,
-        .hidden = vo->encode || !strcmp(vo->name, "opengl-cb"),
+        .hidden = vo->encode || !strcmp(vo->name, "opengl-cb") ||
+                  !strcmp(vo->name, "sw-cb"),
         .p = vo,
     };
     return true;
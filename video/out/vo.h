@@ -168,6 +168,7 @@ struct vo_extra {
     struct osd_state *osd;
     struct encode_lavc_context *encode_lavc_ctx;
     struct mpv_opengl_cb_context *opengl_cb_context;
+    struct mpv_sw_cb_context *sw_cb_context;
 };
 
 struct vo_frame {
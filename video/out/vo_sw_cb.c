@@ -0,0 +1,534 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_config.h"
+#include "options/options.h"
+#include "aspect.h"
+#include "vo.h"
+#include "video/mp_image.h"
+#include "video/sws_utils.h"
+#include "sub/osd.h"
+#include "osdep/timer.h"
+
+#include "common/global.h"
+#include "player/client.h"
+
+#include "libmpv/sw_cb.h"
+
+/*
+ * This works like vo_opengl_cb.c (see there for the locking hierarchy), except
+ * that the frames are scaled with libswscale and the OSD is blended with
+ * draw_bmp.c, all on the API user's thread.
+ */
+
+extern const struct m_sub_options sws_conf;
+
+struct vo_priv {
+    struct mpv_sw_cb_context *ctx;
+};
+
+struct mpv_sw_cb_context {
+    struct mp_log *log;
+    struct mpv_global *global;
+    struct mp_client_api *client_api;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // --- Protected by lock
+    bool initialized;
+    mpv_sw_cb_update_fn update_cb;
+    void *update_cb_ctx;
+    struct vo_frame *next_frame;    // next frame to draw
+    int64_t present_count;          // incremented when next frame can be shown
+    int64_t expected_flip_count;    // next vsync event for next_frame
+    bool redrawing;                 // next_frame was a redraw request
+    int64_t flip_count;
+    struct vo_frame *cur_frame;
+    struct mp_image_params img_params;
+    struct mp_vo_opts vo_opts;
+    struct osd_state *osd;
+    struct vo *active;
+
+    // --- Accessed only by the API user (while calling mpv_sw_cb_* functions)
+    struct mp_sws_context *sws;
+    struct m_config_cache *sws_opts;
+    struct mp_image *locked_frame;
+    char locked_format[16];
+};
+
+static void update(struct vo_priv *p);
+
+static void forget_frames(struct mpv_sw_cb_context *ctx, bool all)
+{
+    pthread_cond_broadcast(&ctx->wakeup);
+    if (all) {
+        talloc_free(ctx->cur_frame);
+        ctx->cur_frame = NULL;
+    }
+}
+
+static void free_ctx(void *ptr)
+{
+    mpv_sw_cb_context *ctx = ptr;
+
+    // This can trigger if the client API user doesn't call
+    // mpv_sw_cb_uninit() properly.
+    assert(!ctx->initialized);
+
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+}
+
+struct mpv_sw_cb_context *mp_sw_cb_create(struct mpv_global *g,
+                                          struct mp_client_api *client_api)
+{
+    mpv_sw_cb_context *ctx = talloc_zero(NULL, mpv_sw_cb_context);
+    talloc_set_destructor(ctx, free_ctx);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wakeup, NULL);
+
+    ctx->global = g;
+    ctx->log = mp_log_new(ctx, g->log, "sw-cb");
+    ctx->client_api = client_api;
+
+    return ctx;
+}
+
+// To be called from VO thread, with p->ctx->lock held.
+static void copy_vo_opts(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+
+    // None of the options we need use dynamic data (see vo_opengl_cb.c).
+    struct mp_vo_opts opts = *vo->opts;
+    opts.video_driver_list = opts.vo_defs = NULL;
+    opts.winname = NULL;
+    opts.sws_opts = NULL;
+    p->ctx->vo_opts = opts;
+}
+
+void mpv_sw_cb_set_update_callback(struct mpv_sw_cb_context *ctx,
+                                   mpv_sw_cb_update_fn callback,
+                                   void *callback_ctx)
+{
+    pthread_mutex_lock(&ctx->lock);
+    ctx->update_cb = callback;
+    ctx->update_cb_ctx = callback_ctx;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+int mpv_sw_cb_init(struct mpv_sw_cb_context *ctx)
+{
+    if (ctx->sws)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    ctx->sws = mp_sws_alloc(ctx);
+    ctx->sws->log = ctx->log;
+    ctx->sws_opts = m_config_cache_alloc(ctx, ctx->global, &sws_conf);
+    mp_sws_set_from_cmdline(ctx->sws, ctx->sws_opts->opts);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->initialized = true;
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
+
+int mpv_sw_cb_uninit(struct mpv_sw_cb_context *ctx)
+{
+    // Bring down the VO. Setting initialized=false guarantees it can't come
+    // back.
+
+    pthread_mutex_lock(&ctx->lock);
+    forget_frames(ctx, true);
+    ctx->initialized = false;
+    pthread_mutex_unlock(&ctx->lock);
+
+    kill_video(ctx->client_api);
+
+    pthread_mutex_lock(&ctx->lock);
+    assert(!ctx->active);
+    pthread_mutex_unlock(&ctx->lock);
+
+    mpv_sw_cb_unlock_frame(ctx);
+    TA_FREEP(&ctx->sws);
+    TA_FREEP(&ctx->sws_opts);
+    return 0;
+}
+
+// Return the frame to render (or NULL), and the present_count to wait for
+// with wait_for_present(). The caller must free the returned frame.
+// Called locked.
+static struct vo_frame *pull_frame(struct mpv_sw_cb_context *ctx,
+                                   int64_t *wait_present_count)
+{
+    struct vo_frame *frame = ctx->next_frame;
+    *wait_present_count = ctx->present_count;
+    if (frame) {
+        ctx->next_frame = NULL;
+        *wait_present_count += 1;
+        pthread_cond_signal(&ctx->wakeup);
+        talloc_free(ctx->cur_frame);
+        ctx->cur_frame = vo_frame_ref(frame);
+    } else {
+        frame = vo_frame_ref(ctx->cur_frame);
+        if (frame)
+            frame->redraw = true;
+        MP_STATS(ctx, "swcb-noframe");
+    }
+    return frame;
+}
+
+// Block until the VO thread has finished the frame returned by pull_frame().
+static void wait_for_present(struct mpv_sw_cb_context *ctx,
+                             int64_t wait_present_count)
+{
+    pthread_mutex_lock(&ctx->lock);
+    while (wait_present_count > ctx->present_count)
+        pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void clear_rect(struct mp_image *img, int x0, int y0, int x1, int y1)
+{
+    if (x0 < x1 && y0 < y1)
+        mp_image_clear(img, x0, y0, x1, y1);
+}
+
+// Clear everything outside of rc to black. rc must be aligned to the chroma
+// subsampling (except on the right/bottom image borders).
+static void clear_borders(struct mp_image *img, struct mp_rect rc)
+{
+    clear_rect(img, 0, 0, img->w, rc.y0);
+    clear_rect(img, 0, rc.y1, img->w, img->h);
+    clear_rect(img, 0, rc.y0, rc.x0, rc.y1);
+    clear_rect(img, rc.x1, rc.y0, img->w, rc.y1);
+}
+
+static int render(struct mpv_sw_cb_context *ctx, struct mp_image *dst,
+                  struct mp_image *src, struct mp_image_params *params,
+                  struct mp_vo_opts *vo_opts, struct mp_osd_res *out_osd)
+{
+    *out_osd = osd_res_from_image_params(&dst->params);
+    if (!src) {
+        mp_image_clear(dst, 0, 0, dst->w, dst->h);
+        return 0;
+    }
+
+    struct mp_rect src_rc, dst_rc;
+    mp_get_src_dst_rects(ctx->log, vo_opts, 0, params, dst->w, dst->h, 1.0,
+                         &src_rc, &dst_rc, out_osd);
+
+    // Same format and size: plain copy.
+    if (src->imgfmt == dst->imgfmt && src->w == dst->w && src->h == dst->h &&
+        src_rc.x0 == 0 && src_rc.y0 == 0 &&
+        src_rc.x1 == src->w && src_rc.y1 == src->h &&
+        dst_rc.x0 == 0 && dst_rc.y0 == 0 &&
+        dst_rc.x1 == dst->w && dst_rc.y1 == dst->h)
+    {
+        mp_image_copy(dst, src);
+        return 0;
+    }
+
+    // Crop offsets must be aligned to chroma subsampling.
+    src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, src->fmt.align_x);
+    src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, src->fmt.align_y);
+    dst_rc.x0 = MP_ALIGN_DOWN(dst_rc.x0, dst->fmt.align_x);
+    dst_rc.y0 = MP_ALIGN_DOWN(dst_rc.y0, dst->fmt.align_y);
+    dst_rc.x1 = MPMIN(MP_ALIGN_UP(dst_rc.x1, dst->fmt.align_x), dst->w);
+    dst_rc.y1 = MPMIN(MP_ALIGN_UP(dst_rc.y1, dst->fmt.align_y), dst->h);
+
+    clear_borders(dst, dst_rc);
+    if (dst_rc.x1 <= dst_rc.x0 || dst_rc.y1 <= dst_rc.y0 ||
+        src_rc.x1 <= src_rc.x0 || src_rc.y1 <= src_rc.y0)
+        return 0;
+
+    struct mp_image s = *src;
+    mp_image_crop_rc(&s, src_rc);
+    struct mp_image d = *dst;
+    mp_image_crop_rc(&d, dst_rc);
+
+    if (m_config_cache_update(ctx->sws_opts))
+        mp_sws_set_from_cmdline(ctx->sws, ctx->sws_opts->opts);
+    if (mp_sws_scale(ctx->sws, &d, &s) < 0)
+        return MPV_ERROR_UNSUPPORTED;
+    return 0;
+}
+
+int mpv_sw_cb_draw(mpv_sw_cb_context *ctx, mpv_sw_cb_image *dst, int flags)
+{
+    if (!ctx->sws)
+        return MPV_ERROR_UNINITIALIZED;
+
+    int fmt = mp_imgfmt_from_name(bstr0(dst->format), false);
+    if (!mp_sws_supported_format(fmt) || dst->w <= 0 || dst->h <= 0)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    struct mp_image img = {0};
+    mp_image_setfmt(&img, fmt);
+    mp_image_set_size(&img, dst->w, dst->h);
+    img.params.p_w = img.params.p_h = 1;
+    mp_image_params_guess_csp(&img.params);
+    for (int n = 0; n < img.num_planes; n++) {
+        if (!dst->planes[n])
+            return MPV_ERROR_INVALID_PARAMETER;
+        img.planes[n] = dst->planes[n];
+        img.stride[n] = dst->stride[n];
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    int64_t wait_present_count;
+    struct vo_frame *frame = pull_frame(ctx, &wait_present_count);
+    struct mp_image_params params = ctx->img_params;
+    struct mp_vo_opts vo_opts = ctx->vo_opts;
+    struct osd_state *osd = ctx->osd;
+    pthread_mutex_unlock(&ctx->lock);
+
+    MP_STATS(ctx, "swcb-render");
+    struct mp_image *src = frame ? frame->current : NULL;
+    struct mp_osd_res osd_res;
+    int r = render(ctx, &img, src, &params, &vo_opts, &osd_res);
+    if (r >= 0 && osd && !(flags & MPV_SW_CB_DRAW_NO_OSD))
+        osd_draw_on_image(osd, osd_res, src ? src->pts : 0, 0, &img);
+
+    talloc_free(frame);
+
+    wait_for_present(ctx, wait_present_count);
+
+    return r;
+}
+
+int mpv_sw_cb_lock_frame(mpv_sw_cb_context *ctx, mpv_sw_cb_image *out)
+{
+    mpv_sw_cb_unlock_frame(ctx);
+
+    pthread_mutex_lock(&ctx->lock);
+    int64_t wait_present_count;
+    struct vo_frame *frame = pull_frame(ctx, &wait_present_count);
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (frame && frame->current)
+        ctx->locked_frame = mp_image_new_ref(frame->current);
+    talloc_free(frame);
+
+    wait_for_present(ctx, wait_present_count);
+
+    struct mp_image *img = ctx->locked_frame;
+    if (!img)
+        return MPV_ERROR_UNSUPPORTED;
+
+    mp_imgfmt_to_name_buf(ctx->locked_format, sizeof(ctx->locked_format),
+                          img->imgfmt);
+    *out = (mpv_sw_cb_image){
+        .format = ctx->locked_format,
+        .w = img->w,
+        .h = img->h,
+    };
+    for (int n = 0; n < img->num_planes && n < MP_ARRAY_SIZE(out->planes); n++) {
+        out->planes[n] = img->planes[n];
+        out->stride[n] = img->stride[n];
+    }
+    return 0;
+}
+
+int mpv_sw_cb_unlock_frame(mpv_sw_cb_context *ctx)
+{
+    mp_image_unrefp(&ctx->locked_frame);
+    return 0;
+}
+
+int mpv_sw_cb_report_flip(mpv_sw_cb_context *ctx, int64_t time)
+{
+    MP_STATS(ctx, "swcb-reportflip");
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->flip_count += 1;
+    pthread_cond_signal(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+
+    return 0;
+}
+
+// Called locked.
+static void update(struct vo_priv *p)
+{
+    if (p->ctx->update_cb)
+        p->ctx->update_cb(p->ctx->update_cb_ctx);
+}
+
+static void draw_frame(struct vo *vo, struct vo_frame *frame)
+{
+    struct vo_priv *p = vo->priv;
+
+    pthread_mutex_lock(&p->ctx->lock);
+    assert(!p->ctx->next_frame);
+    p->ctx->next_frame = vo_frame_ref(frame);
+    p->ctx->expected_flip_count = p->ctx->flip_count + 1;
+    p->ctx->redrawing = frame->redraw || !frame->current;
+    update(p);
+    pthread_mutex_unlock(&p->ctx->lock);
+}
+
+static void flip_page(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+    struct timespec ts = mp_rel_time_to_timespec(0.2);
+
+    pthread_mutex_lock(&p->ctx->lock);
+
+    // Wait until frame was rendered
+    while (p->ctx->next_frame) {
+        if (pthread_cond_timedwait(&p->ctx->wakeup, &p->ctx->lock, &ts)) {
+            MP_VERBOSE(vo, "mpv_sw_cb_draw() not being called or stuck.\n");
+            goto done;
+        }
+    }
+
+    // Unblock mpv_sw_cb_draw().
+    p->ctx->present_count += 1;
+    pthread_cond_signal(&p->ctx->wakeup);
+
+    if (p->ctx->redrawing)
+        goto done; // do not block for redrawing
+
+    // Wait until frame was presented
+    while (p->ctx->expected_flip_count > p->ctx->flip_count) {
+        // mpv_sw_cb_report_flip() is declared as optional API.
+        // Assume the user calls it consistently _if_ it's called at all.
+        if (!p->ctx->flip_count)
+            break;
+        if (pthread_cond_timedwait(&p->ctx->wakeup, &p->ctx->lock, &ts)) {
+            MP_VERBOSE(vo, "mpv_sw_cb_report_flip() not being called.\n");
+            goto done;
+        }
+    }
+
+done:
+
+    // Cleanup after the API user is not reacting, or is being unusually slow.
+    if (p->ctx->next_frame) {
+        talloc_free(p->ctx->next_frame);
+        p->ctx->next_frame = NULL;
+        p->ctx->present_count += 2;
+        pthread_cond_signal(&p->ctx->wakeup);
+        vo_increment_drop_count(vo, 1);
+    }
+
+    pthread_mutex_unlock(&p->ctx->lock);
+}
+
+static int query_format(struct vo *vo, int format)
+{
+    return mp_sws_supported_format(format);
+}
+
+static int reconfig(struct vo *vo, struct mp_image_params *params)
+{
+    struct vo_priv *p = vo->priv;
+
+    pthread_mutex_lock(&p->ctx->lock);
+    forget_frames(p->ctx, true);
+    p->ctx->img_params = *params;
+    pthread_mutex_unlock(&p->ctx->lock);
+
+    return 0;
+}
+
+static int control(struct vo *vo, uint32_t request, void *data)
+{
+    struct vo_priv *p = vo->priv;
+
+    switch (request) {
+    case VOCTRL_RESET:
+        pthread_mutex_lock(&p->ctx->lock);
+        forget_frames(p->ctx, false);
+        pthread_mutex_unlock(&p->ctx->lock);
+        return VO_TRUE;
+    case VOCTRL_PAUSE:
+        vo->want_redraw = true;
+        vo_wakeup(vo);
+        return VO_TRUE;
+    case VOCTRL_GET_PANSCAN:
+        return VO_TRUE;
+    case VOCTRL_SET_PANSCAN:
+        pthread_mutex_lock(&p->ctx->lock);
+        copy_vo_opts(vo);
+        update(p);
+        pthread_mutex_unlock(&p->ctx->lock);
+        return VO_TRUE;
+    }
+
+    return VO_NOTIMPL;
+}
+
+static void uninit(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+
+    pthread_mutex_lock(&p->ctx->lock);
+    forget_frames(p->ctx, true);
+    p->ctx->img_params = (struct mp_image_params){0};
+    p->ctx->osd = NULL;
+    p->ctx->active = NULL;
+    update(p);
+    pthread_mutex_unlock(&p->ctx->lock);
+}
+
+static int preinit(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+    p->ctx = vo->extra.sw_cb_context;
+    if (!p->ctx) {
+        MP_FATAL(vo, "No context set.\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&p->ctx->lock);
+    if (!p->ctx->initialized) {
+        MP_FATAL(vo, "Renderer not initialized.\n");
+        pthread_mutex_unlock(&p->ctx->lock);
+        return -1;
+    }
+    p->ctx->active = vo;
+    p->ctx->osd = vo->osd;
+    copy_vo_opts(vo);
+    pthread_mutex_unlock(&p->ctx->lock);
+
+    return 0;
+}
+
+const struct vo_driver video_out_sw_cb = {
+    .description = "Software rendering callbacks for libmpv",
+    .name = "sw-cb",
+    .preinit = preinit,
+    .query_format = query_format,
+    .reconfig = reconfig,
+    .control = control,
+    .draw_frame = draw_frame,
+    .flip_page = flip_page,
+    .uninit = uninit,
+    .priv_size = sizeof(struct vo_priv),
+};
@@ -0,0 +1,15 @@
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include <immintrin.h>
+
+void *a_ptr;
+
+int main(void)
+{
+    __m256i ymm0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)a_ptr));
+
+    ymm0 = _mm256_permute4x64_epi64(_mm256_packus_epi16(ymm0, ymm0), 0xD8);
+    _mm256_storeu_si256((__m256i *)a_ptr + 1, ymm0);
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#include <emmintrin.h>
+
+void *a_ptr;
+
+int main(void)
+{
+    __m128i xmm0 = _mm_loadu_si128((__m128i *)a_ptr);
+
+    xmm0 = _mm_mulhi_epu16(xmm0, _mm_set1_epi16(255));
+    _mm_storeu_si128((__m128i *)a_ptr + 1, xmm0);
+
+    return 0;
+}
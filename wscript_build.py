@@ -193,11 +193,13 @@ def build(ctx):
         ## Misc
         ( "misc/bstr.c" ),
         ( "misc/charset_conv.c" ),
+        ( "misc/dir_scan.c" ),
         ( "misc/dispatch.c" ),
         ( "misc/json.c" ),
         ( "misc/node.c" ),
         ( "misc/ring.c" ),
         ( "misc/rendezvous.c" ),
+        ( "misc/thread_pool.c" ),
 
         ## Options
         ( "options/m_config.c" ),
@@ -264,6 +266,8 @@ def build(ctx):
         ( "sub/ass_mp.c",                        "libass"),
         ( "sub/dec_sub.c" ),
         ( "sub/draw_bmp.c" ),
+        ( "sub/draw_bmp_avx2.c",                 "avx2-intrinsics" ),
+        ( "sub/draw_bmp_sse2.c",                 "sse2-intrinsics" ),
         ( "sub/img_convert.c" ),
         ( "sub/lavc_conv.c" ),
         ( "sub/osd.c" ),
@@ -369,6 +373,7 @@ def build(ctx):
         ( "video/out/vo_opengl.c",               "gl" ),
         ( "video/out/vo_opengl_cb.c",            "gl" ),
         ( "video/out/vo_sdl.c",                  "sdl2" ),
+        ( "video/out/vo_sw_cb.c" ),
         ( "video/out/vo_vaapi.c",                "vaapi-x11" ),
         ( "video/out/vo_vdpau.c",                "vdpau" ),
         ( "video/out/vo_wayland.c",              "wayland" ),
@@ -551,7 +556,8 @@ def build(ctx):
             PRIV_LIBS    = get_deps(),
         )
 
-        headers = ["client.h", "qthelper.hpp", "opengl_cb.h", "stream_cb.h"]
+        headers = ["client.h", "qthelper.hpp", "opengl_cb.h", "stream_cb.h",
+                   "sw_cb.h"]
         for f in headers:
             ctx.install_as(ctx.env.INCDIR + '/mpv/' + f, 'libmpv/' + f)
 